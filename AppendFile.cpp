@@ -0,0 +1,191 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/AppendFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+
+namespace nsBase
+{
+
+AppendFile::~AppendFile()
+{
+    close();
+}
+
+
+AppendFile::AppendFile(
+    AppendFile && src
+)
+{
+    ::std::swap(m_fd, src.m_fd);
+}
+
+
+AppendFile &
+AppendFile::operator=(
+    AppendFile && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        ::std::swap(m_fd, src.m_fd);
+    }
+
+    return *this;
+}
+
+
+bool
+AppendFile::open(
+    ::fs::path const & path
+)
+{
+    close();
+
+#ifdef _WIN32
+    m_fd = ::_wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY | _O_NOINHERIT, _S_IREAD | _S_IWRITE);
+#else
+    do
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    while (m_fd<0 && errno==EINTR);
+#endif
+
+    return is_open();
+}
+
+
+void
+AppendFile::close()
+{
+    if (!is_open())
+        return;
+
+#ifdef _WIN32
+    ::_close(m_fd);
+#else
+    ::close(m_fd);
+#endif
+
+    m_fd = -1;
+}
+
+
+bool
+AppendFile::write(
+    ::std::string_view const & data_
+)
+{
+    if (!is_open())
+        return false;
+
+    auto
+        data = data_;
+
+    // a regular file only writes partially on errors like a full disk
+    while (!data.empty())
+    {
+#ifdef _WIN32
+        auto n = ::_write(m_fd, data.data(), unsigned(::std::min<::std::size_t>(data.size(), INT_MAX)));
+#else
+        auto n = ::write(m_fd, data.data(), data.size());
+
+        if (n<0 && errno==EINTR)
+            continue;
+#endif
+        if (n<=0)
+            return false;
+
+        data.remove_prefix(::std::size_t(n));
+    }
+
+    return true;
+}
+
+
+bool
+AppendFile::writev(
+    ::std::span<::std::string_view const> buffers
+)
+{
+    if (!is_open())
+        return false;
+
+#ifdef _WIN32
+    ::std::string
+        joined;
+
+    for (auto & b : buffers)
+        joined += b;
+
+    return write(joined);
+#else
+    ::std::vector<::iovec>
+        iov;
+        iov.reserve(buffers.size());
+
+    for (auto & b : buffers)
+        if (!b.empty())
+            iov.push_back({const_cast<char*>(b.data()), b.size()});
+
+    auto
+        first = 0_sz;
+
+    while (first<iov.size())
+    {
+        auto count = int(::std::min<::std::size_t>(iov.size()-first, IOV_MAX));
+        auto n     = ::writev(m_fd, iov.data()+first, count);
+
+        if (n<0 && errno==EINTR)
+            continue;
+
+        if (n<=0)
+            return false;
+
+        // skip what got written, continue behind a partial write
+        auto done = ::std::size_t(n);
+
+        while (first<iov.size() && done>=iov[first].iov_len)
+            done -= iov[first++].iov_len;
+
+        if (done)
+        {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + done;
+            iov[first].iov_len -= done;
+        }
+    }
+
+    return true;
+#endif
+}
+
+
+bool
+AppendFile::sync()
+{
+    if (!is_open())
+        return false;
+
+#ifdef _WIN32
+    return ::_commit(m_fd)==0;
+#else
+    return ::fsync(m_fd)==0;
+#endif
+}
+
+}
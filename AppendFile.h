@@ -0,0 +1,82 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/filesystem.h"
+
+#include <span>
+#include <string_view>
+
+
+namespace nsBase
+{
+
+/**
+    A file opened in append mode (O_APPEND) that is written without any
+    user-space buffering.
+
+    Each write() or writev() is a single system call. Since the kernel
+    positions every append atomically at the end of the file, concurrent
+    appends of complete lines - even from several processes - do not
+    interleave.
+*/
+class AppendFile
+{
+    R_DTOR(AppendFile);
+    R_CTOR(AppendFile) = default;
+    R_CCPY(AppendFile) = delete;
+    R_CMOV(AppendFile);
+    R_COPY(AppendFile) = delete;
+    R_MOVE(AppendFile);
+
+    /** Open or create the target file.
+        \return FALSE on failure.
+    */
+    public : bool
+        open(
+                ::fs::path const & path
+            );
+
+    public : bool
+        is_open() const
+            {
+                return m_fd>=0;
+            }
+
+    public : void
+        close();
+
+    /** Append the data with a single system call.
+        \return FALSE on failure.
+    */
+    public : bool
+        write(
+                ::std::string_view const & data
+            );
+
+    /** Append all buffers with a single system call (writev(2) if available).
+        \return FALSE on failure.
+    */
+    public : bool
+        writev(
+                ::std::span<::std::string_view const> buffers
+            );
+
+    /** Force the written data to the storage device.
+    */
+    public : bool
+        sync();
+
+    /** The native file descriptor, -1 if closed.
+    */
+    public : int
+        fd() const
+            {
+                return m_fd;
+            }
+
+    private : int
+        m_fd {-1};
+};
+
+}
@@ -0,0 +1,821 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/AsyncAppendFile.h"
+#include "r_base/AppendFile.h"
+#include "r_base/concurrent.h"
+#include "r_base/log_metrics.h"
+#include "r_base/on_delete.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define R_ASYNC_APPEND_FILE_IO_URING
+#endif
+#endif
+
+
+namespace nsBase
+{
+
+struct
+AsyncAppendFile::Target
+{
+    AppendFile
+        file;
+
+    ::std::mutex
+        mutex;
+
+    ::std::condition_variable
+        cv_idle;
+
+    // count of queued Jobs
+    ::std::size_t
+        pending {};
+
+    bool
+        failed {};
+
+    void
+        done(
+                ::std::size_t count
+            ,   bool          ok
+            )
+            {
+                {
+                    ::std::lock_guard<::std::mutex>
+                        guard(mutex);
+
+                    pending -= count;
+
+                    if (!ok)
+                        failed = true;
+                }
+
+                cv_idle.notify_all();
+            }
+};
+
+
+namespace
+{
+using target_ref_t = ::std::shared_ptr<AsyncAppendFile::Target>;
+
+struct
+    Job
+        {
+            target_ref_t
+                target;
+
+            ::std::string
+                data;
+
+            bool
+                durable {};
+        };
+
+using jobs_t = ::std::deque<Job>;
+
+
+/// write the Jobs [first,last) of the same target with a single writev()
+bool
+    write_group_sync(
+            jobs_t::iterator first
+        ,   jobs_t::iterator last
+        )
+        {
+            ::std::vector<::std::string_view>
+                buffers;
+
+            auto
+                durable = false;
+
+            for (auto it = first; it!=last; ++it)
+            {
+                buffers.push_back(it->data);
+                durable |= it->durable;
+            }
+
+            auto &
+                file = first->target->file;
+
+            auto
+                ok = file.writev(buffers);
+
+            if (ok && durable)
+                ok = file.sync();
+
+            return ok;
+        }
+
+
+#ifdef R_ASYNC_APPEND_FILE_IO_URING
+/**
+    The minimal subset of io_uring used by the writer, talking to the kernel
+    by raw system calls.
+*/
+class
+    Ring
+        {
+            public : static constexpr unsigned
+                c_entries = 32;
+
+            public : static constexpr ::std::size_t
+                c_buffer_count = 8;
+
+            public : static constexpr ::std::size_t
+                c_buffer_size = 256_sz<<10;
+
+            private : int
+                m_fd {-1};
+
+            private : void *            m_sq_ptr  {MAP_FAILED};
+            private : ::std::size_t     m_sq_len  {};
+            private : void *            m_cq_ptr  {MAP_FAILED};
+            private : ::std::size_t     m_cq_len  {};
+            private : ::io_uring_sqe *  m_sqes    {static_cast<::io_uring_sqe*>(MAP_FAILED)};
+            private : ::std::size_t     m_sqes_len{};
+
+            private : unsigned *        m_sq_tail {};
+            private : unsigned *        m_sq_mask {};
+            private : unsigned *        m_sq_array{};
+            private : unsigned *        m_cq_head {};
+            private : unsigned *        m_cq_tail {};
+            private : unsigned *        m_cq_mask {};
+            private : ::io_uring_cqe *  m_cqes    {};
+
+            private : unsigned
+                m_sq_local_tail {};
+
+            public : ::std::vector<::std::unique_ptr<char[]>>
+                buffers;
+
+            public :
+                ~Ring()
+                    {
+                        if (m_sqes!=MAP_FAILED)                     ::munmap(m_sqes, m_sqes_len);
+                        if (m_cq_ptr!=MAP_FAILED && m_cq_ptr!=m_sq_ptr) ::munmap(m_cq_ptr, m_cq_len);
+                        if (m_sq_ptr!=MAP_FAILED)                   ::munmap(m_sq_ptr, m_sq_len);
+                        if (m_fd>=0)                                ::close(m_fd);
+                    }
+
+            /// \return FALSE if io_uring is not usable
+            public : bool
+                init()
+                    {
+                        ::io_uring_params
+                            p {};
+
+                        m_fd = int(::syscall(__NR_io_uring_setup, c_entries, &p));
+
+                        if (m_fd<0)
+                            return false;
+
+                        m_sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+                        m_cq_len = p.cq_off.cqes  + p.cq_entries * sizeof(::io_uring_cqe);
+
+                        auto
+                            single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP)!=0;
+
+                        if (single_mmap)
+                            m_sq_len = m_cq_len = ::std::max(m_sq_len, m_cq_len);
+
+                        m_sq_ptr = ::mmap(nullptr, m_sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+
+                        if (m_sq_ptr==MAP_FAILED)
+                            return false;
+
+                        m_cq_ptr = single_mmap
+                            ?   m_sq_ptr
+                            :   ::mmap(nullptr, m_cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING)
+                            ;
+
+                        if (m_cq_ptr==MAP_FAILED)
+                            return false;
+
+                        m_sqes_len = p.sq_entries * sizeof(::io_uring_sqe);
+                        m_sqes     = static_cast<::io_uring_sqe*>(::mmap(nullptr, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES));
+
+                        if (m_sqes==MAP_FAILED)
+                            return false;
+
+                        auto sq = static_cast<char*>(m_sq_ptr);
+                        auto cq = static_cast<char*>(m_cq_ptr);
+
+                        m_sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+                        m_sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+                        m_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+                        m_cq_head  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+                        m_cq_tail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+                        m_cq_mask  = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+                        m_cqes     = reinterpret_cast<::io_uring_cqe*>(cq + p.cq_off.cqes);
+
+                        m_sq_local_tail = *m_sq_tail;
+
+                        // the registered buffers stay pinned by the kernel
+                        ::std::vector<::iovec>
+                            iov;
+
+                        for (auto i = 0_sz; i<c_buffer_count; ++i)
+                        {
+                            buffers.emplace_back(new char[c_buffer_size]);
+                            iov.push_back({buffers.back().get(), c_buffer_size});
+                        }
+
+                        return ::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, iov.data(), unsigned(iov.size()))==0;
+                    }
+
+            public : ::io_uring_sqe &
+                sqe_next()
+                    {
+                        auto
+                            index = m_sq_local_tail & *m_sq_mask;
+
+                        auto &
+                            sqe = m_sqes[index];
+
+                        ::std::memset(&sqe, 0, sizeof(sqe));
+
+                        m_sq_array[index] = index;
+                        ++m_sq_local_tail;
+
+                        return sqe;
+                    }
+
+            /** Submit the prepared entries and wait for the completion of all of them.
+                If the kernel fails to take entries, the completions of the entries
+                it took are still reaped.
+                \param submitted The count of the entries the kernel took.
+                \return FALSE if the ring is not usable anymore: entries not taken
+                    stay in the submission queue, and if the reaping failed too,
+                    the completion of the entries in flight is unknown.
+            */
+            public : template<typename F>
+                bool
+                submit_and_reap(
+                        unsigned   count
+                    ,   unsigned & submitted
+                    ,   F       && on_completion
+                    )
+                    {
+                        ::std::atomic_ref<unsigned>(*m_sq_tail).store(m_sq_local_tail, ::std::memory_order_release);
+
+                        submitted = 0;
+
+                        auto
+                            reaped = 0u;
+
+                        auto
+                            ok = true;
+
+                        while (reaped<submitted || (ok && submitted<count))
+                        {
+                            auto
+                                to_submit = ok ? count-submitted : 0u;
+
+                            auto
+                                rc = ::syscall(__NR_io_uring_enter, m_fd, to_submit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+                            if (rc<0)
+                            {
+                                if (errno==EINTR)
+                                    continue;
+
+                                // the completions of the entries in flight are lost
+                                if (!ok)
+                                    return false;
+
+                                ok = false;
+                                continue;
+                            }
+
+                            if (ok)
+                                submitted += unsigned(rc);
+
+                            auto head = ::std::atomic_ref<unsigned>(*m_cq_head).load(::std::memory_order_relaxed);
+                            auto tail = ::std::atomic_ref<unsigned>(*m_cq_tail).load(::std::memory_order_acquire);
+
+                            for (; head!=tail; ++head, ++reaped)
+                            {
+                                auto &
+                                    cqe = m_cqes[head & *m_cq_mask];
+
+                                on_completion(cqe.user_data, cqe.res);
+                            }
+
+                            ::std::atomic_ref<unsigned>(*m_cq_head).store(head, ::std::memory_order_release);
+                        }
+
+                        return ok;
+                    }
+        };
+#endif
+
+
+struct
+    Writer
+        {
+            /// the appends queued at most, append() waits while the queue is full
+            static constexpr int
+                c_jobs_max = 4096;
+
+            concurrent::channel<Job>
+                jobs {c_jobs_max};
+
+            ::std::atomic<::std::size_t>
+                queued_bytes {};
+
+            on_delete
+                metrics_registration;
+
+#ifdef R_ASYNC_APPEND_FILE_IO_URING
+            ::std::unique_ptr<Ring>
+                ring;
+#endif
+
+            /// false once the ring failed, readable by other threads
+            ::std::atomic_bool
+                uses_ring {};
+
+            void
+                write_sync(
+                        jobs_t::iterator first
+                    ,   jobs_t::iterator end
+                    )
+                    {
+                        while (first!=end)
+                        {
+                            auto
+                                last = ::std::find_if(first, end, [&](Job const & j){return j.target!=first->target;});
+
+                            first->target->done(::std::size_t(last-first), write_group_sync(first, last));
+
+                            first = last;
+                        }
+                    }
+
+#ifdef R_ASYNC_APPEND_FILE_IO_URING
+            /**
+                Pack the Jobs into the registered buffers, one chunk per write.
+                All entries of a round are linked, so appends keep their order
+                and a fsync follows the writes it belongs to.
+                Whatever the completions report as not completely written gets
+                rewritten synchronously.
+
+                If the ring fails, it is given up and the rest of the batch is
+                written synchronously. A chunk whose completion got lost is not
+                rewritten, since it might be written anyway, and its Jobs fail.
+            */
+            void
+                write_ring(
+                        jobs_t & batch
+                    )
+                    {
+                        auto & r = *ring;
+
+                        struct
+                            Chunk
+                                {
+                                    target_ref_t    target;
+                                    ::std::size_t   buffer;
+                                    ::std::size_t   size;
+                                    ::std::size_t   written;
+                                    bool            durable;
+
+                                    // the index of the write and fsync entries, -1 if none
+                                    ::std::size_t   write_sqe;
+                                    ::std::size_t   sync_sqe;
+
+                                    bool            write_completed;
+                                    bool            sync_completed;
+                                    bool            sync_failed;
+                                };
+
+                        constexpr auto
+                            c_none = ::std::size_t(-1);
+
+                        auto
+                            job = batch.begin();
+
+                        auto
+                            job_offset = 0_sz;
+
+                        while (job!=batch.end())
+                        {
+                            ::std::vector<Chunk>
+                                chunks;
+
+                            ::std::vector<::io_uring_sqe*>
+                                sqes;
+
+                            // the jobs completely packed into this round
+                            auto
+                                round_first = job;
+
+                            while (job!=batch.end() && chunks.size()<Ring::c_buffer_count)
+                            {
+                                auto
+                                    target = job->target;
+
+                                auto
+                                    buffer = chunks.size();
+
+                                auto
+                                    p = r.buffers[buffer].get();
+
+                                auto
+                                    size = 0_sz;
+
+                                auto
+                                    durable = false;
+
+                                // consecutive jobs of the same target share a buffer
+                                while (job!=batch.end() && job->target==target && size<Ring::c_buffer_size)
+                                {
+                                    auto
+                                        n = ::std::min(job->data.size() - job_offset, Ring::c_buffer_size - size);
+
+                                    ::std::memcpy(p+size, job->data.data()+job_offset, n);
+
+                                    size       += n;
+                                    job_offset += n;
+
+                                    if (job_offset<job->data.size())
+                                        break;
+
+                                    durable   |= job->durable;
+                                    job_offset = 0;
+                                    ++job;
+                                }
+
+                                chunks.push_back({target, buffer, size, 0, durable, c_none, c_none, false, false, false});
+
+                                if (size)
+                                {
+                                    chunks.back().write_sqe = sqes.size();
+
+                                    auto &
+                                        sqe = r.sqe_next();
+                                        sqe.opcode    = IORING_OP_WRITE_FIXED;
+                                        sqe.fd        = target->file.fd();
+                                        sqe.addr      = reinterpret_cast<::std::uint64_t>(p);
+                                        sqe.len       = unsigned(size);
+                                        sqe.off       = ::std::uint64_t(-1);
+                                        sqe.buf_index = ::std::uint16_t(buffer);
+                                        sqe.user_data = buffer<<1;
+
+                                    sqes.push_back(&sqe);
+                                }
+
+                                if (durable)
+                                {
+                                    chunks.back().sync_sqe = sqes.size();
+
+                                    auto &
+                                        sqe = r.sqe_next();
+                                        sqe.opcode    = IORING_OP_FSYNC;
+                                        sqe.fd        = target->file.fd();
+                                        sqe.user_data = buffer<<1 | 1;
+
+                                    sqes.push_back(&sqe);
+                                }
+                            }
+
+                            for (auto i = 0_sz; i+1<sqes.size(); ++i)
+                                sqes[i]->flags |= IOSQE_IO_LINK;
+
+                            auto
+                                submitted = 0u;
+
+                            auto
+                                ok = r.submit_and_reap(
+                                        unsigned(sqes.size())
+                                    ,   submitted
+                                    ,   [&](::std::uint64_t user_data, int res)
+                                        {
+                                            auto & c = chunks[user_data>>1];
+
+                                            if (user_data & 1)
+                                            {
+                                                c.sync_completed = true;
+                                                c.sync_failed    = res<0;
+                                            }
+                                            else
+                                            {
+                                                c.write_completed = true;
+
+                                                if (res>0)
+                                                    c.written = ::std::size_t(res);
+                                            }
+                                        }
+                                    );
+
+                            auto
+                                is_lost = [&](::std::size_t sqe, bool completed)
+                                    {
+                                        return sqe!=c_none && sqe<submitted && !completed;
+                                    };
+
+                            auto
+                                chunks_ok = true;
+
+                            for (auto & c : chunks)
+                            {
+                                // a write in flight might still happen, rewriting it could duplicate the data
+                                if (is_lost(c.write_sqe, c.write_completed))
+                                {
+                                    chunks_ok = false;
+                                    continue;
+                                }
+
+                                // short, failed, canceled or not submitted writes
+                                if (c.written<c.size)
+                                {
+                                    if (!c.target->file.write({r.buffers[c.buffer].get() + c.written, c.size - c.written}))
+                                        chunks_ok = false;
+                                }
+
+                                if (c.durable && (!c.sync_completed || c.sync_failed) && !c.target->file.sync())
+                                    chunks_ok = false;
+                            }
+
+                            // a job split at the end of the round completes in a later one
+                            for (auto it = round_first; it!=job; )
+                            {
+                                auto
+                                    last = ::std::find_if(it, job, [&](Job const & j){return j.target!=it->target;});
+
+                                it->target->done(::std::size_t(last-it), chunks_ok);
+
+                                it = last;
+                            }
+
+                            if (!ok)
+                            {
+                                auto
+                                    is_in_flight = false;
+
+                                for (auto & c : chunks)
+                                    is_in_flight |= is_lost(c.write_sqe, c.write_completed) || is_lost(c.sync_sqe, c.sync_completed);
+
+                                uses_ring = false;
+
+                                // the kernel might still read the registered buffers
+                                if (is_in_flight)
+                                    ring.release();
+                                else
+                                    ring.reset();
+
+                                // the part of a split Job written by this round
+                                if (job!=batch.end() && job_offset)
+                                {
+                                    if (is_lost(chunks.back().write_sqe, chunks.back().write_completed))
+                                        job->target->done(0, false);
+
+                                    job->data.erase(0, job_offset);
+                                }
+
+                                write_sync(job, batch.end());
+
+                                return;
+                            }
+                        }
+                    }
+#endif
+
+            void
+                write(
+                        jobs_t & batch
+                    )
+                    {
+                        auto
+                            bytes = 0_sz;
+
+                        for (auto & j : batch)
+                            bytes += j.data.size();
+
+#ifdef R_ASYNC_APPEND_FILE_IO_URING
+                        if (ring)
+                            write_ring(batch);
+                        else
+#endif
+                            write_sync(batch.begin(), batch.end());
+
+                        queued_bytes -= bytes;
+                    }
+
+            void
+                run()
+                    {
+                        while (auto job = jobs.recv())
+                        {
+                            jobs_t
+                                batch;
+
+                            batch.push_back(::std::move(*job));
+
+                            for (auto & j : jobs.recv_all())
+                                batch.push_back(::std::move(j));
+
+                            write(batch);
+                        }
+                    }
+        };
+
+
+Writer &
+    obtain_writer()
+        {
+            static ::std::atomic<Writer*>
+                writer {};
+
+            if (!writer.load())
+            {
+                Writer *
+                    null {};
+
+                auto w = ::std::make_unique<Writer>();
+
+                if (writer.compare_exchange_strong(null, w.get()))
+                {
+#ifdef R_ASYNC_APPEND_FILE_IO_URING
+                    // the writev backend can be forced, e.g. where io_uring is not permitted
+                    auto
+                        backend = ::std::getenv("async_append_file_backend");
+
+                    if (!backend || ::std::string_view{backend}!="writev")
+                    {
+                        w->ring = ::std::make_unique<Ring>();
+
+                        if (w->ring->init())
+                            w->uses_ring = true;
+                        else
+                            w->ring.reset();
+                    }
+#endif
+
+                    w->metrics_registration = log_metrics_queue_register(
+                            "async_append_file.queued_bytes"
+                        ,   [w = w.get()](){return w->queued_bytes.load();}
+                        );
+
+                    // the writer is never destroyed, so the thread may outlive main()
+                    ::std::thread([w = w.get()](){w->run();}).detach();
+
+                    w.release();
+                }
+            }
+
+            return *writer.load();
+        }
+}
+
+
+AsyncAppendFile::~AsyncAppendFile()
+{
+    close();
+}
+
+
+AsyncAppendFile::AsyncAppendFile() = default;
+
+
+AsyncAppendFile::AsyncAppendFile(
+    AsyncAppendFile && src
+)
+{
+    ::std::swap(m_target, src.m_target);
+}
+
+
+AsyncAppendFile &
+AsyncAppendFile::operator=(
+    AsyncAppendFile && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        ::std::swap(m_target, src.m_target);
+    }
+
+    return *this;
+}
+
+
+bool
+AsyncAppendFile::open(
+    ::fs::path const & path
+)
+{
+    close();
+
+    auto
+        target = ::std::make_shared<Target>();
+
+    if (!target->file.open(path))
+        return false;
+
+    m_target = ::std::move(target);
+
+    return true;
+}
+
+
+bool
+AsyncAppendFile::is_open() const
+{
+    return bool(m_target);
+}
+
+
+int
+AsyncAppendFile::fd() const
+{
+    return m_target ? m_target->file.fd() : -1;
+}
+
+
+void
+AsyncAppendFile::close()
+{
+    if (!m_target)
+        return;
+
+    flush();
+
+    m_target.reset();
+}
+
+
+bool
+AsyncAppendFile::append(
+    ::std::string && data
+,   bool             durable
+)
+{
+    if (!m_target)
+        return false;
+
+    if (data.empty() && !durable)
+        return true;
+
+    auto &
+        w = obtain_writer();
+
+    {
+        ::std::lock_guard<::std::mutex>
+            guard(m_target->mutex);
+
+        ++m_target->pending;
+    }
+
+    w.queued_bytes += data.size();
+
+    w.jobs.send(Job{m_target, ::std::move(data), durable});
+
+    return true;
+}
+
+
+bool
+AsyncAppendFile::flush()
+{
+    if (!m_target)
+        return true;
+
+    ::std::unique_lock<::std::mutex>
+        guard(m_target->mutex);
+
+    m_target->cv_idle.wait(guard, [this](){return m_target->pending==0;});
+
+    return !::std::exchange(m_target->failed, false);
+}
+
+
+::std::string_view
+async_append_file_backend()
+{
+#ifdef R_ASYNC_APPEND_FILE_IO_URING
+    if (obtain_writer().uses_ring)
+        return "io_uring";
+#endif
+
+    return "writev";
+}
+
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/filesystem.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+namespace nsBase
+{
+
+/**
+    A file in append mode (see AppendFile) that is written by a background
+    thread.
+
+    append() hands the data over to the writer thread and returns without
+    entering the kernel for I/O, so stalls of a busy disk do not reach the
+    emitting thread. The appends of one file are written in order.
+
+    On Linux the writer submits the appends through io_uring, using a pool of
+    registered buffers and a linked fsync if durability is requested. Without
+    io_uring (other platforms, old kernels, build environments without
+    <linux/io_uring.h>) a plain writev(2) loop is used.
+*/
+class AsyncAppendFile
+{
+    R_DTOR(AsyncAppendFile);
+    R_CTOR(AsyncAppendFile);
+    R_CCPY(AsyncAppendFile) = delete;
+    R_CMOV(AsyncAppendFile);
+    R_COPY(AsyncAppendFile) = delete;
+    R_MOVE(AsyncAppendFile);
+
+    /** Open or create the target file.
+        Opening happens synchronously.
+        \return FALSE on failure.
+    */
+    public : bool
+        open(
+                ::fs::path const & path
+            );
+
+    public : bool
+        is_open() const;
+
+    /** The native file descriptor, -1 if closed.
+        Writing to it bypasses the queued appends.
+    */
+    public : int
+        fd() const;
+
+    /** Wait until all pending appends are written, then close the file.
+    */
+    public : void
+        close();
+
+    /** Queue the data for being appended.
+        At most 4096 appends of all files are queued. While the queue is full
+        the call waits for the writer thread to take appends from it, so a
+        disk not keeping up slows the emitting threads down instead of
+        growing the memory without limit.
+        \param durable If TRUE, the data gets synced to the storage device.
+        \return FALSE if the file is not open.
+    */
+    public : bool
+        append(
+                ::std::string && data
+            ,   bool             durable = {}
+            );
+
+    /** Wait until all pending appends are written.
+        \return FALSE if any write failed since the last call.
+    */
+    public : bool
+        flush();
+
+    public : struct
+        Target;
+
+    private : ::std::shared_ptr<Target>
+        m_target;
+};
+
+
+/** The name of the backend that writes the AsyncAppendFiles,
+    "io_uring" or "writev".
+*/
+::std::string_view
+    async_append_file_backend();
+
+}
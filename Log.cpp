@@ -7,6 +7,9 @@
 #include "r_base/time.h"
 #include "r_base/Error.h"
 #include "r_base/current.h"
+#include "r_base/log_metrics.h"
+#include "r_base/compression.h"
+#include "r_base/file.h"
 
 #include <optional>
 #include <mutex>
@@ -219,6 +222,8 @@ Log::Log(
         host(current::host());
         user(current::user());
         thread(current::thread());
+
+        log_metrics_count_constructed();
     }
     else
     {
@@ -300,8 +305,27 @@ Log::broadcast_if()
 
     guard.unlock();
 
+    log_metrics_count_broadcast();
+
+    if (!log_metrics_enabled())
+    {
+        for (auto & [consumer_id, consumer_func] : consumers)
+            consumer_func(*this);
+
+        return;
+    }
+
     for (auto & [consumer_id, consumer_func] : consumers)
+    {
+        auto t0 = ::std::chrono::steady_clock::now();
+
         consumer_func(*this);
+
+        log_metrics_record_consumer(
+                int(consumer_id)
+            ,   ::std::chrono::steady_clock::now() - t0
+            );
+    }
 }
 
 
@@ -722,15 +746,26 @@ Log::ConsumerRegistrationDisposer::dispose()
     if (!m_id)
         return;
 
-    ::std::lock_guard<::std::mutex>
-        guard(obtain_mutex());
+    {
+        ::std::lock_guard<::std::mutex>
+            guard(obtain_mutex());
+
+        obtain_consumers().erase(*m_id);
+    }
 
-    obtain_consumers().erase(*m_id);
+    log_metrics_consumer_retired(*m_id);
 
     m_id.reset();
 }
 
 
+::std::optional<int>
+Log::ConsumerRegistrationDisposer::id() const
+{
+    return m_id;
+}
+
+
 
 Log::ConsumerRegistrationDisposer::ConsumerRegistrationDisposer(
     unsigned int id
@@ -894,9 +929,14 @@ Log::serialize(
         j;
         for (auto & [k,v] : properties_and_attributes()) j[k] = v;
 
-    return j.dump(
-            pretty ? 4 : -1 // int indent = -1
-        );
+    auto
+        s = j.dump(
+                pretty ? 4 : -1 // int indent = -1
+            );
+
+    log_metrics_count_bytes_serialized(s.size());
+
+    return s;
 }
 
 
@@ -920,38 +960,89 @@ Log::deserialize(
     ::std::optional<Log>
         log;
 
+    log.emplace();
+
+    if (!log->deserialize_assign(data))
+        log.reset();
+
+    return log;
+}
+
+
+bool
+Log::deserialize_assign(
+    ::std::string_view  const & data
+)
+{
+    if (!p)
+        p = ::std::make_unique<Log_Impl>();
+
     auto stream = data;
 
     // crop optional prefix up to the first '{'-character
     if (auto i=data.find_first_of('{'); i!=::std::string::npos)
         stream = ::std::string_view{data.data()+i, data.size()-i};
 
+    // keep the buffers of the previous content
+    auto scope      = ::std::move(p->scope_mutable());
+    auto message    = ::std::move(p->message_mutable());
+    auto attributes = ::std::move(p->mAttributes);
+
+    *p = Log_Impl{};
+
+    p->do_broadcast_assign(false);
+
+    scope.clear();
+    message.clear();
+
+    p->scope_mutable()   = ::std::move(scope);
+    p->message_mutable() = ::std::move(message);
+
     try
     {
         auto json = ::nlohmann::json::parse(stream);
 
-        log.emplace();
-
         for (auto const & [k_,v_] : json.items())
         {
             auto k = ::std::string_view{k_};
-            auto v = v_.is_string() ? ::std::string{v_} : to_string(v_);
+
+            if (k.empty())
+                continue;
 
             auto
                 is_property = k[0] == '_' || k=="scope" || k=="message";
 
             if (is_property)
-                log->property(k, v);
+            {
+                property(k, v_.is_string() ? v_.get_ref<::std::string const &>() : to_string(v_));
+                continue;
+            }
+
+            // the attributes of consecutive Logs mostly have the same keys, so their nodes get reused
+            auto
+                node = attributes.extract(k_);
+
+            if (node.empty())
+            {
+                p->mAttributes[k_] = v_.is_string() ? v_.get_ref<::std::string const &>() : to_string(v_);
+                continue;
+            }
+
+            if (v_.is_string())
+                node.mapped() = v_.get_ref<::std::string const &>();
             else
-                log->att(k, v);
+                node.mapped() = to_string(v_);
+
+            p->mAttributes.insert(::std::move(node));
         }
     }
     catch(...)
     {
-        log.reset();
+        p->mAttributes.clear();
+        return false;
     }
 
-    return log;
+    return true;
 }
 
 
@@ -1017,24 +1108,87 @@ Log::attributeRemoveAll()
 }
 
 
+namespace
+{
+/// the key of the first match of the regex \$\{([^$]*)\}
+::std::optional<::std::string_view>
+    placeholder_first(
+            ::std::string_view const & s
+        )
+        {
+            for (auto pos = s.find("${"); pos!=s.npos; pos = s.find("${", pos+1))
+            {
+                auto
+                    limit = ::std::min(s.find('$', pos+2), s.size());
+
+                // [^$]* is greedy - the match ends at the last '}' before the next '$'
+                auto
+                    close = s.substr(0, limit).rfind('}');
+
+                if (close!=s.npos && close>=pos+2)
+                    return s.substr(pos+2, close-pos-2);
+            }
+
+            return {};
+        }
+
+/// TRUE if the literal replacement gives the same result as the regex_replace() in resolved()
+bool
+    is_literal_replacement(
+            ::std::string_view const & key
+        ,   ::std::string_view const & value
+        )
+        {
+            constexpr ::std::string_view
+                regex_special = "\\^$.|?*+()[]{}";
+
+            return
+                    key.find_first_of(regex_special)==key.npos
+                &&  value.find('$')==value.npos
+                ;
+        }
+
+::std::string
+    replaced_all(
+            ::std::string_view const & s
+        ,   ::std::string_view const & pattern
+        ,   ::std::string_view const & value
+        )
+        {
+            ::std::string
+                res;
+                res.reserve(s.size());
+
+            auto
+                from = 0_sz;
+
+            for (auto pos = s.find(pattern); pos!=s.npos; pos = s.find(pattern, from))
+            {
+                res.append(s.substr(from, pos-from));
+                res.append(value);
+                from = pos + pattern.size();
+            }
+
+            res.append(s.substr(from));
+
+            return res;
+        }
+}
+
+
 ::std::string
 Log::resolved(
     ::std::string_view const & s
 ) const
 {
-    ::std::regex
-        regex("\\$\\{([^$]*)\\}");
-    ::std::smatch
-        match;
     auto
         res = ::std::string{s};
 
-    while (::std::regex_search(res,match,regex))
+    // avoid ::std::regex, this runs for every Log written to the console
+    while (auto k = placeholder_first(res))
     {
-        if (match.size()<2)
-            break;
         auto
-            key = match[1].str();
+            key = ::std::string{*k};
         auto
             value = attribute(key);
 
@@ -1045,7 +1199,10 @@ Log::resolved(
             value = "<" + key + ">";
 
         auto
-            new_res = resolved(res, key, *value);
+            new_res = is_literal_replacement(key, *value)
+                ?   replaced_all(res, "${" + key + "}", *value)
+                :   resolved(res, key, *value)
+                ;
 
         if (res==new_res)
             break; // break endless loops
@@ -1094,6 +1251,44 @@ logs_read(
     ::std::ifstream
         stream {path, ::std::ios::in | ::std::ios::binary};
 
+    // rotated segments might be compressed
+    {
+        char
+            magic[compression::c_magic.size()] {};
+
+        stream.read(magic, sizeof(magic));
+
+        auto
+            is_compressed = stream.gcount()==sizeof(magic) && compression::is_compressed({magic, sizeof(magic)});
+
+        stream.clear();
+        stream.seekg(0);
+
+        if (is_compressed)
+        {
+            stream.close();
+
+            auto
+                data = compression::decompress(file_read_all(path));
+
+            auto
+                lines = ::std::string_view{data};
+
+            while (!lines.empty())
+            {
+                auto
+                    eol = ::std::min(lines.find('\n'), lines.size());
+
+                if (auto log = Log::deserialize(lines.substr(0, eol)))
+                    logs.emplace_back(::std::move(*log));
+
+                lines.remove_prefix(::std::min(eol+1, lines.size()));
+            }
+
+            return;
+        }
+    }
+
     ::std::string
         line;
 
@@ -1167,7 +1362,10 @@ log_filter_anti_flood(
             }
 
             if (events.size()>max_event_count_per_creator_per_duration)
+            {
+                log_metrics_count_dropped();
                 return; // skip log due to overload
+            }
         }
 
         events.emplace(now);
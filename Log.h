@@ -902,6 +902,16 @@ class  Log
         deserialize(
                 ::std::string_view const & data
             );
+
+    /** Replace the content by a Log read from a JSON-object, like deserialize().
+        The allocations of this instance are reused, which makes reading many
+        Logs one after the other into the same instance cheap.
+        \return FALSE if the data is not a Log.
+    */
+    public : bool
+        deserialize_assign(
+                ::std::string_view const & data
+            );
 //@}
 
 
@@ -929,6 +939,13 @@ class  Log
                     m_id;
                 public : void
                     dispose();
+
+                /** The registration id. It keys the consumer statistics
+                    of log_metrics_snapshot().
+                    EMPTY after disposal.
+                */
+                public : ::std::optional<int>
+                    id() const;
             };
 
     public : using
@@ -1095,6 +1112,8 @@ inline Log &
 
 /**
     Read Logs from a target file.
+    Segments compressed by the log rotation are decompressed transparently.
+    Large files are read faster by logs_read_parallel() (see log_read_parallel.h).
 
     \param path Path of the target file.
 
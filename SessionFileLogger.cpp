@@ -3,60 +3,100 @@
 #include "r_base/SessionFileLogger.h"
 
 #include <mutex>
-#include <atomic>
 #include <memory>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 using namespace ::nsBase;
 
 namespace nsBase
 {
 
-namespace
+SessionFileLogger::~SessionFileLogger()
 {
-::std::unique_lock<::std::recursive_mutex>
-    lock()
-        {
-            static ::std::atomic<::std::recursive_mutex*>
-                mutex(nullptr);
+    dispose();
+}
 
-            if (!mutex.load())
-            {
-                ::std::recursive_mutex *
-                    null {};
 
-                auto m = ::std::make_unique<::std::recursive_mutex>();
+SessionFileLogger::SessionFileLogger(
+    SessionFileLogger && rhs
+)
+{
+    *this = ::std::move(rhs);
+}
+
 
-                if (mutex.compare_exchange_strong(null, m.get()))
-                    m.release();
-            }
+void
+SessionFileLogger::dispose()
+{
+    ::std::lock_guard<::std::mutex>
+        guard(*m_mutex);
 
-            return ::std::unique_lock<::std::recursive_mutex>(*mutex.load());
-        }
+    close_locked();
 }
 
 
-SessionFileLogger::~SessionFileLogger()
+bool
+SessionFileLogger::is_open() const
 {
-    dispose();
+    ::std::lock_guard<::std::mutex>
+        guard(*m_mutex);
+
+    return is_open_locked();
 }
 
 
-SessionFileLogger::SessionFileLogger(
-    SessionFileLogger && rhs
-)
+bool
+SessionFileLogger::is_open_locked() const
 {
-    *this = ::std::move(rhs);
+    return m_file.is_open() || m_async_file.is_open();
+}
+
+
+::std::FILE *
+SessionFileLogger::log_file() const
+{
+    ::std::lock_guard<::std::mutex>
+        guard(*m_mutex);
+
+    if (m_log_file || !m_file.is_open())
+        return m_log_file;
+
+    // a stream of its own, closing it must not close m_file
+#ifdef _WIN32
+    auto
+        fd = ::_dup(m_file.fd());
+
+    if (fd>=0 && !(m_log_file = ::_fdopen(fd, "a")))
+        ::_close(fd);
+#else
+    auto
+        fd = ::dup(m_file.fd());
+
+    if (fd>=0 && !(m_log_file = ::fdopen(fd, "a")))
+        ::close(fd);
+#endif
+
+    return m_log_file;
 }
 
 
 void
-SessionFileLogger::dispose()
+SessionFileLogger::close_locked()
 {
-    if (log_file())
+    if (m_log_file)
     {
-        ::std::fclose(log_file());
-        log_file_clear();
+        ::std::fclose(m_log_file);
+        m_log_file = nullptr;
     }
+
+    m_file.close();
+    m_async_file.close();
+    m_index.close();
 }
 
 
@@ -67,12 +107,24 @@ SessionFileLogger::operator=(
 {
     if (this != &rhs)
     {
-        auto guard = lock();
+        ::std::scoped_lock
+            guard(*m_mutex, *rhs.m_mutex);
 
         session_assign(rhs.session());
         log_dir_path_assign(rhs.log_dir_path());
-
-        ::std::swap(*m_log_file, *rhs.m_log_file);
+        log_file_path_assign(rhs.log_file_path());
+        extension_assign(rhs.extension());
+        time_assign(rhs.time());
+        rotation_assign(rhs.rotation());
+        asynchronous_assign(rhs.asynchronous());
+        durable_assign(rhs.durable());
+        indexed_assign(rhs.indexed());
+
+        ::std::swap(m_file, rhs.m_file);
+        ::std::swap(m_async_file, rhs.m_async_file);
+        ::std::swap(m_index, rhs.m_index);
+        ::std::swap(m_file_size, rhs.m_file_size);
+        ::std::swap(m_log_file, rhs.m_log_file);
     }
     return *this;
 }
@@ -108,6 +160,30 @@ namespace
 }
 
 
+void
+SessionFileLogger::prepare_locked(
+    Log const & log
+)
+{
+    if (log_file_path().empty())
+    {
+        if (time().empty())
+            time_assign(to_string(log.time()));
+
+        log_file_path_assign(eff_path(*this));
+    }
+
+    auto
+        log_dir_abs = log_file_path().parent_path();
+
+    ::std::error_code
+        err;
+
+    if (!log_dir_abs.empty())
+        ::fs::create_directories(log_dir_abs, err);
+}
+
+
 void
 SessionFileLogger::operator()(
     Log & log
@@ -116,44 +192,93 @@ SessionFileLogger::operator()(
     if (log.session()!=session())
         return;
 
+    // the expensive part happens outside the lock
     auto
-        guard = lock();
+        line = log.serialize() + "\n";
 
-    if (log_file_path().empty())
+    ::std::lock_guard<::std::mutex>
+        guard(*m_mutex);
+
+    // the mode might have been switched
+    if (asynchronous() ? m_file.is_open() : m_async_file.is_open())
+        close_locked();
+
+    if (is_open_locked() && rotation() && rotation()->due())
     {
-        if (time().empty())
-            time_assign(to_string(log.time()));
+        close_locked();
 
-        log_file_path_assign(eff_path(*this));
+        // the index describes the active file only, it is kept if the rename failed
+        if (rotation_mutable()->rotate(log_file_path()))
+            m_index.remove();
     }
 
-    if (!log_file())
+    if (!is_open_locked())
     {
+        prepare_locked(log);
+
         auto
-            log_dir_abs = log_file_path().parent_path();
+            is_opened = asynchronous()
+                ?   m_async_file.open(log_file_path())
+                :   m_file.open(log_file_path())
+                ;
+
+        if (is_opened)
+        {
+            ::std::error_code
+                err;
 
-        if (!log_dir_abs.empty() && !::fs::exists(log_dir_abs))
-            ::fs::create_directories(log_dir_abs);
+            m_file_size = ::fs::file_size(log_file_path(), err);
 
-        log_file_assign(::std::fopen(log_file_path().string().c_str(), "ab"));
-    }
+            if (err)
+                m_file_size = 0;
 
-    if (!log_file())
-        return;
+            if (indexed())
+                m_index.open(log_file_path());
+
+            if (rotation())
+                rotation_mutable()->opened(log_file_path());
+        }
+    }
 
     auto
-        line = log.serialize() + "\n";
+        size = line.size();
+
+    if (asynchronous())
+    {
+        if (!m_async_file.append(::std::move(line), durable()))
+            return;
+    }
+    else
+    {
+        if (!m_file.write(line))
+            return;
 
-    ::std::fwrite(line.c_str(), line.size(), 1, log_file());
-    ::std::fflush(log_file());
+        if (durable())
+            m_file.sync();
+    }
+
+    if (m_index.is_open())
+    {
+        auto
+            entry = LogIndexEntry::of(log);
+            entry.offset = m_file_size;
+            entry.length = ::std::uint32_t(size);
+
+        m_index.add(entry);
+    }
+
+    m_file_size += size;
+
+    if (rotation())
+        rotation_mutable()->written(size);
 }
 
 
 void
 SessionFileLogger::rename_if()
 {
-    auto
-        guard = lock();
+    ::std::lock_guard<::std::mutex>
+        guard(*m_mutex);
 
     auto
         new_path = eff_path(*this);
@@ -161,10 +286,9 @@ SessionFileLogger::rename_if()
     if (new_path==log_file_path())
         return;
 
-    if (log_file())
+    if (is_open_locked())
     {
-        ::std::fclose(log_file());
-        log_file_clear();
+        close_locked();
 
         ::std::error_code
             err;
@@ -174,6 +298,13 @@ SessionFileLogger::rename_if()
             ,   new_path
             ,   err
             );
+
+        if (indexed())
+            ::fs::rename(
+                    log_index_path(log_file_path())
+                ,   log_index_path(new_path)
+                ,   err
+                );
     }
 
     log_file_path_clear();
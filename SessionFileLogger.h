@@ -5,13 +5,27 @@
 #include "r_base/uuid.h"
 #include "r_base/file.h"
 #include "r_base/Log.h"
+#include "r_base/log_file_rotation.h"
+#include "r_base/AppendFile.h"
+#include "r_base/AsyncAppendFile.h"
+#include "r_base/log_index.h"
 
 #include <cstdio>
+#include <memory>
+#include <mutex>
 
 
 namespace nsBase
 {
 
+/**
+    A log consumer that appends the Logs of a single session to a file.
+
+    Each instance has its own lock, so unrelated sessions don't contend.
+    Logs are serialized outside the lock and appended with a single write
+    to a file opened with O_APPEND. In asynchronous mode the write happens
+    in the background (see AsyncAppendFile).
+*/
 class SessionFileLogger
 {
     R_DTOR(SessionFileLogger);
@@ -36,12 +50,6 @@ class SessionFileLogger
         ,   ::fs::path
         );
 
-    R_PROPERTY_D(
-            log_file
-        ,   ::std::FILE *
-        ,   nullptr
-        );
-
     R_PROPERTY_(
             extension
         ,   ::std::string
@@ -52,12 +60,89 @@ class SessionFileLogger
         ,   ::std::string
         );
 
+    /** If set, the session file gets rotated by size and/or period.
+    */
+    R_PROPERTY_M(
+            rotation
+        ,   ::std::optional<LogFileRotation>
+        );
+
+    /** If TRUE, the Logs are handed over to the background writer instead of
+        being written by the emitting thread.
+    */
+    R_PROPERTY_D(
+            asynchronous
+        ,   bool
+        ,   false
+        );
+
+    /** If TRUE, every Log gets synced to the storage device.
+    */
+    R_PROPERTY_D(
+            durable
+        ,   bool
+        ,   false
+        );
+
+    /** If TRUE, a sidecar index is written next to the file (see LogIndexWriter).
+    */
+    R_PROPERTY_D(
+            indexed
+        ,   bool
+        ,   false
+        );
+
+    private : ::std::unique_ptr<::std::mutex>
+        m_mutex {::std::make_unique<::std::mutex>()};
+
+    private : AppendFile
+        m_file;
+
+    private : AsyncAppendFile
+        m_async_file;
+
+    private : LogIndexWriter
+        m_index;
+
+    // the size of the file as far as written by this instance
+    private : ::std::uint64_t
+        m_file_size {};
+
+    // handed out by log_file()
+    private : mutable ::std::FILE *
+        m_log_file {};
+
+    private : bool
+        is_open_locked() const;
+
+    private : void
+        close_locked();
+
+    /// resolve the file path and create its directory - once
+    private : void
+        prepare_locked(
+                Log const &
+            );
+
     public : void
         rename_if();
 
+    /** Close the file. The next Log re-opens it.
+    */
     public : void
         dispose();
 
+    public : bool
+        is_open() const;
+
+    /** \deprecated The file is no longer written through stdio.
+        \return A stream appending to the open file, nullptr if the file is
+            closed or written asynchronously. Writes through it bypass the lock
+            of this instance. The stream gets closed along with the file.
+    */
+    public : [[deprecated("the file is written without stdio, see AppendFile")]] ::std::FILE *
+        log_file() const;
+
     public : void
         operator()(::nsBase::Log &);
 };
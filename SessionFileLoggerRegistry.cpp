@@ -0,0 +1,292 @@
+﻿// Copyright (C) Ralf Kubis
+
+#include "r_base/SessionFileLoggerRegistry.h"
+#include "r_base/on_delete.h"
+#include "r_base/thread.h"
+
+#include <vector>
+
+
+namespace nsBase
+{
+
+SessionFileLoggerRegistry::~SessionFileLoggerRegistry()
+{
+    {
+        ::std::lock_guard<::std::mutex>
+            guard(m_mutex);
+
+        m_is_stopped = true;
+    }
+
+    m_sweeper_cv.notify_all();
+
+    if (m_sweeper.joinable())
+        m_sweeper.join();
+}
+
+
+void
+SessionFileLoggerRegistry::sweeper_run()
+{
+    thread::set_thread_name("session_sweep");
+
+    ::std::unique_lock<::std::mutex>
+        guard(m_mutex);
+
+    while (!m_is_stopped)
+    {
+        // sweep 4 times per timeout period
+        m_sweeper_cv.wait_for(guard, ::std::max(idle_timeout()/4, ::std::chrono::seconds{1}));
+
+        if (m_is_stopped)
+            break;
+
+        ::std::vector<entry_ref_t>
+            to_close;
+
+        sweep_locked(::std::chrono::steady_clock::now(), to_close);
+
+        if (to_close.empty())
+            continue;
+
+        // file operations happen unlocked
+        guard.unlock();
+
+        for (auto & c : to_close)
+            c->logger.dispose();
+
+        to_close.clear();
+
+        guard.lock();
+    }
+}
+
+
+SessionFileLoggerRegistry::entry_ref_t
+SessionFileLoggerRegistry::entry_make_locked(
+    ::uuids::uuid const & session
+)
+{
+    auto
+        e = ::std::make_shared<Entry>();
+        e->logger.session_assign(session);
+        e->logger.log_dir_path_assign(log_dir_path());
+        e->logger.extension_assign(extension());
+        e->logger.asynchronous_assign(asynchronous());
+        e->logger.durable_assign(durable());
+        e->logger.indexed_assign(indexed());
+
+    if (rotation())
+        e->logger.rotation_assign(LogFileRotation{*rotation()});
+
+    m_entries[session] = e;
+
+    if (!m_sweeper.joinable())
+        m_sweeper = ::std::thread{[this](){sweeper_run();}};
+
+    return e;
+}
+
+
+void
+SessionFileLoggerRegistry::session_add(
+    ::uuids::uuid const & session
+)
+{
+    ::std::lock_guard<::std::mutex>
+        guard(m_mutex);
+
+    auto
+        it = m_entries.find(session);
+
+    auto
+        e = it!=m_entries.end() ? it->second : entry_make_locked(session);
+
+    e->is_added = true;
+}
+
+
+void
+SessionFileLoggerRegistry::session_remove(
+    ::uuids::uuid const & session
+)
+{
+    entry_ref_t
+        e;
+
+    {
+        ::std::lock_guard<::std::mutex>
+            guard(m_mutex);
+
+        auto
+            it = m_entries.find(session);
+
+        if (it==m_entries.end())
+            return;
+
+        e = it->second;
+
+        if (e->lru_position)
+            m_lru.erase(*e->lru_position);
+
+        m_entries.erase(it);
+    }
+
+    e->logger.dispose();
+}
+
+
+void
+SessionFileLoggerRegistry::rename_if(
+    ::uuids::uuid const & session
+)
+{
+    entry_ref_t
+        e;
+
+    {
+        ::std::lock_guard<::std::mutex>
+            guard(m_mutex);
+
+        auto
+            it = m_entries.find(session);
+
+        if (it==m_entries.end())
+            return;
+
+        e = it->second;
+    }
+
+    e->logger.rename_if();
+}
+
+
+::std::size_t
+SessionFileLoggerRegistry::open_file_count() const
+{
+    ::std::lock_guard<::std::mutex>
+        guard(m_mutex);
+
+    return m_lru.size();
+}
+
+
+void
+SessionFileLoggerRegistry::sweep_locked(
+    ::std::chrono::steady_clock::time_point   now
+,   ::std::vector<entry_ref_t>              & to_close
+)
+{
+    auto
+        timeout = ::std::chrono::duration_cast<::std::chrono::steady_clock::duration>(idle_timeout());
+
+    // the least recently used files are at the back
+    for (auto lru = m_lru.end(); lru!=m_lru.begin(); )
+    {
+        --lru;
+
+        auto
+            it = m_entries.find(*lru);
+
+        auto
+            e = it->second;
+
+        if (now - e->last_use < timeout)
+            break;
+
+        if (e->pins)
+            continue;
+
+        lru = m_lru.erase(lru);
+        e->lru_position.reset();
+
+        to_close.push_back(e);
+
+        if (!e->is_added)
+            m_entries.erase(it);
+    }
+}
+
+
+void
+SessionFileLoggerRegistry::operator()(
+    Log & log
+)
+{
+    auto &
+        session = log.session();
+
+    if (session.is_nil())
+        return;
+
+    entry_ref_t
+        e;
+
+    ::std::vector<entry_ref_t>
+        to_close;
+
+    {
+        auto
+            now = ::std::chrono::steady_clock::now();
+
+        ::std::lock_guard<::std::mutex>
+            guard(m_mutex);
+
+        if (auto it = m_entries.find(session); it!=m_entries.end())
+            e = it->second;
+        else if (route_all_sessions())
+            e = entry_make_locked(session);
+        else
+            return;
+
+        e->last_use = now;
+
+        // an entry is in m_lru whenever its file may be open
+        ++e->pins;
+
+        if (e->lru_position)
+        {
+            m_lru.splice(m_lru.begin(), m_lru, *e->lru_position);
+        }
+        else
+        {
+            e->lru_position = m_lru.insert(m_lru.begin(), session);
+
+            // the least recently used files are at the back, the ones being written stay open
+            for (auto lru = m_lru.end(); m_lru.size() > ::std::max<::std::size_t>(1, max_open_files()) && lru!=m_lru.begin(); )
+            {
+                --lru;
+
+                auto
+                    it = m_entries.find(*lru);
+
+                auto
+                    victim = it->second;
+
+                if (victim->pins)
+                    continue;
+
+                lru = m_lru.erase(lru);
+                victim->lru_position.reset();
+
+                to_close.push_back(victim);
+
+                // only the added sessions are remembered while closed
+                if (!victim->is_added)
+                    m_entries.erase(it);
+            }
+        }
+    }
+
+    on_delete
+        unpin {[&e](){--e->pins;}};
+
+    // file operations happen unlocked
+    for (auto & c : to_close)
+        c->logger.dispose();
+
+    e->logger(log);
+}
+
+}
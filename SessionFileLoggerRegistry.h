@@ -0,0 +1,217 @@
+﻿#pragma once
+// Copyright (C) Ralf Kubis
+
+#include "r_base/language_tools.h"
+#include "r_base/SessionFileLogger.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    A single log consumer that routes Logs to per-session files.
+
+    Registering one SessionFileLogger per session makes every Log visit all
+    of them. This registry instead looks up the writer of the Logs session
+    in a hash map.
+
+    Files are opened lazily on the first Log of a session. The count of open
+    files is capped - if exceeded, the least recently used file is closed (and
+    transparently re-opened on its next Log). A file that is being written is
+    not closed, so the cap is exceeded only while more sessions log at the
+    same time than files are allowed. A background thread closes the files of
+    sessions that did not log for idle_timeout.
+
+    Example:
+
+        auto
+            registry = ::std::make_shared<SessionFileLoggerRegistry>();
+            registry->log_dir_path_assign(dir);
+            registry->extension_assign("log");
+
+        auto
+            guard = Log::consumer_register([registry](Log & l){(*registry)(l);});
+
+        registry->session_add(session_id);
+*/
+class SessionFileLoggerRegistry
+{
+    R_DTOR(SessionFileLoggerRegistry);
+    R_CTOR(SessionFileLoggerRegistry) = default;
+    R_CCPY(SessionFileLoggerRegistry) = delete;
+    R_CMOV(SessionFileLoggerRegistry) = delete;
+    R_COPY(SessionFileLoggerRegistry) = delete;
+    R_MOVE(SessionFileLoggerRegistry) = delete;
+
+    R_PROPERTY_(
+            log_dir_path
+        ,   ::fs::path
+        );
+
+    R_PROPERTY_(
+            extension
+        ,   ::std::string
+        );
+
+    /** Upper limit of simultaneously open files.
+    */
+    R_PROPERTY_D(
+            max_open_files
+        ,   ::std::size_t
+        ,   64
+        );
+
+    /** Close the file of a session that did not log for this duration.
+    */
+    R_PROPERTY_D(
+            idle_timeout
+        ,   ::std::chrono::seconds
+        ,   ::std::chrono::seconds{300}
+        );
+
+    /** If TRUE, every session that logs gets its own file, without the need
+        to call session_add(). Such sessions are forgotten once their file
+        gets closed - the next Log of the session starts a new file.
+    */
+    R_PROPERTY_D(
+            route_all_sessions
+        ,   bool
+        ,   false
+        );
+
+    /** Applied to the files of sessions added afterwards.
+    */
+    R_PROPERTY_(
+            rotation
+        ,   ::std::optional<LogRotationPolicy>
+        );
+
+    /** Applied to the files of sessions added afterwards
+        (see SessionFileLogger::asynchronous).
+    */
+    R_PROPERTY_D(
+            asynchronous
+        ,   bool
+        ,   false
+        );
+
+    /** Applied to the files of sessions added afterwards
+        (see SessionFileLogger::durable).
+    */
+    R_PROPERTY_D(
+            durable
+        ,   bool
+        ,   false
+        );
+
+    /** Applied to the files of sessions added afterwards
+        (see SessionFileLogger::indexed).
+    */
+    R_PROPERTY_D(
+            indexed
+        ,   bool
+        ,   false
+        );
+
+    /** Start routing the Logs of the target session.
+    */
+    public : void
+        session_add(
+                ::uuids::uuid const & session
+            );
+
+    /** Stop routing the Logs of the target session and close its file.
+    */
+    public : void
+        session_remove(
+                ::uuids::uuid const & session
+            );
+
+    /** Rename the file of the target session if its name changed
+        (see SessionFileLogger::rename_if()).
+    */
+    public : void
+        rename_if(
+                ::uuids::uuid const & session
+            );
+
+    public : ::std::size_t
+        open_file_count() const;
+
+    public : void
+        operator()(::nsBase::Log &);
+
+
+    private : struct
+        Entry
+            {
+                SessionFileLogger
+                    logger;
+
+                ::std::chrono::steady_clock::time_point
+                    last_use;
+
+                // position in m_lru while the file is open
+                ::std::optional<::std::list<::uuids::uuid>::iterator>
+                    lru_position;
+
+                bool
+                    is_added {};
+
+                // count of the Logs being written, the file isn't closed meanwhile
+                // - incremented under the lock only
+                ::std::atomic<int>
+                    pins {};
+            };
+
+    private : using
+        entry_ref_t = ::std::shared_ptr<Entry>;
+
+    private : mutable ::std::mutex
+        m_mutex;
+
+    private : ::std::unordered_map<::uuids::uuid, entry_ref_t>
+        m_entries;
+
+    // sessions with open files, most recently used first
+    private : ::std::list<::uuids::uuid>
+        m_lru;
+
+    private : ::std::thread
+        m_sweeper;
+
+    private : ::std::condition_variable
+        m_sweeper_cv;
+
+    private : bool
+        m_is_stopped {};
+
+    /// closes the idle files until stopped
+    private : void
+        sweeper_run();
+
+    private : entry_ref_t
+        entry_make_locked(
+                ::uuids::uuid const & session
+            );
+
+    /// collects the idle files, to be closed after unlocking
+    private : void
+        sweep_locked(
+                ::std::chrono::steady_clock::time_point   now
+            ,   ::std::vector<entry_ref_t>              & to_close
+            );
+};
+
+}
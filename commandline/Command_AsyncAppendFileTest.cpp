@@ -0,0 +1,332 @@
+﻿#include "r_base/commandline/Command_AsyncAppendFileTest.h"
+#include "r_base/AsyncAppendFile.h"
+#include "r_base/commandline/test_tools.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test AsyncAppendFile with the backend of this process: the appends are\n"
+"written in order, including large and durable ones, and short and failed\n"
+"writes are reported without writing data twice.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : backend\n"
+"       occurrence  : once (optional)\n"
+"       values      : io_uring | writev\n"
+"       default     : io_uring if available\n"
+"           The backend to test. Fails if it is not available.\n"
+"\n"
+"       attribute   : dir\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : the temp directory\n"
+"           The directory of the test files.\n"
+;
+
+
+
+::std::string
+    file_read(
+            ::fs::path const & path
+        )
+        {
+            ::std::ifstream
+                f {path, ::std::ios::binary};
+
+            return {::std::istreambuf_iterator<char>{f}, ::std::istreambuf_iterator<char>{}};
+        }
+
+
+/// the i-th of the test appends, of varying sizes and distinguishable content
+::std::string
+    data_make(
+            int i
+        )
+        {
+            auto
+                size = i%7==6
+                    ?   ::std::size_t(700'000 + i)  // spans several registered buffers
+                    :   ::std::size_t(1 + i*37 % 4000)
+                    ;
+
+            ::std::string
+                ret(size, '\0');
+
+            for (auto k = 0_sz; k<size; ++k)
+                ret[k] = char('a' + (i+k) % 26);
+
+            ret.back() = '\n';
+
+            return ret;
+        }
+
+
+/// the appends of several threads to several files arrive in order per file
+void
+    test_order(
+            ::fs::path const & dir
+        )
+        {
+            constexpr auto
+                c_files = 3;
+
+            constexpr auto
+                c_appends = 60;
+
+            ::std::vector<::std::thread>
+                threads;
+
+            // one flag per thread, a vector<bool> packs them into shared words
+            ::std::atomic<bool>
+                flushed[c_files] {};
+
+            for (auto f=0; f<c_files; ++f)
+            {
+                threads.emplace_back([&, f]()
+                    {
+                        AsyncAppendFile
+                            file;
+
+                        check(file.open(dir / ("order_" + ::std::to_string(f))), "the file opens");
+
+                        for (auto i=0; i<c_appends; ++i)
+                            file.append(data_make(f*1000+i), i%10==9);
+
+                        flushed[f] = file.flush();
+                    });
+            }
+
+            for (auto & t : threads)
+                t.join();
+
+            for (auto f=0; f<c_files; ++f)
+            {
+                ::std::string
+                    expected;
+
+                for (auto i=0; i<c_appends; ++i)
+                    expected += data_make(f*1000+i);
+
+                check(flushed[f], "the appends succeed");
+                check(file_read(dir / ("order_" + ::std::to_string(f)))==expected, "the file holds the appends in order");
+            }
+        }
+
+
+/// more appends than the queue holds wait for the writer, none is lost
+void
+    test_full_queue(
+            ::fs::path const & dir
+        )
+        {
+            constexpr auto
+                c_appends = 20'000;
+
+            auto
+                path = dir / "full_queue";
+
+            ::std::string
+                expected;
+
+            AsyncAppendFile
+                file;
+
+            check(file.open(path), "the file opens");
+
+            for (auto i=0; i<c_appends; ++i)
+            {
+                auto
+                    data = ::std::to_string(i) + '\n';
+
+                expected += data;
+
+                file.append(::std::move(data));
+            }
+
+            check(file.flush(), "the appends succeed");
+            check(file_read(path)==expected, "the file holds all appends in order");
+        }
+
+
+#ifndef _WIN32
+/** The writes beyond the file size limit are short or fail. The file holds
+    the data up to the limit exactly once.
+*/
+void
+    test_short_writes(
+            ::fs::path const & dir
+        )
+        {
+            constexpr auto
+                c_limit = 1'000'000;
+
+            auto
+                path = dir / "short";
+
+            ::rlimit
+                previous;
+
+            ::getrlimit(RLIMIT_FSIZE, &previous);
+
+            auto
+                limit = previous;
+
+            limit.rlim_cur = c_limit;
+
+            auto
+                handler_previous = ::signal(SIGXFSZ, SIG_IGN);
+
+            ::setrlimit(RLIMIT_FSIZE, &limit);
+
+            ::std::string
+                expected;
+
+            auto
+                flushed = true;
+
+            {
+                AsyncAppendFile
+                    file;
+
+                check(file.open(path), "the file opens");
+
+                for (auto i=0; expected.size()<2*c_limit; ++i)
+                {
+                    auto
+                        data = data_make(i);
+
+                    expected += data;
+
+                    file.append(::std::move(data));
+                }
+
+                flushed = file.flush();
+            }
+
+            ::setrlimit(RLIMIT_FSIZE, &previous);
+            ::signal(SIGXFSZ, handler_previous);
+
+            check(!flushed, "the failed writes are reported");
+            check(file_read(path)==expected.substr(0, c_limit), "the file holds the data up to the limit once");
+        }
+
+
+/// all writes fail
+void
+    test_failed_writes(
+            ::fs::path const &
+        )
+        {
+            AsyncAppendFile
+                file;
+
+            check(file.open("/dev/full"), "/dev/full opens");
+
+            for (auto i=0; i<20; ++i)
+                file.append(data_make(i), i==19);
+
+            check(!file.flush(), "the failed writes are reported");
+
+            file.append(::std::string{});
+
+            check(file.flush(), "a failure is reported once");
+        }
+#endif
+}
+
+
+command_ref_t
+Command_AsyncAppendFileTest::factory()
+{
+    return command_ref_t(new Command_AsyncAppendFileTest);
+}
+
+
+void
+Command_AsyncAppendFileTest::registerMe()
+{
+    registerFactory("async-append-file-test",factory);
+}
+
+
+::std::string_view
+Command_AsyncAppendFileTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_AsyncAppendFileTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_AsyncAppendFileTest::execute()
+{
+#ifdef _WIN32
+    "92d53c03-d947-4e94-a10b-ba2d23387d3f"_log("async-append-file-test is not supported on this platform").throw_error();
+#else
+    // the backend is chosen when the first AsyncAppendFile gets used
+    if (auto a = attribute1("backend", false))
+    {
+        if (a->value()=="writev")
+            ::setenv("async_append_file_backend", "writev", 1);
+
+        if (async_append_file_backend()!=a->value())
+            "f05770a8-3aaa-4e4e-bdd5-e75fdea744f7"_log("the backend ${data} is not available").data(a->value()).throw_error();
+    }
+
+    auto
+        dir = ::fs::temp_directory_path();
+
+    if (auto a = attribute1("dir", false))
+        dir = a->value();
+
+    dir /= "async_append_file_test_" + ::std::to_string(::getpid());
+
+    ::fs::create_directories(dir);
+
+    auto
+        run = [&](char const * name, void (*test)(::fs::path const &))
+            {
+                test(dir);
+
+                ::std::cout << async_append_file_backend() << ' ' << name << " ok" << ::std::endl;
+            };
+
+    run("order", test_order);
+    run("full queue", test_full_queue);
+    run("short writes", test_short_writes);
+    run("failed writes", test_failed_writes);
+
+    ::fs::remove_all(dir);
+#endif
+}
+
+}
@@ -0,0 +1,290 @@
+﻿#include "r_base/commandline/Command_ChannelBenchmark.h"
+#include "r_base/concurrent.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+auto
+sHelpMessageBrief =
+"Compare the throughput of the channels of concurrent.h from one sending to\n"
+"one receiving thread: channel, channel_ring and spsc_channel with single\n"
+"elements and in batches."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : count\n"
+"       occurrence  : once (optional)\n"
+"       values      : Integer\n"
+"       default     : 2000000\n"
+"           The count of elements per run.\n"
+"\n"
+"       attribute   : batch\n"
+"       occurrence  : once (optional)\n"
+"       values      : Integer\n"
+"       default     : 256\n"
+"           The size of the batches of spsc_channel.\n"
+"\n"
+"       attribute   : capacity\n"
+"       occurrence  : once (optional)\n"
+"       values      : Integer\n"
+"       default     : 1024\n"
+"           The capacity of each channel.\n"
+;
+
+using clock = ::std::chrono::steady_clock;
+
+
+/// run the sender in a thread and the receiver in this one
+template<typename Send, typename Recv>
+clock::duration
+    measure(
+            Send const & send
+        ,   Recv const & recv
+        )
+        {
+            auto
+                start = clock::now();
+
+            ::std::thread
+                sender(send);
+
+            recv();
+            sender.join();
+
+            return clock::now() - start;
+        }
+
+
+void
+    result_print(
+            char const      * name
+        ,   clock::duration   d
+        ,   clock::duration   base
+        ,   ::std::size_t     count
+        )
+        {
+            auto
+                ns = [](clock::duration d)
+                    {
+                        return double(::std::chrono::duration_cast<::std::chrono::nanoseconds>(d).count());
+                    };
+
+            char
+                line[160];
+
+            ::std::snprintf(
+                    line
+                ,   sizeof(line)
+                ,   "%-14s %8.1f ns/element   total %9.1f ms   %6.2fx channel\n"
+                ,   name
+                ,   ns(d)/double(count)
+                ,   ns(d)/1e6
+                ,   ns(base)/ns(d)
+                );
+
+            ::std::cout << line;
+        }
+}
+
+
+command_ref_t
+Command_ChannelBenchmark::factory()
+{
+    return command_ref_t(new Command_ChannelBenchmark);
+}
+
+
+void
+Command_ChannelBenchmark::registerMe()
+{
+    registerFactory("channel-benchmark",factory);
+}
+
+
+::std::string_view
+Command_ChannelBenchmark::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_ChannelBenchmark::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_ChannelBenchmark::execute()
+{
+    auto
+        count = 2000000_sz;
+
+    if (auto a = attribute1("count", false))
+        count = ::std::stoul(a->value());
+
+    auto
+        batch = 256_sz;
+
+    if (auto a = attribute1("batch", false))
+        batch = ::std::max(::std::stoul(a->value()), 1ul);
+
+    auto
+        capacity = 1024_sz;
+
+    if (auto a = attribute1("capacity", false))
+        capacity = ::std::stoul(a->value());
+
+    // the sum tells that every element arrived
+    auto const
+        expected = count*(count-1)/2;
+
+    auto
+        checked = [&](char const * name, long sum)
+            {
+                if (::std::size_t(sum)!=expected)
+                    "e4fe1b7e-37da-4665-a5eb-631975e2e047"_log("${data} lost elements").data(name).throw_error();
+            };
+
+    clock::duration
+        base;
+
+    {
+        concurrent::channel<long>
+            c {int(capacity)};
+
+        long
+            sum {};
+
+        base = measure(
+                [&]
+                {
+                    for (auto i=0_sz; i<count; ++i)
+                        c.send(long(i));
+
+                    c.drain();
+                }
+            ,   [&]
+                {
+                    while (auto v = c.recv())
+                        sum += *v;
+                }
+            );
+
+        checked("channel", sum);
+        result_print("channel", base, base, count);
+    }
+
+    {
+        concurrent::channel_ring<long>
+            c {capacity};
+
+        long
+            sum {};
+
+        auto
+            d = measure(
+                    [&]
+                    {
+                        for (auto i=0_sz; i<count; ++i)
+                            c.send(long(i));
+
+                        c.drain();
+                    }
+                ,   [&]
+                    {
+                        while (auto v = c.recv())
+                            sum += *v;
+                    }
+                );
+
+        checked("channel_ring", sum);
+        result_print("channel_ring", d, base, count);
+    }
+
+    {
+        concurrent::spsc_channel<long>
+            c {capacity};
+
+        long
+            sum {};
+
+        auto
+            d = measure(
+                    [&]
+                    {
+                        for (auto i=0_sz; i<count; ++i)
+                            c.send(long(i));
+
+                        c.drain();
+                    }
+                ,   [&]
+                    {
+                        while (auto v = c.recv())
+                            sum += *v;
+                    }
+                );
+
+        checked("spsc", sum);
+        result_print("spsc", d, base, count);
+    }
+
+    {
+        concurrent::spsc_channel<long>
+            c {capacity};
+
+        long
+            sum {};
+
+        auto
+            d = measure(
+                    [&]
+                    {
+                        ::std::vector<long>
+                            vvv(batch);
+
+                        for (auto i=0_sz; i<count;)
+                        {
+                            auto
+                                n = ::std::min(batch, count-i);
+
+                            for (auto k=0_sz; k<n; ++k)
+                                vvv[k] = long(i+k);
+
+                            i += c.send_n(vvv.begin(), n);
+                        }
+
+                        c.drain();
+                    }
+                ,   [&]
+                    {
+                        ::std::vector<long>
+                            vvv;
+
+                        while (c.recv_n(batch, vvv))
+                        {
+                            for (auto v : vvv)
+                                sum += v;
+
+                            vvv.clear();
+                        }
+                    }
+                );
+
+        checked("spsc batches", sum);
+        result_print("spsc batches", d, base, count);
+    }
+}
+
+}
@@ -0,0 +1,808 @@
+﻿#include "r_base/commandline/Command_ConcurrentTest.h"
+#include "r_base/commandline/test_tools.h"
+#include "r_base/concurrent.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test the channels of concurrent.h, their wait strategies, select() and the\n"
+"multiplexer.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : test\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : all tests\n"
+"           The name of the single test to run.\n"
+;
+
+/// a deadline that is reached already, to recv without waiting
+auto const c_now = ::std::chrono::system_clock::time_point{};
+
+
+/// the elements of several senders arrive completely and in order per sender
+void
+    test_ring_send_recv()
+        {
+            constexpr auto
+                c_senders = 4;
+
+            constexpr auto
+                c_sends = 20000;
+
+            concurrent::channel_ring<int>
+                c {64};
+
+            ::std::vector<::std::thread>
+                threads;
+
+            for (auto t=0; t<c_senders; ++t)
+                threads.emplace_back([&, t]
+                    {
+                        for (auto i=0; i<c_sends; ++i)
+                            c.send(t*c_sends + i);
+                    });
+
+            ::std::atomic<int>
+                count {};
+
+            ::std::atomic<bool>
+                is_ordered {true};
+
+            ::std::vector<::std::thread>
+                receivers;
+
+            for (auto r=0; r<2; ++r)
+                receivers.emplace_back([&]
+                    {
+                        int
+                            last[c_senders];
+
+                        ::std::fill(::std::begin(last), ::std::end(last), -1);
+
+                        while (auto v = c.recv())
+                        {
+                            auto & l = last[*v / c_sends];
+
+                            if (*v<=l)
+                                is_ordered = false;
+
+                            l = *v;
+                            ++count;
+                        }
+                    });
+
+            for (auto & t : threads)
+                t.join();
+
+            check(wait_until([&]{return c.empty();}), "the receivers empty the channel");
+
+            c.drain();
+
+            for (auto & t : receivers)
+                t.join();
+
+            check(count==c_senders*c_sends, "every element is received once");
+            check(is_ordered, "the elements of a sender are received in order");
+        }
+
+
+/// a drained ring takes nothing but hands out what it holds
+void
+    test_ring_drain()
+        {
+            concurrent::channel_ring<int>
+                c {5};
+
+            check(c.capacity()==8, "the capacity is rounded up to a power of 2");
+
+            for (auto i=0; i<8; ++i)
+                check(c.try_send(int{i}), "the element is sent");
+
+            check(!c.try_send(8), "a full channel takes no element");
+
+            c.drain();
+
+            check(!c.is_open() && !c.is_drained(), "the drained channel still holds elements");
+            check(!c.send(9), "a drained channel takes no element");
+            check(c.recv()==0, "the held elements are received");
+            check(c.recv_all().size()==7, "the held elements are received at once");
+            check(c.is_drained() && !c.recv(), "the drained channel is empty");
+        }
+
+
+/// blocked receivers and senders are released by drain()
+void
+    test_ring_drain_wakes()
+        {
+            concurrent::channel_ring<int>
+                c {2};
+
+            ::std::atomic<int>
+                released {};
+
+            ::std::thread
+                receiver([&]
+                    {
+                        if (!c.recv())
+                            ++released;
+                    });
+
+            // let the receiver block
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{20});
+
+            c.drain();
+            receiver.join();
+
+            check(released==1, "the waiting receiver is released");
+
+            concurrent::channel_ring<int>
+                full {2};
+
+            full.send(1);
+            full.send(2);
+
+            ::std::thread
+                sender([&]
+                    {
+                        if (!full.send(3))
+                            ++released;
+                    });
+
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{20});
+
+            full.drain();
+            sender.join();
+
+            check(released==2, "the waiting sender is released");
+        }
+
+
+/// single and batched elements arrive completely and in order
+void
+    test_spsc_send_recv()
+        {
+            constexpr auto
+                c_sends = 100000;
+
+            concurrent::spsc_channel<int>
+                c {16};
+
+            ::std::thread
+                sender([&]
+                    {
+                        ::std::vector<int>
+                            batch;
+
+                        for (auto i=0; i<c_sends;)
+                        {
+                            // alternate single elements and batches larger than the channel
+                            if (i%3)
+                            {
+                                c.send(int{i++});
+                                continue;
+                            }
+
+                            batch.clear();
+
+                            for (auto k=0; k<40 && i<c_sends; ++k)
+                                batch.push_back(i++);
+
+                            c.send_n(batch.begin(), batch.size());
+                        }
+
+                        c.drain();
+                    });
+
+            ::std::vector<int>
+                received;
+
+            ::std::vector<int>
+                batch;
+
+            while (true)
+            {
+                if (received.size()%2)
+                {
+                    if (auto v = c.recv())
+                        received.push_back(*v);
+                    else
+                        break;
+                }
+                else
+                {
+                    batch.clear();
+
+                    if (!c.recv_n(7, batch))
+                        break;
+
+                    received.insert(received.end(), batch.begin(), batch.end());
+                }
+            }
+
+            sender.join();
+
+            auto
+                is_ordered = received.size()==c_sends;
+
+            for (auto i=0_sz; is_ordered && i<received.size(); ++i)
+                is_ordered = received[i]==int(i);
+
+            check(is_ordered, "every element is received once and in order");
+        }
+
+
+/// a drained spsc_channel takes nothing but hands out what it holds
+void
+    test_spsc_drain()
+        {
+            concurrent::spsc_channel<::std::string>
+                c {3};
+
+            check(c.capacity()==4, "the capacity is rounded up to a power of 2");
+
+            for (auto i=0; i<4; ++i)
+                check(c.try_send(::std::to_string(i)), "the element is sent");
+
+            ::std::string
+                val {"4"};
+
+            check(!c.try_send(::std::move(val)) && val=="4", "a full channel takes no element and leaves it");
+
+            c.drain();
+
+            check(!c.send(::std::string{"5"}), "a drained channel takes no element");
+            check(c.recv()=="0", "the held elements are received");
+
+            ::std::vector<::std::string>
+                rest;
+
+            check(c.recv_n(10, rest)==3 && rest.back()=="3", "the held elements are received at once");
+            check(c.is_drained() && !c.recv(), "the drained channel is empty");
+        }
+
+
+/// blocked receiver and sender are released by drain()
+void
+    test_spsc_drain_wakes()
+        {
+            ::std::atomic<int>
+                released {};
+
+            concurrent::spsc_channel<int>
+                empty {2};
+
+            ::std::thread
+                receiver([&]
+                    {
+                        if (!empty.recv())
+                            ++released;
+                    });
+
+            // let the receiver block
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{20});
+
+            empty.drain();
+            receiver.join();
+
+            check(released==1, "the waiting receiver is released");
+
+            concurrent::spsc_channel<int>
+                full {2};
+
+            ::std::thread
+                sender([&]
+                    {
+                        full.send(1);
+                        full.send(2);
+
+                        if (!full.send(3))
+                            ++released;
+                    });
+
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{20});
+
+            full.drain();
+            sender.join();
+
+            check(released==2, "the waiting sender is released");
+        }
+
+
+/** Each wait strategy on a channel type: the deadlines of both clocks expire,
+    blocked senders and receivers are woken.
+*/
+template<typename Channel>
+void
+    strategies_check()
+        {
+            using namespace ::std::chrono_literals;
+
+            constexpr auto
+                c_timeout = 20ms;
+
+            auto
+                expires = [&](auto const & op, auto now)
+                    {
+                        auto
+                            start = ::std::chrono::steady_clock::now();
+
+                        return !op(now() + c_timeout) && ::std::chrono::steady_clock::now() - start >= c_timeout;
+                    };
+
+            auto
+                steady_now = []{return ::std::chrono::steady_clock::now();};
+
+            auto
+                system_now = []{return ::std::chrono::system_clock::now();};
+
+            for (auto strategy : {
+                    concurrent::wait_strategy::PARK
+                ,   concurrent::wait_strategy::SPIN_YIELD_PARK
+                ,   concurrent::wait_strategy::BUSY_SPIN
+                })
+            {
+                Channel
+                    c {2, strategy};
+
+                auto
+                    recv = [&](concurrent::deadline const & d){return bool(c.recv(d));};
+
+                auto
+                    send = [&](concurrent::deadline const & d){return c.send(3, d);};
+
+                check(expires(recv, steady_now), "a recv() deadline of the steady_clock expires");
+                check(expires(recv, system_now), "a recv() deadline of the system_clock expires");
+
+                c.send(1);
+                c.send(2);
+
+                check(expires(send, steady_now), "a send() deadline of the steady_clock expires");
+                check(expires(send, system_now), "a send() deadline of the system_clock expires");
+
+                // a blocked sender is woken by a recv()
+                ::std::thread
+                    sender([&]{c.send(3);});
+
+                ::std::this_thread::sleep_for(c_timeout);
+
+                check(c.recv()==1, "the first element is received");
+
+                sender.join();
+
+                check(c.recv()==2 && c.recv()==3, "the blocked sender completes");
+
+                // a blocked receiver is woken by a send()
+                ::std::optional<int>
+                    received;
+
+                ::std::thread
+                    receiver([&]{received = c.recv();});
+
+                ::std::this_thread::sleep_for(c_timeout);
+
+                c.send(4);
+                receiver.join();
+
+                check(received==4, "the blocked receiver completes");
+            }
+        }
+
+
+void
+    test_strategies()
+        {
+            strategies_check<concurrent::channel<int>>();
+            strategies_check<concurrent::channel_ring<int>>();
+            strategies_check<concurrent::spsc_channel<int>>();
+        }
+
+
+/// a deadline converts from the time points of both clocks and optionals
+void
+    test_deadline()
+        {
+            auto
+                past_steady = concurrent::deadline{::std::chrono::steady_clock::now() - ::std::chrono::seconds{1}};
+
+            auto
+                past_system = concurrent::deadline{::std::chrono::system_clock::time_point{}};
+
+            auto
+                future = concurrent::deadline{::std::chrono::steady_clock::now() + ::std::chrono::hours{1}};
+
+            auto
+                none = concurrent::deadline{::std::optional<::std::chrono::steady_clock::time_point>{}};
+
+            check(past_steady && past_steady.is_reached(), "a past steady_clock deadline is reached");
+            check(past_system && past_system.is_reached(), "a past system_clock deadline is reached");
+            check(future && !future.is_reached(), "a future deadline is not reached");
+            check(!none && !none.is_reached(), "an empty optional means no limit");
+        }
+
+
+/// select() tries once with a past deadline and expires with both clocks
+void
+    test_select_deadline()
+        {
+            using namespace ::std::chrono_literals;
+
+            concurrent::channel<int>
+                a, b;
+
+            concurrent::recv_case
+                ra {a}, rb {b};
+
+            check(!concurrent::select(c_now, ra, rb), "nothing completes without waiting");
+
+            auto
+                start = ::std::chrono::steady_clock::now();
+
+            check(!concurrent::select(::std::chrono::steady_clock::now() + 20ms, ra, rb), "a steady_clock deadline expires");
+            check(!concurrent::select(::std::chrono::system_clock::now() + 20ms, ra, rb), "a system_clock deadline expires");
+            check(::std::chrono::steady_clock::now() - start >= 40ms, "the deadlines are waited for");
+        }
+
+
+/// exactly one ready case completes, the ready cases take turns
+void
+    test_select_ready()
+        {
+            concurrent::channel<int>
+                a, b;
+
+            for (auto i=0; i<100; ++i)
+            {
+                a.send(int{i});
+                b.send(int{i});
+            }
+
+            int
+                completed[2] {};
+
+            for (auto i=0; i<100; ++i)
+            {
+                concurrent::recv_case
+                    ra {a}, rb {b};
+
+                auto
+                    k = concurrent::select({}, ra, rb);
+
+                check(k && (*k==0 ? ra.value && !rb.value : rb.value && !ra.value), "exactly one case completes");
+
+                ++completed[*k];
+            }
+
+            check(completed[0] && completed[1], "no ready channel starves");
+            check(a.size() + b.size()==100, "the other elements remain queued");
+        }
+
+
+/// a thread blocked in select() is woken by a send, a recv making room and a drain
+void
+    test_select_wakeups()
+        {
+            using namespace ::std::chrono_literals;
+
+            concurrent::channel<int>
+                a, b, full {1};
+
+            full.send(0);
+
+            auto
+                later = [](auto && f)
+                    {
+                        return ::std::thread([f]
+                            {
+                                ::std::this_thread::sleep_for(20ms);
+                                f();
+                            });
+                    };
+
+            {
+                concurrent::recv_case
+                    ra {a}, rb {b};
+
+                auto
+                    t = later([&]{b.send(7);});
+
+                auto
+                    k = concurrent::select({}, ra, rb);
+
+                t.join();
+
+                check(k==1 && rb.value==7, "a send wakes the select");
+            }
+
+            {
+                concurrent::recv_case
+                    ra {a};
+
+                concurrent::send_case
+                    sf {full, 1};
+
+                auto
+                    t = later([&]{full.recv();});
+
+                auto
+                    k = concurrent::select({}, ra, sf);
+
+                t.join();
+
+                check(k==1 && sf.is_sent() && full.recv(c_now)==1, "a recv making room wakes the select");
+            }
+
+            {
+                concurrent::recv_case
+                    ra {a};
+
+                auto
+                    t = later([&]{a.drain();});
+
+                auto
+                    k = concurrent::select({}, ra);
+
+                t.join();
+
+                check(k==0 && !ra.value, "a drain completes the case without a value");
+            }
+        }
+
+
+/// concurrent sends arrive at all subscribers in the same order
+void
+    test_multiplexer_order()
+        {
+            constexpr auto
+                c_threads = 4;
+
+            constexpr auto
+                c_sends = 1000;
+
+            concurrent::multiplexer<int>
+                mux;
+
+            ::std::vector<concurrent::multiplexer<int>::channel_ref_t>
+                channels;
+
+            for (auto i=0; i<3; ++i)
+                channels.push_back(mux.subscribe());
+
+            ::std::vector<::std::thread>
+                threads;
+
+            for (auto t=0; t<c_threads; ++t)
+                threads.emplace_back([&, t]
+                    {
+                        for (auto i=0; i<c_sends; ++i)
+                            mux.send(t*c_sends + i);
+                    });
+
+            for (auto & t : threads)
+                t.join();
+
+            ::std::vector<::std::vector<int>>
+                received(channels.size());
+
+            for (auto i=0_sz; i<channels.size(); ++i)
+                while (auto v = channels[i]->recv(c_now))
+                    received[i].push_back(*v);
+
+            check(received[0].size()==c_threads*c_sends, "every element is received");
+            check(received[1]==received[0] && received[2]==received[0], "the subscribers receive the same order");
+        }
+
+
+/// a WAIT subscriber with a full channel doesn't hold back the others
+void
+    test_multiplexer_wait()
+        {
+            concurrent::multiplexer<int>
+                mux;
+
+            auto
+                waiting = mux.subscribe(1, concurrent::overflow_policy::WAIT);
+
+            auto
+                other = mux.subscribe();
+
+            mux.send(1);
+
+            ::std::thread
+                sender([&]
+                    {
+                        mux.send(2);
+                        mux.send_all(::std::vector<int>{3, 4, 5});
+                    });
+
+            check(
+                    wait_until([&]{return other->recv(c_now)==2;})
+                ,   "the other subscriber receives while the WAIT subscriber is full"
+                );
+
+            ::std::vector<int>
+                received;
+
+            while (received.size()<5)
+                if (auto v = waiting->recv())
+                    received.push_back(*v);
+
+            sender.join();
+
+            check(received==::std::vector<int>{1, 2, 3, 4, 5}, "the WAIT subscriber receives every element in order");
+            check(mux.counters(waiting)->delivered==5, "the elements delivered are counted");
+
+            ::std::vector<int>
+                others;
+
+            while (auto v = other->recv(c_now))
+                others.push_back(*v);
+
+            check(others==::std::vector<int>{3, 4, 5}, "the collection is received by the other subscriber");
+        }
+
+
+/// DROP_OLDEST on a channel without room drops the element itself
+void
+    test_multiplexer_drop_oldest_unbuffered()
+        {
+            concurrent::multiplexer<int>
+                mux;
+
+            auto
+                c = mux.subscribe(::std::optional{0}, concurrent::overflow_policy::DROP_OLDEST);
+
+            mux.send(1);
+            mux.send_all(::std::vector<int>{2, 3});
+
+            auto
+                counters = mux.counters(c);
+
+            check(!c->recv(c_now), "nothing is queued");
+            check(counters->delivered==0 && counters->dropped==3, "the elements are counted as dropped");
+
+            concurrent::channel<int>
+                channel {0};
+
+            check(channel.send_overwrite(1)==1_sz, "send_overwrite() drops the element");
+            check(!channel.recv(c_now), "the channel stays within its limit");
+        }
+
+
+/// a channel dropped by its subscriber gets unsubscribed
+void
+    test_multiplexer_unsubscribe()
+        {
+            concurrent::multiplexer<int>
+                mux;
+
+            auto
+                kept = mux.subscribe();
+
+            mux.subscribe();
+
+            mux.send(1);
+
+            check(mux.counters(kept)->delivered==1, "the element is delivered");
+            check(kept->recv(c_now)==1, "the element is received");
+
+            kept.reset();
+            mux.send(2);
+
+            check(!mux.has_subscribers(), "the dropped channels are unsubscribed");
+        }
+
+
+/// the subscribers of a shared_multiplexer receive the same instance
+void
+    test_shared_multiplexer()
+        {
+            concurrent::shared_multiplexer<::std::string>
+                mux;
+
+            auto
+                a = mux.subscribe();
+
+            auto
+                b = mux.subscribe(2, concurrent::overflow_policy::DROP_NEWEST);
+
+            mux.send(::std::string{"one"});
+            mux.send_all(::std::vector<::std::string>{"two", "three"});
+
+            auto
+                first = a->recv(c_now);
+
+            check(first && **first=="one", "the element is received");
+            check(b->recv(c_now)==*first, "the subscribers share the instance");
+            ::std::vector<concurrent::shared_multiplexer<::std::string>::element_t>
+                rest;
+
+            check(a->recv_n(10, rest, c_now)==2, "the collection is received");
+            check(mux.counters(b)->dropped==1, "the element beyond the limit is dropped");
+        }
+}
+
+
+command_ref_t
+Command_ConcurrentTest::factory()
+{
+    return command_ref_t(new Command_ConcurrentTest);
+}
+
+
+void
+Command_ConcurrentTest::registerMe()
+{
+    registerFactory("concurrent-test",factory);
+}
+
+
+::std::string_view
+Command_ConcurrentTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_ConcurrentTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_ConcurrentTest::execute()
+{
+    ::std::optional<::std::string>
+        only;
+
+    if (auto a = attribute1("test", false))
+        only = a->value();
+
+    auto
+        run = [&](char const * name, void (*test)())
+            {
+                if (only && *only!=name)
+                    return;
+
+                test();
+
+                ::std::cout << name << " ok" << ::std::endl;
+            };
+
+    run("ring send recv", test_ring_send_recv);
+    run("ring drain", test_ring_drain);
+    run("ring drain wakes", test_ring_drain_wakes);
+    run("spsc send recv", test_spsc_send_recv);
+    run("spsc drain", test_spsc_drain);
+    run("spsc drain wakes", test_spsc_drain_wakes);
+    run("strategies", test_strategies);
+    run("deadline", test_deadline);
+    run("select deadline", test_select_deadline);
+    run("select ready", test_select_ready);
+    run("select wakeups", test_select_wakeups);
+    run("multiplexer order", test_multiplexer_order);
+    run("multiplexer wait", test_multiplexer_wait);
+    run("multiplexer drop oldest unbuffered", test_multiplexer_drop_oldest_unbuffered);
+    run("multiplexer unsubscribe", test_multiplexer_unsubscribe);
+    run("shared multiplexer", test_shared_multiplexer);
+}
+
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+// Copyright (C) Ralf Kubis
+
+#include "r_base/commandline/Command.h"
+
+namespace nsBase::commandline
+{
+
+class Command_ConcurrentTest
+:   public Command
+{
+    public  : R_DTOR_(Command_ConcurrentTest) = default;
+    private : R_CTOR_(Command_ConcurrentTest) = default;
+    private : R_CCPY_(Command_ConcurrentTest) = delete;
+    private : R_CMOV_(Command_ConcurrentTest) = delete;
+    private : R_COPY_(Command_ConcurrentTest) = delete;
+    private : R_MOVE_(Command_ConcurrentTest) = delete;
+
+    private : static command_ref_t
+        factory();
+
+    public : static void
+        registerMe();
+
+////////////////////////////////////////////////////////////////////////////////
+/** \name base
+@{*/
+    public : virtual ::std::string_view
+        helpMessageBrief() override;
+
+    public : virtual ::std::string_view
+        helpMessageAttributes() override;
+
+    public : virtual void
+        execute();
+
+    public : virtual ::std::string
+        name() const override
+            {
+                return "concurrent-test";
+            }
+//@}
+};
+
+}
@@ -0,0 +1,94 @@
+﻿#include "r_base/commandline/Command_LogArchive.h"
+#include "r_base/log_archive.h"
+
+#include <iostream>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+auto
+sHelpMessageBrief =
+"Convert log files into a columnar archive (see LogArchiveWriter), or print\n"
+"the Logs of an archive, one JSON object per line."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : archive\n"
+"       occurrence  : once (required)\n"
+"       values      : String\n"
+"       default     : \n"
+"           The path of the archive.\n"
+"\n"
+"       attribute   : path\n"
+"       occurrence  : any\n"
+"       values      : String\n"
+"       default     : \n"
+"           A log file to convert, including its rotated segments.\n"
+"           The Logs of all files are written to the archive, in the given\n"
+"           order. Without this attribute the archive gets printed.\n"
+;
+}
+
+
+command_ref_t
+Command_LogArchive::factory()
+{
+    return command_ref_t(new Command_LogArchive);
+}
+
+
+void
+Command_LogArchive::registerMe()
+{
+    registerFactory("log-archive",factory);
+}
+
+
+::std::string_view
+Command_LogArchive::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogArchive::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogArchive::execute()
+{
+    auto
+        archive = attribute1("archive")->value();
+
+    ::std::vector<::fs::path>
+        paths;
+
+    for (auto & a : attributes("path"))
+        paths.push_back(a->value());
+
+    if (!paths.empty())
+    {
+        auto
+            count = log_archive_convert(paths, archive);
+
+        ::std::cout << count << " Logs archived\n";
+        ::std::cout.flush();
+
+        return;
+    }
+
+    for (auto & log : LogArchive{archive}.logs())
+        ::std::cout << log.serialize() << '\n';
+
+    ::std::cout.flush();
+}
+
+}
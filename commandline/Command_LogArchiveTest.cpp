@@ -0,0 +1,268 @@
+﻿#include "r_base/commandline/Command_LogArchiveTest.h"
+#include "r_base/log_archive.h"
+#include "r_base/commandline/test_tools.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test LogArchiveWriter and LogArchive: the Logs written are read back,\n"
+"also across chunks, single columns can be read, and full chunks are\n"
+"written before the archive gets closed.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : dir\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : the temp directory\n"
+"           The directory of the archives.\n"
+;
+
+
+constexpr ::std::size_t
+    c_chunk_rows = 100;
+
+constexpr auto
+    c_count = 250;
+
+
+/// Logs with columns of all kinds, some of them absent in some rows
+::std::vector<Log>
+    logs_make()
+        {
+            ::std::vector<Log>
+                logs;
+
+            for (auto i=0; i<c_count; ++i)
+            {
+                Log
+                    log {"e89665f3-bc44-486a-b4d0-bc34640cf293"_uuid};
+
+                log.message("line ${data}").data(i);
+                log.time(time::time_point_t{::std::chrono::microseconds{1'700'000'000'000'000 + i*1'000'003}});
+
+                if (i%3==0)
+                    log.warning();
+
+                if (i<150)
+                    log.scope("first");
+
+                log("n", i);
+
+                if (i%2)
+                    log("text", i%5 ? "odd" : "odd five");
+
+                log.disarm();
+
+                logs.push_back(::std::move(log));
+            }
+
+            return logs;
+        }
+
+
+void
+    archive_write(
+            ::fs::path          const & path
+        ,   ::std::vector<Log>  const & logs
+        )
+        {
+            LogArchiveWriter
+                writer;
+
+            writer.open(path, c_chunk_rows);
+
+            for (auto & log : logs)
+                writer.add(log);
+
+            writer.close();
+
+            check(writer.size()==logs.size(), "all Logs are counted");
+        }
+
+
+/// the Logs are read back as they were written, across the chunks
+void
+    test_round_trip(
+            ::fs::path const & path
+        )
+        {
+            auto
+                logs = logs_make();
+
+            archive_write(path, logs);
+
+            LogArchive
+                archive {path};
+
+            check(archive.size()==logs.size(), "the archive has all Logs");
+
+            auto
+                read = archive.logs();
+
+            check(read.size()==logs.size(), "all Logs are read back");
+
+            for (auto i=0_sz; i<logs.size(); ++i)
+                check(read[i].serialize()==logs[i].serialize(), "the Logs are read back as written");
+        }
+
+
+/// a column is read on its own
+void
+    test_columns(
+            ::fs::path const & path
+        )
+        {
+            auto
+                logs = logs_make();
+
+            archive_write(path, logs);
+
+            LogArchive
+                archive {path};
+
+            auto levels   = archive.levels();
+            auto creators = archive.creators();
+            auto times    = archive.times();
+            auto messages = archive.property("message");
+            auto scopes   = archive.property("scope");
+            auto ns       = archive.attribute("n");
+            auto texts    = archive.attribute("text");
+            auto missing  = archive.attribute("missing");
+
+            for (auto i=0_sz; i<logs.size(); ++i)
+            {
+                check(levels[i]==logs[i].level(), "the levels are read");
+                check(creators[i]==logs[i].creator(), "the creators are read");
+                check(times[i]==logs[i].time(), "the times are read");
+                check(messages[i]==logs[i].message(), "the messages are read");
+                check(scopes[i]==logs[i].property("scope"), "the scopes are read, also where absent");
+                check(ns[i]==logs[i].attribute("n"), "the integer attributes are read");
+                check(texts[i]==logs[i].attribute("text"), "the string attributes are read, also where absent");
+                check(!missing[i], "an unknown attribute is absent");
+            }
+
+            auto
+                keys = archive.attribute_keys();
+
+            for (auto key : {"data", "n", "text"})
+                check(::std::find(keys.begin(), keys.end(), key)!=keys.end(), "the attribute keys of all chunks are listed");
+        }
+
+
+/// the columns of a full chunk are written before the archive is closed
+void
+    test_chunks(
+            ::fs::path const & path
+        )
+        {
+            auto
+                logs = logs_make();
+
+            LogArchiveWriter
+                writer;
+
+            writer.open(path, c_chunk_rows);
+
+            auto
+                size_empty = ::fs::file_size(path);
+
+            for (auto i=0_sz; i<c_chunk_rows-1; ++i)
+                writer.add(logs[i]);
+
+            check(::fs::file_size(path)==size_empty, "the rows of a chunk are collected");
+
+            writer.add(logs[c_chunk_rows-1]);
+
+            check(::fs::file_size(path)>size_empty, "a full chunk gets written");
+
+            writer.close();
+
+            LogArchive
+                archive {path};
+
+            check(archive.size()==c_chunk_rows, "the archive has the Logs of the chunk");
+
+            writer.open(path);
+            writer.close();
+
+            check(LogArchive{path}.size()==0, "an archive can be empty");
+        }
+}
+
+
+command_ref_t
+Command_LogArchiveTest::factory()
+{
+    return command_ref_t(new Command_LogArchiveTest);
+}
+
+
+void
+Command_LogArchiveTest::registerMe()
+{
+    registerFactory("log-archive-test",factory);
+}
+
+
+::std::string_view
+Command_LogArchiveTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogArchiveTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogArchiveTest::execute()
+{
+    auto
+        dir = ::fs::temp_directory_path();
+
+    if (auto a = attribute1("dir", false))
+        dir = a->value();
+
+    auto
+        suffix = to_string(::uuids::uuid_system_generator{}());
+
+    auto
+        run = [&](char const * name, void (*test)(::fs::path const &))
+            {
+                auto
+                    path = dir / ("log_archive_test_" + suffix + ".rlarc");
+
+                ::fs::remove(path);
+
+                test(path);
+
+                ::fs::remove(path);
+
+                ::std::cout << name << " ok" << ::std::endl;
+            };
+
+    run("round trip", test_round_trip);
+    run("columns", test_columns);
+    run("chunks", test_chunks);
+}
+
+}
@@ -0,0 +1,198 @@
+﻿#include "r_base/commandline/Command_LogCollector.h"
+#include "r_base/log_socket.h"
+#include "r_base/log_shm_ring.h"
+#include "r_base/log_consumer_file.h"
+
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+auto
+sHelpMessageBrief =
+"Receive the Logs shipped by LogSocketSender or LogShmRingWriter of the local\n"
+"processes and re-broadcast them to the consumers of this process, until\n"
+"SIGINT or SIGTERM."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : socket\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : \n"
+"           The path of the Unix domain socket to listen on.\n"
+"\n"
+"       attribute   : ring\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : \n"
+"           The name of the shared-memory log ring to drain, e.g. /my_app.log.\n"
+"           At least one of 'socket' and 'ring' is required.\n"
+"\n"
+"       attribute   : file\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : \n"
+"           The log file to write the Logs to (see log_consumer_file()).\n"
+"           Without this attribute the Logs are written to stdout, one JSON\n"
+"           object per line.\n"
+;
+
+// the ring is polled at this interval while it is empty
+constexpr auto
+    c_ring_poll_interval = ::std::chrono::milliseconds{1};
+}
+
+
+command_ref_t
+Command_LogCollector::factory()
+{
+    return command_ref_t(new Command_LogCollector);
+}
+
+
+void
+Command_LogCollector::registerMe()
+{
+    registerFactory("log-collector",factory);
+}
+
+
+::std::string_view
+Command_LogCollector::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogCollector::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogCollector::execute()
+{
+#ifdef _WIN32
+    "5b0e7c31-9d2a-4f86-a3c4-1e8f6d20b957"_log("log-collector is not supported on this platform").throw_error();
+#else
+    auto
+        a_socket = attribute1("socket", false);
+
+    auto
+        a_ring = attribute1("ring", false);
+
+    if (!a_socket && !a_ring)
+        "0e6d2a95-7c41-4b3f-9a18-d5c2f7e60b34"_log("One of the attributes 'socket' and 'ring' is required.").throw_error();
+
+    ::std::mutex
+        mutex;
+
+    Log::consumer_guard_t
+        consumer;
+
+    if (auto a = attribute1("file", false))
+    {
+        log_consumer_file_path_assign(a->value());
+
+        consumer = Log::consumer_register(log_consumer_file);
+    }
+    else
+    {
+        consumer = Log::consumer_register([&mutex](Log & log)
+            {
+                ::std::lock_guard
+                    guard {mutex};
+
+                ::std::cout << log.serialize() << '\n';
+            });
+    }
+
+    // the collector thread inherits the mask, so the signals end up in sigwait()
+    sigset_t
+        signals,
+        signals_previous;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    ::pthread_sigmask(SIG_BLOCK, &signals, &signals_previous);
+
+    LogSocketCollector
+        collector;
+
+    LogShmRingReader
+        ring;
+
+    auto
+        fail = [&](Log & log)
+            {
+                ::pthread_sigmask(SIG_SETMASK, &signals_previous, nullptr);
+
+                log.throw_error();
+            };
+
+    if (a_socket && !collector.open(a_socket->value()))
+        fail("c9a4e2f7-60b1-4d38-8e5c-7f2d1b93a046"_log("failed to listen on ${path}").path(a_socket->value()));
+
+    if (a_ring && !ring.open(a_ring->value()))
+        fail("8b27f4c0-3e9d-4a65-b1f8-6c0d9e2a7153"_log("failed to open the ring ${data}").data(a_ring->value()));
+
+    int
+        signal;
+
+    if (!a_ring)
+    {
+        ::sigwait(&signals, &signal);
+    }
+    else
+    {
+        auto
+            rebroadcast = [](Log & log){log.arm().broadcast_if();};
+
+        while (true)
+        {
+            if (ring.drain(rebroadcast))
+                continue;
+
+            sigset_t
+                pending;
+
+            if (::sigpending(&pending)==0 && (sigismember(&pending, SIGINT) || sigismember(&pending, SIGTERM)))
+            {
+                ::sigwait(&signals, &signal);
+                break;
+            }
+
+            ::std::this_thread::sleep_for(c_ring_poll_interval);
+        }
+
+        ring.drain(rebroadcast);
+    }
+
+    collector.close();
+    ring.close();
+
+    ::pthread_sigmask(SIG_SETMASK, &signals_previous, nullptr);
+
+    consumer.reset();
+
+    log_consumer_file_flush();
+    ::std::cout.flush();
+#endif
+}
+
+}
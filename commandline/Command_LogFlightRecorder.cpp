@@ -0,0 +1,69 @@
+﻿#include "r_base/commandline/Command_LogFlightRecorder.h"
+#include "r_base/log_flight_recorder.h"
+
+#include <iostream>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+auto
+sHelpMessageBrief =
+"Print the Logs recovered from a flight recorder ring file, oldest first,\n"
+"one JSON object per line."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : path\n"
+"       occurrence  : once (required)\n"
+"       values      : String\n"
+"       default     : \n"
+"           The path of the ring file written by LogFlightRecorder.\n"
+;
+}
+
+
+command_ref_t
+Command_LogFlightRecorder::factory()
+{
+    return command_ref_t(new Command_LogFlightRecorder);
+}
+
+
+void
+Command_LogFlightRecorder::registerMe()
+{
+    registerFactory("log-flight-recorder",factory);
+}
+
+
+::std::string_view
+Command_LogFlightRecorder::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogFlightRecorder::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogFlightRecorder::execute()
+{
+    auto
+        path = attribute1("path")->value();
+
+    for (auto & log : log_flight_recorder_read(path))
+        ::std::cout << log.serialize() << '\n';
+
+    ::std::cout.flush();
+}
+
+}
@@ -0,0 +1,295 @@
+﻿#include "r_base/commandline/Command_LogFlightRecorderTest.h"
+#include "r_base/log_flight_recorder.h"
+#include "r_base/commandline/test_tools.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test LogFlightRecorder: the Logs written are read back in order, reopening\n"
+"continues behind the newest record, and reopening while other threads log\n"
+"neither crashes nor damages records.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : dir\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : the temp directory\n"
+"           The directory of the ring files.\n"
+"\n"
+"       attribute   : reopens\n"
+"       occurrence  : once (optional)\n"
+"       values      : Integer\n"
+"       default     : 2000\n"
+"           How often the ring is reopened while the threads log.\n"
+;
+
+
+void
+    log_write(
+            LogFlightRecorder       & recorder
+        ,   int                       thread
+        ,   int                       n
+        )
+        {
+            Log
+                log {"2c46e04c-2b7c-4fbb-af55-309b73502d37"_uuid};
+
+            log.message("line");
+            log("thread", thread);
+            log("n", n);
+            log.disarm();
+
+            recorder(log);
+        }
+
+
+int
+    attribute_int(
+            Log             const & log
+        ,   ::std::string   const & key
+        )
+        {
+            auto
+                p = log.attribute(key);
+
+            check(p.has_value(), "the Log read back has its attributes");
+
+            return ::std::stoi(*p);
+        }
+
+
+/// the Logs written are read back in order
+void
+    test_round_trip(
+            ::fs::path const & path
+        ,   int
+        )
+        {
+            LogFlightRecorder
+                recorder;
+
+            check(recorder.open(path), "the ring file can be opened");
+
+            for (auto i=0; i<100; ++i)
+                log_write(recorder, 0, i);
+
+            recorder.close();
+
+            check(!recorder.is_open(), "the recorder is closed");
+
+            auto
+                logs = log_flight_recorder_read(path);
+
+            check(logs.size()==100, "all Logs are read back");
+
+            for (auto i=0; i<100; ++i)
+                check(attribute_int(logs[i], "n")==i, "the Logs are read back in order");
+        }
+
+
+/// reopening continues behind the newest record
+void
+    test_reopen_continues(
+            ::fs::path const & path
+        ,   int
+        )
+        {
+            LogFlightRecorder
+                recorder;
+
+            for (auto round=0; round<3; ++round)
+            {
+                check(recorder.open(path), "the ring file can be reopened");
+
+                for (auto i=0; i<10; ++i)
+                    log_write(recorder, 0, round*10+i);
+            }
+
+            recorder.close();
+
+            auto
+                logs = log_flight_recorder_read(path);
+
+            check(logs.size()==30, "the Logs of all rounds are read back");
+
+            for (auto i=0; i<30; ++i)
+                check(attribute_int(logs[i], "n")==i, "the Logs of all rounds are read back in order");
+        }
+
+
+/// reopening while other threads log doesn't write into an unmapped ring
+void
+    test_reopen_while_logging(
+            ::fs::path const & path
+        ,   int                reopens
+        )
+        {
+            constexpr auto
+                c_threads = 3;
+
+            LogFlightRecorder
+                recorder;
+
+            // small enough to wrap around
+            constexpr auto
+                c_capacity = 64_sz<<10;
+
+            check(recorder.open(path, c_capacity), "the ring file can be opened");
+
+            ::std::atomic_bool
+                is_stopped {};
+
+            ::std::atomic_int
+                written {};
+
+            ::std::vector<::std::thread>
+                threads;
+
+            for (auto t=0; t<c_threads; ++t)
+                threads.emplace_back([&, t]
+                    {
+                        for (auto n=0; !is_stopped; ++n)
+                        {
+                            log_write(recorder, t, n);
+                            ++written;
+                        }
+                    });
+
+            for (auto i=0; i<reopens; ++i)
+            {
+                if (!recorder.open(path, c_capacity))
+                {
+                    is_stopped = true;
+                    break;
+                }
+            }
+
+            auto
+                is_open = recorder.is_open();
+
+            is_stopped = true;
+
+            for (auto & t : threads)
+                t.join();
+
+            recorder.close();
+
+            check(is_open, "the ring file can be reopened each time");
+            check(written>0, "the threads logged");
+
+            auto
+                logs = log_flight_recorder_read(path);
+
+            check(!logs.empty(), "the Logs are read back");
+
+            int
+                last[c_threads];
+
+            ::std::fill(::std::begin(last), ::std::end(last), -1);
+
+            for (auto & log : logs)
+            {
+                auto
+                    t = attribute_int(log, "thread");
+
+                check(t>=0 && t<c_threads, "the Logs read back are intact");
+
+                auto
+                    n = attribute_int(log, "n");
+
+                check(n>last[t], "the Logs of each thread are read back in order");
+
+                last[t] = n;
+            }
+        }
+}
+
+
+command_ref_t
+Command_LogFlightRecorderTest::factory()
+{
+    return command_ref_t(new Command_LogFlightRecorderTest);
+}
+
+
+void
+Command_LogFlightRecorderTest::registerMe()
+{
+    registerFactory("log-flight-recorder-test",factory);
+}
+
+
+::std::string_view
+Command_LogFlightRecorderTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogFlightRecorderTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogFlightRecorderTest::execute()
+{
+#ifdef _WIN32
+    "21ae20be-a1b2-47db-8b91-13b523b99787"_log("log-flight-recorder-test is not supported on this platform").throw_error();
+#else
+    auto
+        dir = ::fs::temp_directory_path();
+
+    if (auto a = attribute1("dir", false))
+        dir = a->value();
+
+    auto
+        reopens = 2000;
+
+    if (auto a = attribute1("reopens", false))
+        reopens = ::std::stoi(a->value());
+
+    auto
+        suffix = to_string(::uuids::uuid_system_generator{}());
+
+    auto
+        run = [&](char const * name, void (*test)(::fs::path const &, int))
+            {
+                auto
+                    path = dir / ("log_flight_recorder_test_" + suffix + ".ring");
+
+                ::fs::remove(path);
+
+                test(path, reopens);
+
+                ::fs::remove(path);
+
+                ::std::cout << name << " ok" << ::std::endl;
+            };
+
+    run("round trip", test_round_trip);
+    run("reopen continues", test_reopen_continues);
+    run("reopen while logging", test_reopen_while_logging);
+#endif
+}
+
+}
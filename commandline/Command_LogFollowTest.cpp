@@ -0,0 +1,314 @@
+﻿#include "r_base/commandline/Command_LogFollowTest.h"
+#include "r_base/log_follow.h"
+#include "r_base/commandline/test_tools.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test log_follow(): Logs appended to a file are passed on, also across a\n"
+"rotation, a rename and a truncation of the file, and a follower sending\n"
+"into a full channel can be stopped.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : dir\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : the temp directory\n"
+"           The directory of the log files.\n"
+;
+
+
+
+void
+    lines_append(
+            ::fs::path  const & path
+        ,   int                 count
+        )
+        {
+            auto
+                f = ::std::fopen(path.string().c_str(), "ab");
+
+            check(f, "the log file can be opened");
+
+            for (auto i=0; i<count; ++i)
+            {
+                Log
+                    log {"9962f8c6-0cb3-4705-ae54-1823d31456fe"_uuid};
+
+                log.message("line ${data}").data(i);
+                log.disarm();
+
+                auto
+                    line = log.serialize() + '\n';
+
+                ::std::fwrite(line.data(), 1, line.size(), f);
+            }
+
+            ::std::fclose(f);
+        }
+
+
+/// the path the tests move the log file to
+::fs::path
+    path_old(
+            ::fs::path const & path
+        )
+        {
+            return path.string() + ".old";
+        }
+
+
+
+/// the Logs in the file and the ones appended later are passed to the callback
+void
+    test_callback(
+            ::fs::path const & path
+        )
+        {
+            lines_append(path, 3);
+
+            ::std::atomic_int
+                count {};
+
+            auto
+                follower = log_follow(path, [&count](Log &){++count;}, true);
+
+            check(wait_until([&]{return count==3;}), "the existing Logs are passed on");
+
+            lines_append(path, 2);
+
+            check(wait_until([&]{return count==5;}), "the appended Logs are passed on");
+
+            follower.dispose();
+
+            lines_append(path, 1);
+
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{100});
+
+            check(count==5, "no Logs are passed on once disposed");
+        }
+
+
+/// after a rotation the rest of the old file is read, then the new file
+void
+    test_rotation(
+            ::fs::path const & path
+        )
+        {
+            lines_append(path, 3);
+
+            ::std::atomic_int
+                count {};
+
+            auto
+                follower = log_follow(path, [&count](Log &){++count;}, true);
+
+            check(wait_until([&]{return count==3;}), "the existing Logs are passed on");
+
+            ::fs::rename(path, path_old(path));
+
+            auto
+                expected = 3;
+
+#ifndef _WIN32
+            // on Windows the Logs appended to the old file since the last poll are missed
+            lines_append(path_old(path), 2);
+            expected += 2;
+#endif
+
+            lines_append(path, 4);
+            expected += 4;
+
+            check(wait_until([&]{return count==expected;}), "the Logs of the old and the new file are passed on");
+
+            lines_append(path, 1);
+            expected += 1;
+
+            check(wait_until([&]{return count==expected;}), "the Logs appended to the new file are passed on");
+        }
+
+
+/// a renamed file is followed on, like after SessionFileLogger::rename_if()
+void
+    test_rename(
+            ::fs::path const & path
+        )
+        {
+            lines_append(path, 3);
+
+            ::std::atomic_int
+                count {};
+
+            auto
+                follower = log_follow(path, [&count](Log &){++count;}, true);
+
+            check(wait_until([&]{return count==3;}), "the existing Logs are passed on");
+
+            ::fs::rename(path, path_old(path));
+
+            lines_append(path_old(path), 2);
+
+            check(wait_until([&]{return count==5;}), "the Logs appended to the renamed file are passed on");
+        }
+
+
+/// a truncated file is read from its beginning again
+void
+    test_truncation(
+            ::fs::path const & path
+        )
+        {
+            lines_append(path, 3);
+
+            ::std::atomic_int
+                count {};
+
+            auto
+                follower = log_follow(path, [&count](Log &){++count;}, true);
+
+            check(wait_until([&]{return count==3;}), "the existing Logs are passed on");
+
+            ::fs::resize_file(path, 0);
+
+            // fewer bytes than before, so the truncation can't be missed
+            lines_append(path, 2);
+
+            check(wait_until([&]{return count==5;}), "the Logs after the truncation are passed on");
+
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{100});
+
+            check(count==5, "no Log is passed on twice");
+        }
+
+
+/// disposing a follower blocked in send() on a full channel nobody reads
+void
+    test_bounded_channel(
+            ::fs::path const & path
+        )
+        {
+            lines_append(path, 10);
+
+            // shared with the disposing thread, which outlives this test if it gets stuck
+            auto
+                channel = ::std::make_shared<concurrent::channel<Log>>(1);
+
+            auto
+                follower = ::std::make_shared<on_delete>(log_follow(path, *channel, true));
+
+            check(wait_until([&]{return channel->size()==1;}), "the channel got filled");
+
+            // give the follower the time to block in send()
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{100});
+
+            auto
+                is_disposed = ::std::make_shared<::std::atomic_bool>();
+
+            auto
+                disposer = ::std::thread{[channel, follower, is_disposed]()
+                    {
+                        follower->dispose();
+                        *is_disposed = true;
+                    }};
+
+            follower.reset();
+
+            if (!wait_until([&]{return bool(*is_disposed);}))
+            {
+                disposer.detach();
+                check(false, "disposing returns while the channel is full");
+            }
+
+            disposer.join();
+
+            check(!channel->is_open(), "the channel got drained");
+            check(channel->recv().has_value(), "the Log sent before remains in the channel");
+            check(channel->is_drained(), "no more Logs are sent");
+        }
+}
+
+
+command_ref_t
+Command_LogFollowTest::factory()
+{
+    return command_ref_t(new Command_LogFollowTest);
+}
+
+
+void
+Command_LogFollowTest::registerMe()
+{
+    registerFactory("log-follow-test",factory);
+}
+
+
+::std::string_view
+Command_LogFollowTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogFollowTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogFollowTest::execute()
+{
+    auto
+        dir = ::fs::temp_directory_path();
+
+    if (auto a = attribute1("dir", false))
+        dir = a->value();
+
+    auto
+        suffix = to_string(::uuids::uuid_system_generator{}());
+
+    auto
+        run = [&](char const * name, void (*test)(::fs::path const &))
+            {
+                auto
+                    path = dir / ("log_follow_test_" + suffix + ".log");
+
+                ::fs::remove(path);
+                ::fs::remove(path_old(path));
+
+                test(path);
+
+                ::fs::remove(path);
+                ::fs::remove(path_old(path));
+
+                ::std::cout << name << " ok" << ::std::endl;
+            };
+
+    run("callback", test_callback);
+    run("rotation", test_rotation);
+#ifndef _WIN32
+    // on Windows a renamed file is taken like a rotation
+    run("rename", test_rename);
+#endif
+    run("truncation", test_truncation);
+    run("bounded channel", test_bounded_channel);
+}
+
+}
@@ -0,0 +1,236 @@
+﻿#include "r_base/commandline/Command_LogIndexTest.h"
+#include "r_base/commandline/test_tools.h"
+#include "r_base/SessionFileLogger.h"
+#include "r_base/log_index.h"
+
+#include <cstdio>
+#include <iostream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test the sidecar index of SessionFileLogger (see log_index.h): the lines\n"
+"behind a complete block, in front of an index started on a file with\n"
+"content and the ones missed by the index are read.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : dir\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : the temp directory\n"
+"           The directory of the log files.\n"
+;
+
+// the creators of the Logs written through the index and of the ones appended around it
+auto const c_indexed   = "030d38d5-7dfe-4951-b378-ff88c8ba2e26"_uuid;
+auto const c_unindexed = "ef668582-c2df-4858-90c5-ee2c5fc25c3f"_uuid;
+
+// the session of the test logger
+auto const c_session   = "b4b1ea3a-0759-47d5-bccd-e1519500a9ff"_uuid;
+
+
+Log
+    log_make(
+            ::uuids::uuid const & creator
+        ,   int                   i
+        )
+        {
+            Log
+                log {creator};
+
+            log.message("line ${data}").data(i);
+            log.session(c_session);
+            log.disarm();
+
+            return log;
+        }
+
+
+/// append Logs to the file bypassing the index
+void
+    lines_append(
+            ::fs::path  const & path
+        ,   int                 count
+        )
+        {
+            auto
+                f = ::std::fopen(path.string().c_str(), "ab");
+
+            check(f, "the log file can be opened");
+
+            for (auto i=0; i<count; ++i)
+            {
+                auto
+                    line = log_make(c_unindexed, i).serialize() + '\n';
+
+                ::std::fwrite(line.data(), 1, line.size(), f);
+            }
+
+            ::std::fclose(f);
+        }
+
+
+/// write Logs through an indexing logger
+void
+    logs_write(
+            ::fs::path  const & path
+        ,   int                 count
+        )
+        {
+            SessionFileLogger
+                logger;
+                logger.session_assign(c_session);
+                logger.log_file_path_assign(path);
+                logger.indexed_assign(true);
+
+            for (auto i=0; i<count; ++i)
+            {
+                auto
+                    log = log_make(c_indexed, i);
+
+                logger(log);
+            }
+        }
+
+
+::std::size_t
+    count_of(
+            ::fs::path    const & path
+        ,   ::uuids::uuid const & creator
+        )
+        {
+            LogIndexFilter
+                filter;
+                filter.creator = creator;
+
+            return log_read(path, filter).size();
+        }
+
+
+/// lines appended behind an index ending exactly on a block
+void
+    test_block_boundary(
+            ::fs::path const & path
+        )
+        {
+            logs_write(path, 1024);
+            lines_append(path, 5);
+
+            check(::fs::exists(log_index_path(path)), "the index is written");
+            check(log_read(path, {}).size()==1029, "all Logs are read");
+            check(count_of(path, c_indexed)==1024, "the indexed Logs are read");
+            check(count_of(path, c_unindexed)==5, "the Logs behind the index are read");
+        }
+
+
+/// an index started on a log file with content
+void
+    test_existing_content(
+            ::fs::path const & path
+        )
+        {
+            lines_append(path, 10);
+            logs_write(path, 10);
+
+            check(count_of(path, c_unindexed)==10, "the Logs in front of the index are read");
+            check(count_of(path, c_indexed)==10, "the indexed Logs are read");
+        }
+
+
+/// lines the index missed, e.g. due to a crash, are indexed on re-opening
+void
+    test_gap(
+            ::fs::path const & path
+        )
+        {
+            logs_write(path, 1020);
+            lines_append(path, 10);
+            logs_write(path, 3);
+
+            check(count_of(path, c_unindexed)==10, "the missed Logs are read");
+            check(count_of(path, c_indexed)==1023, "the indexed Logs are read");
+        }
+}
+
+
+command_ref_t
+Command_LogIndexTest::factory()
+{
+    return command_ref_t(new Command_LogIndexTest);
+}
+
+
+void
+Command_LogIndexTest::registerMe()
+{
+    registerFactory("log-index-test",factory);
+}
+
+
+::std::string_view
+Command_LogIndexTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogIndexTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogIndexTest::execute()
+{
+#ifdef _WIN32
+    "d7b01a4c-fe61-41b6-b024-b68a55be05b2"_log("log-index-test is not supported on this platform").throw_error();
+#else
+    auto
+        dir = ::fs::temp_directory_path();
+
+    if (auto a = attribute1("dir", false))
+        dir = a->value();
+
+    auto
+        suffix = ::std::to_string(::getpid());
+
+    auto
+        run = [&](char const * name, void (*test)(::fs::path const &))
+            {
+                auto
+                    path = dir / ("log_index_test_" + suffix + ".log");
+
+                ::fs::remove(path);
+                ::fs::remove(log_index_path(path));
+
+                test(path);
+
+                ::fs::remove(path);
+                ::fs::remove(log_index_path(path));
+
+                ::std::cout << name << " ok" << ::std::endl;
+            };
+
+    run("block boundary", test_block_boundary);
+    run("existing content", test_existing_content);
+    run("gap", test_gap);
+#endif
+}
+
+}
@@ -0,0 +1,146 @@
+﻿#include "r_base/commandline/Command_LogMerge.h"
+#include "r_base/log_merge.h"
+#include "r_base/log_binary.h"
+
+#include <fstream>
+#include <iostream>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+auto
+sHelpMessageBrief =
+"Merge the Logs of several log files (each including its rotated segments)\n"
+"into a single stream ordered by time."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : path\n"
+"       occurrence  : at least once\n"
+"       values      : String\n"
+"       default     : \n"
+"           A log file to merge.\n"
+"\n"
+"       attribute   : format\n"
+"       occurrence  : once (optional)\n"
+"       values      : json | binary\n"
+"       default     : json\n"
+"           json   : one JSON object per line.\n"
+"           binary : a sequence of frames as written by log_binary_encode().\n"
+"\n"
+"       attribute   : output\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : \n"
+"           The path of the file to write. Without this attribute the Logs\n"
+"           are written to stdout.\n"
+;
+
+// output is written in portions of this size
+constexpr ::std::size_t
+    c_flush_size = 1<<20;
+}
+
+
+command_ref_t
+Command_LogMerge::factory()
+{
+    return command_ref_t(new Command_LogMerge);
+}
+
+
+void
+Command_LogMerge::registerMe()
+{
+    registerFactory("log-merge",factory);
+}
+
+
+::std::string_view
+Command_LogMerge::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogMerge::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogMerge::execute()
+{
+    ::std::vector<::fs::path>
+        paths;
+
+    for (auto & a : attributes("path"))
+        paths.push_back(a->value());
+
+    if (paths.empty())
+        "7f3c9a12-5e8b-4d06-b4a1-2c9e0f7d6b38"_log("The attribute 'path' must occur at least once.").throw_error();
+
+    auto
+        is_binary = false;
+
+    if (auto a = attribute1("format", false))
+    {
+        if (a->value()=="binary")
+            is_binary = true;
+        else if (a->value()!="json")
+            "d81e6b04-3a9f-4c27-8e5d-6b0f2a4c9d71"_log("invalid format '${data}'").data(a->value()).throw_error();
+    }
+
+    ::std::ofstream
+        file;
+
+    if (auto a = attribute1("output", false))
+    {
+        file.open(a->value(), ::std::ios::out | ::std::ios::binary | ::std::ios::trunc);
+
+        if (!file.is_open())
+            "1a6f0d93-8c2e-4b75-9d14-e3b7c5a08f62"_log("failed to open ${path}").path(a->value()).throw_error();
+    }
+
+    auto &
+        out = file.is_open() ? static_cast<::std::ostream&>(file) : ::std::cout;
+
+    ::std::string
+        buffer;
+
+    logs_merge(
+            paths
+        ,   [&](Log & log)
+            {
+                if (is_binary)
+                {
+                    log_binary_encode(log, buffer);
+                }
+                else
+                {
+                    buffer += log.serialize();
+                    buffer += '\n';
+                }
+
+                if (buffer.size()>=c_flush_size)
+                {
+                    out.write(buffer.data(), ::std::streamsize(buffer.size()));
+                    buffer.clear();
+                }
+            }
+        );
+
+    out.write(buffer.data(), ::std::streamsize(buffer.size()));
+    out.flush();
+
+    if (!out)
+        "4e92b7d0-1c6a-4f38-a5e9-8d3b0c7f2a15"_log("failed to write the merged Logs").throw_error();
+}
+
+}
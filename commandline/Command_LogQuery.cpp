@@ -0,0 +1,196 @@
+﻿#include "r_base/commandline/Command_LogQuery.h"
+#include "r_base/log_query.h"
+
+#include <iostream>
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+auto
+sHelpMessageBrief =
+"Print the Logs of a log file and its rotated segments that match all given\n"
+"conditions, oldest first, one JSON object per line."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : path\n"
+"       occurrence  : once (required)\n"
+"       values      : String\n"
+"       default     : \n"
+"           The path of the log file.\n"
+"\n"
+"       attribute   : level\n"
+"       occurrence  : once (optional)\n"
+"       values      : DEBUG | INFO | WARNING | ERROR | CRITICAL\n"
+"       default     : \n"
+"           The minimum level.\n"
+"\n"
+"       attribute   : creator\n"
+"       occurrence  : any\n"
+"       values      : UUID\n"
+"       default     : \n"
+"           Select the Logs of any of the creators.\n"
+"\n"
+"       attribute   : session\n"
+"       occurrence  : any\n"
+"       values      : UUID\n"
+"       default     : \n"
+"           Select the Logs of any of the sessions.\n"
+"\n"
+"       attribute   : time-min\n"
+"       occurrence  : once (optional)\n"
+"       values      : UTC time 'YYYY-MM-DD HH:mm:ss.mmm'\n"
+"       default     : \n"
+"           The earliest time, inclusive. Trailing fields may be omitted.\n"
+"\n"
+"       attribute   : time-max\n"
+"       occurrence  : once (optional)\n"
+"       values      : UTC time 'YYYY-MM-DD HH:mm:ss.mmm'\n"
+"       default     : \n"
+"           The latest time, inclusive. Trailing fields may be omitted.\n"
+"\n"
+"       attribute   : contains\n"
+"       occurrence  : any\n"
+"       values      : key:text\n"
+"       default     : \n"
+"           The value of the attribute 'key' contains 'text'.\n"
+"           Properties like 'message' or 'scope' are supported as well.\n"
+"\n"
+"       attribute   : count\n"
+"       occurrence  : once (optional)\n"
+"       values      : true | false\n"
+"       default     : false\n"
+"           If true, only the count of the matching Logs is printed.\n"
+;
+
+
+::nsBase::time::time_point_t
+    time_of(
+            Command::attribute_ref_t const & a
+        )
+        {
+            auto
+                tp = ::nsBase::time::time_from_string_utc_YYYY_MM_DD_HH_mm_ss_mmm(a->value());
+
+            if (!tp)
+                "3b5f8e21-6c9d-4a07-b1e4-8d2a7c0f9e56"_log("invalid time '${data}'").data(a->value()).throw_error();
+
+            return *tp;
+        }
+
+
+::uuids::uuid
+    uuid_of(
+            Command::attribute_ref_t const & a
+        )
+        {
+            auto
+                u = ::uuids::uuid::from_string(a->value());
+
+            if (!u)
+                "e4a17c3d-0b58-4f92-8d6e-2f9b3a5c7e10"_log("invalid UUID '${data}'").data(a->value()).throw_error();
+
+            return *u;
+        }
+}
+
+
+command_ref_t
+Command_LogQuery::factory()
+{
+    return command_ref_t(new Command_LogQuery);
+}
+
+
+void
+Command_LogQuery::registerMe()
+{
+    registerFactory("log-query",factory);
+}
+
+
+::std::string_view
+Command_LogQuery::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogQuery::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogQuery::execute()
+{
+    auto
+        path = attribute1("path")->value();
+
+    LogQuery
+        query;
+
+    if (auto a = attribute1("level", false))
+    {
+        query.level_min = level_from_string(a->value());
+
+        if (!query.level_min)
+            "9c2d6f14-7e3a-4b58-a0c1-5f8e2d9b4a73"_log("invalid level '${data}'").data(a->value()).throw_error();
+    }
+
+    for (auto & a : attributes("creator"))
+        query.creators.push_back(uuid_of(a));
+
+    for (auto & a : attributes("session"))
+        query.sessions.push_back(uuid_of(a));
+
+    if (auto a = attribute1("time-min", false))
+        query.time_min = time_of(a);
+
+    if (auto a = attribute1("time-max", false))
+        query.time_max = time_of(a);
+
+    for (auto & a : attributes("contains"))
+    {
+        auto
+            v = a->value();
+
+        auto
+            colon = v.find(':');
+
+        if (colon==0 || colon==::std::string::npos)
+            "61d8b0e7-2a4f-4c39-9e5b-c7f3a1d0862b"_log("invalid condition '${data}', expected key:text").data(v).throw_error();
+
+        query.contains.push_back({v.substr(0, colon), v.substr(colon+1)});
+    }
+
+    auto
+        is_count_only = false;
+
+    if (auto a = attribute1("count", false))
+        is_count_only = a->value()=="true";
+
+    auto
+        count = log_query_for_each(
+                path
+            ,   query
+            ,   [&](Log & log)
+                {
+                    if (!is_count_only)
+                        ::std::cout << log.serialize() << '\n';
+                }
+            );
+
+    if (is_count_only)
+        ::std::cout << count << '\n';
+
+    ::std::cout.flush();
+}
+
+}
@@ -0,0 +1,583 @@
+﻿#include "r_base/commandline/Command_LogShmRingTest.h"
+#include "r_base/commandline/test_tools.h"
+#include "r_base/log_shm_ring.h"
+#include "r_base/on_delete.h"
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test the shared-memory log ring (see log_shm_ring.h) with producers in\n"
+"forked processes: every Log is delivered or counted as lost exactly once,\n"
+"also with several readers, and producers killed or stopped while\n"
+"publishing don't block the ring.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : producers\n"
+"       occurrence  : once (optional)\n"
+"       values      : Integer\n"
+"       default     : 4\n"
+"           The count of producer processes.\n"
+;
+
+auto const c_creator = "44330575-00cd-4ca2-8705-33ea97998b21"_uuid;
+
+auto const c_logs_per_producer = 2000;
+
+#ifndef _WIN32
+
+/// the Logs the producers attempted to publish, shared with the forked producers
+using counter_t = ::std::atomic<::std::uint64_t>;
+
+
+counter_t *
+    counter_make()
+        {
+            auto
+                p = ::mmap(
+                        nullptr
+                    ,   sizeof(counter_t)
+                    ,   PROT_READ|PROT_WRITE
+                    ,   MAP_SHARED|MAP_ANONYMOUS
+                    ,   -1
+                    ,   0
+                    );
+
+            check(p!=MAP_FAILED, "the shared counter is mapped");
+
+            return new (p) counter_t {0};
+        }
+
+
+void
+    counter_free(
+            counter_t * counter
+        )
+        {
+            ::munmap(counter, sizeof(counter_t));
+        }
+
+
+/** Fork a process publishing count Logs, endless if count<0.
+    The payload makes the Logs large, so a kill likely hits a claimed slot.
+*/
+pid_t
+    producer_fork(
+            ::std::string const & name
+        ,   int                   producer
+        ,   int                   count
+        ,   ::std::size_t         payload
+        ,   counter_t           * attempted
+        )
+        {
+            auto
+                pid = ::fork();
+
+            check(pid>=0, "the producer is forked");
+
+            if (pid)
+                return pid;
+
+            LogShmRingWriter
+                writer;
+
+            if (!writer.open(name))
+                ::_exit(1);
+
+            auto const
+                data = ::std::string(payload, 'x');
+
+            for (auto i=0; count<0 || i<count; ++i)
+            {
+                Log
+                    log {c_creator};
+
+                log.message("ring ${data}").data(data);
+                log("producer", producer);
+                log("seq", i);
+                log.disarm();
+
+                if (attempted)
+                    ++*attempted;
+
+                writer(log);
+            }
+
+            ::_exit(0);
+        }
+
+
+void
+    producer_join(
+            pid_t pid
+        )
+        {
+            int
+                status = 0;
+
+            check(::waitpid(pid, &status, 0)==pid, "the producer is joined");
+            check(WIFEXITED(status) && WEXITSTATUS(status)==0, "the producer succeeded");
+        }
+
+
+void
+    producer_kill(
+            pid_t pid
+        )
+        {
+            ::kill(pid, SIGKILL);
+
+            // a zombie still exists for kill(pid,0)
+            ::waitpid(pid, nullptr, 0);
+        }
+
+
+/// the Logs a reader passed, checked to be in order per producer
+struct Delivered
+{
+    ::std::mutex
+        mutex;
+
+    ::std::uint64_t
+        count {0};
+
+    ::std::map<int,int>
+        seq_last;
+
+    bool
+        is_ordered {true};
+
+    ::std::map<int,::std::uint64_t>
+        count_of;
+
+    void
+        operator()(
+                Log & log
+            )
+            {
+                auto
+                    producer = ::std::stoi(log.attribute("producer").value_or("-1"));
+
+                auto
+                    seq = ::std::stoi(log.attribute("seq").value_or("-1"));
+
+                auto
+                    lock = ::std::lock_guard{mutex};
+
+                auto
+                    [it, is_new] = seq_last.try_emplace(producer, seq);
+
+                if (!is_new)
+                {
+                    if (seq<=it->second)
+                        is_ordered = false;
+
+                    it->second = seq;
+                }
+
+                ++count_of[producer];
+                ++count;
+            }
+
+    ::std::uint64_t
+        total()
+            {
+                auto
+                    lock = ::std::lock_guard{mutex};
+
+                return count;
+            }
+};
+
+
+/// drain until the ring stays empty for a while
+void
+    drain_all(
+            LogShmRingReader & reader
+        ,   Delivered        & delivered
+        )
+        {
+            auto
+                sink = [&](Log & log) { delivered(log); };
+
+            for (auto idle=0; idle<10;)
+            {
+                if (reader.drain(sink))
+                    idle = 0;
+                else
+                {
+                    ++idle;
+                    ::std::this_thread::sleep_for(::std::chrono::milliseconds{10});
+                }
+            }
+        }
+
+
+void
+    drain_for(
+            LogShmRingReader          & reader
+        ,   Delivered                 & delivered
+        ,   ::std::chrono::milliseconds duration
+        )
+        {
+            auto
+                sink = [&](Log & log) { delivered(log); };
+
+            auto const
+                end = ::std::chrono::steady_clock::now() + duration;
+
+            while (::std::chrono::steady_clock::now()<end)
+            {
+                if (!reader.drain(sink))
+                    ::std::this_thread::sleep_for(::std::chrono::milliseconds{1});
+            }
+        }
+
+
+/// every Log of producers publishing concurrently is delivered or lost
+void
+    test_forked_producers(
+            ::std::string const & name
+        ,   int                   producers
+        )
+        {
+            LogShmRingReader
+                reader;
+
+            check(reader.open(name, {.slot_size=512, .slot_count=1024}), "the reader opens the ring");
+
+            ::std::vector<pid_t>
+                pids;
+
+            for (auto p=0; p<producers; ++p)
+                pids.push_back(producer_fork(name, p, c_logs_per_producer, 16, nullptr));
+
+            Delivered
+                delivered;
+
+            auto const
+                total = ::std::uint64_t(producers) * c_logs_per_producer;
+
+            check(
+                    wait_until([&]
+                        {
+                            drain_for(reader, delivered, ::std::chrono::milliseconds{1});
+
+                            return delivered.total() + reader.lost_count()==total;
+                        })
+                ,   "every Log is delivered or lost"
+                );
+
+            for (auto pid : pids)
+                producer_join(pid);
+
+            drain_all(reader, delivered);
+
+            check(delivered.total() + reader.lost_count()==total, "no Log is counted twice");
+            check(delivered.total()>0, "Logs are delivered");
+            check(delivered.is_ordered, "the Logs of a producer are delivered in order");
+        }
+
+
+/// the readers share the ring and its count of losses
+void
+    test_several_readers(
+            ::std::string const & name
+        ,   int                   producers
+        )
+        {
+            LogShmRingReader
+                readers[2];
+
+            for (auto & reader : readers)
+                check(reader.open(name, {.slot_size=512, .slot_count=1024}), "the reader opens the ring");
+
+            // fork before starting threads
+            ::std::vector<pid_t>
+                pids;
+
+            for (auto p=0; p<producers; ++p)
+                pids.push_back(producer_fork(name, p, c_logs_per_producer, 16, nullptr));
+
+            Delivered
+                delivered[2];
+
+            ::std::atomic<bool>
+                stop {false};
+
+            ::std::vector<::std::thread>
+                threads;
+
+            for (auto r=0; r<2; ++r)
+                threads.emplace_back([&, r]
+                    {
+                        auto
+                            sink = [&](Log & log) { delivered[r](log); };
+
+                        while (!stop)
+                        {
+                            if (!readers[r].drain(sink))
+                                ::std::this_thread::sleep_for(::std::chrono::milliseconds{1});
+                        }
+                    });
+
+            for (auto pid : pids)
+                producer_join(pid);
+
+            auto const
+                total = ::std::uint64_t(producers) * c_logs_per_producer;
+
+            auto const
+                is_complete = wait_until([&]
+                    {
+                        return delivered[0].total() + delivered[1].total() + readers[0].lost_count()==total;
+                    });
+
+            stop = true;
+
+            for (auto & t : threads)
+                t.join();
+
+            check(is_complete, "every Log is delivered or lost");
+            check(readers[0].lost_count()==readers[1].lost_count(), "the readers report the same losses");
+            check(delivered[0].is_ordered && delivered[1].is_ordered, "each reader passes the Logs of a producer in order");
+        }
+
+
+/// producers killed while publishing neither block the ring nor lose uncounted Logs
+void
+    test_dead_producers(
+            ::std::string const & name
+        ,   int                   producers
+        )
+        {
+            LogShmRingReader
+                reader;
+
+            // long enough that only the dead claimer is detected
+            check(
+                    reader.open(name, {.slot_size=2048, .slot_count=256}, ::std::chrono::seconds{60})
+                ,   "the reader opens the ring"
+                );
+
+            auto
+                attempted = counter_make();
+
+            Delivered
+                delivered;
+
+            auto const
+                kills = 4 * producers;
+
+            for (auto k=0; k<kills; ++k)
+            {
+                auto
+                    pid = producer_fork(name, k, -1, 1800, attempted);
+
+                drain_for(reader, delivered, ::std::chrono::milliseconds{20});
+
+                producer_kill(pid);
+            }
+
+            // the ring must pass the claims of the dead producers to take new Logs
+            drain_all(reader, delivered);
+
+            auto
+                pid = producer_fork(name, kills, 100, 16, attempted);
+
+            check(
+                    wait_until([&]
+                        {
+                            drain_for(reader, delivered, ::std::chrono::milliseconds{1});
+
+                            auto
+                                lock = ::std::lock_guard{delivered.mutex};
+
+                            return delivered.count_of[kills]==100;
+                        })
+                ,   "the Logs behind the dead producers are delivered"
+                );
+
+            producer_join(pid);
+            drain_all(reader, delivered);
+
+            // a producer killed between counting and claiming has no slot
+            auto const
+                accounted = delivered.total() + reader.lost_count();
+
+            check(accounted<=*attempted, "no Log is counted twice");
+            check(accounted + kills>=*attempted, "the Logs of the dead producers are counted as lost");
+            check(delivered.is_ordered, "the Logs of a producer are delivered in order");
+
+            counter_free(attempted);
+        }
+
+
+/// a producer stopped while publishing blocks the ring for the stale_timeout only
+void
+    test_stuck_producer(
+            ::std::string const & name
+        ,   int
+        )
+        {
+            LogShmRingReader
+                reader;
+
+            check(
+                    reader.open(name, {.slot_size=2048, .slot_count=256}, ::std::chrono::milliseconds{100})
+                ,   "the reader opens the ring"
+                );
+
+            auto
+                attempted = counter_make();
+
+            Delivered
+                delivered;
+
+            auto
+                stuck = producer_fork(name, 0, -1, 1800, attempted);
+
+            // don't leave the endless producer behind a failed check
+            on_delete
+                stuck_kill {[&]
+                    {
+                        if (stuck)
+                            producer_kill(stuck);
+                    }};
+
+            drain_for(reader, delivered, ::std::chrono::milliseconds{20});
+
+            ::kill(stuck, SIGSTOP);
+            ::waitpid(stuck, nullptr, WUNTRACED);
+
+            // the claim of the stopped producer is skipped after the stale_timeout
+            drain_all(reader, delivered);
+
+            auto
+                pid = producer_fork(name, 1, 100, 16, attempted);
+
+            check(
+                    wait_until([&]
+                        {
+                            drain_for(reader, delivered, ::std::chrono::milliseconds{1});
+
+                            auto
+                                lock = ::std::lock_guard{delivered.mutex};
+
+                            return delivered.count_of[1]==100;
+                        })
+                ,   "the Logs behind the stopped producer are delivered"
+                );
+
+            producer_join(pid);
+
+            // resumed, the producer detects its slot was skipped and counts the Log as dropped
+            ::kill(stuck, SIGCONT);
+            drain_for(reader, delivered, ::std::chrono::milliseconds{20});
+            producer_kill(stuck);
+            stuck = 0;
+            drain_all(reader, delivered);
+
+            auto const
+                accounted = delivered.total() + reader.lost_count();
+
+            check(accounted<=*attempted, "no Log is counted twice");
+            check(accounted + 1>=*attempted, "the Logs of the stopped producer are counted");
+            check(delivered.is_ordered, "the Logs of a producer are delivered in order");
+
+            counter_free(attempted);
+        }
+
+#endif
+}
+
+
+command_ref_t
+Command_LogShmRingTest::factory()
+{
+    return command_ref_t(new Command_LogShmRingTest);
+}
+
+
+void
+Command_LogShmRingTest::registerMe()
+{
+    registerFactory("log-shm-ring-test",factory);
+}
+
+
+::std::string_view
+Command_LogShmRingTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogShmRingTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogShmRingTest::execute()
+{
+#ifdef _WIN32
+    "29c38d5b-f6cb-4f7a-914f-a748aa1c7d3d"_log("log-shm-ring-test is not supported on this platform").throw_error();
+#else
+    auto
+        producers = 4;
+
+    if (auto a = attribute1("producers", false))
+        producers = ::std::stoi(a->value());
+
+    auto
+        suffix = ::std::to_string(::getpid());
+
+    auto
+        run = [&](char const * name, void (*test)(::std::string const &, int))
+            {
+                auto
+                    ring = "/log_shm_ring_test_" + suffix;
+
+                log_shm_ring_remove(ring);
+
+                test(ring, producers);
+
+                log_shm_ring_remove(ring);
+
+                ::std::cout << name << " ok" << ::std::endl;
+            };
+
+    run("forked producers", test_forked_producers);
+    run("several readers", test_several_readers);
+    run("dead producers", test_dead_producers);
+    run("stuck producer", test_stuck_producer);
+#endif
+}
+
+}
@@ -0,0 +1,400 @@
+﻿#include "r_base/commandline/Command_LogSocketTest.h"
+#include "r_base/log_socket.h"
+#include "r_base/commandline/test_tools.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+using namespace test;
+
+auto
+sHelpMessageBrief =
+"Test LogSocketSender and LogSocketCollector through a loopback socket:\n"
+"delivery, spilling while the collector is down, drop counting, delivery of\n"
+"the pending Logs on close(), the default re-broadcasting sink and a busy\n"
+"client not starving the others.\n"
+"Fails with an error on the first failed check."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : dir\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : the temp directory\n"
+"           The directory of the sockets.\n"
+;
+
+// the creator of the Logs sent by the tests
+auto const
+    c_creator = "685fd682-117a-4c3b-a97f-59b8bfb6de44"_uuid;
+
+
+
+
+void
+    logs_send(
+            LogSocketSender   & sender
+        ,   int                 count
+        )
+        {
+            for (auto i=0; i<count; ++i)
+            {
+                Log
+                    log {c_creator};
+
+                log.message("loopback ${data}").data(i);
+                log.disarm();
+
+                sender(log);
+            }
+        }
+
+
+/// counts the Logs of the tests received by a collector
+struct
+    Received
+        {
+            ::std::atomic<::std::uint64_t>
+                count {};
+
+            ::std::function<void(Log &)>
+                sink()
+                    {
+                        return [this](Log & log)
+                            {
+                                if (log.creator()==c_creator)
+                                    ++count;
+                            };
+                    }
+        };
+
+
+LogSocketPolicy
+    policy_fast()
+        {
+            LogSocketPolicy
+                ret;
+
+            ret.max_age            = ::std::chrono::milliseconds{10};
+            ret.reconnect_interval = ::std::chrono::milliseconds{20};
+
+            return ret;
+        }
+
+
+void
+    test_delivery(
+            ::fs::path const & path
+        )
+        {
+            Received
+                received;
+
+            LogSocketCollector
+                collector;
+
+            LogSocketSender
+                sender;
+
+            check(collector.open(path, received.sink()), "the collector opens");
+            check(sender.open(path, policy_fast()), "the sender opens");
+
+            logs_send(sender, 1000);
+
+            check(wait_until([&]{return received.count==1000;}), "all Logs are received");
+            check(sender.dropped_count()==0, "no Log is dropped");
+            check(collector.received_count()==1000, "the collector counts the Logs");
+        }
+
+
+void
+    test_spill_and_reconnect(
+            ::fs::path const & path
+        )
+        {
+            Received
+                received;
+
+            LogSocketSender
+                sender;
+
+            // the collector is down
+            check(sender.open(path, policy_fast()), "the sender opens without a collector");
+
+            logs_send(sender, 500);
+
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{100});
+
+            LogSocketCollector
+                collector;
+
+            check(collector.open(path, received.sink()), "the collector opens");
+
+            check(wait_until([&]{return received.count==500;}), "the spilled Logs are received after connecting");
+
+            // the collector restarts
+            collector.close();
+
+            logs_send(sender, 200);
+
+            check(collector.open(path, received.sink()), "the collector opens again");
+
+            check(wait_until([&]{return received.count==700;}), "the Logs are received after reconnecting");
+            check(sender.dropped_count()==0, "no Log is dropped");
+        }
+
+
+void
+    test_overflow(
+            ::fs::path const & path
+        )
+        {
+            Received
+                received;
+
+            auto
+                policy = policy_fast();
+
+            policy.spill_size = 4096;
+
+            LogSocketSender
+                sender;
+
+            check(sender.open(path, policy), "the sender opens without a collector");
+
+            logs_send(sender, 1000);
+
+            auto
+                dropped = sender.dropped_count();
+
+            check(dropped>0, "the Logs beyond the spill size are dropped");
+            check(dropped<1000, "the Logs within the spill size are kept");
+
+            LogSocketCollector
+                collector;
+
+            check(collector.open(path, received.sink()), "the collector opens");
+
+            check(wait_until([&]{return received.count+dropped==1000;}), "each Log is either received or counted as dropped");
+
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{50});
+
+            check(received.count+dropped==1000, "no Log is received twice");
+        }
+
+
+void
+    test_close(
+            ::fs::path const & path
+        )
+        {
+            Received
+                received;
+
+            LogSocketCollector
+                collector;
+
+            check(collector.open(path, received.sink()), "the collector opens");
+
+            // nothing gets sent before close()
+            auto
+                policy = policy_fast();
+
+            policy.max_age    = ::std::chrono::hours{1};
+            policy.batch_size = 64_sz<<20;
+
+            LogSocketSender
+                sender;
+
+            check(sender.open(path, policy), "the sender opens");
+
+            logs_send(sender, 300);
+
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds{50});
+
+            check(received.count==0, "the Logs are batched");
+
+            sender.close();
+
+            check(!sender.is_open(), "the sender is closed");
+            check(wait_until([&]{return received.count==300;}), "close() delivers the pending Logs");
+        }
+
+
+void
+    test_rebroadcast(
+            ::fs::path const & path
+        )
+        {
+            ::std::atomic<::std::uint64_t>
+                count {};
+
+            auto
+                consumer = Log::consumer_register([&count](Log & log)
+                    {
+                        if (log.creator()==c_creator)
+                            ++count;
+                    });
+
+            LogSocketCollector
+                collector;
+
+            check(collector.open(path), "the collector opens with the default sink");
+
+            LogSocketSender
+                sender;
+
+            check(sender.open(path, policy_fast()), "the sender opens");
+
+            // sent directly, not broadcast in this process
+            logs_send(sender, 100);
+
+            check(wait_until([&]{return count==100;}), "the received Logs are re-broadcast to the consumers");
+        }
+
+
+/// a client sending all the time doesn't starve the others
+void
+    test_busy_client(
+            ::fs::path const & path
+        )
+        {
+            Received
+                received;
+
+            LogSocketCollector
+                collector;
+
+            check(collector.open(path, received.sink()), "the collector opens");
+
+            auto
+                policy = policy_fast();
+                policy.batch_size = 4_sz<<20;
+                policy.spill_size = 16_sz<<20;
+
+            LogSocketSender
+                busy;
+
+            check(busy.open(path, policy), "the busy sender opens");
+
+            ::std::atomic_bool
+                is_stopped {};
+
+            // the Logs of another creator are not counted
+            auto
+                flood = ::std::thread{[&]()
+                    {
+                        auto
+                            payload = ::std::string(4096, 'x');
+
+                        while (!is_stopped)
+                        {
+                            Log
+                                log {"6f674ff0-6c76-4ad6-9ee3-2a7ca52e387e"_uuid};
+
+                            log.message("flood ${data}").data(payload);
+                            log.disarm();
+
+                            busy(log);
+                        }
+                    }};
+
+            LogSocketSender
+                sender;
+
+            check(sender.open(path, policy_fast()), "the sender opens");
+
+            logs_send(sender, 100);
+
+            auto
+                is_received = wait_until([&]{return received.count==100;});
+
+            is_stopped = true;
+            flood.join();
+
+            check(is_received, "the Logs are received while another client is busy");
+        }
+}
+
+
+command_ref_t
+Command_LogSocketTest::factory()
+{
+    return command_ref_t(new Command_LogSocketTest);
+}
+
+
+void
+Command_LogSocketTest::registerMe()
+{
+    registerFactory("log-socket-test",factory);
+}
+
+
+::std::string_view
+Command_LogSocketTest::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogSocketTest::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogSocketTest::execute()
+{
+#ifdef _WIN32
+    "0457953c-0a79-4268-a84a-f3f8c0ad0fc1"_log("log-socket-test is not supported on this platform").throw_error();
+#else
+    auto
+        dir = ::fs::temp_directory_path();
+
+    if (auto a = attribute1("dir", false))
+        dir = a->value();
+
+    auto
+        suffix = ::std::to_string(::getpid());
+
+    auto
+        run = [&](char const * name, void (*test)(::fs::path const &))
+            {
+                auto
+                    path = dir / ("log_socket_test_" + suffix + ".sock");
+
+                ::fs::remove(path);
+
+                test(path);
+
+                ::fs::remove(path);
+
+                ::std::cout << name << " ok" << ::std::endl;
+            };
+
+    run("delivery", test_delivery);
+    run("spill and reconnect", test_spill_and_reconnect);
+    run("overflow", test_overflow);
+    run("close", test_close);
+    run("rebroadcast", test_rebroadcast);
+    run("busy client", test_busy_client);
+#endif
+}
+
+}
@@ -0,0 +1,308 @@
+﻿#include "r_base/commandline/Command_LogTransportBenchmark.h"
+#include "r_base/AppendFile.h"
+#include "r_base/log_shm_ring.h"
+#include "r_base/log_socket.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+namespace nsBase::commandline
+{
+
+namespace
+{
+auto
+sHelpMessageBrief =
+"Compare the cost of shipping Logs to a collector through the shared-memory\n"
+"ring, through the Unix domain socket and of writing them directly to a file.\n"
+"The collectors run in this process."
+;
+
+auto
+sHelpMessageAttributes =
+"       attribute   : count\n"
+"       occurrence  : once (optional)\n"
+"       values      : Integer\n"
+"       default     : 100000\n"
+"           The count of Logs per transport.\n"
+"\n"
+"       attribute   : dir\n"
+"       occurrence  : once (optional)\n"
+"       values      : String\n"
+"       default     : the temp directory\n"
+"           The directory of the log file and the socket.\n"
+;
+
+using clock = ::std::chrono::steady_clock;
+
+// a collector that got nothing for this long is considered done
+constexpr auto
+    c_idle_timeout = ::std::chrono::seconds{2};
+
+
+struct
+    Result
+        {
+            char const        * name;
+            clock::duration     emit;
+            clock::duration     total;
+            ::std::uint64_t     delivered;
+            ::std::uint64_t     dropped;
+        };
+
+
+void
+    result_print(
+            Result          const & r
+        ,   ::std::size_t           count
+        )
+        {
+            auto
+                ns = [](clock::duration d)
+                    {
+                        return double(::std::chrono::duration_cast<::std::chrono::nanoseconds>(d).count());
+                    };
+
+            char
+                line[160];
+
+            ::std::snprintf(
+                    line
+                ,   sizeof(line)
+                ,   "%-8s emit %8.0f ns/Log   total %9.1f ms   delivered %9llu   dropped %9llu\n"
+                ,   r.name
+                ,   ns(r.emit)/double(count)
+                ,   ns(r.total)/1e6
+                ,   static_cast<unsigned long long>(r.delivered)
+                ,   static_cast<unsigned long long>(r.dropped)
+                );
+
+            ::std::cout << line;
+        }
+
+
+/// wait until the collector got everything or stalls
+void
+    wait_delivered(
+            ::std::atomic<::std::uint64_t> const & delivered
+        ,   ::std::uint64_t                        expected
+        )
+        {
+            auto
+                last = delivered.load();
+
+            auto
+                last_change = clock::now();
+
+            while (delivered<expected && clock::now()-last_change<c_idle_timeout)
+            {
+                ::std::this_thread::sleep_for(::std::chrono::milliseconds{1});
+
+                if (delivered!=last)
+                {
+                    last        = delivered;
+                    last_change = clock::now();
+                }
+            }
+        }
+}
+
+
+command_ref_t
+Command_LogTransportBenchmark::factory()
+{
+    return command_ref_t(new Command_LogTransportBenchmark);
+}
+
+
+void
+Command_LogTransportBenchmark::registerMe()
+{
+    registerFactory("log-transport-benchmark",factory);
+}
+
+
+::std::string_view
+Command_LogTransportBenchmark::helpMessageAttributes()
+{
+    return sHelpMessageAttributes;
+}
+
+
+::std::string_view
+Command_LogTransportBenchmark::helpMessageBrief()
+{
+    return sHelpMessageBrief;
+}
+
+
+void
+Command_LogTransportBenchmark::execute()
+{
+#ifdef _WIN32
+    "e4b19c72-0d58-4a3e-96f1-2b7c8d05e6a9"_log("log-transport-benchmark is not supported on this platform").throw_error();
+#else
+    auto
+        count = 100000_sz;
+
+    if (auto a = attribute1("count", false))
+        count = ::std::stoul(a->value());
+
+    auto
+        dir = ::fs::temp_directory_path();
+
+    if (auto a = attribute1("dir", false))
+        dir = a->value();
+
+    auto
+        suffix = ::std::to_string(::getpid());
+
+    Log
+        sample {"52c8e0b7-1f4a-4d96-a3e5-0b9d7c2f6841"_uuid};
+
+    sample.message("benchmark Log ${data}").data(42);
+    sample("key", "value");
+    sample.disarm();
+
+    ::std::vector<Result>
+        results;
+
+    // the Logs serialized and appended to a file, one write per Log
+    {
+        auto
+            path = dir / ("log_transport_benchmark_" + suffix + ".log");
+
+        AppendFile
+            file;
+
+        if (!file.open(path))
+            "2a5d8f16-b9c0-4e73-8d42-f1e6a07c3b95"_log("failed to open ${path}").path(path).throw_error();
+
+        auto
+            t0 = clock::now();
+
+        ::std::uint64_t
+            delivered {};
+
+        for (auto i=0_sz; i<count; ++i)
+        {
+            auto
+                line = sample.serialize();
+
+            line += '\n';
+
+            delivered += file.write(line);
+        }
+
+        auto
+            t1 = clock::now();
+
+        file.close();
+        ::fs::remove(path);
+
+        results.push_back({"file", t1-t0, t1-t0, delivered, count-delivered});
+    }
+
+    // the Unix domain socket
+    {
+        auto
+            path = dir / ("log_transport_benchmark_" + suffix + ".sock");
+
+        ::std::atomic<::std::uint64_t>
+            delivered {};
+
+        LogSocketCollector
+            collector;
+
+        LogSocketSender
+            sender;
+
+        if (!collector.open(path, [&](Log &){++delivered;}) || !sender.open(path))
+            "71c3e9a0-5f28-4b6d-a0e4-9d2b8f1c7e53"_log("failed to open the socket ${path}").path(path).throw_error();
+
+        auto
+            t0 = clock::now();
+
+        for (auto i=0_sz; i<count; ++i)
+            sender(sample);
+
+        auto
+            t1 = clock::now();
+
+        auto
+            dropped = sender.dropped_count();
+
+        wait_delivered(delivered, count-dropped);
+
+        results.push_back({"socket", t1-t0, clock::now()-t0, delivered, dropped});
+    }
+
+    // the shared-memory ring, drained by a thread
+    {
+        auto
+            name = "/log_transport_benchmark_" + suffix;
+
+        ::std::atomic<::std::uint64_t>
+            delivered {};
+
+        ::std::atomic_bool
+            is_done {};
+
+        LogShmRingReader
+            reader;
+
+        LogShmRingWriter
+            writer;
+
+        if (!reader.open(name) || !writer.open(name))
+            "c5f08a2d-7b36-4e91-8c0f-3d4a6e9b1f27"_log("failed to open the ring ${data}").data(name).throw_error();
+
+        auto
+            collector = ::std::thread{[&]()
+                {
+                    while (!is_done)
+                        if (!reader.drain([&](Log &){++delivered;}))
+                            ::std::this_thread::yield();
+                }};
+
+        auto
+            t0 = clock::now();
+
+        for (auto i=0_sz; i<count; ++i)
+            writer(sample);
+
+        auto
+            t1 = clock::now();
+
+        auto
+            dropped = writer.dropped_count();
+
+        wait_delivered(delivered, count-dropped);
+
+        auto
+            t2 = clock::now();
+
+        is_done = true;
+        collector.join();
+
+        log_shm_ring_remove(name);
+
+        results.push_back({"shm", t1-t0, t2-t0, delivered, dropped});
+    }
+
+    for (auto & r : results)
+        result_print(r, count);
+
+    ::std::cout.flush();
+#endif
+}
+
+}
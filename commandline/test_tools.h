@@ -0,0 +1,59 @@
+﻿#pragma once
+// Copyright (C) Ralf Kubis
+
+#include "r_base/Log.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+
+/**
+    Helpers of the Command_*Test commands.
+*/
+namespace nsBase::commandline::test
+{
+
+/// the time wait_until() waits by default
+constexpr auto
+    c_timeout = ::std::chrono::seconds{5};
+
+
+/** \throws if the check failed.
+*/
+inline void
+    check(
+            bool            is_ok
+        ,   char    const * what
+        )
+        {
+            if (!is_ok)
+                "433401d5-b90b-494d-9578-5efdc1ca75be"_log("check failed: ${data}").data(::std::string{what}).throw_error();
+        }
+
+
+/** Wait until the predicate holds or the timeout is reached.
+    \return FALSE on timeout.
+*/
+template<typename Predicate>
+bool
+    wait_until(
+            Predicate                   const & is_ready
+        ,   ::std::chrono::milliseconds         timeout = c_timeout
+        )
+        {
+            auto
+                end = ::std::chrono::steady_clock::now() + timeout;
+
+            while (!is_ready())
+            {
+                if (::std::chrono::steady_clock::now()>end)
+                    return false;
+
+                ::std::this_thread::sleep_for(::std::chrono::milliseconds{10});
+            }
+
+            return true;
+        }
+
+}
@@ -0,0 +1,559 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/compression.h"
+
+#include "r_base/Log.h"
+#include "r_base/language_tools.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+
+namespace nsBase::compression
+{
+
+namespace
+{
+constexpr ::std::size_t c_min_match     = 4;
+constexpr ::std::size_t c_max_offset    = 0xffff;
+constexpr ::std::size_t c_hash_bits     = 14;
+constexpr ::std::size_t c_tail_literals = 8;  // a match never reaches into the last bytes of a block
+
+constexpr ::std::uint32_t
+    c_stored_flag = 0x80000000u;
+
+
+constexpr auto
+    c_crc_table = []
+        {
+            ::std::array<::std::uint32_t,256>
+                table {};
+
+            for (auto i = 0u; i<256; ++i)
+            {
+                auto c = ::std::uint32_t(i);
+
+                for (auto k = 0; k<8; ++k)
+                    c = c&1 ? 0xEDB88320u ^ (c>>1) : c>>1;
+
+                table[i] = c;
+            }
+
+            return table;
+        }();
+
+/// CRC-32 of a decompressed block
+::std::size_t
+    checksum(
+            char const    * data
+        ,   ::std::size_t   size
+        )
+        {
+            auto
+                crc = ~::std::uint32_t(0);
+
+            for (auto i = 0_sz; i<size; ++i)
+                crc = c_crc_table[(crc ^ ::std::uint8_t(data[i])) & 0xFF] ^ (crc>>8);
+
+            return ~crc;
+        }
+
+
+::std::uint32_t
+    read32(
+            char const * p
+        )
+        {
+            ::std::uint32_t v;
+            ::std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+void
+    put_u16(
+            ::std::string & out
+        ,   ::std::size_t   v
+        )
+        {
+            out += char( v       & 0xff);
+            out += char((v >> 8) & 0xff);
+        }
+
+void
+    put_u32(
+            ::std::string & out
+        ,   ::std::size_t   v
+        )
+        {
+            for (auto i=0; i<4; ++i)
+                out += char((v >> (8*i)) & 0xff);
+        }
+
+void
+    put_length(
+            ::std::string & out
+        ,   ::std::size_t   v
+        )
+        {
+            for (; v>=255; v-=255)
+                out += char(255);
+
+            out += char(v);
+        }
+
+void
+    put_sequence(
+            ::std::string     & out
+        ,   char const        * literals
+        ,   ::std::size_t       literal_count
+        ,   ::std::size_t       offset
+        ,   ::std::size_t       match_length // 0 for the trailing literals
+        )
+        {
+            auto lit = ::std::min<::std::size_t>(literal_count, 15);
+            auto mat = match_length ? ::std::min<::std::size_t>(match_length - c_min_match, 15) : 0;
+
+            out += char((lit << 4) | mat);
+
+            if (lit==15)
+                put_length(out, literal_count - 15);
+
+            out.append(literals, literal_count);
+
+            if (!match_length)
+                return;
+
+            put_u16(out, offset);
+
+            if (mat==15)
+                put_length(out, match_length - c_min_match - 15);
+        }
+
+
+void
+    compress_block(
+            ::std::string                 & out
+        ,   char const                    * src
+        ,   ::std::size_t                   n
+        ,   ::std::vector<::std::uint32_t> & table
+        )
+        {
+            ::std::fill(table.begin(), table.end(), 0);
+
+            ::std::size_t anchor = 0;
+            ::std::size_t i      = 0;
+
+            while (n>c_tail_literals && i + c_tail_literals < n)
+            {
+                auto seq = read32(src+i);
+                auto h   = (seq * 2654435761u) >> (32 - c_hash_bits);
+                auto ref = ::std::size_t(table[h]);   // position + 1
+
+                table[h] = ::std::uint32_t(i+1);
+
+                if (!ref || i+1-ref > c_max_offset || read32(src+ref-1)!=seq)
+                {
+                    ++i;
+                    continue;
+                }
+
+                --ref;
+
+                auto len   = c_min_match;
+                auto limit = n - c_tail_literals;
+
+                while (i+len < limit && src[ref+len]==src[i+len])
+                    ++len;
+
+                put_sequence(out, src+anchor, i-anchor, i-ref, len);
+
+                i     += len;
+                anchor = i;
+            }
+
+            put_sequence(out, src+anchor, n-anchor, 0, 0);
+        }
+
+
+/// append the header and the data of a block of at most c_block_size bytes
+void
+    block_put(
+            ::std::string                 & out
+        ,   char const                    * src
+        ,   ::std::size_t                   n
+        ,   ::std::vector<::std::uint32_t> & table
+        ,   ::std::string                 & block
+        )
+        {
+            block.clear();
+            compress_block(block, src, n, table);
+
+            put_u32(out, n);
+
+            if (block.size() < n)
+            {
+                put_u32(out, block.size());
+                put_u32(out, checksum(src, n));
+                out += block;
+            }
+            else
+            {
+                put_u32(out, n | c_stored_flag);
+                put_u32(out, checksum(src, n));
+                out.append(src, n);
+            }
+        }
+
+
+[[noreturn]] void
+    throw_malformed()
+        {
+            "0b8f2c61-7d4e-4a93-b1c5-9e2d6f3a8c07"_log("malformed compressed frame").throw_DATA_LOSS();
+        }
+
+
+[[noreturn]] void
+    throw_write_failed()
+        {
+            "9ccffbac-8622-4828-88f7-b0c28a587cb0"_log("failed to write the compressed frame").throw_error();
+        }
+
+
+struct Reader
+{
+    char const    * p;
+    char const    * end;
+
+    ::std::size_t
+        remaining() const
+            {
+                return ::std::size_t(end-p);
+            }
+
+    ::std::uint8_t
+        u8()
+            {
+                if (p>=end)
+                    throw_malformed();
+
+                return ::std::uint8_t(*p++);
+            }
+
+    ::std::size_t
+        u16()
+            {
+                auto lo = u8();
+                auto hi = u8();
+                return lo | (::std::size_t(hi) << 8);
+            }
+
+    ::std::size_t
+        u32()
+            {
+                ::std::size_t v = 0;
+
+                for (auto i=0; i<4; ++i)
+                    v |= ::std::size_t(u8()) << (8*i);
+
+                return v;
+            }
+
+    ::std::size_t
+        length()
+            {
+                ::std::size_t v = 0;
+
+                while (true)
+                {
+                    auto b = u8();
+                    v += b;
+
+                    if (b!=255)
+                        return v;
+                }
+            }
+};
+
+
+void
+    decompress_block(
+            ::std::string       & out
+        ,   char const          * src
+        ,   ::std::size_t         n
+        ,   ::std::size_t         raw_size
+        )
+        {
+            auto r     = Reader{src, src+n};
+            auto base  = out.size();
+            auto limit = base + raw_size;
+            auto pos   = base;
+
+            out.resize(limit);
+
+            while (r.remaining())
+            {
+                auto token = r.u8();
+
+                ::std::size_t
+                    lit = token >> 4;
+
+                if (lit==15)
+                    lit += r.length();
+
+                if (lit > r.remaining() || pos+lit > limit)
+                    throw_malformed();
+
+                ::std::memcpy(out.data()+pos, r.p, lit);
+                pos += lit;
+                r.p += lit;
+
+                if (!r.remaining())
+                    break; // trailing literals
+
+                auto offset = r.u16();
+
+                ::std::size_t
+                    len = (token & 0x0f);
+
+                if (len==15)
+                    len += r.length();
+
+                len += c_min_match;
+
+                if (!offset || offset > pos-base || pos+len > limit)
+                    throw_malformed();
+
+                auto d = out.data() + pos;
+
+                if (offset>=len)
+                    ::std::memcpy(d, d-offset, len);
+                else
+                    for (auto k=0_sz; k<len; ++k) // source and target overlap
+                        d[k] = d[k-offset];
+
+                pos += len;
+            }
+
+            if (pos!=limit)
+                throw_malformed();
+        }
+}
+
+
+bool
+is_compressed(
+    ::std::string_view const & data
+)
+{
+    return data.substr(0, c_magic.size())==c_magic;
+}
+
+
+::std::string
+compress(
+    ::std::string_view const & data
+)
+{
+    ::std::string
+        out {c_magic};
+
+    ::std::vector<::std::uint32_t>
+        table(::std::size_t{1} << c_hash_bits);
+
+    ::std::string
+        block;
+
+    for (auto pos=0_sz; pos<data.size(); pos+=c_block_size)
+    {
+        auto n = ::std::min(c_block_size, data.size()-pos);
+
+        block_put(out, data.data()+pos, n, table, block);
+    }
+
+    put_u32(out, 0);
+
+    return out;
+}
+
+
+::std::string
+decompress(
+    ::std::string_view const & frame
+)
+{
+    if (!is_compressed(frame))
+        throw_malformed();
+
+    ::std::string
+        out;
+
+    auto
+        r = Reader{frame.data()+c_magic.size(), frame.data()+frame.size()};
+
+    while (true)
+    {
+        auto raw_size = r.u32();
+
+        if (!raw_size)
+            break;
+
+        auto stored = r.u32();
+        auto crc    = r.u32();
+        auto n      = stored & ~::std::size_t{c_stored_flag};
+        auto base   = out.size();
+
+        if (n > r.remaining() || raw_size > c_block_size)
+            throw_malformed();
+
+        if (stored & c_stored_flag)
+        {
+            if (n!=raw_size)
+                throw_malformed();
+
+            out.append(r.p, n);
+        }
+        else
+        {
+            decompress_block(out, r.p, n, raw_size);
+        }
+
+        if (checksum(out.data()+base, raw_size)!=crc)
+            throw_malformed();
+
+        r.p += n;
+    }
+
+    if (r.remaining())
+        throw_malformed();
+
+    return out;
+}
+
+
+
+FrameReader::FrameReader(
+    ::std::istream & frame
+)
+:   m_frame {frame}
+{
+    char
+        magic[c_magic.size()] {};
+
+    m_frame.read(magic, sizeof(magic));
+
+    if (m_frame.gcount()!=sizeof(magic) || !is_compressed({magic, sizeof(magic)}))
+        throw_malformed();
+}
+
+
+bool
+FrameReader::read_block(
+    ::std::string & out
+)
+{
+    if (m_is_at_end)
+        return false;
+
+    auto
+        u32 = [&]()
+            {
+                unsigned char
+                    b[4];
+
+                if (!m_frame.read(reinterpret_cast<char*>(b), sizeof(b)))
+                    throw_malformed();
+
+                return b[0] | (::std::size_t(b[1])<<8) | (::std::size_t(b[2])<<16) | (::std::size_t(b[3])<<24);
+            };
+
+    auto raw_size = u32();
+
+    if (!raw_size)
+    {
+        m_is_at_end = true;
+        return false;
+    }
+
+    auto stored = u32();
+    auto crc    = u32();
+    auto n      = stored & ~::std::size_t{c_stored_flag};
+    auto base   = out.size();
+
+    if (n > c_block_size || raw_size > c_block_size)
+        throw_malformed();
+
+    m_block.resize(n);
+
+    if (!m_frame.read(m_block.data(), ::std::streamsize(n)))
+        throw_malformed();
+
+    if (stored & c_stored_flag)
+    {
+        if (n!=raw_size)
+            throw_malformed();
+
+        out += m_block;
+    }
+    else
+    {
+        decompress_block(out, m_block.data(), n, raw_size);
+    }
+
+    if (checksum(out.data()+base, raw_size)!=crc)
+        throw_malformed();
+
+    return true;
+}
+
+
+
+
+FrameWriter::FrameWriter(
+    ::std::ostream & frame
+)
+:   m_frame {frame}
+,   m_table (::std::size_t{1} << c_hash_bits)
+{
+    m_frame.write(c_magic.data(), ::std::streamsize(c_magic.size()));
+
+    if (!m_frame)
+        throw_write_failed();
+}
+
+
+void
+FrameWriter::write_block(
+    ::std::string_view const & data
+)
+{
+    if (DBC_FAIL(data.size()<=c_block_size))
+        return;
+
+    if (data.empty())
+        return; // a block of size 0 would end the frame
+
+    m_out.clear();
+    block_put(m_out, data.data(), data.size(), m_table, m_block);
+
+    m_frame.write(m_out.data(), ::std::streamsize(m_out.size()));
+
+    if (!m_frame)
+        throw_write_failed();
+}
+
+
+void
+FrameWriter::finish()
+{
+    m_out.clear();
+    put_u32(m_out, 0);
+
+    m_frame.write(m_out.data(), ::std::streamsize(m_out.size()));
+    m_frame.flush();
+
+    if (!m_frame)
+        throw_write_failed();
+}
+
+}
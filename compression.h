@@ -0,0 +1,142 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace nsBase::compression
+{
+/**
+    A self-contained LZ77 codec in the spirit of LZ4.
+    It trades ratio for speed and is used to shrink rotated log segments.
+
+    Each block carries a checksum, so a corrupted frame is detected on
+    decompression instead of yielding garbage.
+
+    Frame layout (all integers little endian):
+
+        "RLZ1"
+        {   u32 raw_size            // 0 marks the end of the frame
+            u32 stored_size         // bit 31 set: block is stored uncompressed
+            u32 crc                 // CRC-32 of the decompressed block
+            u8  data[stored_size & 0x7fffffff]
+        }
+
+    A compressed block is a sequence of
+        token       : high nibble literal count, low nibble match length - 4
+                      (15 means: followed by bytes to add, 255 means: continue)
+        literals
+        offset      : u16, omitted after the trailing literals of a block
+*/
+
+constexpr ::std::string_view
+    c_magic = "RLZ1";
+
+constexpr ::std::size_t
+    c_block_size = 1024 * 1024;
+
+
+/** Test if the data starts like a frame produced by compress().
+*/
+bool
+    is_compressed(
+            ::std::string_view const & data
+        );
+
+::std::string
+    compress(
+            ::std::string_view const & data
+        );
+
+/** \throws if the frame is malformed.
+*/
+::std::string
+    decompress(
+            ::std::string_view const & frame
+        );
+
+
+/**
+    Decompresses a frame read from a stream one block at a time, so the memory
+    needed does not depend on the size of the frame.
+*/
+class FrameReader
+{
+    /** Read the magic of the frame.
+        \throws if the stream doesn't start like a frame.
+    */
+    public : explicit
+        FrameReader(
+                ::std::istream & frame
+            );
+
+    /** Append the next block of the decompressed data to the target.
+        \return FALSE at the end of the frame.
+        \throws if the frame is malformed.
+    */
+    public : bool
+        read_block(
+                ::std::string & target
+            );
+
+    private : ::std::istream &
+        m_frame;
+
+    private : ::std::string
+        m_block;
+
+    private : bool
+        m_is_at_end {};
+};
+
+
+
+/**
+    Compresses into a frame written to a stream one block at a time, so the
+    memory needed does not depend on the size of the data. Fed with blocks of
+    c_block_size bytes, the frame equals the one of compress().
+*/
+class FrameWriter
+{
+    /** Write the magic of the frame.
+        \throws if the stream fails.
+    */
+    public : explicit
+        FrameWriter(
+                ::std::ostream & frame
+            );
+
+    /** Compress the data, at most c_block_size bytes, into the next block.
+        \throws if the stream fails.
+    */
+    public : void
+        write_block(
+                ::std::string_view const & data
+            );
+
+    /** Write the end of the frame and flush the stream.
+        \throws if the stream fails.
+    */
+    public : void
+        finish();
+
+    private : ::std::ostream &
+        m_frame;
+
+    private : ::std::vector<::std::uint32_t>
+        m_table;
+
+    private : ::std::string
+        m_block;
+
+    private : ::std::string
+        m_out;
+};
+
+}
@@ -6,10 +6,16 @@
 #include <atomic>
 #include <memory>
 #include <algorithm>
+#include <array>
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
+#include <cstdint>
 #include <functional>
+#include <variant>
+#include <new>
+#include <ranges>
+#include <thread>
 
 #include "r_base/vector.h"
 #include "r_base/language_tools.h"
@@ -20,6 +26,248 @@ namespace nsBase::concurrent
 {
 
 
+/** How a thread waits for a channel to become ready.
+*/
+enum class
+    wait_strategy
+        {
+            /// park on a condition variable right away - for background work
+            PARK
+            /// spin for a short while, yield, then park - for latency-sensitive work
+        ,   SPIN_YIELD_PARK
+            /// spin until ready or the deadline is reached - for threads pinned to a core
+        ,   BUSY_SPIN
+        };
+
+
+/** The point in time until a blocking channel operation waits.
+
+    EMPTY means to wait without a limit. The point may be of the system_clock
+    or - unaffected by adjustments of the wall clock - of the steady_clock.
+    Both convert implicitly, also from an optional.
+*/
+class deadline
+{
+    public : using system_time_point_t = ::std::chrono::system_clock::time_point;
+    public : using steady_time_point_t = ::std::chrono::steady_clock::time_point;
+
+    private : ::std::variant<::std::monostate,system_time_point_t,steady_time_point_t>
+        m_time_point;
+
+    public :
+        deadline() = default;
+
+    public :
+        deadline(
+                ::std::nullopt_t
+            )
+            {
+            }
+
+    public : template<typename Duration>
+        deadline(
+                ::std::chrono::time_point<::std::chrono::system_clock,Duration> const & tp
+            )
+            :   m_time_point {::std::chrono::time_point_cast<system_time_point_t::duration>(tp)}
+            {
+            }
+
+    public : template<typename Duration>
+        deadline(
+                ::std::chrono::time_point<::std::chrono::steady_clock,Duration> const & tp
+            )
+            :   m_time_point {::std::chrono::time_point_cast<steady_time_point_t::duration>(tp)}
+            {
+            }
+
+    public : template<typename Clock, typename Duration>
+        deadline(
+                ::std::optional<::std::chrono::time_point<Clock,Duration>> const & tp
+            )
+            {
+                if (tp)
+                    *this = deadline{*tp};
+            }
+
+    /// FALSE if there is no limit
+    public : explicit
+        operator bool() const
+            {
+                return m_time_point.index()!=0;
+            }
+
+    public : bool
+        is_reached() const
+            {
+                if (auto tp = ::std::get_if<system_time_point_t>(&m_time_point))
+                    return *tp < ::std::chrono::system_clock::now();
+
+                if (auto tp = ::std::get_if<steady_time_point_t>(&m_time_point))
+                    return *tp < ::std::chrono::steady_clock::now();
+
+                return false;
+            }
+
+    /** Wait on the condition variable until notified or the deadline is reached.
+    */
+    public : template<typename Lock>
+        void
+        wait(
+                ::std::condition_variable & cv
+            ,   Lock                      & l
+            ) const
+            {
+                if (auto tp = ::std::get_if<system_time_point_t>(&m_time_point))
+                    cv.wait_until(l, *tp);
+                else if (auto tp = ::std::get_if<steady_time_point_t>(&m_time_point))
+                    cv.wait_until(l, *tp);
+                else
+                    cv.wait(l);
+            }
+
+    /** Wait on the condition variable until 'is_ready' holds or the deadline is reached.
+        \return The result of 'is_ready'.
+    */
+    public : template<typename Lock, typename Predicate>
+        bool
+        wait(
+                ::std::condition_variable & cv
+            ,   Lock                      & l
+            ,   Predicate           const & is_ready
+            ) const
+            {
+                if (auto tp = ::std::get_if<system_time_point_t>(&m_time_point))
+                    return cv.wait_until(l, *tp, is_ready);
+
+                if (auto tp = ::std::get_if<steady_time_point_t>(&m_time_point))
+                    return cv.wait_until(l, *tp, is_ready);
+
+                cv.wait(l, is_ready);
+
+                return true;
+            }
+};
+
+
+/** A hint to the processor that the calling thread is spinning.
+*/
+inline void
+    cpu_relax()
+        {
+        #if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+        #elif defined(__aarch64__)
+            asm volatile("yield");
+        #endif
+        }
+
+
+/** Spin until 'is_ready' holds, as far as the strategy allows spinning.
+    \return The result of 'is_ready'. If FALSE, the caller has to park,
+        except for BUSY_SPIN where the deadline was reached.
+*/
+template<typename Predicate>
+bool
+    spin_until(
+            wait_strategy       strategy
+        ,   deadline    const & try_until_time_point
+        ,   Predicate   const & is_ready
+        )
+        {
+            // attempts of SPIN_YIELD_PARK, the second half yields
+            constexpr int
+                c_spin_count = 64;
+
+            switch (strategy)
+            {
+                case wait_strategy::PARK :
+                    return is_ready();
+
+                case wait_strategy::SPIN_YIELD_PARK :
+                    for (auto i=0; i<c_spin_count; ++i)
+                    {
+                        if (is_ready())
+                            return true;
+
+                        if (i<c_spin_count/2)
+                            cpu_relax();
+                        else
+                            ::std::this_thread::yield();
+                    }
+
+                    return is_ready();
+
+                case wait_strategy::BUSY_SPIN :
+                    while (!is_ready())
+                    {
+                        if (try_until_time_point.is_reached())
+                            return is_ready();
+
+                        cpu_relax();
+                    }
+
+                    return true;
+            }
+
+            return is_ready();
+        }
+
+
+/** The registration of a thread blocked in select() with the channels it
+    waits for. A channel notifies it on each change of its state.
+*/
+class select_waiter
+{
+    R_DTOR(select_waiter) = default;
+    R_CTOR(select_waiter) = default;
+    R_CCPY(select_waiter) = delete;
+    R_CMOV(select_waiter) = delete;
+    R_COPY(select_waiter) = delete;
+    R_MOVE(select_waiter) = delete;
+
+    private : ::std::mutex
+        m_mutex;
+
+    private : ::std::condition_variable
+        m_cv;
+
+    private : bool
+        m_is_notified {};
+
+    public : void
+        notify()
+            {
+                {
+                    ::std::lock_guard
+                        l {m_mutex};
+
+                    m_is_notified = true;
+                }
+
+                m_cv.notify_one();
+            }
+
+    /** Wait until notified since the last call or the deadline is reached.
+        \return FALSE if the deadline was reached.
+    */
+    public : bool
+        wait(
+                deadline const & try_until_time_point
+            )
+            {
+                ::std::unique_lock
+                    l {m_mutex};
+
+                auto
+                    ret = try_until_time_point.wait(m_cv, l, [this]{return m_is_notified;});
+
+                m_is_notified = false;
+
+                return ret;
+            }
+};
+
+
 /** This implementation is inspired by GoLang-Channels.
 
     A channel is a queue-like container where elements can be stuffed into or
@@ -37,9 +285,16 @@ namespace nsBase::concurrent
 
     One can register a handler that is called each time an element gets queued.
 
+    A blocked send() or recv() parks on a condition variable. A latency-sensitive
+    channel can be created with another wait_strategy to spin first, or to
+    never park at all. The timeouts are given as a deadline, of the system_clock
+    or of the steady_clock.
+
     There can be multiple consumer-threads. This allows to scale incoming
     compute jobs to a collection of consumers.
 
+    A thread can wait for several channels at once by select().
+
     Example:
 
         // Thread A - the owner
@@ -93,8 +348,11 @@ class channel
     public :
         channel(
                 ::std::optional<int> max_size
+            ,   wait_strategy        strategy = wait_strategy::PARK
             )
-            :   m_max_size {max_size}
+            :   m_wait_strategy {strategy}
+            ,   m_max_size_hint {max_size_hint(max_size)}
+            ,   m_max_size      {max_size}
             {
             }
 
@@ -123,6 +381,118 @@ class channel
             {
                 return guard_t{m_mutex};
             }
+
+    private : wait_strategy
+        m_wait_strategy;
+
+    // the size of the queue and its limit, readable without the lock while
+    // spinning - both are written under the lock, so under the lock they are exact
+    private : ::std::atomic<::std::size_t>
+        m_size_hint {};
+
+    private : ::std::atomic<::std::size_t>
+        m_max_size_hint;
+
+    private : void
+        size_hint_update()
+            {
+                m_size_hint.store(m_queue.size(), ::std::memory_order_relaxed);
+            }
+
+    private : static ::std::size_t
+        max_size_hint(
+                ::std::optional<int> max_size
+            )
+            {
+                return max_size ? ::std::size_t(::std::max(*max_size, 0)) : ::std::size_t(-1);
+            }
+
+    private : auto
+        is_pushable_hint()
+            {
+                return [this]()
+                    {
+                        return !m_is_open || m_size_hint.load(::std::memory_order_relaxed) < m_max_size_hint.load(::std::memory_order_relaxed);
+                    };
+            }
+
+    private : auto
+        is_popable_hint()
+            {
+                return [this]()
+                    {
+                        return !m_is_open || m_size_hint.load(::std::memory_order_relaxed) > 0;
+                    };
+            }
+
+    /** Wait on the condition variable as the strategy demands.
+        Spinning is done with the lock released, on the hint. Once the lock is
+        taken again, the hint is exact and a change in between isn't missed.
+        The caller re-checks the state anyway.
+    */
+    private : template<typename Predicate>
+        void
+        wait_for(
+                guard_t                   & l
+            ,   cond_var_t                & cv
+            ,   deadline            const & try_until_time_point
+            ,   Predicate           const & is_ready_hint
+            )
+            {
+                if (m_wait_strategy!=wait_strategy::PARK)
+                {
+                    l.unlock();
+
+                    auto
+                        is_ready = spin_until(m_wait_strategy, try_until_time_point, is_ready_hint);
+
+                    l.lock();
+
+                    if (is_ready || m_wait_strategy==wait_strategy::BUSY_SPIN)
+                        return;
+
+                    try_until_time_point.wait(cv, l, is_ready_hint);
+                    return;
+                }
+
+                try_until_time_point.wait(cv, l);
+            }
+//@}
+
+
+/** \name Select
+    The threads blocked in select() on this channel.
+@{*/
+    private : ::std::vector<select_waiter*>
+        m_select_waiters;
+
+    // to be called under the lock on each change of the state
+    private : void
+        select_waiters_notify()
+            {
+                for (auto w : m_select_waiters)
+                    w->notify();
+            }
+
+    /// used by select()
+    public : void
+        select_attach(
+                select_waiter & w
+            )
+            {
+                auto l = lock();
+                m_select_waiters.push_back(&w);
+            }
+
+    /// used by select()
+    public : void
+        select_detach(
+                select_waiter & w
+            )
+            {
+                auto l = lock();
+                remove_if_and_erase(m_select_waiters, [&w](auto p){return p==&w;});
+            }
 //@}
 
 
@@ -151,9 +521,13 @@ class channel
                 auto old = m_max_size;
 
                 m_max_size = x;
+                m_max_size_hint.store(max_size_hint(x), ::std::memory_order_relaxed);
 
                 if (auto got_larger = !x.has_value() || old.has_value() && x>old)
+                {
                     m_cv_pushable.notify_one();
+                    select_waiters_notify();
+                }
             }
 //@}
 
@@ -190,6 +564,7 @@ class channel
 
                     m_cv_pushable.notify_all();
                     m_cv_popable.notify_all();
+                    select_waiters_notify();
                 }
             }
 //@}
@@ -229,11 +604,10 @@ class channel
     */
     public : bool
         send(
-                element_t && val_
-            ,   ::std::optional<::std::chrono::system_clock::time_point> const & try_until_time_point = {}
+                element_t          && val
+            ,   deadline      const & try_until_time_point = {}
             )
             {
-                auto val = ::std::move(val_);
                 auto l = lock();
 
                 while (true)
@@ -244,9 +618,11 @@ class channel
                     if (!m_max_size || m_max_size > m_queue.size())
                     {
                         m_queue.push_back(::std::move(val));
+                        size_hint_update();
 
                         // entry can be popped
                         m_cv_popable.notify_one();
+                        select_waiters_notify();
 
                         l.unlock();
 
@@ -256,15 +632,10 @@ class channel
                         return true;
                     }
 
-                    if (    try_until_time_point
-                        &&  try_until_time_point < ::std::chrono::system_clock::now()
-                    )
+                    if (try_until_time_point.is_reached())
                         return false;
 
-                    if (try_until_time_point)
-                        m_cv_pushable.wait_until(l, *try_until_time_point);
-                    else
-                        m_cv_pushable.wait(l);
+                    wait_for(l, m_cv_pushable, try_until_time_point, is_pushable_hint());
                 }
             }
 
@@ -276,6 +647,52 @@ class channel
                 return send(::std::move(val), ::std::chrono::system_clock::time_point{});
             }
 
+    /** Send an element without waiting for space. If the channel reached its
+        size limit, the oldest elements are dropped to make room.
+
+        \return The count of the elements dropped.
+                1 if the size limit is 0, the value itself was dropped then.
+                EMPTY if the channel got drained.
+                In both cases the value was not moved and remains usable.
+    */
+    public : ::std::optional<::std::size_t>
+        send_overwrite(
+                element_t && val
+            )
+            {
+                auto l = lock();
+
+                if (!m_is_open)
+                    return {};
+
+                // no room to make, the element itself is dropped
+                if (m_max_size && *m_max_size<=0)
+                    return 1_sz;
+
+                auto
+                    dropped = 0_sz;
+
+                while (m_max_size && !m_queue.empty() && *m_max_size <= int(m_queue.size()))
+                {
+                    m_queue.pop_front();
+                    ++dropped;
+                }
+
+                m_queue.push_back(::std::move(val));
+                size_hint_update();
+
+                // entry can be popped
+                m_cv_popable.notify_one();
+                select_waiters_notify();
+
+                l.unlock();
+
+                if (handler)
+                    handler();
+
+                return dropped;
+            }
+
 
     /** Pop the next element off the channel.
 
@@ -290,8 +707,8 @@ class channel
     */
     public : ::std::optional<element_t>
         recv(
-                ::std::optional<::std::chrono::system_clock::time_point> try_until_time_point = {}
-            ,   bool                                                     wait_only = {}
+                deadline    const & try_until_time_point = {}
+            ,   bool                wait_only = {}
             )
             {
                 ::std::optional<element_t>
@@ -311,7 +728,9 @@ class channel
 
                         ret.emplace(::std::move(m_queue.front()));
                         m_queue.pop_front();
+                        size_hint_update();
                         m_cv_pushable.notify_one();
+                        select_waiters_notify();
 
                         // next entry can be popped
                         if (!m_queue.empty())
@@ -320,17 +739,10 @@ class channel
                         break;
                     }
 
-                    if (try_until_time_point)
-                    {
-                        if (try_until_time_point < ::std::chrono::system_clock::now())
-                            return ret;
+                    if (try_until_time_point.is_reached())
+                        return ret;
 
-                        m_cv_popable.wait_until(l, *try_until_time_point);
-                    }
-                    else
-                    {
-                        m_cv_popable.wait(l);
-                    }
+                    wait_for(l, m_cv_popable, try_until_time_point, is_popable_hint());
                 }
 
                 return ret;
@@ -341,32 +753,137 @@ class channel
     */
     public : void
         wait(
-                ::std::optional<::std::chrono::system_clock::time_point> try_until_time_point = {}
+                deadline const & try_until_time_point = {}
             )
             {
                 recv(try_until_time_point, true);
             }
 
+    /** Send all elements of the collection trough the channel.
+
+        The elements are queued in chunks under a single lock each. If the
+        channel has a size limit, a chunk is as large as the free space and the
+        call blocks for more space like send(). The handler is called once per
+        chunk.
+
+        \return The count of the elements sent, less than the size of the
+                collection if the try_until_time_point was reached or the
+                channel got drained.
+    */
     public : template<typename COLLECTION>
-        void
+        ::std::size_t
         send_all(
-                COLLECTION && eee_
+                COLLECTION         && eee_
+            ,   deadline      const & try_until_time_point = {}
             )
             {
                 auto eee = ::std::move(eee_);
 
-                if (m_max_size) "5d68a804-0e1a-4537-905e-fd28d4317870"_log().throw_UNIMPLEMENTED();
-                if (handler)    "32647eaf-9e85-481f-846b-4a13803d0b66"_log().throw_UNIMPLEMENTED();
+                auto
+                    sent = 0_sz;
 
-                if (eee.empty())
-                    return;
+                auto
+                    it = ::std::begin(eee);
 
                 auto l = lock();
 
-                for (auto & e : eee)
-                    m_queue.push_back(::std::move(e));
+                while (it!=::std::end(eee))
+                {
+                    if (!m_is_open)
+                        break;
+
+                    auto
+                        chunk = 0_sz;
 
-                m_cv_popable.notify_one();
+                    for (; it!=::std::end(eee) && (!m_max_size || m_max_size > m_queue.size()); ++it, ++chunk)
+                        m_queue.push_back(::std::move(*it));
+
+                    if (chunk)
+                    {
+                        sent += chunk;
+                        size_hint_update();
+
+                        // entries can be popped
+                        if (chunk==1)
+                            m_cv_popable.notify_one();
+                        else
+                            m_cv_popable.notify_all();
+
+                        select_waiters_notify();
+
+                        if (handler)
+                        {
+                            l.unlock();
+                            handler();
+                            l.lock();
+                        }
+
+                        continue;
+                    }
+
+                    if (try_until_time_point.is_reached())
+                        break;
+
+                    wait_for(l, m_cv_pushable, try_until_time_point, is_pushable_hint());
+                }
+
+                return sent;
+            }
+
+    /** Wait like recv() for an element, then append up to 'count_max' of the
+        queued elements to the target.
+        Passing the same target repeatedly lets its capacity be reused.
+
+        \return The count of the elements appended, 0 if the try_until_time_point
+                was reached or the channel got drained and ran empty.
+    */
+    public : ::std::size_t
+        recv_n(
+                ::std::size_t                   count_max
+            ,   ::std::vector<element_t>      & target
+            ,   deadline                const & try_until_time_point = {}
+            )
+            {
+                if (!count_max)
+                    return 0;
+
+                auto l = lock();
+
+                while (true)
+                {
+                    if (!m_queue.empty())
+                    {
+                        auto
+                            n = ::std::min(count_max, m_queue.size());
+
+                        target.reserve(target.size()+n);
+
+                        for (auto i=0_sz; i<n; ++i)
+                        {
+                            target.push_back(::std::move(m_queue.front()));
+                            m_queue.pop_front();
+                        }
+
+                        size_hint_update();
+
+                        m_cv_pushable.notify_all();
+                        select_waiters_notify();
+
+                        // next entry can be popped
+                        if (!m_queue.empty())
+                            m_cv_popable.notify_one();
+
+                        return n;
+                    }
+
+                    if (!m_is_open)
+                        return 0;
+
+                    if (try_until_time_point.is_reached())
+                        return 0;
+
+                    wait_for(l, m_cv_popable, try_until_time_point, is_popable_hint());
+                }
             }
 
     public : queue_t
@@ -380,7 +897,9 @@ class channel
                 {
                     m_queue.swap(ret);
                     m_queue.clear();
+                    size_hint_update();
                     m_cv_pushable.notify_all();
+                    select_waiters_notify();
                 }
 
                 return ret;
@@ -415,31 +934,1274 @@ class channel
 };
 
 
-/** A multiplexer can be used to multicast Elements in a thread-safe way to
-    multiple subscribed clients.
-
-    When a client calls subscribe() a new Channel is emplaced for this client.
-    The multiplexer maintains a collection of channels, one for each subscriber.
-
-    When an element is send() into the multiplexer, a copy of the element is send()
-    through the channels. One copy for each channel. The last channel gets a
-    move-constructed instance.
+/** A case of select(): an operation on a channel that is tried without
+    blocking.
+*/
+class select_case
+{
+    R_VTOR(select_case) = default;
+    R_CTOR(select_case) = default;
+    R_CCPY(select_case) = delete;
+    R_CMOV(select_case) = delete;
+    R_COPY(select_case) = delete;
+    R_MOVE(select_case) = delete;
+
+    /** Try the operation.
+        \return TRUE if the case is complete: the operation succeeded or the
+                channel got drained so that it never will.
+    */
+    public : virtual bool
+        try_complete() = 0;
+
+    public : virtual void
+        attach(
+                select_waiter &
+            ) = 0;
+
+    public : virtual void
+        detach(
+                select_waiter &
+            ) = 0;
+};
 
-    Like a channel, a multiplexer can be drained, which drains all its channels.
 
-    One can register a handler that is called when the set of subscriptions has
-    changed.
+/** The case of select() to receive an element.
+    If the case completed, 'value' holds the element received - or is EMPTY
+    if the channel got drained and ran empty.
 */
 template<typename Element>
-class multiplexer
+class recv_case : public select_case
 {
-    private : using mutex_t = ::std::mutex;
-    private : using guard_t = ::std::lock_guard<mutex_t>;
+    public : using element_t = Element;
 
-    private : mutable mutex_t       m_mutex;
-    private : ::std::atomic_bool    m_is_open {true};
+    private : channel<element_t>
+        & m_channel;
 
-    private : guard_t
+    public : ::std::optional<element_t>
+        value;
+
+    public : explicit
+        recv_case(
+                channel<element_t> & c
+            )
+            :   m_channel {c}
+            {
+            }
+
+    public : bool
+        try_complete() override
+            {
+                value = m_channel.recv(::std::chrono::system_clock::time_point{});
+
+                return value || m_channel.is_drained();
+            }
+
+    public : void
+        attach(
+                select_waiter & w
+            ) override
+            {
+                m_channel.select_attach(w);
+            }
+
+    public : void
+        detach(
+                select_waiter & w
+            ) override
+            {
+                m_channel.select_detach(w);
+            }
+};
+
+
+/** The case of select() to send an element.
+    If the case completed, the element was sent - or the channel got drained
+    and the element remains in 'value'.
+*/
+template<typename Element>
+class send_case : public select_case
+{
+    public : using element_t = Element;
+
+    private : channel<element_t>
+        & m_channel;
+
+    public : ::std::optional<element_t>
+        value;
+
+    public :
+        send_case(
+                channel<element_t> & c
+            ,   element_t         && val
+            )
+            :   m_channel {c}
+            ,   value     {::std::move(val)}
+            {
+            }
+
+    public : bool
+        is_sent() const
+            {
+                return !value;
+            }
+
+    public : bool
+        try_complete() override
+            {
+                if (!value)
+                    return true;
+
+                if (m_channel.send(::std::move(*value), ::std::chrono::system_clock::time_point{}))
+                {
+                    value.reset();
+                    return true;
+                }
+
+                return !m_channel.is_open();
+            }
+
+    public : void
+        attach(
+                select_waiter & w
+            ) override
+            {
+                m_channel.select_attach(w);
+            }
+
+    public : void
+        detach(
+                select_waiter & w
+            ) override
+            {
+                m_channel.select_detach(w);
+            }
+};
+
+
+/** Wait for the first of several channel operations to complete, like the
+    select statement of Go.
+
+    The cases are tried in turn, starting at a rotating position so that no
+    channel starves the others. If none completes, the calling thread
+    registers with all the channels and sleeps until one of them changes.
+    Exactly one case completes.
+
+    \param try_until_time_point
+            If EMPTY, the call blocks until a case completed. A time point in the
+            past tries each case once, like a select with a default clause.
+
+    \return The index of the completed case. EMPTY if the try_until_time_point
+            was reached.
+
+    Example:
+
+        auto
+            events = recv_case{channel_events};
+
+        auto
+            commands = recv_case{channel_commands};
+
+        auto
+            results = send_case{channel_results, ::std::move(result)};
+
+        switch (auto i = select({}, events, commands, results); i.value_or(-1))
+        {
+            case 0 : consume_event(events.value); break;
+            case 1 : consume_command(commands.value); break;
+            case 2 : break; // results.is_sent()
+        }
+*/
+template<typename... Cases>
+::std::optional<::std::size_t>
+    select(
+            deadline    const & try_until_time_point
+        ,   Cases             & ... cases
+        )
+        {
+            static_assert(sizeof...(Cases)>0);
+
+            ::std::array<select_case*,sizeof...(Cases)>
+                cc {&cases...};
+
+            thread_local ::std::size_t
+                start {};
+
+            auto
+                first = start++;
+
+            auto
+                try_all = [&]() -> ::std::optional<::std::size_t>
+                    {
+                        for (auto i=0_sz; i<cc.size(); ++i)
+                        {
+                            auto
+                                k = (first+i) % cc.size();
+
+                            if (cc[k]->try_complete())
+                                return k;
+                        }
+
+                        return {};
+                    };
+
+            if (auto k = try_all())
+                return k;
+
+            if (try_until_time_point.is_reached())
+                return {};
+
+            select_waiter
+                waiter;
+
+            struct
+                Attachment
+                    {
+                        ::std::array<select_case*,sizeof...(Cases)> & cc;
+                        select_waiter                                & waiter;
+
+                        ~Attachment()
+                            {
+                                for (auto c : cc)
+                                    c->detach(waiter);
+                            }
+                    };
+
+            for (auto c : cc)
+                c->attach(waiter);
+
+            Attachment
+                attachment {cc, waiter};
+
+            while (true)
+            {
+                // a change after the attachment was notified to the waiter
+                if (auto k = try_all())
+                    return k;
+
+                if (!waiter.wait(try_until_time_point))
+                    return {};
+            }
+        }
+
+
+/** The size assumed for a cache line, to keep independently written data
+    apart.
+*/
+inline constexpr ::std::size_t
+    cache_line_size = 64;
+
+
+/** Lets threads wait for a condition that other threads make true without
+    holding a lock, like the state of a lock-free queue.
+
+    A waiting thread spins as far as its wait_strategy allows, then parks on
+    a condition variable.
+    wake() is cheap while no thread is parked: it touches the mutex only if
+    the count of parked threads is non-zero.
+*/
+class parker
+{
+    R_DTOR(parker) = default;
+    R_CTOR(parker) = default;
+    R_CCPY(parker) = delete;
+    R_CMOV(parker) = delete;
+    R_COPY(parker) = delete;
+    R_MOVE(parker) = delete;
+
+    private : ::std::mutex
+        m_mutex;
+
+    private : ::std::condition_variable
+        m_cv;
+
+    private : alignas(cache_line_size) ::std::atomic<int>
+        m_waiting {};
+
+    /** Wake the parked threads.
+        To be called after the condition might have become true.
+    */
+    public : void
+        wake()
+            {
+                // pairs with the fence of park(), either the parking thread sees the
+                // change or this thread sees the parking thread
+                ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+
+                if (m_waiting.load(::std::memory_order_relaxed)==0)
+                    return;
+
+                {
+                    ::std::lock_guard
+                        l {m_mutex};
+                }
+
+                m_cv.notify_all();
+            }
+
+    /** Wait until 'is_ready' holds or the deadline is reached.
+        How long to spin before parking is up to the strategy.
+        \return FALSE if the deadline was reached.
+    */
+    public : template<typename Predicate>
+        bool
+        park(
+                wait_strategy               strategy
+            ,   deadline            const & try_until_time_point
+            ,   Predicate           const & is_ready
+            )
+            {
+                if (spin_until(strategy, try_until_time_point, is_ready))
+                    return true;
+
+                if (strategy==wait_strategy::BUSY_SPIN)
+                    return false;
+
+                ::std::unique_lock
+                    l {m_mutex};
+
+                m_waiting.fetch_add(1, ::std::memory_order_relaxed);
+
+                ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+
+                auto
+                    ret = try_until_time_point.wait(m_cv, l, is_ready);
+
+                m_waiting.fetch_sub(1, ::std::memory_order_relaxed);
+
+                return ret;
+            }
+};
+
+
+/** A bounded channel for many producers and consumers, without a mutex on
+    the path of send() and recv().
+
+    The elements are kept in a ring of slots, each with a sequence number that
+    tells whether the slot is free or filled for the current lap (see Dmitry
+    Vyukov's bounded MPMC queue). Producers and consumers claim their positions
+    by a compare-and-swap on the head or on the tail, which sit in cache lines
+    of their own.
+
+    A send() on a full and a recv() on an empty channel spin for a while and
+    then park, as the wait_strategy demands (see parker).
+
+    The semantics of send(), try_send(), recv(), wait() and drain() are those
+    of channel. The capacity is fixed and rounded up to a power of 2, there is
+    no handler.
+*/
+template<typename Element>
+class channel_ring
+{
+    R_DTOR(channel_ring)
+        {
+            while (try_pop())
+                ;
+        }
+
+    R_CTOR(channel_ring) = delete;
+    R_CCPY(channel_ring) = delete;
+    R_CMOV(channel_ring) = delete;
+    R_COPY(channel_ring) = delete;
+    R_MOVE(channel_ring) = delete;
+
+    public  : using element_t  = Element;
+    public  : using queue_t    = ::std::deque<element_t>;
+
+    private : using time_point_t = ::std::chrono::system_clock::time_point;
+
+    public : explicit
+        channel_ring(
+                ::std::size_t   capacity
+            ,   wait_strategy   strategy = wait_strategy::SPIN_YIELD_PARK
+            )
+            :   m_mask  {capacity_round(capacity)-1}
+            ,   m_slots {::std::make_unique<Slot[]>(m_mask+1)}
+            ,   m_wait_strategy {strategy}
+            {
+                for (auto i=0_sz; i<=m_mask; ++i)
+                    m_slots[i].seq.store(i, ::std::memory_order_relaxed);
+            }
+
+
+/** \name Ring
+@{*/
+    // the head carries this bit once the channel got drained
+    private : static constexpr ::std::size_t
+        c_closed = ::std::size_t{1} << (sizeof(::std::size_t)*8-1);
+
+    private : struct alignas(cache_line_size)
+        Slot
+            {
+                ::std::atomic<::std::size_t>
+                    seq;
+
+                alignas(element_t) unsigned char
+                    storage[sizeof(element_t)];
+
+                element_t *
+                    element()
+                        {
+                            return ::std::launder(reinterpret_cast<element_t*>(storage));
+                        }
+            };
+
+    private : static ::std::size_t
+        capacity_round(
+                ::std::size_t capacity
+            )
+            {
+                auto
+                    n = 2_sz;
+
+                while (n<capacity)
+                    n <<= 1;
+
+                return n;
+            }
+
+    private : ::std::size_t const
+        m_mask;
+
+    private : ::std::unique_ptr<Slot[]> const
+        m_slots;
+
+    // the next position to send to, plus c_closed
+    private : alignas(cache_line_size) ::std::atomic<::std::size_t>
+        m_head {};
+
+    // the next position to receive from
+    private : alignas(cache_line_size) ::std::atomic<::std::size_t>
+        m_tail {};
+
+    private : enum class
+        Push
+            {
+                DONE
+            ,   FULL
+            ,   CLOSED
+            };
+
+    private : Push
+        try_push(
+                element_t & val
+            )
+            {
+                auto
+                    pos = m_head.load(::std::memory_order_relaxed);
+
+                Slot *
+                    slot;
+
+                while (true)
+                {
+                    if (pos & c_closed)
+                        return Push::CLOSED;
+
+                    slot = &m_slots[pos & m_mask];
+
+                    auto
+                        diff = ::std::ptrdiff_t(slot->seq.load(::std::memory_order_acquire) - pos);
+
+                    if (diff==0)
+                    {
+                        if (m_head.compare_exchange_weak(pos, pos+1, ::std::memory_order_relaxed))
+                            break;
+                    }
+                    else if (diff<0)
+                    {
+                        return Push::FULL;
+                    }
+                    else
+                    {
+                        pos = m_head.load(::std::memory_order_relaxed);
+                    }
+                }
+
+                new (slot->storage) element_t(::std::move(val));
+
+                slot->seq.store(pos+1, ::std::memory_order_release);
+
+                return Push::DONE;
+            }
+
+    private : ::std::optional<element_t>
+        try_pop()
+            {
+                ::std::optional<element_t>
+                    ret;
+
+                auto
+                    pos = m_tail.load(::std::memory_order_relaxed);
+
+                Slot *
+                    slot;
+
+                while (true)
+                {
+                    slot = &m_slots[pos & m_mask];
+
+                    auto
+                        diff = ::std::ptrdiff_t(slot->seq.load(::std::memory_order_acquire) - (pos+1));
+
+                    if (diff==0)
+                    {
+                        if (m_tail.compare_exchange_weak(pos, pos+1, ::std::memory_order_relaxed))
+                            break;
+                    }
+                    else if (diff<0)
+                    {
+                        return ret;
+                    }
+                    else
+                    {
+                        pos = m_tail.load(::std::memory_order_relaxed);
+                    }
+                }
+
+                auto
+                    e = slot->element();
+
+                ret.emplace(::std::move(*e));
+                e->~element_t();
+
+                slot->seq.store(pos+m_mask+1, ::std::memory_order_release);
+
+                return ret;
+            }
+
+    /// TRUE if an element can be received without waiting
+    private : bool
+        is_poppable() const
+            {
+                auto
+                    pos = m_tail.load(::std::memory_order_relaxed);
+
+                return m_slots[pos & m_mask].seq.load(::std::memory_order_acquire) == pos+1;
+            }
+//@}
+
+
+/** \name Parking
+@{*/
+    private : wait_strategy const
+        m_wait_strategy;
+
+    private : parker
+        m_senders;
+
+    private : parker
+        m_receivers;
+//@}
+
+
+/** \name Life Cycle Control
+@{*/
+    public : bool
+        is_open() const
+            {
+                return !(m_head.load() & c_closed);
+            }
+
+    /** If this function returns TRUE, no object will appear in the channel again.
+    */
+    public : bool
+        is_drained() const
+            {
+                auto
+                    head = m_head.load();
+
+                return (head & c_closed) && (head & ~c_closed)==m_tail.load();
+            }
+
+    public : void
+        drain()
+            {
+                if (m_head.fetch_or(c_closed) & c_closed)
+                    return;
+
+                m_senders.wake();
+                m_receivers.wake();
+            }
+//@}
+
+
+/** \name Queue operations
+@{*/
+    public : ::std::size_t
+        capacity() const
+            {
+                return m_mask+1;
+            }
+
+    /** The count of the elements, approximately if other threads are sending
+        or receiving.
+    */
+    public : ::std::size_t
+        size() const
+            {
+                auto
+                    tail = m_tail.load();
+
+                auto
+                    head = m_head.load() & ~c_closed;
+
+                return head>tail ? head-tail : 0;
+            }
+
+    public : bool
+        empty() const
+            {
+                return size()==0;
+            }
+
+    /** Send an element trough the channel.
+        \see channel::send()
+        \return TRUE if the element was sent. In this case the value was moved and is no longer usable.
+                FALSE if the try_until_time_point was reached or the channel got drained.
+                In this case the value was not moved and remains usable.
+    */
+    public : bool
+        send(
+                element_t          && val
+            ,   deadline      const & try_until_time_point = {}
+            )
+            {
+                while (true)
+                {
+                    switch (try_push(val))
+                    {
+                        case Push::DONE :
+                            m_receivers.wake();
+                            return true;
+
+                        case Push::CLOSED :
+                            return false;
+
+                        case Push::FULL :
+                            break;
+                    }
+
+                    if (try_until_time_point.is_reached())
+                        return false;
+
+                    m_senders.park(
+                            m_wait_strategy
+                        ,   try_until_time_point
+                        ,   [this]
+                            {
+                                auto
+                                    head = m_head.load(::std::memory_order_relaxed);
+
+                                return (head & c_closed)
+                                    || ::std::ptrdiff_t(m_slots[head & m_mask].seq.load(::std::memory_order_acquire) - head) >= 0;
+                            }
+                        );
+                }
+            }
+
+    public : bool
+        try_send(
+                element_t && val
+            )
+            {
+                return send(::std::move(val), time_point_t{});
+            }
+
+    /** Pop the next element off the channel.
+        \see channel::recv()
+    */
+    public : ::std::optional<element_t>
+        recv(
+                deadline    const & try_until_time_point = {}
+            ,   bool                wait_only = {}
+            )
+            {
+                while (true)
+                {
+                    if (wait_only)
+                    {
+                        if (is_poppable())
+                            return {};
+                    }
+                    else if (auto ret = try_pop())
+                    {
+                        m_senders.wake();
+                        return ret;
+                    }
+
+                    if (is_drained())
+                        return {};
+
+                    if (try_until_time_point.is_reached())
+                        return {};
+
+                    m_receivers.park(
+                            m_wait_strategy
+                        ,   try_until_time_point
+                        ,   [this]{return is_poppable() || is_drained();}
+                        );
+                }
+            }
+
+    /** Wait for a channel event.
+        Calls recv(try_until_time_point, true).
+    */
+    public : void
+        wait(
+                deadline const & try_until_time_point = {}
+            )
+            {
+                recv(try_until_time_point, true);
+            }
+
+    /** Pop all elements that are available without waiting.
+    */
+    public : queue_t
+        recv_all()
+            {
+                queue_t
+                    ret;
+
+                while (auto e = try_pop())
+                    ret.push_back(::std::move(*e));
+
+                if (!ret.empty())
+                    m_senders.wake();
+
+                return ret;
+            }
+//@}
+};
+
+
+/** A bounded channel for exactly one sending and one receiving thread.
+
+    The elements are kept in a ring. The sender only writes the head, the
+    receiver only writes the tail, each in a cache line of its own. Both keep a
+    cached copy of the other index and re-read the shared one only when the
+    ring looks full or empty, so the cache lines don't bounce between the
+    cores while the ring is neither. Sending and receiving are wait-free.
+
+    send_n() and recv_n() move a batch of elements with a single publication.
+
+    The blocking variants spin for a while and then park as the wait_strategy
+    demands (see parker), with the timeout semantics of channel::send() and
+    channel::recv(). drain() may be called by any thread.
+
+    The capacity is fixed and rounded up to a power of 2, there is no handler.
+*/
+template<typename Element>
+class spsc_channel
+{
+    R_DTOR(spsc_channel)
+        {
+            auto
+                head = m_head.load() & ~c_closed;
+
+            for (auto pos = m_tail.load(); pos!=head; ++pos)
+                element(pos)->~element_t();
+        }
+
+    R_CTOR(spsc_channel) = delete;
+    R_CCPY(spsc_channel) = delete;
+    R_CMOV(spsc_channel) = delete;
+    R_COPY(spsc_channel) = delete;
+    R_MOVE(spsc_channel) = delete;
+
+    public  : using element_t  = Element;
+
+    private : using time_point_t = ::std::chrono::system_clock::time_point;
+
+    public : explicit
+        spsc_channel(
+                ::std::size_t   capacity
+            ,   wait_strategy   strategy = wait_strategy::SPIN_YIELD_PARK
+            )
+            :   m_mask    {capacity_round(capacity)-1}
+            ,   m_storage {::std::make_unique<Storage[]>(m_mask+1)}
+            ,   m_wait_strategy {strategy}
+            {
+            }
+
+
+/** \name Ring
+@{*/
+    // the head carries this bit once the channel got drained
+    private : static constexpr ::std::size_t
+        c_closed = ::std::size_t{1} << (sizeof(::std::size_t)*8-1);
+
+    private : struct
+        Storage
+            {
+                alignas(element_t) unsigned char
+                    bytes[sizeof(element_t)];
+            };
+
+    private : static ::std::size_t
+        capacity_round(
+                ::std::size_t capacity
+            )
+            {
+                auto
+                    n = 2_sz;
+
+                while (n<capacity)
+                    n <<= 1;
+
+                return n;
+            }
+
+    private : ::std::size_t const
+        m_mask;
+
+    private : ::std::unique_ptr<Storage[]> const
+        m_storage;
+
+    // written by the sender: the next position to send to, plus c_closed
+    private : alignas(cache_line_size) ::std::atomic<::std::size_t>
+        m_head {};
+
+    // the sender's copy of m_tail
+    private : ::std::size_t
+        m_tail_cached {};
+
+    // written by the receiver: the next position to receive from
+    private : alignas(cache_line_size) ::std::atomic<::std::size_t>
+        m_tail {};
+
+    // the receiver's copy of m_head, without c_closed
+    private : ::std::size_t
+        m_head_cached {};
+
+    private : wait_strategy const
+        m_wait_strategy;
+
+    private : alignas(cache_line_size) parker
+        m_senders;
+
+    private : parker
+        m_receivers;
+
+    private : element_t *
+        element(
+                ::std::size_t pos
+            ) const
+            {
+                return ::std::launder(reinterpret_cast<element_t*>(m_storage[pos & m_mask].bytes));
+            }
+
+    /** The count of the free slots, seen by the sender.
+        EMPTY if the channel got drained.
+    */
+    private : ::std::optional<::std::size_t>
+        space(
+                ::std::size_t & head
+            )
+            {
+                head = m_head.load(::std::memory_order_relaxed);
+
+                if (head & c_closed)
+                    return {};
+
+                auto
+                    free = m_mask+1 - (head - m_tail_cached);
+
+                if (free==0)
+                {
+                    m_tail_cached = m_tail.load(::std::memory_order_acquire);
+
+                    free = m_mask+1 - (head - m_tail_cached);
+                }
+
+                return free;
+            }
+
+    /** Make the elements up to 'head_new' visible to the receiver.
+        \return FALSE if the channel got drained meanwhile.
+    */
+    private : bool
+        publish(
+                ::std::size_t head
+            ,   ::std::size_t head_new
+            )
+            {
+                // fails only if drain() set c_closed
+                if (!m_head.compare_exchange_strong(head, head_new, ::std::memory_order_release))
+                    return false;
+
+                m_receivers.wake();
+
+                return true;
+            }
+
+    /// The count of the available elements, seen by the receiver.
+    private : ::std::size_t
+        available()
+            {
+                auto
+                    tail = m_tail.load(::std::memory_order_relaxed);
+
+                if (m_head_cached==tail)
+                    m_head_cached = m_head.load(::std::memory_order_acquire) & ~c_closed;
+
+                return m_head_cached - tail;
+            }
+
+    private : void
+        pop_n(
+                ::std::size_t                 count
+            ,   ::std::vector<element_t>    * target
+            ,   ::std::optional<element_t>  * target1
+            )
+            {
+                auto
+                    tail = m_tail.load(::std::memory_order_relaxed);
+
+                for (auto i=0_sz; i<count; ++i)
+                {
+                    auto
+                        e = element(tail+i);
+
+                    if (target)
+                        target->push_back(::std::move(*e));
+                    else
+                        target1->emplace(::std::move(*e));
+
+                    e->~element_t();
+                }
+
+                m_tail.store(tail+count, ::std::memory_order_release);
+
+                m_senders.wake();
+            }
+//@}
+
+
+/** \name Life Cycle Control
+@{*/
+    public : bool
+        is_open() const
+            {
+                return !(m_head.load() & c_closed);
+            }
+
+    /** If this function returns TRUE, no object will appear in the channel again.
+    */
+    public : bool
+        is_drained() const
+            {
+                auto
+                    head = m_head.load();
+
+                return (head & c_closed) && (head & ~c_closed)==m_tail.load();
+            }
+
+    public : void
+        drain()
+            {
+                if (m_head.fetch_or(c_closed) & c_closed)
+                    return;
+
+                m_senders.wake();
+                m_receivers.wake();
+            }
+//@}
+
+
+/** \name Queue operations
+@{*/
+    public : ::std::size_t
+        capacity() const
+            {
+                return m_mask+1;
+            }
+
+    /** The count of the elements, approximately if called by a third thread.
+    */
+    public : ::std::size_t
+        size() const
+            {
+                return (m_head.load() & ~c_closed) - m_tail.load();
+            }
+
+    public : bool
+        empty() const
+            {
+                return size()==0;
+            }
+
+    /** Send an element trough the channel. Only to be called by the sender.
+        \see channel::send()
+        \return TRUE if the element was sent. In this case the value was moved and is no longer usable.
+                FALSE if the try_until_time_point was reached or the channel got drained.
+                In this case the value was not moved and remains usable.
+    */
+    public : bool
+        send(
+                element_t          && val
+            ,   deadline      const & try_until_time_point = {}
+            )
+            {
+                while (true)
+                {
+                    ::std::size_t
+                        head;
+
+                    auto
+                        free = space(head);
+
+                    if (!free)
+                        return false;
+
+                    if (*free)
+                    {
+                        auto
+                            e = new (m_storage[head & m_mask].bytes) element_t(::std::move(val));
+
+                        if (publish(head, head+1))
+                            return true;
+
+                        val = ::std::move(*e);
+                        e->~element_t();
+
+                        return false;
+                    }
+
+                    if (try_until_time_point.is_reached())
+                        return false;
+
+                    m_senders.park(
+                            m_wait_strategy
+                        ,   try_until_time_point
+                        ,   [this]
+                            {
+                                ::std::size_t
+                                    head;
+
+                                auto
+                                    free = space(head);
+
+                                return !free || *free;
+                            }
+                        );
+                }
+            }
+
+    public : bool
+        try_send(
+                element_t && val
+            )
+            {
+                return send(::std::move(val), time_point_t{});
+            }
+
+    /** Send 'count' elements, moved from the range starting at 'first'.
+        Only to be called by the sender.
+        The elements are published in batches as large as the free space.
+        \return The count of the elements sent, less than 'count' if the
+                try_until_time_point was reached or the channel got drained.
+    */
+    public : template<typename Iterator>
+        ::std::size_t
+        send_n(
+                Iterator                first
+            ,   ::std::size_t           count
+            ,   deadline        const & try_until_time_point = {}
+            )
+            {
+                auto
+                    sent = 0_sz;
+
+                while (sent<count)
+                {
+                    ::std::size_t
+                        head;
+
+                    auto
+                        free = space(head);
+
+                    if (!free)
+                        break;
+
+                    if (*free)
+                    {
+                        auto
+                            n = ::std::min(*free, count-sent);
+
+                        for (auto i=0_sz; i<n; ++i, ++first)
+                            new (m_storage[(head+i) & m_mask].bytes) element_t(::std::move(*first));
+
+                        if (!publish(head, head+n))
+                        {
+                            for (auto i=0_sz; i<n; ++i)
+                                element(head+i)->~element_t();
+
+                            break;
+                        }
+
+                        sent += n;
+                        continue;
+                    }
+
+                    if (try_until_time_point.is_reached())
+                        break;
+
+                    m_senders.park(
+                            m_wait_strategy
+                        ,   try_until_time_point
+                        ,   [this]
+                            {
+                                ::std::size_t
+                                    head;
+
+                                auto
+                                    free = space(head);
+
+                                return !free || *free;
+                            }
+                        );
+                }
+
+                return sent;
+            }
+
+    /** Pop the next element off the channel. Only to be called by the receiver.
+        \see channel::recv()
+    */
+    public : ::std::optional<element_t>
+        recv(
+                deadline    const & try_until_time_point = {}
+            ,   bool                wait_only = {}
+            )
+            {
+                ::std::optional<element_t>
+                    ret;
+
+                if (wait_for_available(try_until_time_point) && !wait_only)
+                    pop_n(1, nullptr, &ret);
+
+                return ret;
+            }
+
+    /** Wait for a channel event.
+        Calls recv(try_until_time_point, true).
+    */
+    public : void
+        wait(
+                deadline const & try_until_time_point = {}
+            )
+            {
+                recv(try_until_time_point, true);
+            }
+
+    /** Wait like recv() for an element, then append up to 'count_max' of the
+        available elements to the target. Only to be called by the receiver.
+        \return The count of the elements appended.
+    */
+    public : ::std::size_t
+        recv_n(
+                ::std::size_t                   count_max
+            ,   ::std::vector<element_t>      & target
+            ,   deadline                const & try_until_time_point = {}
+            )
+            {
+                if (!count_max || !wait_for_available(try_until_time_point))
+                    return 0;
+
+                auto
+                    n = ::std::min(available(), count_max);
+
+                target.reserve(target.size()+n);
+
+                pop_n(n, &target, nullptr);
+
+                return n;
+            }
+
+    /** \return FALSE if the try_until_time_point was reached or the channel
+            got drained and ran empty.
+    */
+    private : bool
+        wait_for_available(
+                deadline const & try_until_time_point
+            )
+            {
+                while (true)
+                {
+                    if (available())
+                        return true;
+
+                    if (is_drained())
+                        return false;
+
+                    if (try_until_time_point.is_reached())
+                        return false;
+
+                    m_receivers.park(
+                            m_wait_strategy
+                        ,   try_until_time_point
+                        ,   [this]{return available() || !is_open();}
+                        );
+                }
+            }
+//@}
+};
+
+
+/** What a multiplexer does with an element for a subscriber whose channel
+    reached its size limit.
+*/
+enum class
+    overflow_policy
+        {
+            /// wait until the subscriber made room, after the other subscribers got the element
+            WAIT
+            /// make room by dropping the oldest element of the channel
+        ,   DROP_OLDEST
+            /// drop the element
+        ,   DROP_NEWEST
+            /// drop the element and drain the channel, the subscriber gets no more elements
+        ,   DISCONNECT
+        };
+
+
+/** A multiplexer can be used to multicast Elements in a thread-safe way to
+    multiple subscribed clients.
+
+    When a client calls subscribe() a new Channel is emplaced for this client.
+    The multiplexer maintains a collection of channels, one for each subscriber.
+
+    When an element is send() into the multiplexer, a copy of the element is send()
+    through the channels. One copy for each channel. The last channel gets a
+    move-constructed instance.
+    For large elements, shared_multiplexer shares a single immutable instance
+    among the channels instead.
+
+    A subscriber with a bounded channel chooses an overflow_policy for when
+    its channel is full. The elements are delivered without holding the lock
+    of the subscriptions, so a slow subscriber can't block the subscriptions.
+    The counters() of each subscriber tell how many elements were delivered
+    and dropped.
+
+    The sends are delivered one after the other, so all subscribers receive
+    the elements in the same order. A WAIT subscriber with a full channel
+    gets the element after the others, but delays the following sends.
+
+    Like a channel, a multiplexer can be drained, which drains all its channels.
+
+    One can register a handler that is called when the set of subscriptions has
+    changed.
+*/
+template<typename Element>
+class multiplexer
+{
+    private : using mutex_t = ::std::mutex;
+    private : using guard_t = ::std::unique_lock<mutex_t>;
+
+    private : mutable mutex_t       m_mutex;
+    private : ::std::atomic_bool    m_is_open {true};
+
+    private : guard_t
         lock() const
             {
                 return guard_t{m_mutex};
@@ -448,17 +2210,236 @@ class multiplexer
     public : using channel_t     = channel<Element>;
     public : using channel_ref_t = ::std::shared_ptr<channel_t>;
 
-    private : ::std::vector<channel_ref_t>
-        subscribers;
+    private : struct
+        Counters
+            {
+                ::std::atomic<::std::uint64_t>  delivered {};
+                ::std::atomic<::std::uint64_t>  dropped {};
+                ::std::atomic_bool              is_disconnected {};
+            };
+
+    private : struct
+        Subscription
+            {
+                channel_ref_t                   channel;
+                overflow_policy                 policy;
+                ::std::shared_ptr<Counters>     counters;
+            };
+
+    private : using
+        subscribers_t = ::std::vector<Subscription>;
+
+    /// replaced as a whole on changes, so a send() holds it without copying
+    private : ::std::shared_ptr<subscribers_t const>
+        subscribers {::std::make_shared<subscribers_t const>()};
+
+    /// serializes send*(), so all subscribers receive the elements in the same order
+    private : mutex_t
+        m_send_mutex;
 
     public : bool
         has_subscribers() const
             {
                 auto l = lock();
-                return !subscribers.empty();
+
+                for (auto & s : *subscribers)
+                    if (!s.counters->is_disconnected)
+                        return true;
+
+                return false;
+            }
+
+    /** Remove the subscriptions whose channel was dropped by the subscriber,
+        then return the current subscriptions. The collection is copied only
+        if a subscription was removed.
+        To be called under the lock.
+    */
+    private : ::std::shared_ptr<subscribers_t const>
+        subscribers_snapshot()
+            {
+                auto
+                    is_dropped = [](auto & s){return s.channel.use_count()==1;};
+
+                if (::std::any_of(subscribers->begin(), subscribers->end(), is_dropped))
+                {
+                    auto
+                        ss = ::std::make_shared<subscribers_t>();
+
+                    for (auto & s : *subscribers)
+                        if (!is_dropped(s))
+                            ss->push_back(s);
+
+                    subscribers = ::std::move(ss);
+                }
+
+                return subscribers;
+            }
+
+    private : enum class
+        delivery
+            {
+                DONE
+                /// the channel of a WAIT subscriber is full, the element remains to be sent
+            ,   FULL
+            ,   DISCONNECTED
+            };
+
+    /** Deliver the element to a subscriber as its policy demands, without waiting.
+        The value is moved only if it was queued.
+    */
+    private : static delivery
+        deliver(
+                Subscription    const & s
+            ,   Element              && val
+            )
+            {
+                auto & c = *s.channel;
+
+                switch (s.policy)
+                {
+                    case overflow_policy::WAIT :
+                        if (c.try_send(::std::move(val)))
+                            ++s.counters->delivered;
+                        else if (c.is_open())
+                            return delivery::FULL;
+                        break;
+
+                    case overflow_policy::DROP_OLDEST :
+                        if (auto max = c.max_size(); max && *max<=0)
+                        {
+                            // no room to make, the element itself is dropped
+                            if (c.is_open())
+                                ++s.counters->dropped;
+                        }
+                        else if (auto dropped = c.send_overwrite(::std::move(val)))
+                        {
+                            ++s.counters->delivered;
+                            s.counters->dropped += *dropped;
+                        }
+                        break;
+
+                    case overflow_policy::DROP_NEWEST :
+                        if (c.try_send(::std::move(val)))
+                            ++s.counters->delivered;
+                        else if (c.is_open())
+                            ++s.counters->dropped;
+                        break;
+
+                    case overflow_policy::DISCONNECT :
+                        if (c.try_send(::std::move(val)))
+                        {
+                            ++s.counters->delivered;
+                        }
+                        else if (c.is_open())
+                        {
+                            ++s.counters->dropped;
+
+                            if (disconnect(s))
+                                return delivery::DISCONNECTED;
+                        }
+                        break;
+                }
+
+                return delivery::DONE;
+            }
+
+    /** Deliver the collection to a subscriber as its policy demands, without waiting.
+        The elements are moved out of the collection as they get queued.
+        \param sent If FULL is returned, the count of the elements queued.
+    */
+    private : template<typename COLLECTION>
+        static delivery
+        deliver_all(
+                Subscription    const & s
+            ,   COLLECTION            & vvv
+            ,   ::std::size_t         & sent
+            )
+            {
+                auto & c = *s.channel;
+
+                auto
+                    size = ::std::size(vvv);
+
+                sent = 0;
+
+                switch (s.policy)
+                {
+                    case overflow_policy::DROP_OLDEST :
+                        for (auto & v : vvv)
+                            deliver(s, ::std::move(v));
+                        break;
+
+                    case overflow_policy::WAIT :
+                    case overflow_policy::DROP_NEWEST :
+                    case overflow_policy::DISCONNECT :
+                        {
+                            sent = c.send_all(::std::ranges::subrange(vvv), ::std::chrono::system_clock::time_point{});
+
+                            s.counters->delivered += sent;
+
+                            if (sent<size && c.is_open())
+                            {
+                                if (s.policy==overflow_policy::WAIT)
+                                    return delivery::FULL;
+
+                                s.counters->dropped += size-sent;
+
+                                if (s.policy==overflow_policy::DISCONNECT && disconnect(s))
+                                    return delivery::DISCONNECTED;
+                            }
+                        }
+                        break;
+                }
+
+                return delivery::DONE;
+            }
+
+    /** Drain the channel of a subscriber that can't keep up.
+        It still receives the elements queued so far.
+        \return TRUE if the subscriber got disconnected by this call.
+    */
+    private : static bool
+        disconnect(
+                Subscription const & s
+            )
+            {
+                if (s.counters->is_disconnected.exchange(true))
+                    return false;
+
+                s.channel->drain();
+
+                return true;
+            }
+
+    /** Call the handler, if any, after subscribers got disconnected.
+    */
+    private : void
+        disconnected_notify()
+            {
+                handler_t * handler_to_call {};
+
+                {
+                    auto l = lock();
+
+                    if (handler)
+                        handler_to_call = &handler;
+                }
+
+                // handler is called in unlocked state
+                if (handler_to_call && *handler_to_call)
+                    (*handler_to_call)();
             }
 
 
+    /** Send the element to each subscriber.
+        Concurrent calls are served one after the other, so all subscribers
+        receive the elements in the same order. The subscriptions are not
+        locked meanwhile, subscriptions and unsubscriptions during the call
+        take effect with the next one.
+        A WAIT subscriber with a full channel is waited for after all other
+        subscribers got the element, so it delays only this call and the
+        following ones.
+    */
     public : void
         send(
                 Element && val_
@@ -466,34 +2447,59 @@ class multiplexer
             {
                 auto val = ::std::move(val_);
 
-                auto l = lock();
+                auto sl = guard_t{m_send_mutex};
 
-                bool have_dangling_channel = false;
+                ::std::shared_ptr<subscribers_t const>
+                    ss;
 
-                for (auto i=subscribers.size(); i--;)
                 {
-                    auto & c = subscribers[i];
+                    auto l = lock();
 
-                    if (c.use_count()==1)
-                    {
-                        have_dangling_channel = true;
-                    }
-                    else
+                    ss = subscribers_snapshot();
+                }
+
+                auto
+                    is_disconnected = false;
+
+                // the WAIT subscribers with a full channel
+                ::std::vector<Subscription const *>
+                    full;
+
+                for (auto i=0_sz; i<ss->size(); ++i)
+                {
+                    auto & s = (*ss)[i];
+
+                    if (s.counters->is_disconnected)
+                        continue;
+
+                    auto
+                        is_last = i+1==ss->size() && full.empty();
+
+                    // move into the last channel, copy otherwise
+                    auto
+                        r = is_last
+                            ?   deliver(s, ::std::move(val))
+                            :   deliver(s, Element{val})
+                            ;
+
+                    switch (r)
                     {
-                        if (i)
-                            c->send(Element{val}); // copy
-                        else
-                            c->send(::std::move(val)); // move (into the last channel)
+                        case delivery::DONE         : break;
+                        case delivery::FULL         : full.push_back(&s);     break;
+                        case delivery::DISCONNECTED : is_disconnected = true; break;
                     }
                 }
 
-                if (have_dangling_channel)
+                for (auto i=0_sz; i<full.size(); ++i)
                 {
-                    remove_if_and_erase(
-                            subscribers
-                        ,   [](auto & c){return c.use_count()==1;}
-                        );
+                    auto & s = *full[i];
+
+                    if (s.channel->send(i+1==full.size() ? ::std::move(val) : Element{val}))
+                        ++s.counters->delivered;
                 }
+
+                if (is_disconnected)
+                    disconnected_notify();
             }
 
 
@@ -505,6 +2511,8 @@ class multiplexer
                 send(Element{val});
             }
 
+    /** Send the elements of the collection to each subscriber, like send().
+    */
     public : template<typename COLLECTION>
         void
         send_all(
@@ -513,34 +2521,66 @@ class multiplexer
             {
                 auto vvv = ::std::move(vvv_);
 
-                auto l = lock();
+                using collection_t = decltype(vvv);
+
+                auto sl = guard_t{m_send_mutex};
+
+                ::std::shared_ptr<subscribers_t const>
+                    ss;
 
-                bool have_dangling_channel = false;
+                {
+                    auto l = lock();
+
+                    ss = subscribers_snapshot();
+                }
 
-                for (auto i=subscribers.size(); i--;)
+                auto
+                    is_disconnected = false;
+
+                // the WAIT subscribers with a full channel and the elements still to send them
+                struct
+                    Full
+                        {
+                            Subscription const *    s;
+                            collection_t            vvv;
+                            ::std::size_t           sent;
+                        };
+
+                ::std::vector<Full>
+                    full;
+
+                for (auto i=0_sz; i<ss->size(); ++i)
                 {
-                    auto & c = subscribers[i];
+                    auto & s = (*ss)[i];
 
-                    if (c.use_count()==1)
-                    {
-                        have_dangling_channel = true;
-                    }
-                    else
+                    if (s.counters->is_disconnected)
+                        continue;
+
+                    // move into the last channel, copy otherwise
+                    auto
+                        v = i+1==ss->size() ? ::std::move(vvv) : collection_t(vvv);
+
+                    auto
+                        sent = 0_sz;
+
+                    switch (deliver_all(s, v, sent))
                     {
-                        if (i)
-                            c->send_all(COLLECTION(vvv)); // copy
-                        else
-                            c->send_all(::std::move(vvv)); // move (into the last channel)
+                        case delivery::DONE         : break;
+                        case delivery::FULL         : full.push_back({&s, ::std::move(v), sent}); break;
+                        case delivery::DISCONNECTED : is_disconnected = true; break;
                     }
                 }
 
-                if (have_dangling_channel)
+                for (auto & f : full)
                 {
-                    remove_if_and_erase(
-                            subscribers
-                        ,   [](auto & c){return c.use_count()==1;}
-                        );
+                    auto
+                        rest = ::std::ranges::subrange(::std::next(::std::begin(f.vvv), ::std::ptrdiff_t(f.sent)), ::std::end(f.vvv));
+
+                    f.s->counters->delivered += f.s->channel->send_all(rest);
                 }
+
+                if (is_disconnected)
+                    disconnected_notify();
             }
 
 
@@ -557,8 +2597,8 @@ class multiplexer
 
                 m_is_open = false;
 
-                for (auto & c : subscribers)
-                    c->drain();
+                for (auto & s : *subscribers)
+                    s.channel->drain();
             }
 
 
@@ -566,28 +2606,18 @@ class multiplexer
         If the multiplexer was closed, the returned channel is initially closed.
         If the caller drops its reference to the channel,
             the channel gets deleted by the multiplexer on the next invocation of send*().
+        \param max_size The size limit of the channel, the policy applies when it is reached.
     */
     public : channel_ref_t
-        subscribe()
+        subscribe(
+                ::std::optional<int>    max_size = {}
+            ,   overflow_policy         policy   = overflow_policy::WAIT
+            )
             {
-                channel_ref_t c;
-                handler_t   * handler_to_call {};
-
-                {
-                    auto l = lock();
-
-                    c = subscribers.emplace_back(::std::make_shared<channel_t>());
-
-                    if (!m_is_open)
-                        c->drain();
-
-                    if (handler)
-                        handler_to_call = &handler;
-                }
+                auto
+                    c = ::std::make_shared<channel_t>(max_size);
 
-                // handler is called in unlocked state
-                if (handler_to_call && *handler_to_call)
-                    (*handler_to_call)();
+                subscribe(c, policy);
 
                 return c;
             }
@@ -596,10 +2626,12 @@ class multiplexer
         If the multiplexer was already closed, the channel gets drained.
         If the caller drops its reference to the channel,
             the channel gets deleted by the multiplexer on the next invocation of send*().
+        \param policy What to do if the channel reached its size limit.
     */
     public : void
         subscribe(
-                channel_ref_t const & channel
+                channel_ref_t   const & channel
+            ,   overflow_policy         policy = overflow_policy::WAIT
             )
             {
                 if (!channel) "de31b802-4a3c-4cd7-907a-5ba155c1368d"_log().throw_INTERNAL();
@@ -609,7 +2641,12 @@ class multiplexer
                 {
                     auto l = lock();
 
-                    subscribers.emplace_back(channel);
+                    auto
+                        ss = ::std::make_shared<subscribers_t>(*subscribers);
+
+                    ss->push_back({channel, policy, ::std::make_shared<Counters>()});
+
+                    subscribers = ::std::move(ss);
 
                     if (!m_is_open)
                         channel->drain();
@@ -624,6 +2661,48 @@ class multiplexer
             }
 
 
+/** \name Counters
+@{*/
+    public : struct
+        subscriber_counters
+            {
+                /// the elements queued into the channel
+                ::std::uint64_t     delivered {};
+
+                /// the elements dropped, due to the policy
+                ::std::uint64_t     dropped {};
+
+                /// TRUE if the subscriber was disconnected due to the policy DISCONNECT
+                bool                is_disconnected {};
+            };
+
+    /** The counters of the subscription of the channel.
+        \return EMPTY if the channel isn't subscribed.
+    */
+    public : ::std::optional<subscriber_counters>
+        counters(
+                channel_ref_t const & channel
+            ) const
+            {
+                auto l = lock();
+
+                for (auto & s : *subscribers)
+                {
+                    if (s.channel==channel)
+                    {
+                        return subscriber_counters{
+                                s.counters->delivered
+                            ,   s.counters->dropped
+                            ,   s.counters->is_disconnected
+                            };
+                    }
+                }
+
+                return {};
+            }
+//@}
+
+
 /** \name Handler
     The handler is called if the set of subscriptions has changed.
     The handler is called in the thread that changed the set of subscriptions.
@@ -649,4 +2728,73 @@ class multiplexer
 //@}
 };
 
+
+
+/** A multiplexer that shares the elements among its subscribers instead of
+    copying them.
+
+    Each element is moved once into an immutable instance held by a
+    ::std::shared_ptr<Element const>. The subscribers receive handles to the
+    same instance, so sending costs one allocation and a reference count per
+    subscriber, regardless of the size of the element.
+
+    A subscriber that needs to modify an element copies it from its handle.
+    The copying multiplexer remains the choice if most subscribers do.
+*/
+template<typename Element>
+class shared_multiplexer : public multiplexer<::std::shared_ptr<Element const>>
+{
+    public : using value_t   = Element;
+    public : using element_t = ::std::shared_ptr<value_t const>;
+
+    private : using base_t = multiplexer<element_t>;
+
+    public : using base_t::send;
+
+    public : void
+        send(
+                value_t && val
+            )
+            {
+                base_t::send(::std::make_shared<value_t const>(::std::move(val)));
+            }
+
+    public : void
+        send(
+                value_t const & val
+            )
+            {
+                base_t::send(::std::make_shared<value_t const>(val));
+            }
+
+    /** Wrap each element of the collection once, then send the handles.
+        A collection of handles is sent as is.
+    */
+    public : template<typename COLLECTION>
+        void
+        send_all(
+                COLLECTION && vvv_
+            )
+            {
+                auto vvv = ::std::move(vvv_);
+
+                if constexpr (::std::is_same_v<typename decltype(vvv)::value_type,element_t>)
+                {
+                    base_t::send_all(::std::move(vvv));
+                }
+                else
+                {
+                    ::std::vector<element_t>
+                        handles;
+
+                    handles.reserve(::std::size(vvv));
+
+                    for (auto & v : vvv)
+                        handles.push_back(::std::make_shared<value_t const>(::std::move(v)));
+
+                    base_t::send_all(::std::move(handles));
+                }
+            }
+};
+
 }
@@ -0,0 +1,1265 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_archive.h"
+#include "r_base/log_stream.h"
+#include "r_base/Error.h"
+#include "r_base/on_delete.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace nsBase
+{
+
+namespace
+{
+constexpr ::std::string_view
+    c_magic = "RLARC002";
+
+// row count, directory offset, magic
+constexpr ::std::size_t
+    c_footer_size = 8 + 8 + c_magic.size();
+
+constexpr ::std::uint8_t
+    c_encoding_integers = 0;
+
+constexpr ::std::uint8_t
+    c_encoding_strings = 1;
+
+// the properties without a fixed width column, dictionary encoded
+constexpr ::std::array<::std::string_view,10>
+    c_dictionary_keys
+        {
+            "_id_application"
+        ,   "_id_application_instance"
+        ,   "_version"
+        ,   "_id_event"
+        ,   "_host"
+        ,   "_user"
+        ,   "_thread"
+        ,   "_trace"
+        ,   "scope"
+        ,   "message"
+        };
+
+
+[[noreturn]] void
+    throw_malformed()
+        {
+            "5e0c3a7d-9b14-4f86-a2d5-1c7e8b3f6a09"_log("malformed log archive").throw_DATA_LOSS();
+        }
+
+
+void
+    put_u8(
+            ::std::string & out
+        ,   ::std::uint8_t  v
+        )
+        {
+            out += char(v);
+        }
+
+void
+    put_u32(
+            ::std::string & out
+        ,   ::std::uint32_t v
+        )
+        {
+            for (auto i=0; i<4; ++i)
+                out += char(v >> (8*i));
+        }
+
+void
+    put_u64(
+            ::std::string & out
+        ,   ::std::uint64_t v
+        )
+        {
+            for (auto i=0; i<8; ++i)
+                out += char(v >> (8*i));
+        }
+
+void
+    put_varint(
+            ::std::string & out
+        ,   ::std::uint64_t v
+        )
+        {
+            while (v>=0x80)
+            {
+                out += char(0x80 | (v & 0x7f));
+                v >>= 7;
+            }
+
+            out += char(v);
+        }
+
+void
+    put_bytes(
+            ::std::string            & out
+        ,   ::std::string_view const & v
+        )
+        {
+            put_varint(out, v.size());
+            out += v;
+        }
+
+void
+    put_uuid(
+            ::std::string       & out
+        ,   ::uuids::uuid const & u
+        )
+        {
+            auto
+                bytes = u.as_bytes();
+
+            out.append(reinterpret_cast<char const*>(bytes.data()), 16);
+        }
+
+::std::uint64_t
+    zigzag(
+            ::std::int64_t v
+        )
+        {
+            return (::std::uint64_t(v) << 1) ^ ::std::uint64_t(v >> 63);
+        }
+
+::std::int64_t
+    unzigzag(
+            ::std::uint64_t v
+        )
+        {
+            return ::std::int64_t(v >> 1) ^ -::std::int64_t(v & 1);
+        }
+
+
+/// TRUE if the value is the canonical decimal representation of an int64
+bool
+    is_integer(
+            ::std::string const & v
+        ,   ::std::int64_t      & x
+        )
+        {
+            auto
+                [end, ec] = ::std::from_chars(v.data(), v.data()+v.size(), x);
+
+            return ec==::std::errc{} && end==v.data()+v.size() && ::std::to_string(x)==v;
+        }
+
+
+struct
+    Reader
+        {
+            char const    * p;
+            char const    * end;
+
+            ::std::size_t
+                remaining() const
+                    {
+                        return ::std::size_t(end-p);
+                    }
+
+            ::std::uint8_t
+                u8()
+                    {
+                        if (p>=end)
+                            throw_malformed();
+
+                        return ::std::uint8_t(*p++);
+                    }
+
+            ::std::uint64_t
+                le(
+                        int size
+                    )
+                    {
+                        ::std::uint64_t v = 0;
+
+                        for (auto i=0; i<size; ++i)
+                            v |= ::std::uint64_t(u8()) << (8*i);
+
+                        return v;
+                    }
+
+            ::std::uint64_t
+                varint()
+                    {
+                        ::std::uint64_t v = 0;
+
+                        for (auto shift=0; shift<64; shift+=7)
+                        {
+                            auto b = u8();
+
+                            v |= ::std::uint64_t(b & 0x7f) << shift;
+
+                            if (!(b & 0x80))
+                                return v;
+                        }
+
+                        throw_malformed();
+                    }
+
+            ::std::string_view
+                bytes(
+                        ::std::size_t n
+                    )
+                    {
+                        if (n>remaining())
+                            throw_malformed();
+
+                        auto s = ::std::string_view{p, n};
+                        p += n;
+                        return s;
+                    }
+
+            ::std::string_view
+                bytes()
+                    {
+                        return bytes(varint());
+                    }
+
+            ::uuids::uuid
+                uuid()
+                    {
+                        auto
+                            s = bytes(16);
+
+                        ::std::uint8_t
+                            b[16];
+
+                        ::std::memcpy(b, s.data(), 16);
+
+                        return ::uuids::uuid{b};
+                    }
+        };
+
+
+/// the values of a column that has one entry per value, without the rows
+::std::vector<::std::string>
+    dictionary_read(
+            Reader & r
+        )
+        {
+            auto
+                count = r.varint();
+
+            // each value takes at least a byte
+            if (count>r.remaining())
+                throw_malformed();
+
+            ::std::vector<::std::string>
+                values(count);
+
+            for (auto & v : values)
+                v = r.bytes();
+
+            return values;
+        }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct
+    LogArchiveWriter::State
+        {
+            struct Dictionary
+            {
+                ::std::unordered_map<::std::string, ::std::uint32_t>
+                    index;
+
+                ::std::vector<::std::string>
+                    values;
+
+                // 0 or 1 + index into values, per row
+                ::std::vector<::std::uint32_t>
+                    rows;
+            };
+
+            struct Values
+            {
+                ::std::vector<::std::uint64_t>
+                    rows;
+
+                ::std::vector<::std::string>
+                    values;
+            };
+
+            ::fs::path
+                path;
+
+            ::std::ofstream
+                file;
+
+            ::std::uint64_t
+                chunk_rows {};
+
+            // bytes written to the file
+            ::std::uint64_t
+                offset {};
+
+            // rows of the chunks written
+            ::std::uint64_t
+                rows_written {};
+
+            // the directory entries of the chunks written
+            ::std::string
+                directory;
+
+            ::std::uint64_t
+                chunk_count {};
+
+            // the rows of the chunk being collected
+            ::std::uint64_t
+                rows {};
+
+            // fixed width columns, encoded while adding
+            ::std::string time;
+            ::std::string level;
+            ::std::string status;
+            ::std::string id;
+            ::std::string creator;
+            ::std::string session;
+
+            ::std::map<::std::string, Dictionary, ::std::less<>>
+                properties;
+
+            ::std::map<::std::string, Values, ::std::less<>>
+                attributes;
+
+
+            void
+                file_write(
+                        ::std::string_view const & data
+                    )
+                    {
+                        file.write(data.data(), ::std::streamsize(data.size()));
+
+                        if (!file)
+                            "eb7d5829-89c3-46e0-91dc-ea3caa6a2f8f"_log("failed to write ${path}")
+                                .path(path)
+                                .throw_error();
+
+                        offset += data.size();
+                    }
+
+
+            /// write the columns of the rows collected and start the next chunk
+            void
+                chunk_flush()
+                    {
+                        if (!rows)
+                            return;
+
+                        ::std::string
+                            columns;
+
+                        ::std::uint64_t
+                            column_count {};
+
+                        auto
+                            column = [&](::std::string_view name, ::std::string_view data)
+                                {
+                                    put_bytes(columns, name);
+                                    put_u64(columns, offset);
+                                    put_u64(columns, data.size());
+
+                                    file_write(data);
+                                    ++column_count;
+                                };
+
+                        column("_time"      , time);
+                        column("_level"     , level);
+                        column("_status"    , status);
+                        column("_id"        , id);
+                        column("_id_creator", creator);
+                        column("_id_session", session);
+
+                        ::std::string
+                            data;
+
+                        for (auto & [key, d] : properties)
+                        {
+                            data.clear();
+
+                            put_varint(data, d.values.size());
+
+                            for (auto & v : d.values)
+                                put_bytes(data, v);
+
+                            for (auto row=0_sz; row<rows; ++row)
+                                put_u32(data, row<d.rows.size() ? d.rows[row] : 0);
+
+                            column("p:" + key, data);
+                        }
+
+                        data.clear();
+
+                        put_varint(data, attributes.size());
+
+                        for (auto & [key, a] : attributes)
+                            put_bytes(data, key);
+
+                        column("keys", data);
+
+                        auto
+                            index = 0;
+
+                        for (auto & [key, a] : attributes)
+                        {
+                            data.clear();
+
+                            put_varint(data, a.rows.size());
+
+                            ::std::uint64_t
+                                previous_row {};
+
+                            for (auto row : a.rows)
+                            {
+                                put_varint(data, row-previous_row);
+                                previous_row = row;
+                            }
+
+                            ::std::vector<::std::int64_t>
+                                integers(a.values.size());
+
+                            auto
+                                are_integers = true;
+
+                            for (auto i=0_sz; i<a.values.size() && are_integers; ++i)
+                                are_integers = is_integer(a.values[i], integers[i]);
+
+                            if (are_integers)
+                            {
+                                // counters and ids tend to grow slowly
+                                put_u8(data, c_encoding_integers);
+
+                                ::std::uint64_t
+                                    previous {};
+
+                                for (auto x : integers)
+                                {
+                                    put_varint(data, zigzag(::std::int64_t(::std::uint64_t(x) - previous)));
+                                    previous = ::std::uint64_t(x);
+                                }
+                            }
+                            else
+                            {
+                                put_u8(data, c_encoding_strings);
+
+                                for (auto i=0_sz; i<a.values.size();)
+                                {
+                                    auto
+                                        run = 1_sz;
+
+                                    while (i+run<a.values.size() && a.values[i+run]==a.values[i])
+                                        ++run;
+
+                                    put_varint(data, run);
+                                    put_bytes(data, a.values[i]);
+
+                                    i += run;
+                                }
+                            }
+
+                            column("a:" + ::std::to_string(index++), data);
+                        }
+
+                        file.flush();
+
+                        if (!file)
+                            "422f60b9-d59f-4a38-9001-a328ca7aab69"_log("failed to write ${path}")
+                                .path(path)
+                                .throw_error();
+
+                        put_varint(directory, rows);
+                        put_varint(directory, column_count);
+                        directory += columns;
+
+                        ++chunk_count;
+                        rows_written += rows;
+
+                        rows = 0;
+
+                        time.clear();
+                        level.clear();
+                        status.clear();
+                        id.clear();
+                        creator.clear();
+                        session.clear();
+                        properties.clear();
+                        attributes.clear();
+                    }
+        };
+
+
+LogArchiveWriter::~LogArchiveWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (Error &)
+    {
+        // already logged
+    }
+}
+
+
+LogArchiveWriter::LogArchiveWriter()
+:   m_state {::std::make_unique<State>()}
+{
+}
+
+
+R_CMOV_IMPL(LogArchiveWriter) = default;
+
+
+LogArchiveWriter &
+LogArchiveWriter::operator=(
+    LogArchiveWriter && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        m_state = ::std::move(src.m_state);
+    }
+
+    return *this;
+}
+
+
+void
+LogArchiveWriter::open(
+    ::fs::path const & path
+,   ::std::size_t      chunk_rows
+)
+{
+    close();
+
+    auto &
+        s = *m_state;
+
+    s = {};
+
+    s.path       = path;
+    s.chunk_rows = ::std::max(chunk_rows, 1_sz);
+
+    s.file.open(path, ::std::ios::out | ::std::ios::binary | ::std::ios::trunc);
+
+    if (!s.file.is_open())
+        "b7ff4bbd-e43f-4991-8003-8d4a83738553"_log("failed to create ${path}")
+            .path(path)
+            .throw_error();
+
+    s.file_write(c_magic);
+}
+
+
+bool
+LogArchiveWriter::is_open() const
+{
+    return m_state && m_state->file.is_open();
+}
+
+
+void
+LogArchiveWriter::add(
+    Log const & log
+)
+{
+    if (DBC_FAIL(is_open()))
+        return;
+
+    auto &
+        s = *m_state;
+
+    auto
+        row = s.rows++;
+
+    put_u64(s.time, ::std::uint64_t(::std::chrono::duration_cast<::std::chrono::microseconds>(log.time().time_since_epoch()).count()));
+    put_u8(s.level, ::std::uint8_t(log.level()));
+    put_u8(s.status, ::std::uint8_t(log.status()));
+    put_uuid(s.id, log.id());
+    put_uuid(s.creator, log.creator());
+    put_uuid(s.session, log.session());
+
+    for (auto key : c_dictionary_keys)
+    {
+        auto
+            value = log.property(key);
+
+        if (!value)
+            continue;
+
+        auto
+            it = s.properties.find(key);
+
+        if (it==s.properties.end())
+            it = s.properties.emplace(::std::string{key}, State::Dictionary{}).first;
+
+        auto &
+            d = it->second;
+
+        auto
+            [index, is_new] = d.index.try_emplace(*value, ::std::uint32_t(d.values.size()+1));
+
+        if (is_new)
+            d.values.push_back(*value);
+
+        d.rows.resize(row, 0);
+        d.rows.push_back(index->second);
+    }
+
+    for (auto & [key, value] : log.attributes())
+    {
+        auto &
+            a = s.attributes[key];
+
+        a.rows.push_back(row);
+        a.values.push_back(value);
+    }
+
+    if (s.rows>=s.chunk_rows)
+        s.chunk_flush();
+}
+
+
+::std::uint64_t
+LogArchiveWriter::size() const
+{
+    return m_state ? m_state->rows_written + m_state->rows : 0;
+}
+
+
+void
+LogArchiveWriter::close()
+{
+    if (!is_open())
+        return;
+
+    auto &
+        s = *m_state;
+
+    // closed also if writing fails, the archive is incomplete then
+    on_delete
+        closing {[&s](){if (s.file.is_open()) s.file.close();}};
+
+    s.chunk_flush();
+
+    ::std::string
+        out;
+
+    auto
+        directory_offset = s.offset;
+
+    put_varint(out, s.chunk_count);
+    out += s.directory;
+
+    put_u64(out, s.rows_written);
+    put_u64(out, directory_offset);
+    out += c_magic;
+
+    s.file_write(out);
+
+    s.file.close();
+
+    if (!s.file)
+        "e7ad13bd-5c76-40dd-bd1d-46887e1a3c80"_log("failed to write ${path}")
+            .path(s.path)
+            .throw_error();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct
+    LogArchive::State
+        {
+            ::fs::path
+                path;
+
+            ::std::uint64_t
+                rows {};
+
+            struct Extent
+            {
+                ::std::uint64_t
+                    offset {};
+
+                ::std::uint64_t
+                    size {};
+            };
+
+            struct Chunk
+            {
+                ::std::uint64_t
+                    rows {};
+
+                ::std::map<::std::string, Extent, ::std::less<>>
+                    columns;
+            };
+
+            ::std::vector<Chunk>
+                chunks;
+
+
+            /// the bytes of a column of a chunk, EMPTY if there is no such column
+            ::std::optional<::std::string>
+                column(
+                        Chunk       const & chunk
+                    ,   ::std::string_view  name
+                    ) const
+                    {
+                        auto
+                            it = chunk.columns.find(name);
+
+                        if (it==chunk.columns.end())
+                            return {};
+
+                        ::std::ifstream
+                            stream {path, ::std::ios::in | ::std::ios::binary};
+
+                        ::std::string
+                            data(it->second.size, '\0');
+
+                        stream.seekg(::std::streamoff(it->second.offset));
+
+                        if (!stream.read(data.data(), ::std::streamsize(data.size())))
+                            "c71f2e09-4d8a-4b35-96e3-0a5d8f1b7c24"_log("failed to read ${path}")
+                                .path(path)
+                                .throw_error();
+
+                        return data;
+                    }
+
+
+            /// a fixed width column with the expected size
+            ::std::optional<::std::string>
+                column(
+                        Chunk       const & chunk
+                    ,   ::std::string_view  name
+                    ,   ::std::size_t       width
+                    ) const
+                    {
+                        auto
+                            data = column(chunk, name);
+
+                        if (data && data->size()!=chunk.rows*width)
+                            throw_malformed();
+
+                        return data;
+                    }
+
+
+            /// call the visitor with each chunk and the index of its first row
+            template<typename Visitor>
+            void
+                chunks_visit(
+                        Visitor const & visit
+                    ) const
+                    {
+                        auto
+                            row = 0_sz;
+
+                        for (auto & chunk : chunks)
+                        {
+                            visit(chunk, row);
+                            row += chunk.rows;
+                        }
+                    }
+
+
+            ::std::vector<::uuids::uuid>
+                uuids(
+                        ::std::string_view name
+                    ) const
+                    {
+                        ::std::vector<::uuids::uuid>
+                            v(rows);
+
+                        chunks_visit([&](Chunk const & chunk, ::std::size_t first)
+                            {
+                                auto
+                                    data = column(chunk, name, 16);
+
+                                if (!data)
+                                    return;
+
+                                auto
+                                    r = Reader{data->data(), data->data()+data->size()};
+
+                                for (auto row=0_sz; row<chunk.rows; ++row)
+                                    v[first+row] = r.uuid();
+                            });
+
+                        return v;
+                    }
+
+
+            ::std::vector<::std::string>
+                attribute_keys(
+                        Chunk const & chunk
+                    ) const
+                    {
+                        auto
+                            data = column(chunk, "keys");
+
+                        if (!data)
+                            return {};
+
+                        auto
+                            r = Reader{data->data(), data->data()+data->size()};
+
+                        return dictionary_read(r);
+                    }
+
+
+            /// decode an attribute column of a chunk into the rows of the chunk in v
+            void
+                attribute(
+                        Chunk                                       const & chunk
+                    ,   ::std::string_view                                  name
+                    ,   ::std::optional<::std::string>                    * v
+                    ) const
+                    {
+                        auto
+                            data = column(chunk, name);
+
+                        if (!data)
+                            return;
+
+                        auto
+                            r = Reader{data->data(), data->data()+data->size()};
+
+                        auto
+                            count = r.varint();
+
+                        if (count>chunk.rows)
+                            throw_malformed();
+
+                        ::std::vector<::std::uint64_t>
+                            rows_of_values(count);
+
+                        ::std::uint64_t
+                            row {};
+
+                        for (auto & x : rows_of_values)
+                        {
+                            row += r.varint();
+
+                            if (row>=chunk.rows)
+                                throw_malformed();
+
+                            x = row;
+                        }
+
+                        auto
+                            encoding = r.u8();
+
+                        if (encoding==c_encoding_integers)
+                        {
+                            ::std::uint64_t
+                                previous {};
+
+                            for (auto x : rows_of_values)
+                            {
+                                previous += ::std::uint64_t(unzigzag(r.varint()));
+                                v[x] = ::std::to_string(::std::int64_t(previous));
+                            }
+                        }
+                        else if (encoding==c_encoding_strings)
+                        {
+                            for (auto i=0_sz; i<rows_of_values.size();)
+                            {
+                                auto
+                                    run = r.varint();
+
+                                auto
+                                    value = r.bytes();
+
+                                if (run==0 || run>rows_of_values.size()-i)
+                                    throw_malformed();
+
+                                for (; run; --run)
+                                    v[rows_of_values[i++]] = ::std::string{value};
+                            }
+                        }
+                        else
+                        {
+                            throw_malformed();
+                        }
+                    }
+        };
+
+
+R_DTOR_IMPL(LogArchive) = default;
+R_CMOV_IMPL(LogArchive) = default;
+R_MOVE_IMPL(LogArchive) = default;
+
+
+LogArchive::LogArchive(
+    ::fs::path const & path
+)
+:   m_state {::std::make_unique<State>()}
+{
+    m_state->path = path;
+
+    ::std::ifstream
+        stream {path, ::std::ios::in | ::std::ios::binary | ::std::ios::ate};
+
+    if (!stream.is_open())
+        "2d94b7e1-6f03-4c5a-b8e2-7a1c9d0f3e65"_log("failed to open ${path}")
+            .path(path)
+            .throw_error();
+
+    auto
+        file_size = ::std::uint64_t(stream.tellg());
+
+    if (file_size < c_magic.size() + c_footer_size)
+        throw_malformed();
+
+    ::std::string
+        footer(c_footer_size, '\0');
+
+    stream.seekg(::std::streamoff(file_size - c_footer_size));
+    stream.read(footer.data(), ::std::streamsize(footer.size()));
+
+    auto
+        r = Reader{footer.data(), footer.data()+footer.size()};
+
+    m_state->rows = r.le(8);
+
+    auto
+        directory_offset = r.le(8);
+
+    if (r.bytes(c_magic.size())!=c_magic || directory_offset<c_magic.size() || directory_offset>file_size-c_footer_size)
+        throw_malformed();
+
+    ::std::string
+        directory(file_size - c_footer_size - directory_offset, '\0');
+
+    stream.seekg(::std::streamoff(directory_offset));
+
+    if (!stream.read(directory.data(), ::std::streamsize(directory.size())))
+        throw_malformed();
+
+    r = Reader{directory.data(), directory.data()+directory.size()};
+
+    ::std::uint64_t
+        rows {};
+
+    for (auto chunks = r.varint(); chunks; --chunks)
+    {
+        State::Chunk
+            chunk;
+            chunk.rows = r.varint();
+
+        for (auto n = r.varint(); n; --n)
+        {
+            auto
+                name = ::std::string{r.bytes()};
+
+            State::Extent
+                e;
+                e.offset = r.le(8);
+                e.size   = r.le(8);
+
+            if (e.offset>directory_offset || e.size>directory_offset-e.offset)
+                throw_malformed();
+
+            chunk.columns.emplace(::std::move(name), e);
+        }
+
+        rows += chunk.rows;
+
+        if (rows<chunk.rows)
+            throw_malformed();
+
+        m_state->chunks.push_back(::std::move(chunk));
+    }
+
+    if (rows!=m_state->rows)
+        throw_malformed();
+}
+
+
+::std::uint64_t
+LogArchive::size() const
+{
+    return m_state->rows;
+}
+
+
+::std::vector<::nsBase::time::time_point_t>
+LogArchive::times() const
+{
+    auto &
+        s = *m_state;
+
+    ::std::vector<::nsBase::time::time_point_t>
+        v(s.rows);
+
+    s.chunks_visit([&](State::Chunk const & chunk, ::std::size_t first)
+        {
+            auto
+                data = s.column(chunk, "_time", 8);
+
+            if (!data)
+                return;
+
+            auto
+                r = Reader{data->data(), data->data()+data->size()};
+
+            for (auto row=0_sz; row<chunk.rows; ++row)
+                v[first+row] = ::nsBase::time::time_point_t{::std::chrono::microseconds{::std::int64_t(r.le(8))}};
+        });
+
+    return v;
+}
+
+
+::std::vector<Log::Level>
+LogArchive::levels() const
+{
+    auto &
+        s = *m_state;
+
+    ::std::vector<Log::Level>
+        v(s.rows, Log::Level::DEBUG);
+
+    s.chunks_visit([&](State::Chunk const & chunk, ::std::size_t first)
+        {
+            if (auto data = s.column(chunk, "_level", 1))
+                for (auto row=0_sz; row<chunk.rows; ++row)
+                    v[first+row] = Log::Level((*data)[row]);
+        });
+
+    return v;
+}
+
+
+::std::vector<Log::Status>
+LogArchive::statuses() const
+{
+    auto &
+        s = *m_state;
+
+    ::std::vector<Log::Status>
+        v(s.rows, Log::Status::OK);
+
+    s.chunks_visit([&](State::Chunk const & chunk, ::std::size_t first)
+        {
+            if (auto data = s.column(chunk, "_status", 1))
+                for (auto row=0_sz; row<chunk.rows; ++row)
+                    v[first+row] = Log::Status((*data)[row]);
+        });
+
+    return v;
+}
+
+
+::std::vector<::uuids::uuid>
+LogArchive::ids() const
+{
+    return m_state->uuids("_id");
+}
+
+
+::std::vector<::uuids::uuid>
+LogArchive::creators() const
+{
+    return m_state->uuids("_id_creator");
+}
+
+
+::std::vector<::uuids::uuid>
+LogArchive::sessions() const
+{
+    return m_state->uuids("_id_session");
+}
+
+
+::std::vector<::std::optional<::std::string>>
+LogArchive::property(
+    ::std::string const & key
+) const
+{
+    auto &
+        s = *m_state;
+
+    ::std::vector<::std::optional<::std::string>>
+        v(s.rows);
+
+    s.chunks_visit([&](State::Chunk const & chunk, ::std::size_t first)
+        {
+            auto
+                data = s.column(chunk, "p:" + key);
+
+            if (!data)
+                return;
+
+            auto
+                r = Reader{data->data(), data->data()+data->size()};
+
+            auto
+                dictionary = dictionary_read(r);
+
+            if (r.remaining()!=chunk.rows*4)
+                throw_malformed();
+
+            for (auto row=0_sz; row<chunk.rows; ++row)
+            {
+                auto
+                    index = r.le(4);
+
+                if (index>dictionary.size())
+                    throw_malformed();
+
+                if (index)
+                    v[first+row] = dictionary[index-1];
+            }
+        });
+
+    return v;
+}
+
+
+::std::vector<::std::string>
+LogArchive::attribute_keys() const
+{
+    auto &
+        s = *m_state;
+
+    // each chunk has its own keys, in the order of their first occurrence
+    ::std::vector<::std::string>
+        keys;
+
+    for (auto & chunk : s.chunks)
+        for (auto & key : s.attribute_keys(chunk))
+            if (::std::find(keys.begin(), keys.end(), key)==keys.end())
+                keys.push_back(::std::move(key));
+
+    return keys;
+}
+
+
+::std::vector<::std::optional<::std::string>>
+LogArchive::attribute(
+    ::std::string const & key
+) const
+{
+    auto &
+        s = *m_state;
+
+    ::std::vector<::std::optional<::std::string>>
+        v(s.rows);
+
+    s.chunks_visit([&](State::Chunk const & chunk, ::std::size_t first)
+        {
+            auto
+                keys = s.attribute_keys(chunk);
+
+            auto
+                it = ::std::find(keys.begin(), keys.end(), key);
+
+            if (it!=keys.end())
+                s.attribute(chunk, "a:" + ::std::to_string(it-keys.begin()), v.data()+first);
+        });
+
+    return v;
+}
+
+
+::std::vector<Log>
+LogArchive::logs() const
+{
+    auto &
+        s = *m_state;
+
+    ::std::vector<Log>
+        logs(s.rows);
+
+    {
+        auto times    = this->times();
+        auto levels   = this->levels();
+        auto statuses = this->statuses();
+        auto ids      = this->ids();
+        auto creators = this->creators();
+        auto sessions = this->sessions();
+
+        for (auto row=0_sz; row<s.rows; ++row)
+        {
+            logs[row]
+                .time(times[row])
+                .level(levels[row])
+                .status(statuses[row])
+                .id(ids[row])
+                .creator(creators[row])
+                .session(sessions[row])
+                ;
+        }
+    }
+
+    for (auto key : c_dictionary_keys)
+    {
+        auto
+            values = property(::std::string{key});
+
+        for (auto row=0_sz; row<s.rows; ++row)
+            if (values[row])
+                logs[row].property(key, *values[row]);
+    }
+
+    ::std::vector<::std::optional<::std::string>>
+        values;
+
+    s.chunks_visit([&](State::Chunk const & chunk, ::std::size_t first)
+        {
+            auto
+                keys = s.attribute_keys(chunk);
+
+            for (auto i=0_sz; i<keys.size(); ++i)
+            {
+                values.assign(chunk.rows, {});
+
+                s.attribute(chunk, "a:" + ::std::to_string(i), values.data());
+
+                for (auto row=0_sz; row<chunk.rows; ++row)
+                    if (values[row])
+                        logs[first+row](keys[i], *values[row]);
+            }
+        });
+
+    return logs;
+}
+
+
+::std::uint64_t
+log_archive_convert(
+    ::std::vector<::fs::path> const & log_paths
+,   ::fs::path                const & archive_path
+)
+{
+    LogArchiveWriter
+        writer;
+
+    writer.open(archive_path);
+
+    for (auto & path : log_paths)
+        for (auto & log : log_stream(path))
+            writer.add(log);
+
+    writer.close();
+
+    return writer.size();
+}
+
+}
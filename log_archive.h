@@ -0,0 +1,194 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/filesystem.h"
+#include "r_base/Log.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    Collects Logs and writes them as a columnar archive segment.
+
+    The archive is meant for long-term retention and analytics: a reader
+    loads only the columns it needs (see LogArchive). All integers are
+    stored little endian.
+
+    The Logs are collected in chunks of rows. Once a chunk is full its
+    columns are written and the memory is reused for the next chunk, so the
+    memory needed does not depend on the size of the archive.
+
+        "RLARC002"
+        column data     : the columns of each chunk
+        directory       : varint chunk count
+                          {   varint row count
+                              varint column count
+                              { varint name size, name, u64 offset, u64 size }
+                          }
+        footer          : u64 row count, u64 directory offset, "RLARC002"
+
+    Columns of a chunk, rows count from the beginning of the chunk
+        "_time"         : i64 per row, micro seconds since the epoch
+        "_level"        : u8 per row
+        "_status"       : u8 per row
+        "_id"
+        "_id_creator"
+        "_id_session"   : 16 bytes per row
+        "p:<property>"  : the other properties (e.g. scope, message, _host),
+                          dictionary encoded:
+                          varint count, { varint size, bytes },
+                          u32 per row, 0 if absent, otherwise 1 + dictionary index
+        "keys"          : the dictionary of the attribute keys:
+                          varint count, { varint size, bytes }
+        "a:<index>"     : the values of an attribute key:
+                          varint count, varint row delta per value,
+                          u8 encoding, then
+                            0 (integers) : zigzag varint delta per value
+                            1 (strings)  : { varint run length, varint size, bytes }
+
+    Rows keep the order in which the Logs were added.
+*/
+class LogArchiveWriter
+{
+    R_DTOR(LogArchiveWriter);
+    R_CTOR(LogArchiveWriter);
+    R_CCPY(LogArchiveWriter) = delete;
+    R_CMOV(LogArchiveWriter);
+    R_COPY(LogArchiveWriter) = delete;
+    R_MOVE(LogArchiveWriter);
+
+    /** Create the archive file.
+        \param chunk_rows Count of the Logs collected before their columns
+            are written.
+        \throws if the file cannot be created.
+    */
+    public : void
+        open(
+                ::fs::path const & path
+            ,   ::std::size_t      chunk_rows = 64_sz<<10
+            );
+
+    public : bool
+        is_open() const;
+
+    /** \throws if the columns of a full chunk cannot be written.
+    */
+    public : void
+        add(
+                Log const &
+            );
+
+    /** Count of the Logs added.
+    */
+    public : ::std::uint64_t
+        size() const;
+
+    /** Write the last chunk and the directory.
+        The destructor closes as well, but can't report a failure.
+        \throws if the file cannot be written.
+    */
+    public : void
+        close();
+
+    private : struct
+        State;
+
+    private : ::std::unique_ptr<State>
+        m_state;
+};
+
+
+/**
+    Reads a columnar archive written by LogArchiveWriter.
+
+    Opening reads the directory only. Each column accessor reads the bytes of
+    its column, chunk by chunk, and nothing else.
+*/
+class LogArchive
+{
+    R_DTOR(LogArchive);
+    R_CTOR(LogArchive) = delete;
+    R_CCPY(LogArchive) = delete;
+    R_CMOV(LogArchive);
+    R_COPY(LogArchive) = delete;
+    R_MOVE(LogArchive);
+
+    /** \throws if the file is not an archive.
+    */
+    public : explicit
+        LogArchive(
+                ::fs::path const & path
+            );
+
+    /** Count of the Logs.
+    */
+    public : ::std::uint64_t
+        size() const;
+
+    public : ::std::vector<::nsBase::time::time_point_t>
+        times() const;
+
+    public : ::std::vector<Log::Level>
+        levels() const;
+
+    public : ::std::vector<Log::Status>
+        statuses() const;
+
+    public : ::std::vector<::uuids::uuid>
+        ids() const;
+
+    public : ::std::vector<::uuids::uuid>
+        creators() const;
+
+    public : ::std::vector<::uuids::uuid>
+        sessions() const;
+
+    /** The values of a dictionary encoded property, e.g. "message" or "_host".
+    */
+    public : ::std::vector<::std::optional<::std::string>>
+        property(
+                ::std::string const & key
+            ) const;
+
+    public : ::std::vector<::std::string>
+        attribute_keys() const;
+
+    /** The values of an attribute, EMPTY for the Logs that don't have it.
+    */
+    public : ::std::vector<::std::optional<::std::string>>
+        attribute(
+                ::std::string const & key
+            ) const;
+
+    /** Reconstruct the Logs, in the order they were added.
+    */
+    public : ::std::vector<Log>
+        logs() const;
+
+    private : struct
+        State;
+
+    private : ::std::unique_ptr<State>
+        m_state;
+};
+
+
+/** Convert log files (including their rotated segments, see log_stream())
+    into an archive.
+    \return The count of Logs written.
+*/
+::std::uint64_t
+    log_archive_convert(
+            ::std::vector<::fs::path> const & log_paths
+        ,   ::fs::path                const & archive_path
+        );
+
+}
@@ -0,0 +1,294 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_binary.h"
+#include "r_base/language_tools.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+
+namespace nsBase
+{
+
+namespace
+{
+constexpr ::std::uint8_t
+    c_version = 1;
+
+// u32 size
+constexpr ::std::size_t
+    c_prefix_size = 4;
+
+// a frame larger than this is considered corrupt
+constexpr ::std::size_t
+    c_frame_size_max = 64_sz<<20;
+
+// the properties without a fixed field
+constexpr ::std::array<::std::string_view,10>
+    c_property_keys
+        {
+            "_id_application"
+        ,   "_id_application_instance"
+        ,   "_version"
+        ,   "_id_event"
+        ,   "_host"
+        ,   "_user"
+        ,   "_thread"
+        ,   "_trace"
+        ,   "scope"
+        ,   "message"
+        };
+
+
+[[noreturn]] void
+    throw_malformed()
+        {
+            "b2f61c8e-4a07-4d93-9e5b-7c1d0a8f3e26"_log("malformed binary Log").throw_DATA_LOSS();
+        }
+
+
+void
+    put_le(
+            ::std::string & out
+        ,   ::std::uint64_t v
+        ,   int             size
+        )
+        {
+            for (auto i=0; i<size; ++i)
+                out += char(v >> (8*i));
+        }
+
+void
+    put_varint(
+            ::std::string & out
+        ,   ::std::uint64_t v
+        )
+        {
+            while (v>=0x80)
+            {
+                out += char(0x80 | (v & 0x7f));
+                v >>= 7;
+            }
+
+            out += char(v);
+        }
+
+void
+    put_bytes(
+            ::std::string            & out
+        ,   ::std::string_view const & v
+        )
+        {
+            put_varint(out, v.size());
+            out += v;
+        }
+
+void
+    put_uuid(
+            ::std::string       & out
+        ,   ::uuids::uuid const & u
+        )
+        {
+            auto
+                bytes = u.as_bytes();
+
+            out.append(reinterpret_cast<char const*>(bytes.data()), 16);
+        }
+
+
+struct
+    Reader
+        {
+            char const    * p;
+            char const    * end;
+
+            ::std::uint8_t
+                u8()
+                    {
+                        if (p>=end)
+                            throw_malformed();
+
+                        return ::std::uint8_t(*p++);
+                    }
+
+            ::std::uint64_t
+                le(
+                        int size
+                    )
+                    {
+                        ::std::uint64_t v = 0;
+
+                        for (auto i=0; i<size; ++i)
+                            v |= ::std::uint64_t(u8()) << (8*i);
+
+                        return v;
+                    }
+
+            ::std::uint64_t
+                varint()
+                    {
+                        ::std::uint64_t v = 0;
+
+                        for (auto shift=0; shift<64; shift+=7)
+                        {
+                            auto b = u8();
+
+                            v |= ::std::uint64_t(b & 0x7f) << shift;
+
+                            if (!(b & 0x80))
+                                return v;
+                        }
+
+                        throw_malformed();
+                    }
+
+            ::std::string_view
+                bytes()
+                    {
+                        auto n = varint();
+
+                        if (n>::std::size_t(end-p))
+                            throw_malformed();
+
+                        auto s = ::std::string_view{p, ::std::size_t(n)};
+                        p += n;
+                        return s;
+                    }
+
+            ::uuids::uuid
+                uuid()
+                    {
+                        if (end-p<16)
+                            throw_malformed();
+
+                        ::std::uint8_t
+                            b[16];
+
+                        ::std::memcpy(b, p, 16);
+                        p += 16;
+
+                        return ::uuids::uuid{b};
+                    }
+        };
+}
+
+
+void
+log_binary_encode(
+    Log           const & log
+,   ::std::string       & out
+)
+{
+    auto
+        begin = out.size();
+
+    put_le(out, 0, c_prefix_size); // patched below
+    put_le(out, c_version, 1);
+    put_le(out, ::std::uint64_t(::std::chrono::duration_cast<::std::chrono::microseconds>(log.time().time_since_epoch()).count()), 8);
+    put_le(out, ::std::uint64_t(log.level()), 1);
+    put_le(out, ::std::uint64_t(log.status()), 1);
+    put_uuid(out, log.id());
+    put_uuid(out, log.creator());
+    put_uuid(out, log.session());
+
+    ::std::uint64_t
+        count {};
+
+    ::std::string
+        properties;
+
+    for (auto key : c_property_keys)
+    {
+        if (auto value = log.property(key))
+        {
+            put_bytes(properties, key);
+            put_bytes(properties, *value);
+            ++count;
+        }
+    }
+
+    put_varint(out, count);
+    out += properties;
+
+    put_varint(out, log.attribute_count());
+
+    if (log.attribute_count())
+    {
+        for (auto & [key, value] : log.attributes())
+        {
+            put_bytes(out, key);
+            put_bytes(out, value);
+        }
+    }
+
+    auto
+        size = out.size() - begin - c_prefix_size;
+
+    for (auto i=0_sz; i<c_prefix_size; ++i)
+        out[begin+i] = char(size >> (8*i));
+}
+
+
+::std::optional<Log>
+log_binary_decode(
+    ::std::string_view & data
+)
+{
+    if (data.size()<c_prefix_size)
+        return {};
+
+    auto
+        size = Reader{data.data(), data.data()+c_prefix_size}.le(c_prefix_size);
+
+    if (size>c_frame_size_max)
+        throw_malformed();
+
+    if (data.size()-c_prefix_size < size)
+        return {};
+
+    auto
+        r = Reader{data.data()+c_prefix_size, data.data()+c_prefix_size+size};
+
+    if (r.u8()!=c_version)
+        throw_malformed();
+
+    ::std::optional<Log>
+        log;
+
+    log.emplace();
+
+    log->time(::nsBase::time::time_point_t{::std::chrono::microseconds{::std::int64_t(r.le(8))}});
+    log->level(Log::Level(r.u8()));
+    log->status(Log::Status(r.u8()));
+    log->id(r.uuid());
+    log->creator(r.uuid());
+    log->session(r.uuid());
+
+    for (auto n = r.varint(); n; --n)
+    {
+        auto key   = r.bytes();
+        auto value = r.bytes();
+
+        if (key.empty() || !(key[0]=='_' || key=="scope" || key=="message"))
+            throw_malformed();
+
+        log->property(key, value);
+    }
+
+    for (auto n = r.varint(); n; --n)
+    {
+        auto key   = r.bytes();
+        auto value = r.bytes();
+
+        (*log)(key, value);
+    }
+
+    if (r.p!=r.end)
+        throw_malformed();
+
+    data.remove_prefix(c_prefix_size + size);
+
+    return log;
+}
+
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/Log.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+
+namespace nsBase
+{
+
+/**
+    A compact binary encoding of Logs, e.g. for transport or merged output.
+
+    Each Log is a self-delimiting frame (integers little endian):
+
+        u32     size of the rest of the frame
+        u8      version (1)
+        i64     time, micro seconds since the epoch
+        u8      level
+        u8      status
+        16      id
+        16      creator
+        16      session
+        varint  count of the other properties   { varint size, key, varint size, value }
+        varint  count of the attributes         { varint size, key, varint size, value }
+
+    Unlike the JSON lines, times keep their microseconds.
+*/
+
+
+/** Append the frame of a Log to the target.
+*/
+void
+    log_binary_encode(
+            Log           const & log
+        ,   ::std::string       & target
+        );
+
+/** Decode the first frame of the data and remove it from the data.
+    \return EMPTY if the data doesn't hold a complete frame (yet).
+    \throws if the frame is malformed.
+*/
+::std::optional<Log>
+    log_binary_decode(
+            ::std::string_view & data
+        );
+
+}
@@ -1,10 +1,17 @@
 ﻿#include "r_base/log_consumer_console.h"
 
 #include "r_base/time.h"
+#include "r_base/log_metrics.h"
 
 #include <fmt/format.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
+#include <string_view>
+#include <thread>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -92,6 +99,137 @@ Initializer
     }
 };
 
+
+// the level column, padded to a common width
+// the 'debug' level is printed as empty string to make it easier to percept the other levels in the output
+constexpr ::std::array<::std::string_view,5>
+    c_level_columns
+        {
+            "         : "
+        ,   " info    : "
+        ,   " warning : "
+        ,   " error   : "
+        ,   " critical: "
+        };
+
+
+/// renders the time, the calendar part is formatted once per second
+class
+TimeRenderer
+{
+    private : ::std::int64_t
+        m_second {-1};
+
+    private : bool
+        m_as_utc {};
+
+    private : bool
+        m_with_date {};
+
+    private : ::std::string
+        m_prefix;
+
+    public : void
+        append(
+                ::std::string                         & target
+            ,   ::std::chrono::system_clock::time_point tp
+            ,   bool                                    as_utc
+            ,   bool                                    with_date
+            )
+            {
+                auto
+                    micros = ::std::chrono::duration_cast<::std::chrono::microseconds>(tp.time_since_epoch()).count();
+
+                auto
+                    second = micros / 1'000'000;
+
+                // to_string() clamps times before the epoch
+                if (micros<0)
+                    second = micros = 0;
+
+                if (second!=m_second || as_utc!=m_as_utc || with_date!=m_with_date)
+                {
+                    m_second    = second;
+                    m_as_utc    = as_utc;
+                    m_with_date = with_date;
+                    m_prefix    = to_string(
+                            ::std::chrono::system_clock::time_point{::std::chrono::seconds{second}}
+                        ,   as_utc
+                        ,   false // with_millis
+                        ,   with_date ? (as_utc ? "%Y-%m-%dT%H:%M:%S" : "%Y-%m-%d %H:%M:%S") : "%H:%M:%S" // format
+                        ,   false // with_micros
+                        );
+                }
+
+                char
+                    fraction[8] {'.'};
+
+                auto
+                    f = micros % 1'000'000;
+
+                for (auto i = 6; i>0; --i, f /= 10)
+                    fraction[i] = char('0' + f%10);
+
+                target += m_prefix;
+                target.append(fraction, 7);
+
+                if (as_utc)
+                    target += 'Z';
+            }
+};
+
+
+void
+    append_hex8(
+            ::std::string       & target
+        ,   ::uuids::uuid const & u
+        )
+        {
+            constexpr char
+                digits[] = "0123456789abcdef";
+
+            auto
+                bytes = u.as_bytes();
+
+            for (auto i = 0; i<4; ++i)
+            {
+                auto b = ::std::to_integer<unsigned>(bytes[i]);
+
+                target += digits[b>>4];
+                target += digits[b&15];
+            }
+        }
+
+
+// set if stdout holds lines that were not flushed yet
+::std::atomic<bool>
+    stdout_is_dirty {};
+
+/// flushes stdout shortly after a burst of Logs
+void
+    flusher_start()
+        {
+            static ::std::atomic<bool>
+                started {};
+
+            if (started.exchange(true))
+                return;
+
+            // runs until the process ends
+            ::std::thread(
+                    []()
+                    {
+                        while (true)
+                        {
+                            ::std::this_thread::sleep_for(::std::chrono::milliseconds{50});
+
+                            if (stdout_is_dirty.exchange(false))
+                                ::std::fflush(stdout);
+                        }
+                    }
+                ).detach();
+        }
+
 } // ns
 
 
@@ -115,7 +253,10 @@ log_consumer_console(
     if (   !log_consumer_console_be_verbose
         &&  level<Log::Level::INFO
     )
+    {
+        log_metrics_count_suppressed_by_level();
         return;
+    }
 
     //  fetch relevant attributes
     auto att_message = log.message_resolved();
@@ -124,40 +265,60 @@ log_consumer_console(
         att_message = "no message"s;
 
     //  console output
-    auto text = ""s;
+    // the buffer keeps its capacity, so rendering does not allocate
+    thread_local ::std::string
+        text;
+        text.clear();
+
+    thread_local TimeRenderer
+        time_renderer;
 
     if (log_consumer_console_be_verbose)
-        text += "{"s + to_string8_with_empty_to_NIL(log.creator()) + "} "s;
+    {
+        text += '{';
+        append_hex8(text, log.creator());
+        text += "} ";
+    }
 
     auto as_utc    = !log_consumer_console_dump_in_local_time.value_or(false);
     auto with_date =  log_consumer_console_dump_date.value_or(true);
 
-    text += to_string(
-            log.time()
-        ,   as_utc
-        ,   true // with_millis
-        ,   with_date ? (as_utc ? "%Y-%m-%dT%H:%M:%S" : "%Y-%m-%d %H:%M:%S") : "%H:%M:%S" // format
-        ,   true // with_micros
-        );
-
-    if (as_utc)
-        text += "Z";
-
-    // the 'debug' level is printed as empty string to make it easier to percept the other levels in the output
-    auto lvl = to_lower(level==Log::Level::DEBUG ? ""s : to_string(level));
-    auto lvl_padding_size = 8 - lvl.size();
+    time_renderer.append(text, log.time(), as_utc, with_date);
 
-    text += " " + lvl + ::std::string(lvl_padding_size, ' ') + ": ";
+    text += c_level_columns[::std::min<::std::size_t>(::std::size_t(level), c_level_columns.size()-1)];
 
     if (auto & s = log.scope(); !s.empty())
-        text += "["s + s + "] "s;
+    {
+        text += '[';
+        text += s;
+        text += "] ";
+    }
 
     text += att_message;
+    text += '\n';
 
     // requirement.74c1daf7-94be-417a-bea0-a9ec90d64f71
     auto fd = level<Log::Level::FAILURE ? stdout : stderr;
-    ::fmt::print(fd, "{}\n", text);
-    ::std::fflush(fd);
+
+    // flush at once on warnings and errors, keep the order of stdout and stderr
+    if (level>=Log::Level::WARNING)
+    {
+        stdout_is_dirty = false;
+
+        if (fd!=stdout)
+            ::std::fflush(stdout);
+
+        ::std::fwrite(text.data(), 1, text.size(), fd);
+        ::std::fflush(fd);
+    }
+    else
+    {
+        flusher_start();
+
+        ::std::fwrite(text.data(), 1, text.size(), fd);
+
+        stdout_is_dirty = true;
+    }
 }
 
 }
@@ -1,56 +1,435 @@
 ﻿#include "r_base/log_consumer_file.h"
 
-#include <fstream>
+#include "r_base/log_metrics.h"
+#include "r_base/AppendFile.h"
+#include "r_base/AsyncAppendFile.h"
+#include "r_base/log_index.h"
+#include "r_base/signals.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 
 namespace nsBase
 {
 using namespace ::std::string_literals;
 
-static ::fs::path
-    log_file_path;
+namespace
+{
+struct State
+{
+    ::std::mutex
+        mutex;
+
+    ::std::condition_variable
+        cv_tick;
+
+    ::fs::path
+        path;
+
+    LogConsumerFilePolicy
+        policy;
+
+    AppendFile
+        file;
+
+    AsyncAppendFile
+        async_file;
+
+    LogIndexWriter
+        index;
+
+    // the index entries of the buffered Logs, offsets relative to the buffer
+    ::std::vector<LogIndexEntry>
+        index_pending;
+
+    // the size of the file as far as written by this process
+    ::std::uint64_t
+        file_size {};
+
+    ::std::optional<LogFileRotation>
+        rotation;
+
+    ::std::string
+        buffer;
+
+    // time the oldest Log was put into the buffer
+    ::std::chrono::steady_clock::time_point
+        buffer_since;
+
+    bool
+        ticker_running {};
+
+    on_delete
+        metrics_registration;
+
+    // lets the signal logger write out the buffer on a crash
+    SignalDrainBuffer
+        drain;
+
+    on_delete
+        drain_registration;
+};
+
+
+State &
+    obtain_state()
+        {
+            static ::std::atomic<State*>
+                state {};
+
+            if (!state.load())
+            {
+                State *
+                    null {};
+
+                auto s = ::std::make_unique<State>();
+
+                if (state.compare_exchange_strong(null, s.get()))
+                    s.release();
+            }
+
+            return *state.load();
+        }
+
+
+bool
+    is_open_locked(
+            State & s
+        )
+        {
+            return s.file.is_open() || s.async_file.is_open();
+        }
+
+
+// the descriptor of the open file, -1 if none
+int
+    fd_locked(
+            State & s
+        )
+        {
+            return s.async_file.is_open() ? s.async_file.fd() : s.file.fd();
+        }
+
+
+// waits for the pending asynchronous writes
+void
+    close_locked(
+            State & s
+        )
+        {
+            // the descriptor may be reused
+            s.drain.withdraw();
+
+            s.file.close();
+            s.async_file.close();
+            s.index.close();
+        }
+
+
+// caller must lock the mutex
+void
+    flush_locked(
+            State & s
+        )
+        {
+            if (s.buffer.empty())
+                return;
+
+            // the mode might have been switched
+            if (s.policy.asynchronous ? s.file.is_open() : s.async_file.is_open())
+                close_locked(s);
+
+            if (s.rotation && is_open_locked(s) && s.rotation->due())
+            {
+                close_locked(s);
+
+                // the index describes the active file only, it is kept if the rename failed
+                if (s.rotation->rotate(s.path))
+                    s.index.remove();
+            }
+
+            if (!is_open_locked(s))
+            {
+                if (s.path.empty())
+                    s.path = "./unnamed.log"_path;
+
+                auto
+                    is_opened = s.policy.asynchronous
+                        ?   s.async_file.open(s.path)
+                        :   s.file.open(s.path)
+                        ;
+
+                if (is_opened)
+                {
+                    ::std::error_code
+                        err;
+
+                    s.file_size = ::fs::file_size(s.path, err);
+
+                    if (err)
+                        s.file_size = 0;
+
+                    if (s.policy.indexed)
+                        s.index.open(s.path);
+
+                    if (s.rotation)
+                        s.rotation->opened(s.path);
+                }
+            }
+
+            s.drain.withdraw();
+
+            auto
+                size = s.buffer.size();
+
+            auto
+                ok = false;
+
+            if (s.policy.asynchronous)
+            {
+                // hand the buffer over and continue with a fresh one
+                ok = s.async_file.append(::std::move(s.buffer), s.policy.durable);
+
+                s.buffer = {};
+                s.buffer.reserve(s.policy.buffer_size);
+            }
+            else
+            {
+                ok = s.file.write(s.buffer);
+
+                if (ok && s.policy.durable)
+                    s.file.sync();
+            }
+
+            if (ok && s.index.is_open())
+            {
+                for (auto & e : s.index_pending)
+                {
+                    e.offset += s.file_size;
+                    s.index.add(e);
+                }
+            }
+
+            if (ok)
+                s.file_size += size;
+
+            if (ok && s.rotation)
+                s.rotation->written(size);
+
+            s.index_pending.clear();
+            s.buffer.clear();
+        }
+
+
+// caller must lock the mutex
+void
+    start_ticker_locked(
+            State & s
+        )
+        {
+            if (s.ticker_running)
+                return;
+
+            s.ticker_running = true;
+
+            ::std::atexit(log_consumer_file_flush);
+
+            s.metrics_registration = log_metrics_queue_register(
+                    "log_consumer_file.buffered_bytes"
+                ,   [&s]()
+                    {
+                        ::std::lock_guard<::std::mutex>
+                            guard(s.mutex);
+
+                        return s.buffer.size();
+                    }
+                );
+
+            s.drain_registration = signal_drain_register(s.drain);
+
+            // the state is never destroyed, so the thread may outlive main()
+            ::std::thread(
+                    [&s]()
+                    {
+                        auto l = ::std::unique_lock<::std::mutex>(s.mutex);
+
+                        while (true)
+                        {
+                            auto max_age = s.policy.max_age;
+
+                            if (s.buffer.empty())
+                                s.cv_tick.wait(l);
+                            else
+                                s.cv_tick.wait_until(l, s.buffer_since + max_age);
+
+                            if (   !s.buffer.empty()
+                                &&  ::std::chrono::steady_clock::now() - s.buffer_since >= s.policy.max_age
+                            )
+                                flush_locked(s);
+                        }
+                    }
+                ).detach();
+        }
+}
+
 
 void
 log_consumer_file_path_assign(
     ::fs::path const & p
 )
 {
-    log_file_path = p;
+    auto & s = obtain_state();
+
+    ::std::lock_guard<::std::mutex>
+        guard(s.mutex);
+
+    if (p==s.path)
+        return;
+
+    // pending Logs belong to the old file
+    flush_locked(s);
+    close_locked(s);
+
+    s.path = p;
 }
 
 
 ::fs::path
 log_consumer_file_path()
 {
-    return log_file_path;
+    auto & s = obtain_state();
+
+    ::std::lock_guard<::std::mutex>
+        guard(s.mutex);
+
+    return s.path;
 }
 
 
 void
-log_consumer_file(
-    Log & log
+log_consumer_file_policy_assign(
+    LogConsumerFilePolicy const & p
 )
 {
-    static ::std::ofstream
-        stream;
+    auto & s = obtain_state();
 
-    if (!stream.is_open())
     {
-        if (log_file_path.empty())
-            log_file_path = "./unnamed.log"_path;
-
-        auto mode = ::std::ios::app | ::std::ios::binary | ::std::ios::out;
+        ::std::lock_guard<::std::mutex>
+            guard(s.mutex);
 
-        stream.open(log_file_path, mode);
+        s.policy = p;
     }
 
-    if (!stream.is_open())
+    s.cv_tick.notify_all();
+}
+
+
+LogConsumerFilePolicy
+log_consumer_file_policy()
+{
+    auto & s = obtain_state();
+
+    ::std::lock_guard<::std::mutex>
+        guard(s.mutex);
+
+    return s.policy;
+}
+
+
+void
+log_consumer_file_rotation_assign(
+    ::std::optional<LogRotationPolicy> const & p
+)
+{
+    auto & s = obtain_state();
+
+    ::std::lock_guard<::std::mutex>
+        guard(s.mutex);
+
+    s.rotation.reset();
+
+    if (!p)
         return;
 
+    s.rotation.emplace(*p);
+
+    if (is_open_locked(s))
+        s.rotation->opened(s.path);
+}
+
+
+void
+log_consumer_file_flush()
+{
+    auto & s = obtain_state();
+
+    ::std::lock_guard<::std::mutex>
+        guard(s.mutex);
+
+    flush_locked(s);
+
+    s.async_file.flush();
+    s.index.flush();
+}
+
+
+void
+log_consumer_file(
+    Log & log
+)
+{
     auto
         line = log.serialize() + "\n";
 
-    stream.write(line.c_str(), line.size()).flush();
+    auto & s = obtain_state();
+
+    ::std::unique_lock<::std::mutex>
+        guard(s.mutex);
+
+    start_ticker_locked(s);
+
+    auto
+        was_empty = s.buffer.empty();
+
+    if (was_empty)
+        s.buffer_since = ::std::chrono::steady_clock::now();
+
+    // a reallocation invalidates what the signal logger might read
+    if (s.buffer.size() + line.size() > s.buffer.capacity())
+        s.drain.withdraw();
+
+    if (s.policy.indexed)
+    {
+        auto
+            entry = LogIndexEntry::of(log);
+            entry.offset = s.buffer.size();
+            entry.length = ::std::uint32_t(line.size());
+
+        s.index_pending.push_back(entry);
+    }
+
+    s.buffer += line;
+
+    s.drain.publish(s.buffer.data(), s.buffer.size(), fd_locked(s));
+
+    if (   s.buffer.size() >= s.policy.buffer_size
+        || int(log.level()) >= int(s.policy.flush_level)
+    )
+    {
+        flush_locked(s);
+        return;
+    }
+
+    guard.unlock();
+
+    // the ticker sleeps while the buffer is empty
+    if (was_empty)
+        s.cv_tick.notify_all();
 }
 
 }
@@ -1,11 +1,48 @@
-﻿#include "r_base/Log.h"
+﻿#pragma once
+
+#include "r_base/Log.h"
 
 #include "r_base/filesystem.h"
+#include "r_base/log_file_rotation.h"
+
+#include <chrono>
+#include <cstddef>
 
 
 namespace nsBase
 {
 
+/** Controls when the buffered Logs of log_consumer_file() hit the file.
+    The buffer is written out as soon as any of the conditions holds.
+*/
+struct LogConsumerFilePolicy
+{
+    /// flush if the buffer holds at least this many bytes
+    ::std::size_t
+        buffer_size {64 * 1024};
+
+    /// flush from a background tick if the oldest buffered Log is older than this
+    ::std::chrono::milliseconds
+        max_age {1000};
+
+    /// flush immediately on Logs of at least this level
+    Log::Level
+        flush_level {Log::Level::WARNING};
+
+    /// hand the buffer over to the background writer (see AsyncAppendFile)
+    bool
+        asynchronous {};
+
+    /// sync every flush to the storage device
+    bool
+        durable {};
+
+    /// write a sidecar index next to the file (see LogIndexWriter)
+    bool
+        indexed {};
+};
+
+
 void
     log_consumer_file_path_assign(
             ::fs::path const &
@@ -15,6 +52,31 @@ void
     log_consumer_file_path();
 
 
+void
+    log_consumer_file_policy_assign(
+            LogConsumerFilePolicy const &
+        );
+
+LogConsumerFilePolicy
+    log_consumer_file_policy();
+
+
+/** Rotate the file by size and/or period.
+    An EMPTY policy disables rotation.
+*/
+void
+    log_consumer_file_rotation_assign(
+            ::std::optional<LogRotationPolicy> const &
+        );
+
+
+/** Write all buffered Logs to the file and wait for the background writer.
+    This is also done at exit.
+*/
+void
+    log_consumer_file_flush();
+
+
 void
     log_consumer_file(
             Log & log
@@ -0,0 +1,398 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_file_rotation.h"
+
+#include "r_base/compression.h"
+#include "r_base/concurrent.h"
+#include "r_base/file.h"
+#include "r_base/Log.h"
+#include "r_base/time.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+namespace nsBase
+{
+using namespace ::std::string_literals;
+
+namespace
+{
+auto const
+    c_compressed_extension = ".rlz"s;
+
+// the back-off after a failed rotation, doubled by each further failure
+constexpr auto
+    c_retry_delay_min = ::std::chrono::seconds{1};
+
+constexpr auto
+    c_retry_delay_max = ::std::chrono::minutes{5};
+
+/// compress the segment one block at a time, the segment may be larger than the memory
+void
+    segment_compress(
+            ::fs::path const & segment
+        ,   ::fs::path const & target
+        )
+        {
+            ::std::ifstream
+                in {segment, ::std::ios::in | ::std::ios::binary};
+
+            if (!in)
+                "d3fe04fb-c37c-4d06-a615-2f2b3e2f94df"_log("failed to open ${path}").path(segment).throw_error();
+
+            ::std::ofstream
+                out {target, ::std::ios::out | ::std::ios::binary | ::std::ios::trunc};
+
+            if (!out)
+                "5881ba39-fb63-497f-98b4-c31ab14db678"_log("failed to create ${path}").path(target).throw_error();
+
+            compression::FrameWriter
+                frame {out};
+
+            ::std::string
+                block(compression::c_block_size, '\0');
+
+            while (in.read(block.data(), ::std::streamsize(block.size())) || in.gcount())
+                frame.write_block({block.data(), ::std::size_t(in.gcount())});
+
+            if (in.bad())
+                "9177cc40-1494-4f70-8dbe-52a1cf5621e4"_log("failed to read ${path}").path(segment).throw_error();
+
+            frame.finish();
+        }
+
+
+struct Job
+{
+    ::fs::path          active;
+    ::fs::path          segment;
+    LogRotationPolicy   policy;
+};
+
+
+struct Worker
+{
+    concurrent::channel<Job>
+        jobs;
+
+    ::std::mutex
+        mutex;
+
+    ::std::condition_variable
+        cv_idle;
+
+    ::std::size_t
+        pending {};
+
+    Worker()
+        {
+            // the worker is never destroyed, so the thread may outlive main()
+            ::std::thread(
+                    [this]()
+                    {
+                        while (auto job = jobs.recv())
+                        {
+                            execute(*job);
+
+                            {
+                                ::std::lock_guard<::std::mutex>
+                                    guard(mutex);
+
+                                --pending;
+                            }
+
+                            cv_idle.notify_all();
+                        }
+                    }
+                ).detach();
+        }
+
+    void
+        schedule(
+                Job && job
+            )
+            {
+                {
+                    ::std::lock_guard<::std::mutex>
+                        guard(mutex);
+
+                    ++pending;
+                }
+
+                jobs.send(::std::move(job));
+            }
+
+    static void
+        execute(
+                Job const & job
+            )
+            {
+                try
+                {
+                    // the segment might already be dropped due to the retention count
+                    if (job.policy.compress && ::fs::exists(job.segment))
+                    {
+                        auto target = job.segment + c_compressed_extension;
+                        auto tmp    = target + ".tmp"s;
+
+                        segment_compress(job.segment, tmp);
+
+                        ::fs::rename(tmp, target);
+                        ::fs::remove(job.segment);
+                    }
+
+                    if (!job.policy.retention)
+                        return;
+
+                    auto segments = log_segments(job.active);
+
+                    for (auto i=0_sz; i+job.policy.retention < segments.size(); ++i)
+                        ::fs::remove(segments[i]);
+                }
+                catch (Error &)
+                {
+                    // already logged
+                }
+                catch (::std::exception & e)
+                {
+                    "5c1e7a93-2f4b-4d86-8e0a-b7d3c9f16a25"_log("log rotation of '${path}' failed: ${data}")
+                        .warning()
+                        .path(job.segment)
+                        .data(e.what())
+                        ;
+                }
+            }
+};
+
+
+Worker &
+    obtain_worker()
+        {
+            static ::std::atomic<Worker*>
+                worker {};
+
+            if (!worker.load())
+            {
+                Worker *
+                    null {};
+
+                auto w = ::std::make_unique<Worker>();
+
+                if (worker.compare_exchange_strong(null, w.get()))
+                    w.release();
+            }
+
+            return *worker.load();
+        }
+
+
+::std::int64_t
+    period_index(
+            LogRotationPolicy const & policy
+        )
+        {
+            if (!policy.period.count())
+                return 0;
+
+            auto since_epoch = ::std::chrono::duration_cast<::std::chrono::seconds>(time::now().time_since_epoch());
+
+            return since_epoch / policy.period;
+        }
+
+
+::std::string
+    segment_stamp(
+            time::time_point_t const & tp
+        )
+        {
+            auto tm     = ::std::chrono::to_calendar_utc(tp);
+            auto micros = ::std::chrono::duration_cast<::std::chrono::microseconds>(tp.time_since_epoch()).count() % 1'000'000;
+
+            return ::fmt::format(
+                    "{:04}{:02}{:02}{:02}{:02}{:02}{:06}"
+                ,   tm.tm_year + 1900
+                ,   tm.tm_mon + 1
+                ,   tm.tm_mday
+                ,   tm.tm_hour
+                ,   tm.tm_min
+                ,   tm.tm_sec
+                ,   micros
+                );
+        }
+}
+
+
+LogFileRotation::LogFileRotation(
+    LogRotationPolicy const & policy
+)
+:   m_policy {policy}
+{
+}
+
+
+void
+LogFileRotation::opened(
+    ::fs::path const & active
+)
+{
+    ::std::error_code
+        err;
+
+    auto
+        size = ::fs::file_size(active, err);
+
+    m_size         = err ? 0 : size;
+    m_period_index = period_index(m_policy);
+}
+
+
+void
+LogFileRotation::written(
+    ::std::size_t bytes
+)
+{
+    m_size += bytes;
+}
+
+
+bool
+LogFileRotation::due() const
+{
+    // don't reopen the file for each flush while the rename keeps failing
+    if (::std::chrono::steady_clock::now()<m_retry_at)
+        return false;
+
+    if (m_policy.max_size && m_size>=m_policy.max_size)
+        return true;
+
+    if (m_policy.period.count() && m_size && period_index(m_policy)!=m_period_index)
+        return true;
+
+    return false;
+}
+
+
+bool
+LogFileRotation::rotate(
+    ::fs::path const & active
+)
+{
+    auto
+        now = time::now();
+
+    ::fs::path
+        segment;
+
+    // find an unused name
+    for (auto tp = now;; tp += ::std::chrono::microseconds{1})
+    {
+        segment = active + ("."s + segment_stamp(tp));
+
+        if (!::fs::exists(segment) && !::fs::exists(segment + c_compressed_extension))
+            break;
+    }
+
+    ::std::error_code
+        err;
+
+    ::fs::rename(active, segment, err);
+
+    // the active file keeps growing if it could not be renamed
+    if (err)
+    {
+        m_retry_delay = m_retry_delay.count()
+            ?   ::std::min<::std::chrono::steady_clock::duration>(m_retry_delay*2, c_retry_delay_max)
+            :   c_retry_delay_min
+            ;
+
+        m_retry_at = ::std::chrono::steady_clock::now() + m_retry_delay;
+
+        return false;
+    }
+
+    m_size         = 0;
+    m_period_index = period_index(m_policy);
+    m_retry_delay  = {};
+    m_retry_at     = {};
+
+    obtain_worker().schedule({active, segment, m_policy});
+
+    return true;
+}
+
+
+::std::vector<::fs::path>
+log_segments(
+    ::fs::path const & active
+)
+{
+    ::std::vector<::fs::path>
+        segments;
+
+    auto
+        dir = active.parent_path();
+
+    if (dir.empty())
+        dir = ".";
+
+    if (!::fs::is_directory(dir))
+        return segments;
+
+    auto
+        prefix = P2S(active.filename()) + ".";
+
+    // <prefix><20 digits>[.rlz]
+    auto
+        is_segment = [&](::std::string const & name)
+            {
+                if (name.size()<prefix.size()+20 || name.compare(0, prefix.size(), prefix))
+                    return false;
+
+                auto stamp = name.substr(prefix.size(), 20);
+
+                if (!::std::all_of(stamp.begin(), stamp.end(), [](char c){return c>='0' && c<='9';}))
+                    return false;
+
+                auto tail = name.substr(prefix.size()+20);
+
+                return tail.empty() || tail==c_compressed_extension;
+            };
+
+    foreachFileInDir(
+            dir
+        ,   [&](::fs::path const & p)
+            {
+                if (is_segment(P2S(p.filename())))
+                    segments.push_back(p);
+            }
+        );
+
+    // the fixed width stamp sorts chronologically
+    ::std::sort(
+            segments.begin()
+        ,   segments.end()
+        ,   [](auto & a, auto & b){return a.filename() < b.filename();}
+        );
+
+    return segments;
+}
+
+
+void
+log_rotation_wait_idle()
+{
+    auto & w = obtain_worker();
+
+    auto l = ::std::unique_lock<::std::mutex>(w.mutex);
+
+    w.cv_idle.wait(l, [&]{return !w.pending;});
+}
+
+}
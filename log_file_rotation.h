@@ -0,0 +1,124 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/filesystem.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+
+namespace nsBase
+{
+
+struct LogRotationPolicy
+{
+    /// rotate once the active file reached this size, 0 disables size based rotation
+    ::std::uint64_t
+        max_size {};
+
+    /** rotate when the wall clock enters the next period, 0 disables time based rotation.
+        Periods are aligned to multiples of the duration since the epoch (UTC),
+        i.e. 24h rotates at midnight UTC.
+    */
+    ::std::chrono::seconds
+        period {};
+
+    /// count of rotated segments to keep, 0 keeps all
+    ::std::size_t
+        retention {};
+
+    /// compress rotated segments in the background
+    bool
+        compress {true};
+};
+
+
+/**
+    Tracks the active segment of a log file and decides when to rotate it.
+
+    A rotation renames the active file to
+
+        <active>.<YYYYMMDDHHmmssuuuuuu>
+
+    and hands it to a background thread which compresses it into
+    <segment>.rlz (see compression.h) and removes segments exceeding the
+    retention count. The emitting thread only pays for the rename.
+
+    The owner is responsible for synchronisation and for closing the file
+    before calling rotate().
+*/
+class LogFileRotation
+{
+    public :
+        LogFileRotation(
+                LogRotationPolicy const & policy
+            );
+
+    public : LogRotationPolicy const &
+        policy() const
+            {
+                return m_policy;
+            }
+
+    /** Call after the active file was opened.
+    */
+    public : void
+        opened(
+                ::fs::path const & active
+            );
+
+    public : void
+        written(
+                ::std::size_t bytes
+            );
+
+    /** FALSE during the back-off after a failed rotation.
+    */
+    public : bool
+        due() const;
+
+    /** Rename the active file and schedule the background work.
+        This never logs, so it may be called while a log consumer holds its lock.
+        \return FALSE if the active file could not be renamed. It gets due
+            again after a back-off of 1s, doubled by each further failure up
+            to 5min.
+    */
+    public : bool
+        rotate(
+                ::fs::path const & active
+            );
+
+    private : LogRotationPolicy
+        m_policy;
+
+    private : ::std::uint64_t
+        m_size {};
+
+    private : ::std::int64_t
+        m_period_index {};
+
+    private : ::std::chrono::steady_clock::duration
+        m_retry_delay {};
+
+    private : ::std::chrono::steady_clock::time_point
+        m_retry_at {};
+};
+
+
+/** Rotated segments of the target active file, oldest first.
+    Uncompressed and compressed segments are included, the active file is not.
+*/
+::std::vector<::fs::path>
+    log_segments(
+            ::fs::path const & active
+        );
+
+
+/** Block until the background thread has finished all compressions and
+    retention clean-ups scheduled so far.
+*/
+void
+    log_rotation_wait_idle();
+
+}
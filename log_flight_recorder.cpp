@@ -0,0 +1,473 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_flight_recorder.h"
+#include "r_base/file.h"
+#include "r_base/log_metrics.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string_view>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace nsBase
+{
+
+namespace
+{
+constexpr char
+    c_file_magic[8] {'R','F','L','R','E','C','0','1'};
+
+constexpr ::std::uint32_t
+    c_record_magic = 0x52464c52;
+
+struct
+    FileHeader
+        {
+            char            magic[8];
+            ::std::uint64_t capacity;
+            ::std::uint64_t reserved[6];
+        };
+
+struct
+    RecordHeader
+        {
+            ::std::uint32_t magic;
+            ::std::uint32_t size;
+            ::std::uint64_t seq;
+            ::std::uint32_t crc;
+            ::std::uint32_t reserved;
+        };
+
+static_assert(sizeof(FileHeader)==64);
+static_assert(sizeof(RecordHeader)==24);
+
+constexpr ::std::size_t
+    c_align = 8;
+
+constexpr ::std::size_t
+    aligned(
+            ::std::size_t n
+        )
+        {
+            return (n + c_align-1) & ~(c_align-1);
+        }
+
+
+constexpr auto
+    c_crc_table = []
+        {
+            ::std::array<::std::uint32_t,256>
+                table {};
+
+            for (auto i = 0u; i<256; ++i)
+            {
+                auto c = ::std::uint32_t(i);
+
+                for (auto k = 0; k<8; ++k)
+                    c = c&1 ? 0xEDB88320u ^ (c>>1) : c>>1;
+
+                table[i] = c;
+            }
+
+            return table;
+        }();
+
+/// CRC-32 of the sequence number and the payload
+::std::uint32_t
+    checksum(
+            ::std::uint64_t            seq
+        ,   ::std::string_view const & payload
+        )
+        {
+            auto
+                crc = ~::std::uint32_t(0);
+
+            auto
+                feed = [&](void const * data, ::std::size_t size)
+                    {
+                        auto p = static_cast<unsigned char const*>(data);
+
+                        for (auto i = 0_sz; i<size; ++i)
+                            crc = c_crc_table[(crc ^ p[i]) & 0xFF] ^ (crc>>8);
+                    };
+
+            feed(&seq, sizeof(seq));
+            feed(payload.data(), payload.size());
+
+            return ~crc;
+        }
+
+
+struct
+    Record
+        {
+            ::std::size_t       offset;
+            ::std::uint64_t     seq;
+            ::std::string_view  payload;
+        };
+
+/// all intact records of the ring in arbitrary order
+::std::vector<Record>
+    records_scan(
+            unsigned char const * ring
+        ,   ::std::size_t         capacity
+        )
+        {
+            ::std::vector<Record>
+                records;
+
+            auto
+                offset = 0_sz;
+
+            while (offset + sizeof(RecordHeader) <= capacity)
+            {
+                RecordHeader
+                    h;
+
+                ::std::memcpy(&h, ring+offset, sizeof(h));
+
+                auto
+                    end = offset + sizeof(RecordHeader) + h.size;
+
+                if (h.magic==c_record_magic && end<=capacity)
+                {
+                    auto
+                        payload = ::std::string_view{reinterpret_cast<char const*>(ring) + offset + sizeof(RecordHeader), h.size};
+
+                    if (checksum(h.seq, payload)==h.crc)
+                    {
+                        records.push_back({offset, h.seq, payload});
+                        offset = aligned(end);
+                        continue;
+                    }
+                }
+
+                // resynchronize behind a damaged or overwritten record
+                offset += c_align;
+            }
+
+            return records;
+        }
+}
+
+
+struct
+LogFlightRecorder::State
+{
+    ::std::mutex
+        mutex;
+
+    // nullptr once closed - guarded by mutex
+    unsigned char *
+        map {};
+
+    ::std::size_t
+        map_size {};
+
+    ::std::size_t
+        capacity {};
+
+    ::std::size_t
+        write_pos {};
+
+    ::std::uint64_t
+        seq_next {};
+
+    unsigned char *
+        ring() const
+            {
+                return map + sizeof(FileHeader);
+            }
+};
+
+
+LogFlightRecorder::~LogFlightRecorder()
+{
+    close();
+}
+
+
+LogFlightRecorder::LogFlightRecorder() = default;
+
+
+LogFlightRecorder::LogFlightRecorder(
+    LogFlightRecorder && src
+)
+:   m_state {src.m_state.exchange(nullptr)}
+{
+}
+
+
+LogFlightRecorder &
+LogFlightRecorder::operator=(
+    LogFlightRecorder && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        m_state = src.m_state.exchange(nullptr);
+    }
+
+    return *this;
+}
+
+
+bool
+LogFlightRecorder::open(
+    ::fs::path const & path
+,   ::std::size_t      capacity_
+)
+{
+    close();
+
+#ifdef _WIN32
+    (void)path;
+    (void)capacity_;
+
+    return false;
+#else
+    auto
+        capacity = aligned(::std::max(capacity_, 4_sz<<10));
+
+    auto
+        map_size = sizeof(FileHeader) + capacity;
+
+    int
+        fd;
+
+    do
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    while (fd<0 && errno==EINTR);
+
+    if (fd<0)
+        return false;
+
+    struct stat
+        st;
+
+    if (::fstat(fd, &st)!=0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // a file of another layout starts over with a zeroed ring
+    auto
+        is_reused = false;
+
+    if (::std::size_t(st.st_size)==map_size)
+    {
+        FileHeader
+            h;
+
+        is_reused =
+                ::pread(fd, &h, sizeof(h), 0)==ssize_t(sizeof(h))
+            &&  ::std::memcmp(h.magic, c_file_magic, sizeof(c_file_magic))==0
+            &&  h.capacity==capacity
+            ;
+    }
+
+    if (!is_reused && (::ftruncate(fd, 0)!=0 || ::ftruncate(fd, off_t(map_size))!=0))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    auto
+        map = ::mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    // the mapping keeps the file referenced
+    ::close(fd);
+
+    if (map==MAP_FAILED)
+        return false;
+
+    auto
+        state = ::std::make_shared<State>();
+        state->map      = static_cast<unsigned char*>(map);
+        state->map_size = map_size;
+        state->capacity = capacity;
+
+    if (is_reused)
+    {
+        // continue behind the newest record
+        auto
+            records = records_scan(state->ring(), capacity);
+
+        auto
+            newest = ::std::max_element(
+                    records.begin()
+                ,   records.end()
+                ,   [](auto & a, auto & b){return a.seq<b.seq;}
+                );
+
+        if (newest!=records.end())
+        {
+            state->seq_next  = newest->seq+1;
+            state->write_pos = aligned(newest->offset + sizeof(RecordHeader) + newest->payload.size());
+        }
+    }
+    else
+    {
+        FileHeader
+            h {};
+
+        ::std::memcpy(h.magic, c_file_magic, sizeof(c_file_magic));
+        h.capacity = capacity;
+
+        ::std::memcpy(state->map, &h, sizeof(h));
+    }
+
+    m_state = ::std::move(state);
+
+    return true;
+#endif
+}
+
+
+bool
+LogFlightRecorder::is_open() const
+{
+    return bool(m_state.load());
+}
+
+
+void
+LogFlightRecorder::close()
+{
+    // writers still in flight keep the state alive
+    auto
+        state = m_state.exchange(nullptr);
+
+    if (!state)
+        return;
+
+    ::std::lock_guard<::std::mutex>
+        guard(state->mutex);
+
+#ifndef _WIN32
+    ::munmap(state->map, state->map_size);
+#endif
+
+    state->map = nullptr;
+}
+
+
+void
+LogFlightRecorder::operator()(
+    Log & log
+)
+{
+    auto
+        state = m_state.load();
+
+    if (!state)
+        return;
+
+    auto &
+        s = *state;
+
+    // the expensive part happens outside the lock
+    auto
+        payload = log.serialize();
+
+    auto
+        record_size = aligned(sizeof(RecordHeader) + payload.size());
+
+    if (record_size > s.capacity)
+    {
+        log_metrics_count_dropped();
+        return;
+    }
+
+    ::std::lock_guard<::std::mutex>
+        guard(s.mutex);
+
+    if (!s.map)
+        return; // closed meanwhile
+
+    if (s.write_pos + record_size > s.capacity)
+        s.write_pos = 0;
+
+    RecordHeader
+        h {};
+        h.magic = c_record_magic;
+        h.size  = ::std::uint32_t(payload.size());
+        h.seq   = s.seq_next++;
+        h.crc   = checksum(h.seq, payload);
+
+    auto
+        target = s.ring() + s.write_pos;
+
+    ::std::memcpy(target, &h, sizeof(h));
+    ::std::memcpy(target + sizeof(h), payload.data(), payload.size());
+
+    s.write_pos += record_size;
+}
+
+
+void
+logs_flight_recorder_read(
+    ::std::vector<Log> & logs
+,   ::fs::path   const & path
+)
+{
+    auto
+        data = file_read_all(path);
+
+    FileHeader
+        h {};
+
+    if (data.size()>=sizeof(h))
+        ::std::memcpy(&h, data.data(), sizeof(h));
+
+    if (    data.size() < sizeof(h)
+        ||  ::std::memcmp(h.magic, c_file_magic, sizeof(c_file_magic))!=0
+        ||  h.capacity != data.size()-sizeof(h)
+        )
+    {
+        "6c1e0f73-2a4b-4d8e-b5f9-8a3d7e21c604"_log("not a flight recorder file ${path}")
+            .path(path)
+            .throw_error();
+    }
+
+    auto
+        records = records_scan(reinterpret_cast<unsigned char const*>(data.data()) + sizeof(h), h.capacity);
+
+    ::std::sort(
+            records.begin()
+        ,   records.end()
+        ,   [](auto & a, auto & b){return a.seq<b.seq;}
+        );
+
+    for (auto & r : records)
+    {
+        if (auto log = Log::deserialize(r.payload))
+            logs.push_back(::std::move(*log));
+    }
+}
+
+
+::std::vector<Log>
+log_flight_recorder_read(
+    ::fs::path const & path
+)
+{
+    ::std::vector<Log>
+        logs;
+
+    logs_flight_recorder_read(logs, path);
+
+    return logs;
+}
+
+}
@@ -0,0 +1,88 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/filesystem.h"
+#include "r_base/Log.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    A log consumer that writes into a fixed-size memory-mapped ring file.
+
+    The file consists of a header followed by the ring of records. Each record
+    carries a sequence number and a checksum of the serialized Log. When the
+    ring is full the oldest records get overwritten.
+
+    Since the pages are shared with the kernel, everything written survives a
+    crash of the process (SIGSEGV, SIGABRT, ...) without any flush. After the
+    crash the records are reconstructed by log_flight_recorder_read().
+
+    Re-opening an existing ring file continues behind its newest record.
+
+    Only available on POSIX systems - elsewhere open() fails.
+*/
+class LogFlightRecorder
+{
+    R_DTOR(LogFlightRecorder);
+    R_CTOR(LogFlightRecorder);
+    R_CCPY(LogFlightRecorder) = delete;
+    R_CMOV(LogFlightRecorder);
+    R_COPY(LogFlightRecorder) = delete;
+    R_MOVE(LogFlightRecorder);
+
+    /** Open or create the target ring file.
+        \param capacity Size of the ring in bytes.
+        \return FALSE on failure.
+    */
+    public : bool
+        open(
+                ::fs::path const & path
+            ,   ::std::size_t      capacity = 4_sz<<20
+            );
+
+    public : bool
+        is_open() const;
+
+    /** May be called while other threads write Logs, these are dropped then.
+    */
+    public : void
+        close();
+
+    public : void
+        operator()(::nsBase::Log &);
+
+    private : struct
+        State;
+
+    private : ::std::atomic<::std::shared_ptr<State>>
+        m_state;
+};
+
+
+/**
+    Read the Logs from a flight recorder ring file.
+    Damaged or partially overwritten records are skipped.
+
+    \return The logs, oldest first.
+*/
+::std::vector<Log>
+    log_flight_recorder_read(
+            ::fs::path const & path
+        );
+
+void
+    logs_flight_recorder_read(
+            ::std::vector<Log> & target
+        ,   ::fs::path   const & path
+        );
+
+}
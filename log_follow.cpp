@@ -0,0 +1,615 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_follow.h"
+#include "r_base/thread.h"
+#include "r_base/language_tools.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define R_LOG_FOLLOW_INOTIFY
+#endif
+
+
+namespace nsBase
+{
+
+namespace
+{
+constexpr auto
+    c_poll_interval = ::std::chrono::milliseconds{250};
+
+// with inotify, polling is only a safety net
+constexpr auto
+    c_poll_interval_inotify = ::std::chrono::seconds{2};
+
+constexpr ::std::size_t
+    c_read_size = 64_sz<<10;
+
+#ifdef _WIN32
+// an open file can't be renamed or removed by the writer, so it is opened
+// for each poll only
+constexpr bool
+    c_keeps_file_open = false;
+#else
+constexpr bool
+    c_keeps_file_open = true;
+#endif
+
+
+/// what tells a file apart from another one under the same path
+struct
+    Identity
+        {
+            ::std::uint64_t
+                device {};
+
+            ::std::uint64_t
+                file {};
+
+            bool
+                operator==(Identity const &) const = default;
+        };
+
+
+int
+    file_open(
+            ::fs::path const & path
+        )
+        {
+#ifdef _WIN32
+            return ::_wopen(path.c_str(), _O_RDONLY | _O_BINARY | _O_NOINHERIT);
+#else
+            int
+                fd;
+
+            do
+                fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            while (fd<0 && errno==EINTR);
+
+            return fd;
+#endif
+        }
+
+
+void
+    file_close(
+            int fd
+        )
+        {
+#ifdef _WIN32
+            ::_close(fd);
+#else
+            ::close(fd);
+#endif
+        }
+
+
+/** The identity and the size of the open file, of the file under the path
+    if fd<0.
+*/
+::std::optional<::std::pair<Identity,::std::int64_t>>
+    file_stat(
+            int                 fd
+        ,   ::fs::path const &  path = {}
+        )
+        {
+#ifdef _WIN32
+            struct ::_stat64
+                st;
+
+            if ((fd>=0 ? ::_fstat64(fd, &st) : ::_wstat64(path.c_str(), &st))!=0)
+                return {};
+
+            // there are no inode numbers, the creation time tells a new file
+            return {{{::std::uint64_t(st.st_dev), ::std::uint64_t(st.st_ctime)}, st.st_size}};
+#else
+            struct stat
+                st;
+
+            if ((fd>=0 ? ::fstat(fd, &st) : ::stat(path.c_str(), &st))!=0)
+                return {};
+
+            return {{{::std::uint64_t(st.st_dev), ::std::uint64_t(st.st_ino)}, st.st_size}};
+#endif
+        }
+
+
+/// \return The count of the bytes read, 0 at the end, <0 on failure.
+::std::int64_t
+    file_read(
+            int             fd
+        ,   char          * data
+        ,   ::std::size_t   size
+        ,   ::std::int64_t  offset
+        )
+        {
+#ifdef _WIN32
+            if (::_lseeki64(fd, offset, SEEK_SET)<0)
+                return -1;
+
+            return ::_read(fd, data, unsigned(size));
+#else
+            while (true)
+            {
+                auto
+                    n = ::pread(fd, data, size, ::off_t(offset));
+
+                if (n<0 && errno==EINTR)
+                    continue;
+
+                return n;
+            }
+#endif
+        }
+
+
+class
+    Follower
+        {
+            R_DTOR(Follower)
+                {
+                    stop();
+
+                #ifdef R_LOG_FOLLOW_INOTIFY
+                    for (auto fd : {m_wake[0], m_wake[1], m_inotify})
+                        if (fd>=0)
+                            ::close(fd);
+                #endif
+
+                    if (m_fd>=0)
+                        file_close(m_fd);
+                }
+
+            R_CTOR(Follower) = delete;
+            R_CCPY(Follower) = delete;
+            R_CMOV(Follower) = delete;
+            R_COPY(Follower) = delete;
+            R_MOVE(Follower) = delete;
+
+            public :
+                Follower(
+                        ::fs::path                   path
+                    ,   ::std::function<void(Log &)> callback
+                    ,   bool                         from_begin
+                    )
+                    :   m_path       {::std::move(path)}
+                    ,   m_callback   {::std::move(callback)}
+                    ,   m_from_begin {from_begin}
+                    {
+                    #ifdef R_LOG_FOLLOW_INOTIFY
+                        m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+                        if (m_inotify>=0 && ::pipe2(m_wake, O_CLOEXEC)!=0)
+                        {
+                            ::close(m_inotify);
+                            m_inotify = -1;
+                        }
+
+                        if (m_inotify>=0)
+                        {
+                            auto
+                                dir = m_path.parent_path();
+
+                            if (dir.empty())
+                                dir = ".";
+
+                            // a file (re-)appearing under the path
+                            m_watch_dir = ::inotify_add_watch(m_inotify, dir.c_str(), IN_CREATE | IN_MOVED_TO);
+
+                            if (m_watch_dir<0)
+                            {
+                                for (auto fd : {m_wake[0], m_wake[1], m_inotify})
+                                    ::close(fd);
+
+                                m_wake[0] = m_wake[1] = m_inotify = -1;
+                            }
+                        }
+                    #endif
+
+                        // the existing content is skipped before log_follow() returns
+                        open_if();
+
+                        m_thread = ::std::thread{[this](){run();}};
+                    }
+
+            public : void
+                stop()
+                    {
+                        {
+                            ::std::lock_guard
+                                l {m_mutex};
+
+                            if (m_is_stopped.exchange(true))
+                                return;
+                        }
+
+                        m_cv_stop.notify_all();
+
+                    #ifdef R_LOG_FOLLOW_INOTIFY
+                        if (m_wake[1]>=0)
+                        {
+                            char
+                                c {};
+
+                            while (::write(m_wake[1], &c, 1)<0 && errno==EINTR)
+                                ;
+                        }
+                    #endif
+
+                        if (m_thread.joinable())
+                            m_thread.join();
+                    }
+
+            private : ::fs::path
+                m_path;
+
+            private : ::std::function<void(Log &)>
+                m_callback;
+
+            private : bool
+                m_from_begin;
+
+            private : ::std::atomic_bool
+                m_is_stopped {};
+
+            private : ::std::thread
+                m_thread;
+
+            // stop() wakes the polling thread
+            private : ::std::mutex
+                m_mutex;
+
+            private : ::std::condition_variable
+                m_cv_stop;
+
+            // written by stop() to wake the thread waiting for inotify
+            private : int
+                m_wake[2] {-1, -1};
+
+            private : int
+                m_inotify {-1};
+
+            private : int
+                m_watch_dir {-1};
+
+            private : int
+                m_watch_file {-1};
+
+            // the followed file
+            private : int
+                m_fd {-1};
+
+            // EMPTY if no file is followed
+            private : ::std::optional<Identity>
+                m_identity;
+
+            private : ::std::int64_t
+                m_offset {};
+
+            // the incomplete last line
+            private : ::std::string
+                m_carry;
+
+            private : ::std::string
+                m_buffer;
+
+            private : Log
+                m_log;
+
+
+            /** Open the file under the path, if not open yet.
+                If it is the followed file, reopened for a poll, it is read on
+                from the offset.
+            */
+            private : void
+                open_if()
+                    {
+                        if (m_fd>=0)
+                            return;
+
+                        auto
+                            fd = file_open(m_path);
+
+                        if (fd<0)
+                            return;
+
+                        auto
+                            st = file_stat(fd);
+
+                        if (!st)
+                        {
+                            file_close(fd);
+                            return;
+                        }
+
+                        m_fd = fd;
+
+                        if (m_identity==st->first)
+                            return;
+
+                        // another file, the rest of the previous one can't be read anymore
+                        flush_carry();
+
+                        m_identity = st->first;
+                        m_offset   = m_from_begin ? 0 : st->second;
+
+                        // files appearing later are read from their beginning
+                        m_from_begin = true;
+
+                    #ifdef R_LOG_FOLLOW_INOTIFY
+                        if (m_inotify>=0)
+                        {
+                            if (m_watch_file>=0)
+                                ::inotify_rm_watch(m_inotify, m_watch_file);
+
+                            // the watch sticks to the inode, also when it gets renamed
+                            m_watch_file = ::inotify_add_watch(m_inotify, m_path.c_str(), IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+                        }
+                    #endif
+                    }
+
+
+            /// close the file, but keep following it
+            private : void
+                suspend()
+                    {
+                        if (m_fd<0)
+                            return;
+
+                        file_close(m_fd);
+                        m_fd = -1;
+                    }
+
+
+            /// close the file and stop following it
+            private : void
+                close()
+                    {
+                        suspend();
+                        flush_carry();
+
+                        m_identity.reset();
+                    }
+
+
+            /// a line that was not completed won't be anymore
+            private : void
+                flush_carry()
+                    {
+                        if (!m_carry.empty())
+                            deliver(m_carry);
+
+                        m_carry.clear();
+                    }
+
+
+            private : void
+                deliver(
+                        ::std::string_view line
+                    )
+                    {
+                        if (!m_log.deserialize_assign(line))
+                            return;
+
+                        if (m_callback)
+                            m_callback(m_log);
+                    }
+
+
+            /// read and pass on the bytes appended since the last call
+            private : void
+                read_new()
+                    {
+                        if (m_fd<0)
+                            return;
+
+                        if (auto st = file_stat(m_fd); st && st->second<m_offset)
+                        {
+                            // truncated
+                            m_offset = 0;
+                            m_carry.clear();
+                        }
+
+                        while (!m_is_stopped)
+                        {
+                            m_buffer.resize(c_read_size);
+
+                            auto
+                                n = file_read(m_fd, m_buffer.data(), m_buffer.size(), m_offset);
+
+                            if (n<=0)
+                                break;
+
+                            m_offset += n;
+
+                            auto
+                                data = ::std::string_view{m_buffer.data(), ::std::size_t(n)};
+
+                            while (!data.empty())
+                            {
+                                auto
+                                    eol = data.find('\n');
+
+                                if (eol==::std::string_view::npos)
+                                {
+                                    m_carry += data;
+                                    break;
+                                }
+
+                                if (m_carry.empty())
+                                {
+                                    deliver(data.substr(0, eol));
+                                }
+                                else
+                                {
+                                    m_carry += data.substr(0, eol);
+                                    deliver(m_carry);
+                                    m_carry.clear();
+                                }
+
+                                data.remove_prefix(eol+1);
+                            }
+                        }
+                    }
+
+
+            /// TRUE if the path names another file than the followed one
+            private : bool
+                is_replaced() const
+                    {
+                        auto
+                            st = file_stat(-1, m_path);
+
+                        if (!st)
+                            return false; // renamed or removed, stay with the open file
+
+                        return st->first!=m_identity;
+                    }
+
+
+            private : void
+                update()
+                    {
+                        open_if();
+                        read_new();
+
+                        if (m_fd>=0 && is_replaced())
+                        {
+                            // the rest of the old file first
+                            read_new();
+                            close();
+                            open_if();
+                            read_new();
+                        }
+
+                        if (!c_keeps_file_open)
+                            suspend();
+                    }
+
+
+            /// wait for an event, the timeout or stop()
+            private : void
+                wait()
+                    {
+                    #ifdef R_LOG_FOLLOW_INOTIFY
+                        if (m_inotify>=0)
+                        {
+                            wait_inotify();
+                            return;
+                        }
+                    #endif
+
+                        ::std::unique_lock
+                            l {m_mutex};
+
+                        m_cv_stop.wait_for(l, c_poll_interval, [this]{return m_is_stopped.load();});
+                    }
+
+
+#ifdef R_LOG_FOLLOW_INOTIFY
+            private : void
+                wait_inotify()
+                    {
+                        pollfd
+                            fds[2] {
+                                    {m_wake[0], POLLIN, 0}
+                                ,   {m_inotify, POLLIN, 0}
+                                };
+
+                        ::poll(fds, 2, int(::std::chrono::duration_cast<::std::chrono::milliseconds>(c_poll_interval_inotify).count()));
+
+                        // the events only trigger an update, their content doesn't matter
+                        alignas(inotify_event) char
+                            events[4096];
+
+                        while (::read(m_inotify, events, sizeof(events))>0)
+                            ;
+                    }
+#endif
+
+
+            private : void
+                run()
+                    {
+                        thread::set_thread_name("log_follow");
+
+                        while (!m_is_stopped)
+                        {
+                            try
+                            {
+                                update();
+                            }
+                            catch(...)
+                            {
+                                // an exception of the callback must not end the follower
+                            }
+
+                            if (m_is_stopped)
+                                break;
+
+                            wait();
+                        }
+                    }
+        };
+}
+
+
+on_delete
+log_follow(
+    ::fs::path                   const & path
+,   ::std::function<void(Log &)>         callback
+,   bool                                 from_begin
+)
+{
+    auto
+        follower = ::std::make_shared<Follower>(path, ::std::move(callback), from_begin);
+
+    return on_delete{[follower](){follower->stop();}};
+}
+
+
+on_delete
+log_follow(
+    ::fs::path               const & path
+,   concurrent::channel<Log>       & channel
+,   bool                             from_begin
+)
+{
+    auto
+        handle = log_follow(
+                path
+            ,   [&channel](Log & log){channel.send(::std::move(log));}
+            ,   from_begin
+            );
+
+    // drained first, so a follower blocked in send() on a full channel
+    // returns and can be joined
+    return on_delete{[h = ::std::make_shared<on_delete>(::std::move(handle)), &channel]()
+        {
+            channel.drain();
+            h->dispose();
+        }};
+}
+
+}
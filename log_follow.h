@@ -0,0 +1,58 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/filesystem.h"
+#include "r_base/on_delete.h"
+#include "r_base/concurrent.h"
+#include "r_base/Log.h"
+
+#include <functional>
+
+
+namespace nsBase
+{
+
+/**
+    Follow a growing log file like 'tail -F' and pass each appended Log on.
+
+    A background thread keeps the byte offset of the file and a carry of the
+    incomplete last line, so a wake-up reads and parses the new bytes only.
+    On Linux it wakes on inotify events, elsewhere (or if inotify is not
+    available) it polls the file every 250ms.
+
+    The file is followed by its identity, not by its name:
+    - when it gets renamed, e.g. by SessionFileLogger::rename_if(), the
+      follower stays with the renamed file
+    - when a new file appears under the path, e.g. after a rotation, the rest
+      of the old file is read, then the follower switches to the new file
+    - when the file gets truncated, it is read from its beginning again
+
+    On Windows an open file can't be renamed or removed by its writer, so the
+    file is opened for each poll only and followed by its name: a rename is
+    taken like a rotation, and the Logs appended to the old file since the
+    last poll are missed.
+
+    \param from_begin If TRUE, the Logs already in the file are passed on
+        first, otherwise only the Logs appended from now on.
+
+    \return The handle of the follower, it stops following when disposed.
+*/
+[[nodiscard]] on_delete
+    log_follow(
+            ::fs::path                   const & path
+        ,   ::std::function<void(Log &)>         callback
+        ,   bool                                 from_begin = {}
+        );
+
+/** Follow a log file and send each appended Log through the channel.
+    The channel gets drained when the follower stops, the Logs not yet sent
+    are dropped - so stopping doesn't wait for a full channel to be read.
+*/
+[[nodiscard]] on_delete
+    log_follow(
+            ::fs::path               const & path
+        ,   concurrent::channel<Log>       & channel
+        ,   bool                             from_begin = {}
+        );
+
+}
@@ -0,0 +1,718 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+
+namespace nsBase
+{
+
+namespace
+{
+constexpr char
+    c_magic[8] {'R','L','I','D','X','0','0','2'};
+
+constexpr ::std::uint32_t
+    c_block_size = 1024;
+
+struct
+    Header
+        {
+            char            magic[8];
+            ::std::uint32_t block_size;
+            ::std::uint32_t record_size;
+            ::std::uint64_t log_begin;  // the part of the log file in front is not indexed
+        };
+
+struct
+    Entry
+        {
+            ::std::uint64_t offset;
+            ::std::int64_t  time;       // micro seconds since the epoch
+            ::std::uint32_t length;
+            ::std::uint8_t  level;
+            ::std::uint8_t  reserved[3];
+            ::std::uint8_t  creator[16];
+            ::std::uint8_t  event[16];
+        };
+
+struct
+    Summary
+        {
+            ::std::int64_t  time_min;
+            ::std::int64_t  time_max;
+            ::std::uint64_t creators;   // bloom masks
+            ::std::uint64_t events;
+            ::std::uint32_t levels;     // bit per level
+            ::std::uint32_t count;
+            ::std::uint64_t reserved[2];
+        };
+
+static_assert(sizeof(Header)==24);
+static_assert(sizeof(Entry)==56);
+static_assert(sizeof(Summary)==sizeof(Entry));
+
+constexpr ::std::uint64_t
+    c_record_size = sizeof(Entry);
+
+// a complete block is followed by its summary
+constexpr ::std::uint64_t
+    c_block_bytes = (c_block_size+1) * c_record_size;
+
+
+::std::int64_t
+    micros(
+            ::nsBase::time::time_point_t const & tp
+        )
+        {
+            return ::std::chrono::duration_cast<::std::chrono::microseconds>(tp.time_since_epoch()).count();
+        }
+
+::std::uint64_t
+    bloom(
+            ::uuids::uuid const & u
+        )
+        {
+            ::std::uint64_t
+                h[2];
+
+            ::std::memcpy(h, u.as_bytes().data(), sizeof(h));
+
+            auto
+                x = h[0] ^ h[1];
+
+            return (1ull << (x & 63)) | (1ull << ((x>>6) & 63));
+        }
+
+void
+    uuid_to_bytes(
+            ::uuids::uuid const & u
+        ,   ::std::uint8_t      (&target)[16]
+        )
+        {
+            ::std::memcpy(target, u.as_bytes().data(), 16);
+        }
+
+::uuids::uuid
+    uuid_from_bytes(
+            ::std::uint8_t const (&src)[16]
+        )
+        {
+            ::std::uint8_t
+                bytes[16];
+
+            ::std::memcpy(bytes, src, 16);
+
+            return ::uuids::uuid{bytes};
+        }
+
+Entry
+    to_entry(
+            LogIndexEntry const & e
+        )
+        {
+            Entry
+                r {};
+                r.offset = e.offset;
+                r.time   = micros(e.time);
+                r.length = e.length;
+                r.level  = ::std::uint8_t(e.level);
+
+            uuid_to_bytes(e.creator, r.creator);
+            uuid_to_bytes(e.event  , r.event);
+
+            return r;
+        }
+
+LogIndexEntry
+    from_entry(
+            Entry const & r
+        )
+        {
+            LogIndexEntry
+                e;
+                e.offset  = r.offset;
+                e.length  = r.length;
+                e.time    = ::nsBase::time::time_point_t{::std::chrono::microseconds{r.time}};
+                e.level   = Log::Level(r.level);
+                e.creator = uuid_from_bytes(r.creator);
+                e.event   = uuid_from_bytes(r.event);
+
+            return e;
+        }
+
+
+/// FALSE if the stream does not start with the header of an index
+bool
+    header_read(
+            ::std::istream & stream
+        ,   Header         & h
+        )
+        {
+            return
+                    stream.read(reinterpret_cast<char*>(&h), sizeof(h))
+                &&  ::std::memcmp(h.magic, c_magic, sizeof(c_magic))==0
+                &&  h.block_size == c_block_size
+                &&  h.record_size == c_record_size
+                ;
+        }
+
+
+/// FALSE if no Log of the block can match
+bool
+    may_match(
+            LogIndexFilter const & f
+        ,   Summary        const & s
+        )
+        {
+            if (f.time_min && s.time_max < micros(*f.time_min))
+                return false;
+
+            if (f.time_max && s.time_min > micros(*f.time_max))
+                return false;
+
+            if (f.level_min && (s.levels >> int(*f.level_min))==0)
+                return false;
+
+            if (f.creator && (s.creators & bloom(*f.creator))!=bloom(*f.creator))
+                return false;
+
+            if (f.event && (s.events & bloom(*f.event))!=bloom(*f.event))
+                return false;
+
+            return true;
+        }
+
+
+/// the matching entries, EMPTY if the file is not a valid index
+::std::optional<::std::vector<LogIndexEntry>>
+    index_scan(
+            ::fs::path     const & path
+        ,   LogIndexFilter const & filter
+        )
+        {
+            ::std::ifstream
+                stream {path, ::std::ios::in | ::std::ios::binary};
+
+            Header
+                h {};
+
+            if (!header_read(stream, h))
+                return {};
+
+            ::std::error_code
+                err;
+
+            auto
+                size = ::fs::file_size(path, err);
+
+            if (err)
+                return {};
+
+            auto
+                records = (size - sizeof(Header)) / c_record_size;
+
+            auto
+                blocks = records / (c_block_size+1);
+
+            ::std::vector<LogIndexEntry>
+                matches;
+
+            ::std::vector<Entry>
+                entries;
+
+            auto
+                scan = [&](::std::uint64_t position, ::std::uint64_t count)
+                    {
+                        entries.resize(count);
+
+                        stream.seekg(::std::streamoff(position));
+                        stream.read(reinterpret_cast<char*>(entries.data()), ::std::streamsize(count * c_record_size));
+
+                        for (auto & r : entries)
+                        {
+                            auto
+                                e = from_entry(r);
+
+                            if (filter.matches(e))
+                                matches.push_back(e);
+                        }
+                    };
+
+            for (auto b = 0_sz; b<blocks; ++b)
+            {
+                auto
+                    position = sizeof(Header) + b * c_block_bytes;
+
+                Summary
+                    s {};
+
+                stream.seekg(::std::streamoff(position + c_block_size * c_record_size));
+                stream.read(reinterpret_cast<char*>(&s), sizeof(s));
+
+                if (may_match(filter, s))
+                    scan(position, c_block_size);
+            }
+
+            // the incomplete block
+            scan(
+                    sizeof(Header) + blocks * c_block_bytes
+                ,   records - blocks * (c_block_size+1)
+                );
+
+            if (!stream)
+                return {};
+
+            return matches;
+        }
+
+
+struct
+    Tail
+        {
+            // the entries of the incomplete block
+            ::std::vector<LogIndexEntry>
+                entries;
+
+            // the begin of the indexed part of the log file
+            ::std::uint64_t
+                begin {};
+
+            // the end of the indexed part of the log file
+            ::std::uint64_t
+                end {};
+
+            // size of the index without a torn record
+            ::std::uint64_t
+                size {};
+        };
+
+/// EMPTY if the file is not a valid index
+::std::optional<Tail>
+    index_tail(
+            ::fs::path const & path
+        )
+        {
+            ::std::ifstream
+                stream {path, ::std::ios::in | ::std::ios::binary};
+
+            Header
+                h {};
+
+            if (!header_read(stream, h))
+                return {};
+
+            ::std::error_code
+                err;
+
+            auto
+                size = ::fs::file_size(path, err);
+
+            if (err)
+                return {};
+
+            auto
+                records = (size - sizeof(Header)) / c_record_size;
+
+            auto
+                in_block = records % (c_block_size+1);
+
+            Tail
+                tail;
+                tail.size  = sizeof(Header) + records * c_record_size;
+                tail.begin = h.log_begin;
+                tail.end   = h.log_begin;
+
+            // behind a complete block, the last entry is the one in front of its summary
+            auto
+                first = records - in_block - (in_block==0 && records ? 2 : 0);
+
+            ::std::vector<Entry>
+                entries(records - first);
+
+            stream.seekg(::std::streamoff(sizeof(Header) + first * c_record_size));
+
+            if (!stream.read(reinterpret_cast<char*>(entries.data()), ::std::streamsize(entries.size() * c_record_size)))
+                return {};
+
+            if (!in_block && records)
+                entries.pop_back(); // the summary
+
+            for (auto & r : entries)
+            {
+                if (in_block)
+                    tail.entries.push_back(from_entry(r));
+
+                tail.end = ::std::max(tail.end, r.offset + r.length);
+            }
+
+            return tail;
+        }
+
+
+/// call 'f' with each Log of the log file between the offsets and the entry of its line
+template<typename F>
+void
+    lines_for_each(
+            ::std::istream       & stream
+        ,   ::std::uint64_t        begin
+        ,   ::std::uint64_t        end
+        ,   F              const & f
+        )
+        {
+            stream.clear();
+            stream.seekg(::std::streamoff(begin));
+
+            ::std::string
+                line;
+
+            for (auto offset = begin; offset<end && ::std::getline(stream, line); )
+            {
+                auto
+                    length = line.size() + (stream.eof() ? 0 : 1);
+
+                if (auto log = Log::deserialize(line))
+                {
+                    auto
+                        e = LogIndexEntry::of(*log);
+                        e.offset = offset;
+                        e.length = ::std::uint32_t(length);
+
+                    f(*log, e);
+                }
+
+                offset += length;
+            }
+
+            stream.clear();
+        }
+
+
+/// parse the lines of the log file between the offsets
+void
+    logs_read_range(
+            ::std::vector<Log>   & logs
+        ,   ::std::istream       & stream
+        ,   ::std::uint64_t        begin
+        ,   ::std::uint64_t        end
+        ,   LogIndexFilter const & filter
+        )
+        {
+            lines_for_each(stream, begin, end, [&](Log & log, LogIndexEntry const & e)
+                {
+                    if (filter.matches(e))
+                        logs.push_back(::std::move(log));
+                });
+        }
+}
+
+
+LogIndexEntry
+LogIndexEntry::of(
+    Log const & log
+)
+{
+    // the precision of the serialized time
+    LogIndexEntry
+        e;
+        e.time    = ::std::chrono::floor<::std::chrono::milliseconds>(log.time());
+        e.level   = log.level();
+        e.creator = log.creator();
+        e.event   = log.event();
+
+    return e;
+}
+
+
+bool
+LogIndexFilter::matches(
+    LogIndexEntry const & e
+) const
+{
+    if (time_min && e.time < *time_min)
+        return false;
+
+    if (time_max && e.time > *time_max)
+        return false;
+
+    if (level_min && int(e.level) < int(*level_min))
+        return false;
+
+    if (creator && e.creator!=*creator)
+        return false;
+
+    if (event && e.event!=*event)
+        return false;
+
+    return true;
+}
+
+
+::fs::path
+log_index_path(
+    ::fs::path const & log_path
+)
+{
+    auto
+        p = log_path;
+        p += ".idx";
+
+    return p;
+}
+
+
+LogIndexWriter::~LogIndexWriter()
+{
+    close();
+}
+
+
+bool
+LogIndexWriter::open(
+    ::fs::path const & log_path
+)
+{
+    close();
+
+    m_path = log_index_path(log_path);
+
+    ::std::error_code
+        err;
+
+    auto
+        log_size = ::fs::exists(log_path, err) ? ::fs::file_size(log_path, err) : 0;
+
+    auto
+        size = ::fs::exists(m_path, err) ? ::fs::file_size(m_path, err) : 0;
+
+    // resume the incomplete block
+    m_block_count = 0;
+    m_pending.clear();
+
+    // the end of the indexed part of the log file
+    auto
+        end = log_size;
+
+    if (size)
+    {
+        auto
+            tail = index_tail(m_path);
+
+        if (tail && tail->end <= log_size)
+        {
+            // drop a torn record
+            if (size != tail->size)
+                ::fs::resize_file(m_path, tail->size, err);
+
+            for (auto & e : tail->entries)
+                add(e);
+
+            // those are in the file already
+            m_pending.clear();
+
+            end = tail->end;
+        }
+        else
+        {
+            ::fs::remove(m_path, err);
+            size = 0;
+        }
+    }
+
+    if (!m_file.open(m_path))
+        return false;
+
+    if (!size)
+    {
+        // the content already in the log file is left to the readers
+        Header
+            h {};
+            h.block_size  = c_block_size;
+            h.record_size = c_record_size;
+            h.log_begin   = log_size;
+
+        ::std::memcpy(h.magic, c_magic, sizeof(c_magic));
+
+        m_file.write({reinterpret_cast<char const*>(&h), sizeof(h)});
+    }
+
+    // catch up with the lines written without the index, e.g. lost by a crash
+    if (end < log_size)
+    {
+        ::std::ifstream
+            stream {log_path, ::std::ios::in | ::std::ios::binary};
+
+        lines_for_each(stream, end, log_size, [&](Log &, LogIndexEntry const & e){add(e);});
+
+        flush();
+    }
+
+    return true;
+}
+
+
+void
+LogIndexWriter::close()
+{
+    if (!is_open())
+        return;
+
+    flush();
+
+    m_file.close();
+}
+
+
+void
+LogIndexWriter::remove()
+{
+    m_pending.clear();
+
+    m_file.close();
+
+    ::std::error_code
+        err;
+
+    if (!m_path.empty())
+        ::fs::remove(m_path, err);
+}
+
+
+void
+LogIndexWriter::add(
+    LogIndexEntry const & e
+)
+{
+    auto
+        r = to_entry(e);
+
+    if (!m_block_count)
+    {
+        m_block_time_min = r.time;
+        m_block_time_max = r.time;
+        m_block_creators = 0;
+        m_block_events   = 0;
+        m_block_levels   = 0;
+    }
+
+    m_block_time_min = ::std::min(m_block_time_min, r.time);
+    m_block_time_max = ::std::max(m_block_time_max, r.time);
+    m_block_creators |= bloom(e.creator);
+    m_block_events   |= bloom(e.event);
+    m_block_levels   |= 1u << r.level;
+
+    m_pending.append(reinterpret_cast<char const*>(&r), sizeof(r));
+
+    if (++m_block_count==c_block_size)
+    {
+        Summary
+            s {};
+            s.time_min = m_block_time_min;
+            s.time_max = m_block_time_max;
+            s.creators = m_block_creators;
+            s.events   = m_block_events;
+            s.levels   = m_block_levels;
+            s.count    = m_block_count;
+
+        m_pending.append(reinterpret_cast<char const*>(&s), sizeof(s));
+
+        m_block_count = 0;
+    }
+
+    if (m_pending.size() >= 64 * c_record_size)
+        flush();
+}
+
+
+bool
+LogIndexWriter::flush()
+{
+    if (m_pending.empty())
+        return true;
+
+    auto
+        ok = m_file.write(m_pending);
+
+    m_pending.clear();
+
+    return ok;
+}
+
+
+void
+logs_read(
+    ::std::vector<Log>   & logs
+,   ::fs::path     const & path
+,   LogIndexFilter const & filter
+)
+{
+    ::std::ifstream
+        stream {path, ::std::ios::in | ::std::ios::binary};
+
+    if (!stream)
+        return;
+
+    auto
+        tail = index_tail(log_index_path(path));
+
+    auto
+        matches = tail ? index_scan(log_index_path(path), filter) : ::std::nullopt;
+
+    if (!matches)
+    {
+        // compressed or not indexed
+        auto
+            all = log_read(path);
+
+        for (auto & log : all)
+            if (filter.matches(LogIndexEntry::of(log)))
+                logs.push_back(::std::move(log));
+
+        return;
+    }
+
+    // the index might have been started on a log file with content
+    logs_read_range(logs, stream, 0, tail->begin, filter);
+
+    ::std::string
+        line;
+
+    for (auto & e : *matches)
+    {
+        line.resize(e.length);
+
+        stream.seekg(::std::streamoff(e.offset));
+
+        if (!stream.read(line.data(), ::std::streamsize(line.size())))
+        {
+            stream.clear();
+            continue;
+        }
+
+        if (auto log = Log::deserialize(line))
+            logs.push_back(::std::move(*log));
+    }
+
+    // the index might lag behind
+    logs_read_range(logs, stream, tail->end, ::std::numeric_limits<::std::uint64_t>::max(), filter);
+}
+
+
+::std::vector<Log>
+log_read(
+    ::fs::path     const & path
+,   LogIndexFilter const & filter
+)
+{
+    ::std::vector<Log>
+        logs;
+
+    logs_read(logs, path, filter);
+
+    return logs;
+}
+
+}
@@ -0,0 +1,194 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/filesystem.h"
+#include "r_base/AppendFile.h"
+#include "r_base/Log.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    A Log line as recorded in the sidecar index of a log file.
+*/
+struct LogIndexEntry
+{
+    /// byte offset of the line in the log file
+    ::std::uint64_t
+        offset {};
+
+    /// length of the line including the line break
+    ::std::uint32_t
+        length {};
+
+    ::nsBase::time::time_point_t
+        time;
+
+    Log::Level
+        level {Log::Level::DEBUG};
+
+    ::uuids::uuid
+        creator;
+
+    ::uuids::uuid
+        event;
+
+    /// the entry of the target Log, offset and length still have to be set
+    static LogIndexEntry
+        of(
+                Log const &
+            );
+};
+
+
+/**
+    Selects Logs by their indexed properties.
+    EMPTY conditions match everything.
+*/
+struct LogIndexFilter
+{
+    /// inclusive
+    ::std::optional<::nsBase::time::time_point_t>
+        time_min;
+
+    /// inclusive
+    ::std::optional<::nsBase::time::time_point_t>
+        time_max;
+
+    ::std::optional<Log::Level>
+        level_min;
+
+    ::std::optional<::uuids::uuid>
+        creator;
+
+    ::std::optional<::uuids::uuid>
+        event;
+
+    bool
+        matches(
+                LogIndexEntry const &
+            ) const;
+};
+
+
+/** The path of the sidecar index of the target log file.
+*/
+::fs::path
+    log_index_path(
+            ::fs::path const & log_path
+        );
+
+
+/**
+    Appends entries to the sidecar index of a log file.
+
+    The index is a sequence of fixed-size entries, grouped into blocks. Each
+    complete block is followed by a summary (time span, levels, bloom masks of
+    creators and events), so a reader skips the blocks that cannot match
+    without looking at their entries.
+
+    Entries are kept in the order of the lines in the log file, they are not
+    sorted by time. Logs of racing threads reach the file slightly out of
+    order, the time span of each block covers that without rewriting the
+    index.
+
+    The index may lag behind its log file - readers parse the unindexed tail,
+    and open() indexes the lines the index missed, e.g. due to a crash. An
+    index started on a log file with content covers the lines appended from
+    then on, readers parse the part in front.
+    It assumes that this process is the only writer of the log file.
+*/
+class LogIndexWriter
+{
+    R_DTOR(LogIndexWriter);
+    R_CTOR(LogIndexWriter) = default;
+    R_CCPY(LogIndexWriter) = delete;
+    R_CMOV(LogIndexWriter) = default;
+    R_COPY(LogIndexWriter) = delete;
+    R_MOVE(LogIndexWriter) = default;
+
+    /** Open or create the index of the target log file.
+        An index that does not fit the log file is started over.
+        \return FALSE on failure.
+    */
+    public : bool
+        open(
+                ::fs::path const & log_path
+            );
+
+    public : bool
+        is_open() const
+            {
+                return m_file.is_open();
+            }
+
+    /** Flush and close the index.
+    */
+    public : void
+        close();
+
+    /** Close and delete the index, e.g. before the log file gets rotated.
+    */
+    public : void
+        remove();
+
+    /** Queue an entry. Entries get written in batches.
+    */
+    public : void
+        add(
+                LogIndexEntry const &
+            );
+
+    /** Write the queued entries.
+    */
+    public : bool
+        flush();
+
+    private : AppendFile
+        m_file;
+
+    private : ::fs::path
+        m_path;
+
+    private : ::std::string
+        m_pending;
+
+    // count of entries in the current block
+    private : ::std::uint32_t
+        m_block_count {};
+
+    private : ::std::int64_t  m_block_time_min {};
+    private : ::std::int64_t  m_block_time_max {};
+    private : ::std::uint64_t m_block_creators {};
+    private : ::std::uint64_t m_block_events   {};
+    private : ::std::uint32_t m_block_levels   {};
+};
+
+
+/**
+    Read the Logs of a log file that match the filter.
+
+    If the file has a sidecar index, only the matching lines are read,
+    otherwise the whole file is parsed.
+*/
+::std::vector<Log>
+    log_read(
+            ::fs::path     const & path
+        ,   LogIndexFilter const & filter
+        );
+
+void
+    logs_read(
+            ::std::vector<Log>   & target
+        ,   ::fs::path     const & path
+        ,   LogIndexFilter const & filter
+        );
+
+}
@@ -0,0 +1,206 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_merge.h"
+#include "r_base/log_stream.h"
+#include "r_base/concurrent.h"
+#include "r_base/thread.h"
+
+#include <exception>
+#include <memory>
+#include <queue>
+#include <thread>
+
+
+namespace nsBase
+{
+
+namespace
+{
+/// count of Logs deserialized ahead per input
+constexpr ::std::size_t
+    c_chunk_size = 256;
+
+
+class
+    Input
+        {
+            R_DTOR(Input)
+                {
+                    // let a reader blocked in send() return
+                    m_chunks.drain();
+
+                    if (m_thread.joinable())
+                        m_thread.join();
+                }
+
+            R_CTOR(Input) = default;
+            R_CCPY(Input) = delete;
+            R_CMOV(Input) = delete;
+            R_COPY(Input) = delete;
+            R_MOVE(Input) = delete;
+
+            // the chunk being merged plus the one read ahead
+            private : concurrent::channel<::std::vector<Log>>
+                m_chunks {1};
+
+            private : ::std::thread
+                m_thread;
+
+            // set by the reader before the channel gets drained
+            private : ::std::exception_ptr
+                m_error;
+
+            private : ::std::vector<Log>
+                m_chunk;
+
+            private : ::std::size_t
+                m_pos {};
+
+            public : void
+                start(
+                        ::fs::path path
+                    )
+                    {
+                        m_thread = ::std::thread{[this, path = ::std::move(path)]()
+                            {
+                                thread::set_thread_name("log_merge");
+
+                                try
+                                {
+                                    ::std::vector<Log>
+                                        chunk;
+
+                                    chunk.reserve(c_chunk_size);
+
+                                    for (auto & log : log_stream(path))
+                                    {
+                                        chunk.push_back(::std::move(log));
+
+                                        if (chunk.size()<c_chunk_size)
+                                            continue;
+
+                                        if (!m_chunks.send(::std::move(chunk)))
+                                            return; // the merge was abandoned
+
+                                        chunk = ::std::vector<Log>{};
+                                        chunk.reserve(c_chunk_size);
+                                    }
+
+                                    if (!chunk.empty())
+                                        m_chunks.send(::std::move(chunk));
+                                }
+                                catch(...)
+                                {
+                                    m_error = ::std::current_exception();
+                                }
+
+                                m_chunks.drain();
+                            }};
+                    }
+
+            /** Make the next Log current.
+                \return FALSE at the end of the input.
+            */
+            public : bool
+                next()
+                    {
+                        if (m_pos<m_chunk.size())
+                            return true;
+
+                        auto
+                            chunk = m_chunks.recv();
+
+                        if (!chunk)
+                        {
+                            if (m_error)
+                                ::std::rethrow_exception(m_error);
+
+                            return false;
+                        }
+
+                        m_chunk = ::std::move(*chunk);
+                        m_pos   = 0;
+
+                        return !m_chunk.empty();
+                    }
+
+            public : Log &
+                current()
+                    {
+                        return m_chunk[m_pos];
+                    }
+
+            public : void
+                pop()
+                    {
+                        ++m_pos;
+                    }
+        };
+}
+
+
+::std::uint64_t
+logs_merge(
+    ::std::vector<::fs::path>       const & paths
+,   ::std::function<void(Log &)>    const & sink
+)
+{
+    ::std::vector<::std::unique_ptr<Input>>
+        inputs;
+
+    for (auto & path : paths)
+    {
+        inputs.push_back(::std::make_unique<Input>());
+        inputs.back()->start(path);
+    }
+
+    // the top is the input with the earliest Log
+    auto
+        is_later = [&](::std::size_t a, ::std::size_t b)
+            {
+                auto & la = inputs[a]->current();
+                auto & lb = inputs[b]->current();
+
+                if (la.time()!=lb.time())
+                    return la.time() > lb.time();
+
+                if (la.id()!=lb.id())
+                    return lb.id() < la.id();
+
+                return a > b;
+            };
+
+    ::std::priority_queue<::std::size_t, ::std::vector<::std::size_t>, decltype(is_later)>
+        heap {is_later};
+
+    for (auto i=0_sz; i<inputs.size(); ++i)
+        if (inputs[i]->next())
+            heap.push(i);
+
+    ::std::uint64_t
+        count {};
+
+    while (!heap.empty())
+    {
+        auto
+            i = heap.top();
+
+        heap.pop();
+
+        auto &
+            input = *inputs[i];
+
+        ++count;
+
+        if (sink)
+            sink(input.current());
+
+        input.pop();
+
+        if (input.next())
+            heap.push(i);
+    }
+
+    return count;
+}
+
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/filesystem.h"
+#include "r_base/Log.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    Merge the Logs of several log files into a single stream, ordered by time
+    and Logs of the same time by id.
+
+    Each input is a log file including its rotated segments (see log_stream())
+    and expected to be ordered by time, like the files written by a single
+    logger. The merge doesn't reorder Logs within an input.
+
+    Each input is read ahead by a thread of its own, which deserializes the
+    next chunk of Logs while the current one is merged. So the memory needed
+    is bounded by a few chunks per input, regardless of the file sizes.
+
+    \param sink Receives the Logs, it may move them away.
+
+    \return The count of Logs passed to the sink.
+
+    \throws if a file cannot be read. Exceptions of the sink are passed on.
+*/
+::std::uint64_t
+    logs_merge(
+            ::std::vector<::fs::path>       const & paths
+        ,   ::std::function<void(Log &)>    const & sink
+        );
+
+}
@@ -0,0 +1,712 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_metrics.h"
+
+#include "r_base/time.h"
+#include "r_base/current.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+namespace nsBase
+{
+using namespace ::std::string_literals;
+
+namespace
+{
+/*  Log-linear histogram of nanoseconds.
+    Values below 4ns get their own bucket. Above, each power of two is split
+    into 4 sub-buckets which bounds the relative error to 25%.
+    Durations beyond 2^34ns (~17s) end up in the last bucket.
+*/
+constexpr ::std::size_t
+    c_bucket_count = 4 + 32*4;
+
+constexpr ::std::size_t
+    c_consumer_slot_count = 32;
+
+::std::size_t
+    bucket_of(
+            ::std::uint64_t ns
+        )
+        {
+            if (ns<4)
+                return ns;
+
+            auto e   = ::std::size_t(::std::bit_width(ns)) - 1;
+            auto sub = ::std::size_t(ns >> (e-2)) & 3;
+
+            return ::std::min(c_bucket_count-1, 4 + (e-2)*4 + sub);
+        }
+
+// mid of the value range covered by a bucket
+::std::uint64_t
+    bucket_value(
+            ::std::size_t i
+        )
+        {
+            if (i<4)
+                return i;
+
+            auto e   = (i-4)/4 + 2;
+            auto sub = (i-4)%4;
+
+            auto lower = (4+sub) << (e-2);
+            auto width = ::std::uint64_t{1} << (e-2);
+
+            return lower + width/2;
+        }
+
+
+/*  Only the owning thread writes, so load()+store() is sufficient and avoids
+    the locked read-modify-write of fetch_add().
+*/
+struct Counter
+{
+    ::std::atomic<::std::uint64_t>
+        v {};
+
+    void
+        add(::std::uint64_t n)
+            {
+                v.store(v.load(::std::memory_order_relaxed) + n, ::std::memory_order_relaxed);
+            }
+
+    void
+        max(::std::uint64_t n)
+            {
+                if (n > v.load(::std::memory_order_relaxed))
+                    v.store(n, ::std::memory_order_relaxed);
+            }
+
+    void
+        reset()
+            {
+                v.store(0, ::std::memory_order_relaxed);
+            }
+
+    ::std::uint64_t
+        get() const
+            {
+                return v.load(::std::memory_order_relaxed);
+            }
+};
+
+
+struct ConsumerSlot
+{
+    // -1 : unused
+    ::std::atomic<int>
+        id {-1};
+
+    Counter calls;
+    Counter total_ns;
+    Counter max_ns;
+
+    ::std::array<Counter, c_bucket_count>
+        buckets;
+
+    void
+        reset()
+            {
+                calls.reset();
+                total_ns.reset();
+                max_ns.reset();
+
+                for (auto & b : buckets)
+                    b.reset();
+            }
+};
+
+
+struct ThreadBlock
+{
+    Counter constructed;
+    Counter broadcast;
+    Counter suppressed_by_level;
+    Counter dropped;
+    Counter bytes_serialized;
+
+    ::std::array<ConsumerSlot, c_consumer_slot_count>
+        consumers;
+
+    // the retirements of consumers this block has caught up with - guarded
+    // by the registry mutex, 0 until the first record of a consumer
+    ::std::uint64_t
+        consumers_retired_epoch {};
+
+    // nullptr if all slots are taken or the consumer is retired
+    ConsumerSlot *
+        slot(
+                int id
+            );
+};
+
+
+// plain accumulator for the counters of terminated threads and for snapshots
+struct ConsumerSum
+{
+    ::std::uint64_t calls    {};
+    ::std::uint64_t total_ns {};
+    ::std::uint64_t max_ns   {};
+
+    ::std::array<::std::uint64_t, c_bucket_count>
+        buckets {};
+
+    void
+        add(ConsumerSlot const & s)
+            {
+                calls    += s.calls.get();
+                total_ns += s.total_ns.get();
+                max_ns    = ::std::max(max_ns, s.max_ns.get());
+
+                for (auto i=0_sz; i<c_bucket_count; ++i)
+                    buckets[i] += s.buckets[i].get();
+            }
+
+    void
+        add(ConsumerSum const & s)
+            {
+                calls    += s.calls;
+                total_ns += s.total_ns;
+                max_ns    = ::std::max(max_ns, s.max_ns);
+
+                for (auto i=0_sz; i<c_bucket_count; ++i)
+                    buckets[i] += s.buckets[i];
+            }
+
+    ::std::uint64_t
+        percentile(double p) const
+            {
+                if (!calls)
+                    return 0;
+
+                auto rank = ::std::uint64_t(p * double(calls));
+                auto seen = ::std::uint64_t{};
+
+                for (auto i=0_sz; i<c_bucket_count; ++i)
+                {
+                    seen += buckets[i];
+
+                    if (seen>rank)
+                        return ::std::min(bucket_value(i), max_ns);
+                }
+
+                return max_ns;
+            }
+};
+
+
+struct Sum
+{
+    ::std::uint64_t constructed         {};
+    ::std::uint64_t broadcast           {};
+    ::std::uint64_t suppressed_by_level {};
+    ::std::uint64_t dropped             {};
+    ::std::uint64_t bytes_serialized    {};
+
+    ::std::map<int, ConsumerSum>
+        consumers;
+
+    void
+        add(ThreadBlock const & b)
+            {
+                constructed         += b.constructed        .get();
+                broadcast           += b.broadcast          .get();
+                suppressed_by_level += b.suppressed_by_level.get();
+                dropped             += b.dropped            .get();
+                bytes_serialized    += b.bytes_serialized   .get();
+
+                for (auto & s : b.consumers)
+                {
+                    if (auto id = s.id.load(::std::memory_order_acquire); id!=-1)
+                        consumers[id].add(s);
+                }
+            }
+
+    void
+        drop(::std::map<int, ::std::uint64_t> const & consumer_ids)
+            {
+                ::std::erase_if(consumers, [&](auto const & c){return consumer_ids.contains(c.first);});
+            }
+
+    void
+        add(Sum const & s)
+            {
+                constructed         += s.constructed;
+                broadcast           += s.broadcast;
+                suppressed_by_level += s.suppressed_by_level;
+                dropped             += s.dropped;
+                bytes_serialized    += s.bytes_serialized;
+
+                for (auto & [id,c] : s.consumers)
+                    consumers[id].add(c);
+            }
+};
+
+
+struct Registry
+{
+    ::std::mutex
+        mutex;
+
+    ::std::list<ThreadBlock*>
+        blocks;
+
+    // contributions of terminated threads
+    Sum
+        retired;
+
+    // disposed consumers and the epoch of their retirement, ids aren't re-used;
+    // kept until every thread has caught up with the epoch
+    ::std::map<int, ::std::uint64_t>
+        retired_consumers;
+
+    // incremented on each change of retired_consumers
+    ::std::atomic<::std::uint64_t>
+        consumers_retired_epoch {};
+
+    unsigned int
+        queue_next_id {};
+
+    ::std::map<unsigned int, ::std::pair<::std::string, ::std::function<::std::size_t()>>>
+        queues;
+
+    /** Forget the retired consumers every thread has caught up with: their
+        slots are freed and a record still in flight was rejected by the
+        catch-up. A thread that doesn't record holds the entries back until it
+        records again or terminates. Call locked.
+    */
+    void
+        retired_consumers_prune()
+            {
+                auto
+                    epoch = consumers_retired_epoch.load(::std::memory_order_relaxed);
+
+                for (auto b : blocks)
+                    epoch = ::std::min(epoch, b->consumers_retired_epoch);
+
+                ::std::erase_if(retired_consumers, [&](auto const & c){return c.second<=epoch;});
+            }
+};
+
+
+Registry &
+    obtain_registry()
+        {
+            static ::std::atomic<Registry*>
+                registry {};
+
+            if (!registry.load())
+            {
+                Registry *
+                    null {};
+
+                auto r = ::std::make_unique<Registry>();
+
+                if (registry.compare_exchange_strong(null, r.get()))
+                    r.release();
+            }
+
+            return *registry.load();
+        }
+
+
+struct ThreadHolder
+{
+    ThreadBlock
+        block;
+
+    ThreadHolder()
+        {
+            auto & r = obtain_registry();
+
+            ::std::lock_guard<::std::mutex>
+                guard(r.mutex);
+
+            r.blocks.push_back(&block);
+        }
+
+    ~ThreadHolder()
+        {
+            auto & r = obtain_registry();
+
+            ::std::lock_guard<::std::mutex>
+                guard(r.mutex);
+
+            r.retired.add(block);
+            r.retired.drop(r.retired_consumers);
+            r.blocks.remove(&block);
+
+            // this thread might have been the last one behind
+            r.retired_consumers_prune();
+        }
+};
+
+
+/*  The slots are written by the owning thread only. A retirement of a consumer
+    just bumps the epoch, the owner frees the slots of retired consumers when it
+    notices.
+*/
+ConsumerSlot *
+ThreadBlock::slot(
+    int id
+)
+{
+    auto & r = obtain_registry();
+
+    // read unlocked, only this thread writes it
+    if (r.consumers_retired_epoch.load(::std::memory_order_acquire)!=consumers_retired_epoch)
+    {
+        ::std::lock_guard<::std::mutex>
+            guard(r.mutex);
+
+        for (auto & s : consumers)
+            if (r.retired_consumers.contains(s.id.load(::std::memory_order_relaxed)))
+                s.id.store(-1, ::std::memory_order_release);
+
+        // a call that was in flight during the retirement, checked before
+        // the entry gets pruned
+        auto
+            is_retired = r.retired_consumers.contains(id);
+
+        consumers_retired_epoch = r.consumers_retired_epoch.load(::std::memory_order_relaxed);
+
+        r.retired_consumers_prune();
+
+        if (is_retired)
+            return nullptr;
+    }
+
+    auto start = ::std::size_t(id) % c_consumer_slot_count;
+
+    ConsumerSlot *
+        free {};
+
+    for (auto n=0_sz; n<c_consumer_slot_count; ++n)
+    {
+        auto & s = consumers[(start+n) % c_consumer_slot_count];
+        auto   i = s.id.load(::std::memory_order_relaxed);
+
+        if (i==id)
+            return &s;
+
+        if (i==-1 && !free)
+            free = &s;
+    }
+
+    if (!free)
+        return nullptr;
+
+    // once per consumer and thread - a call still in flight when the consumer
+    // got disposed must not bring its slot back
+    ::std::lock_guard<::std::mutex>
+        guard(r.mutex);
+
+    if (r.retired_consumers.contains(id))
+        return nullptr;
+
+    free->reset();
+    free->id.store(id, ::std::memory_order_release);
+
+    return free;
+}
+
+
+ThreadBlock &
+    thread_block()
+        {
+            thread_local ThreadHolder
+                holder;
+
+            return holder.block;
+        }
+
+
+::std::atomic_bool
+    s_enabled {true};
+}
+
+
+void
+log_metrics_enable(
+    bool v
+)
+{
+    s_enabled = v;
+}
+
+
+bool
+log_metrics_enabled()
+{
+    return s_enabled.load(::std::memory_order_relaxed);
+}
+
+
+void
+log_metrics_count_constructed()
+{
+    if (log_metrics_enabled())
+        thread_block().constructed.add(1);
+}
+
+
+void
+log_metrics_count_broadcast()
+{
+    if (log_metrics_enabled())
+        thread_block().broadcast.add(1);
+}
+
+
+void
+log_metrics_count_suppressed_by_level()
+{
+    if (log_metrics_enabled())
+        thread_block().suppressed_by_level.add(1);
+}
+
+
+void
+log_metrics_count_dropped()
+{
+    if (log_metrics_enabled())
+        thread_block().dropped.add(1);
+}
+
+
+void
+log_metrics_count_bytes_serialized(
+    ::std::size_t n
+)
+{
+    if (log_metrics_enabled())
+        thread_block().bytes_serialized.add(n);
+}
+
+
+void
+log_metrics_record_consumer(
+    int                        consumer_id
+,   ::std::chrono::nanoseconds duration
+)
+{
+    if (!log_metrics_enabled())
+        return;
+
+    auto
+        slot = thread_block().slot(consumer_id);
+
+    if (!slot)
+        return; // all slots taken by other consumers
+
+    auto
+        ns = ::std::uint64_t(::std::max<::std::int64_t>(0, duration.count()));
+
+    slot->calls.add(1);
+    slot->total_ns.add(ns);
+    slot->max_ns.max(ns);
+    slot->buckets[bucket_of(ns)].add(1);
+}
+
+
+LogMetricsSnapshot
+log_metrics_snapshot()
+{
+    Sum
+        sum;
+
+    ::std::vector<::std::pair<::std::string, ::std::function<::std::size_t()>>>
+        queues;
+
+    {
+        auto & r = obtain_registry();
+
+        ::std::lock_guard<::std::mutex>
+            guard(r.mutex);
+
+        sum.add(r.retired);
+
+        for (auto b : r.blocks)
+            sum.add(*b);
+
+        // slots not yet freed by their owners
+        sum.drop(r.retired_consumers);
+
+        for (auto & [id,q] : r.queues)
+            queues.push_back(q);
+    }
+
+    LogMetricsSnapshot
+        s;
+        s.time                = current::time();
+        s.constructed         = sum.constructed;
+        s.broadcast           = sum.broadcast;
+        s.suppressed_by_level = sum.suppressed_by_level;
+        s.dropped             = sum.dropped;
+        s.bytes_serialized    = sum.bytes_serialized;
+
+    for (auto & [id,c] : sum.consumers)
+    {
+        auto &
+            m = s.consumers[id];
+            m.calls = c.calls;
+            m.total = ::std::chrono::nanoseconds(c.total_ns);
+            m.p50   = ::std::chrono::nanoseconds(c.percentile(0.50));
+            m.p99   = ::std::chrono::nanoseconds(c.percentile(0.99));
+            m.max   = ::std::chrono::nanoseconds(c.max_ns);
+    }
+
+    // the depth functions are called unlocked
+    for (auto & [name,depth] : queues)
+        if (depth)
+            s.queue_depths[name] = depth();
+
+    return s;
+}
+
+
+Log
+log_metrics_log(
+    LogMetricsSnapshot const & s
+)
+{
+    auto
+        log = "6f0d3e2a-51c7-4b8e-9a0e-3c1f7d5b2e84"_log();
+        log
+            ("log pipeline: ${constructed} constructed, ${broadcast} broadcast, ${suppressed_by_level} suppressed, ${dropped} dropped, ${bytes_serialized} bytes serialized")
+            .debug()
+            .event("d2b7c1a4-8e3f-4f6a-b5d9-0c7e2a1f4b63"_uuid)
+            ("constructed"        , s.constructed)
+            ("broadcast"          , s.broadcast)
+            ("suppressed_by_level", s.suppressed_by_level)
+            ("dropped"            , s.dropped)
+            ("bytes_serialized"   , s.bytes_serialized)
+            ;
+
+    auto us = [](::std::chrono::nanoseconds d){return d.count() / 1000;};
+
+    for (auto & [id,c] : s.consumers)
+    {
+        auto prefix = "consumer."s + ::std::to_string(id) + ".";
+
+        log
+            (prefix+"calls"   , c.calls)
+            (prefix+"total_us", us(c.total))
+            (prefix+"p50_us"  , us(c.p50))
+            (prefix+"p99_us"  , us(c.p99))
+            (prefix+"max_us"  , us(c.max))
+            ;
+    }
+
+    for (auto & [name,depth] : s.queue_depths)
+        log("queue."s + name + ".depth", depth);
+
+    return log;
+}
+
+
+on_delete
+log_metrics_emit_periodically(
+    ::std::chrono::milliseconds interval
+)
+{
+    struct State
+    {
+        ::std::mutex                mutex;
+        ::std::condition_variable   cv;
+        bool                        stop {};
+        ::std::thread               thread;
+    };
+
+    auto
+        state = ::std::make_shared<State>();
+
+    state->thread = ::std::thread(
+            [state,interval]()
+            {
+                auto l = ::std::unique_lock<::std::mutex>(state->mutex);
+
+                while (!state->cv.wait_for(l, interval, [&]{return state->stop;}))
+                {
+                    l.unlock();
+                    log_metrics_log(log_metrics_snapshot());
+                    l.lock();
+                }
+            }
+        );
+
+    return on_delete{
+            [state]()
+            {
+                {
+                    ::std::lock_guard<::std::mutex>
+                        guard(state->mutex);
+
+                    state->stop = true;
+                }
+
+                state->cv.notify_all();
+
+                if (state->thread.joinable())
+                    state->thread.join();
+            }
+        };
+}
+
+
+on_delete
+log_metrics_queue_register(
+    ::std::string                    const & name
+,   ::std::function<::std::size_t()>         depth
+)
+{
+    auto & r = obtain_registry();
+
+    ::std::lock_guard<::std::mutex>
+        guard(r.mutex);
+
+    auto
+        id = r.queue_next_id++;
+
+    r.queues[id] = {name, ::std::move(depth)};
+
+    return on_delete{
+            [id]()
+            {
+                auto & r = obtain_registry();
+
+                ::std::lock_guard<::std::mutex>
+                    guard(r.mutex);
+
+                r.queues.erase(id);
+            }
+        };
+}
+
+
+void
+log_metrics_consumer_retired(
+    int consumer_id
+)
+{
+    auto & r = obtain_registry();
+
+    ::std::lock_guard<::std::mutex>
+        guard(r.mutex);
+
+    r.retired.consumers.erase(consumer_id);
+
+    // the owning threads free the slots on their next record
+    r.retired_consumers[consumer_id] = r.consumers_retired_epoch.fetch_add(1, ::std::memory_order_release) + 1;
+}
+
+}
@@ -0,0 +1,172 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/Log.h"
+#include "r_base/on_delete.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+
+namespace nsBase
+{
+/**
+    Instrumentation of the logging pipeline itself.
+
+    Each thread counts into its own block of counters. Only the owning thread
+    writes to a block, so the probes are plain relaxed atomic stores without any
+    lock or read-modify-write. A snapshot sums up the blocks of all living
+    threads plus the contributions of threads that already terminated.
+
+    The time spent in a consumer is recorded into a log-linear histogram keyed
+    by the registration id of the consumer (see
+    Log::ConsumerRegistrationDisposer::id()).
+
+    Example:
+
+        auto
+            metrics_emitter = log_metrics_emit_periodically(60s);
+*/
+
+/** Latency distribution of a single consumer.
+*/
+struct LogConsumerMetrics
+{
+    ::std::uint64_t
+        calls {};
+
+    ::std::chrono::nanoseconds
+        total {};
+
+    ::std::chrono::nanoseconds
+        p50 {};
+
+    ::std::chrono::nanoseconds
+        p99 {};
+
+    ::std::chrono::nanoseconds
+        max {};
+};
+
+
+struct LogMetricsSnapshot
+{
+    ::nsBase::time::time_point_t
+        time;
+
+    /// armed Logs that got constructed
+    ::std::uint64_t
+        constructed {};
+
+    /// Logs that got handed to the consumers
+    ::std::uint64_t
+        broadcast {};
+
+    /// Logs a consumer ignored due to their level
+    ::std::uint64_t
+        suppressed_by_level {};
+
+    /// Logs a filter dropped due to flood prevention or sampling
+    ::std::uint64_t
+        dropped {};
+
+    /// size of the output of Log::serialize()
+    ::std::uint64_t
+        bytes_serialized {};
+
+    /// registration id -> timing
+    ::std::map<int, LogConsumerMetrics>
+        consumers;
+
+    /// queue name -> current depth
+    ::std::map<::std::string, ::std::size_t>
+        queue_depths;
+};
+
+
+/** Globally enable or disable the probes.
+    Enabled by default.
+*/
+void
+    log_metrics_enable(
+            bool
+        );
+
+bool
+    log_metrics_enabled();
+
+
+/** Sum up the counters of all threads.
+*/
+LogMetricsSnapshot
+    log_metrics_snapshot();
+
+
+/** Build a self-describing Log from a snapshot.
+    The returned instance is armed.
+*/
+Log
+    log_metrics_log(
+            LogMetricsSnapshot const & snapshot
+        );
+
+
+/** Broadcast log_metrics_log(log_metrics_snapshot()) each interval from a
+    background thread until the returned object gets disposed.
+*/
+[[nodiscard]] on_delete
+    log_metrics_emit_periodically(
+            ::std::chrono::milliseconds interval
+        );
+
+
+/** Register a function that reports the current depth of a queue.
+    The function is called while taking a snapshot, never on the hot path.
+    The registration is dropped when the returned object gets disposed.
+*/
+[[nodiscard]] on_delete
+    log_metrics_queue_register(
+            ::std::string                        const & name
+        ,   ::std::function<::std::size_t()>             depth
+        );
+
+
+/** \name Probes
+    These are called by the pipeline and by consumers or filters that drop Logs.
+@{*/
+void
+    log_metrics_count_constructed();
+
+void
+    log_metrics_count_broadcast();
+
+void
+    log_metrics_count_suppressed_by_level();
+
+void
+    log_metrics_count_dropped();
+
+void
+    log_metrics_count_bytes_serialized(
+            ::std::size_t
+        );
+
+void
+    log_metrics_record_consumer(
+            int                        consumer_id
+        ,   ::std::chrono::nanoseconds duration
+        );
+
+/// drop the statistics of a disposed consumer
+void
+    log_metrics_consumer_retired(
+            int consumer_id
+        );
+//@}
+
+}
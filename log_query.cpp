@@ -0,0 +1,299 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_query.h"
+#include "r_base/log_stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+
+namespace nsBase
+{
+
+namespace
+{
+constexpr ::std::string_view
+    c_time_token = "\"_time\":\"";
+
+// 'YYYY-MM-DDTHH:MM:SS.mmmZ' as written by Log::serialize()
+constexpr ::std::size_t
+    c_time_size = 24;
+
+
+bool
+    contains(
+            ::std::string_view line
+        ,   ::std::string_view needle
+        )
+        {
+        #ifdef __GLIBC__
+            return ::memmem(line.data(), line.size(), needle.data(), needle.size())!=nullptr;
+        #else
+            return line.find(needle)!=::std::string_view::npos;
+        #endif
+        }
+
+
+/// TRUE if the text appears verbatim in JSON, i.e. without being escaped
+bool
+    is_verbatim(
+            ::std::string_view text
+        )
+        {
+            return ::std::none_of(
+                    text.begin()
+                ,   text.end()
+                ,   [](char c){return c=='"' || c=='\\' || ::std::uint8_t(c)<0x20;}
+                );
+        }
+
+
+bool
+    is_property(
+            ::std::string_view key
+        )
+        {
+            return !key.empty() && (key[0]=='_' || key=="scope" || key=="message");
+        }
+
+
+/// a line passes if it contains any of the needles
+struct
+    AnyOf
+        {
+            ::std::vector<::std::string>
+                needles;
+
+            bool
+                operator()(
+                        ::std::string_view line
+                    ) const
+                    {
+                        for (auto & n : needles)
+                            if (contains(line, n))
+                                return true;
+
+                        return false;
+                    }
+        };
+
+
+struct
+    Prefilter
+        {
+            // each of them has to pass
+            ::std::vector<AnyOf>
+                conditions;
+
+            ::std::string
+                time_min;
+
+            ::std::string
+                time_max;
+
+            bool
+                operator()(
+                        ::std::string_view line
+                    ) const
+                    {
+                        for (auto & c : conditions)
+                            if (!c(line))
+                                return false;
+
+                        if (time_min.empty() && time_max.empty())
+                            return true;
+
+                        auto
+                            i = line.find(c_time_token);
+
+                        if (i==::std::string_view::npos)
+                            return true;
+
+                        auto
+                            time = line.substr(i + c_time_token.size(), c_time_size);
+
+                        // other formats are left to the exact evaluation
+                        if (time.size()!=c_time_size || time[19]!='.' || time[23]!='Z')
+                            return true;
+
+                        if (!time_min.empty() && time < time_min)
+                            return false;
+
+                        if (!time_max.empty() && time > time_max)
+                            return false;
+
+                        return true;
+                    }
+        };
+
+
+/// a token for comparison with the raw time stamps, empty if not applicable
+::std::string
+    time_token(
+            ::std::optional<::nsBase::time::time_point_t> const & tp
+        )
+        {
+            if (!tp)
+                return {};
+
+            auto
+                s = to_string_iso_utc(::std::chrono::floor<::std::chrono::milliseconds>(*tp));
+
+            if (s.size()!=c_time_size)
+                return {};
+
+            return s;
+        }
+}
+
+
+bool
+LogQuery::matches(
+    Log const & log
+) const
+{
+    if (time_min && log.time() < *time_min)
+        return false;
+
+    if (time_max && log.time() > *time_max)
+        return false;
+
+    if (level_min && log.level() < *level_min)
+        return false;
+
+    if (!creators.empty() && ::std::find(creators.begin(), creators.end(), log.creator())==creators.end())
+        return false;
+
+    if (!sessions.empty() && ::std::find(sessions.begin(), sessions.end(), log.session())==sessions.end())
+        return false;
+
+    for (auto & c : contains)
+    {
+        auto
+            value = is_property(c.key) ? log.property(c.key) : log.attribute(c.key);
+
+        if (!value || value->find(c.text)==::std::string::npos)
+            return false;
+    }
+
+    return true;
+}
+
+
+::std::function<bool(::std::string_view)>
+LogQuery::prefilter() const
+{
+    Prefilter
+        f;
+
+    // nil ids are not serialized, so the Logs can't be recognized by them
+    auto
+        ids = [&](::std::string_view key, ::std::vector<::uuids::uuid> const & values)
+            {
+                if (values.empty() || ::std::any_of(values.begin(), values.end(), [](auto & u){return u.is_nil();}))
+                    return;
+
+                AnyOf
+                    c;
+
+                for (auto & u : values)
+                    c.needles.push_back("\"" + ::std::string{key} + "\":\"" + to_string(u) + "\"");
+
+                f.conditions.push_back(::std::move(c));
+            };
+
+    ids("_id_creator", creators);
+    ids("_id_session", sessions);
+
+    if (level_min && *level_min > Log::Level::DEBUG)
+    {
+        AnyOf
+            c;
+
+        for (auto l = int(*level_min); l<=int(Log::Level::CRITICAL); ++l)
+            c.needles.push_back("\"_level\":\"" + to_string(Log::Level(l)) + "\"");
+
+        f.conditions.push_back(::std::move(c));
+    }
+
+    for (auto & c : contains)
+    {
+        if (!is_verbatim(c.key))
+            continue;
+
+        f.conditions.push_back({{"\"" + c.key + "\":"}});
+
+        if (!c.text.empty() && is_verbatim(c.text))
+            f.conditions.push_back({{c.text}});
+    }
+
+    f.time_min = time_token(time_min);
+    f.time_max = time_token(time_max);
+
+    if (f.conditions.empty() && f.time_min.empty() && f.time_max.empty())
+        return {};
+
+    return f;
+}
+
+
+::std::uint64_t
+log_query_for_each(
+    ::fs::path                      const & path
+,   LogQuery                        const & query
+,   ::std::function<void(Log &)>    const & consumer
+)
+{
+    auto
+        stream = log_stream(path);
+
+    stream.line_filter_assign(query.prefilter());
+
+    ::std::uint64_t
+        count {};
+
+    for (auto & log : stream)
+    {
+        if (!query.matches(log))
+            continue;
+
+        ++count;
+
+        if (consumer)
+            consumer(log);
+    }
+
+    return count;
+}
+
+
+void
+logs_query(
+    ::std::vector<Log>   & logs
+,   ::fs::path     const & path
+,   LogQuery       const & query
+)
+{
+    log_query_for_each(
+            path
+        ,   query
+        ,   [&](Log & log){logs.emplace_back(::std::move(log));}
+        );
+}
+
+
+::std::vector<Log>
+log_query(
+    ::fs::path const & path
+,   LogQuery   const & query
+)
+{
+    ::std::vector<Log>
+        logs;
+
+    logs_query(logs, path, query);
+
+    return logs;
+}
+
+}
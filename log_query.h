@@ -0,0 +1,104 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/filesystem.h"
+#include "r_base/Log.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    Selects Logs by a conjunction of conditions.
+    EMPTY conditions match everything.
+
+    Reading a log file with a query first tests the raw lines against cheap
+    prefilters (substring searches for the creators, levels, attribute values
+    and a comparison of the time stamp). Only the lines that pass get
+    deserialized and evaluated exactly by matches().
+*/
+struct LogQuery
+{
+    /// inclusive
+    ::std::optional<::nsBase::time::time_point_t>
+        time_min;
+
+    /// inclusive
+    ::std::optional<::nsBase::time::time_point_t>
+        time_max;
+
+    ::std::optional<Log::Level>
+        level_min;
+
+    /// any of
+    ::std::vector<::uuids::uuid>
+        creators;
+
+    /// any of
+    ::std::vector<::uuids::uuid>
+        sessions;
+
+    /// the value of the attribute (or property, e.g. "message") contains the text
+    struct Contains
+    {
+        ::std::string
+            key;
+
+        ::std::string
+            text;
+    };
+
+    /// all of
+    ::std::vector<Contains>
+        contains;
+
+    /** Exact evaluation.
+    */
+    bool
+        matches(
+                Log const &
+            ) const;
+
+    /** A test of raw lines, as written by Log::serialize().
+        It never rejects a line whose Log matches(), but might pass lines that
+        don't.
+    */
+    ::std::function<bool(::std::string_view)>
+        prefilter() const;
+};
+
+
+/**
+    Pass the Logs of a log file and its rotated segments (see log_stream())
+    that match the query to the consumer, oldest first.
+
+    \return The count of matching Logs.
+*/
+::std::uint64_t
+    log_query_for_each(
+            ::fs::path                      const & path
+        ,   LogQuery                        const & query
+        ,   ::std::function<void(Log &)>    const & consumer
+        );
+
+::std::vector<Log>
+    log_query(
+            ::fs::path const & path
+        ,   LogQuery   const & query
+        );
+
+void
+    logs_query(
+            ::std::vector<Log>   & target
+        ,   ::fs::path     const & path
+        ,   LogQuery       const & query
+        );
+
+}
@@ -0,0 +1,356 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_read_parallel.h"
+#include "r_base/compression.h"
+#include "r_base/thread.h"
+#include "r_base/file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <string_view>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace nsBase
+{
+
+namespace
+{
+/// smaller chunks do not pay for their thread
+constexpr ::std::size_t
+    c_chunk_size_min = 1_sz<<20;
+
+/// chunks per worker, so fast workers help out slow ones
+constexpr ::std::size_t
+    c_chunks_per_worker = 4;
+
+
+/// a read-only view of the whole file
+class
+    FileView
+        {
+            R_DTOR(FileView)
+                {
+                #ifndef _WIN32
+                    if (m_map)
+                        ::munmap(m_map, m_map_size);
+                #endif
+                }
+
+            R_CTOR(FileView) = delete;
+            R_CCPY(FileView) = delete;
+            R_CMOV(FileView) = delete;
+            R_COPY(FileView) = delete;
+            R_MOVE(FileView) = delete;
+
+            public : explicit
+                FileView(
+                        ::fs::path const & path
+                    )
+                    {
+                    #ifdef _WIN32
+                        m_data = file_read_all(path);
+                        m_view = m_data;
+                    #else
+                        int
+                            fd;
+
+                        do
+                            fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                        while (fd<0 && errno==EINTR);
+
+                        if (fd<0)
+                            "a52b0f6e-5d39-4c8f-9a57-3b0c1f7d2e64"_log("failed to open ${path}")
+                                .path(path)
+                                .throw_error();
+
+                        struct stat
+                            st;
+
+                        if (::fstat(fd, &st)!=0)
+                        {
+                            ::close(fd);
+
+                            "1f0c97d4-6b2a-4e1d-8f3b-7a9e5c2d0b18"_log("failed to stat ${path}")
+                                .path(path)
+                                .throw_error();
+                        }
+
+                        // an empty file can't be mapped
+                        if (st.st_size>0)
+                        {
+                            auto
+                                map = ::mmap(nullptr, ::std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+                            if (map==MAP_FAILED)
+                            {
+                                ::close(fd);
+
+                                "d3e86a1b-0c47-4f5e-b2a9-6e1f8d4c7a35"_log("failed to map ${path}")
+                                    .path(path)
+                                    .throw_error();
+                            }
+
+                            // the workers fault in the pages concurrently, each of them sequentially
+                            ::madvise(map, ::std::size_t(st.st_size), MADV_WILLNEED);
+
+                            m_map      = map;
+                            m_map_size = ::std::size_t(st.st_size);
+                            m_view     = {static_cast<char const*>(map), m_map_size};
+                        }
+
+                        // the mapping keeps the file referenced
+                        ::close(fd);
+                    #endif
+
+                        // rotated segments might be compressed
+                        if (compression::is_compressed(m_view))
+                        {
+                            m_data = compression::decompress(m_view);
+                            m_view = m_data;
+                        }
+                    }
+
+            public : ::std::string_view
+                view() const
+                    {
+                        return m_view;
+                    }
+
+            private : void *
+                m_map {};
+
+            private : ::std::size_t
+                m_map_size {};
+
+            // decompressed or read content
+            private : ::std::string
+                m_data;
+
+            private : ::std::string_view
+                m_view;
+        };
+
+
+struct
+    Chunk
+        {
+            ::std::string_view
+                data;
+
+            ::std::vector<Log>
+                logs;
+
+            ::std::uint64_t
+                lines {};
+
+            ::std::uint64_t
+                invalid {};
+
+            ::std::exception_ptr
+                error;
+        };
+
+
+/// deserialize the lines of a chunk, each of them terminated by a line break
+void
+    chunk_parse(
+            Chunk & chunk
+        )
+        {
+            auto
+                p = chunk.data.data();
+
+            auto const
+                end = p + chunk.data.size();
+
+            while (p<end)
+            {
+                // glibc scans vectorized
+                auto
+                    eol = static_cast<char const*>(::std::memchr(p, '\n', ::std::size_t(end-p)));
+
+                if (!eol)
+                    eol = end;
+
+                ++chunk.lines;
+
+                if (auto log = Log::deserialize(::std::string_view{p, ::std::size_t(eol-p)}))
+                    chunk.logs.emplace_back(::std::move(*log));
+                else
+                    ++chunk.invalid;
+
+                p = eol+1;
+            }
+        }
+
+
+/// split the complete lines into chunks at line boundaries
+::std::vector<Chunk>
+    chunks_of(
+            ::std::string_view lines
+        ,   ::std::size_t      count
+        )
+        {
+            ::std::vector<Chunk>
+                chunks;
+
+            chunks.reserve(count);
+
+            auto
+                begin = 0_sz;
+
+            for (auto i = 1_sz; i<=count && begin<lines.size(); ++i)
+            {
+                auto
+                    end = lines.size();
+
+                if (i<count)
+                {
+                    auto
+                        eol = lines.find('\n', ::std::max(begin, lines.size() / count * i));
+
+                    end = eol==::std::string_view::npos ? lines.size() : eol+1;
+                }
+
+                chunks.push_back({});
+                chunks.back().data = lines.substr(begin, end-begin);
+
+                begin = end;
+            }
+
+            return chunks;
+        }
+}
+
+
+LogReadReport
+logs_read_parallel(
+    ::std::vector<Log>   & logs
+,   ::fs::path     const & path
+,   unsigned               threads
+)
+{
+    FileView
+        file {path};
+
+    auto
+        data = file.view();
+
+    LogReadReport
+        report;
+
+    // a crashed writer might have left a partial line
+    auto
+        lines_size = data.rfind('\n');
+
+    lines_size = lines_size==::std::string_view::npos ? 0 : lines_size+1;
+
+    if (lines_size<data.size())
+    {
+        report.partial_line        = ::std::string{data.substr(lines_size)};
+        report.partial_line_offset = lines_size;
+    }
+
+    if (threads==0)
+        threads = ::std::max(1u, ::std::thread::hardware_concurrency());
+
+    auto
+        chunks = chunks_of(
+                data.substr(0, lines_size)
+            ,   ::std::clamp(lines_size / c_chunk_size_min, 1_sz, threads * c_chunks_per_worker)
+            );
+
+    ::std::atomic<::std::size_t>
+        next {0};
+
+    auto
+        work = [&]()
+            {
+                for (auto i = next++; i<chunks.size(); i = next++)
+                {
+                    try
+                    {
+                        chunk_parse(chunks[i]);
+                    }
+                    catch(...)
+                    {
+                        chunks[i].error = ::std::current_exception();
+                    }
+                }
+            };
+
+    {
+        ::std::vector<::std::thread>
+            workers;
+
+        auto
+            count = ::std::min<::std::size_t>(threads, chunks.size());
+
+        // the calling thread is one of the workers
+        for (auto i = 1_sz; i<count; ++i)
+            workers.emplace_back([&work]()
+                {
+                    thread::set_thread_name("log_read");
+                    work();
+                });
+
+        work();
+
+        for (auto & w : workers)
+            w.join();
+    }
+
+    auto
+        size = logs.size();
+
+    for (auto & c : chunks)
+    {
+        if (c.error)
+            ::std::rethrow_exception(c.error);
+
+        size           += c.logs.size();
+        report.lines   += c.lines;
+        report.invalid += c.invalid;
+    }
+
+    logs.reserve(size);
+
+    for (auto & c : chunks)
+        ::std::move(c.logs.begin(), c.logs.end(), ::std::back_inserter(logs));
+
+    if (!report.partial_line.empty())
+    {
+        if (auto log = Log::deserialize(report.partial_line))
+            logs.emplace_back(::std::move(*log));
+    }
+
+    return report;
+}
+
+
+::std::vector<Log>
+log_read_parallel(
+    ::fs::path const & path
+,   unsigned           threads
+)
+{
+    ::std::vector<Log>
+        logs;
+
+    logs_read_parallel(logs, path, threads);
+
+    return logs;
+}
+
+}
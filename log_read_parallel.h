@@ -0,0 +1,68 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/filesystem.h"
+#include "r_base/Log.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    What logs_read_parallel() found in a log file besides the Logs.
+*/
+struct LogReadReport
+{
+    /// count of the lines terminated by a line break
+    ::std::uint64_t
+        lines {};
+
+    /// count of the lines that could not be deserialized
+    ::std::uint64_t
+        invalid {};
+
+    /** The bytes after the last line break, e.g. left by a writer that crashed
+        while appending. EMPTY if the file ends with a line break.
+    */
+    ::std::string
+        partial_line;
+
+    /// byte offset of the partial line (in the decompressed data)
+    ::std::uint64_t
+        partial_line_offset {};
+};
+
+
+/**
+    Read Logs from a target file like logs_read(), using all cores.
+
+    The file is memory-mapped and split into chunks at line boundaries.
+    The chunks are deserialized by a pool of worker threads and the Logs get
+    appended to the target in file order.
+    Segments compressed by the log rotation are decompressed first.
+
+    A partial line at the end of the file is reported. If it still happens to
+    be a complete Log, the Log is appended as well.
+
+    \param threads The count of worker threads, 0 for one per core.
+
+    \throws if the file cannot be read.
+*/
+LogReadReport
+    logs_read_parallel(
+            ::std::vector<Log>   & target
+        ,   ::fs::path     const & path
+        ,   unsigned               threads = 0
+        );
+
+::std::vector<Log>
+    log_read_parallel(
+            ::fs::path const & path
+        ,   unsigned           threads = 0
+        );
+
+}
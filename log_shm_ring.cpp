@@ -0,0 +1,911 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_shm_ring.h"
+#include "r_base/log_binary.h"
+#include "r_base/log_metrics.h"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string_view>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace nsBase
+{
+
+#ifndef _WIN32
+namespace
+{
+constexpr ::std::uint64_t
+    c_magic = 0x31304d4853474c52; // "RLGSHM01"
+
+constexpr ::std::size_t
+    c_cache_line = 64;
+
+
+struct
+    RingHeader
+        {
+            // set by the creator when the ring is ready
+            ::std::atomic<::std::uint64_t>  magic;
+            ::std::uint64_t                 slot_size;
+            ::std::uint64_t                 slot_count;
+
+            // Logs lost in the ring, each counted by the writer or reader noticing it
+            ::std::atomic<::std::uint64_t>  lost;
+            ::std::uint64_t                 reserved[4];
+
+            // next position to claim by a producer, a hint only
+            alignas(c_cache_line) ::std::atomic<::std::uint64_t>   head;
+
+            // next position to read
+            alignas(c_cache_line) ::std::atomic<::std::uint64_t>   tail;
+        };
+
+/*
+    The sequence word of the slot of position 'pos' passes through
+        2*pos     free
+        2*pos+1   claimed by a producer
+        2*pos+2   published
+    and is set to 2*(pos+slot_count) when read, that is free for the next lap.
+*/
+struct
+    SlotHeader
+        {
+            ::std::atomic<::std::uint64_t>  seq;
+            ::std::atomic<::std::int32_t>   pid;
+            ::std::uint32_t                 size;
+            ::std::uint64_t                 producer;
+            ::std::uint64_t                 producer_seq;
+            ::std::uint64_t                 checksum;
+            ::std::uint64_t                 pid_ns;     // the pid namespace of 'pid'
+        };
+
+static_assert(::std::atomic<::std::uint64_t>::is_always_lock_free);
+static_assert(::std::atomic<::std::int32_t>::is_always_lock_free);
+static_assert(sizeof(RingHeader)==3*c_cache_line);
+static_assert(sizeof(SlotHeader)==48);
+
+
+::std::uint64_t
+    checksum(
+            ::std::uint64_t          pos
+        ,   ::std::uint64_t          producer
+        ,   ::std::uint64_t          producer_seq
+        ,   ::std::string_view const payload
+        )
+        {
+            // FNV-1a
+            auto
+                h = ::std::uint64_t{0xcbf29ce484222325};
+
+            auto
+                add = [&h](::std::uint64_t v)
+                    {
+                        h ^= v;
+                        h *= 0x100000001b3;
+                    };
+
+            add(pos);
+            add(producer);
+            add(producer_seq);
+
+            for (auto c : payload)
+                add(::std::uint8_t(c));
+
+            return h;
+        }
+
+
+/// identifies the pid namespace of this process, 0 if there are none
+::std::uint64_t
+    pid_namespace()
+        {
+            struct stat
+                st;
+
+            if (::stat("/proc/self/ns/pid", &st)!=0)
+                return 0;
+
+            return ::std::uint64_t(st.st_ino);
+        }
+
+
+::std::size_t
+    round_up_pow2(
+            ::std::size_t n
+        )
+        {
+            auto
+                r = 2_sz;
+
+            while (r<n)
+                r <<= 1;
+
+            return r;
+        }
+
+
+class
+    Mapping
+        {
+            R_DTOR(Mapping)
+                {
+                    if (m_map)
+                        ::munmap(m_map, m_map_size);
+                }
+
+            R_CTOR(Mapping) = default;
+            R_CCPY(Mapping) = delete;
+            R_CMOV(Mapping) = delete;
+            R_COPY(Mapping) = delete;
+            R_MOVE(Mapping) = delete;
+
+            private : void *
+                m_map {};
+
+            private : ::std::size_t
+                m_map_size {};
+
+            private : RingHeader *
+                m_header {};
+
+            private : unsigned char *
+                m_slots {};
+
+            private : ::std::size_t
+                m_slot_size {};
+
+            private : ::std::uint64_t
+                m_slot_count {};
+
+            public : bool
+                attach(
+                        ::std::string      const & name
+                    ,   LogShmRingGeometry const & geometry
+                    )
+                    {
+                        auto
+                            fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+                        if (fd>=0)
+                        {
+                            auto
+                                is_created = create(fd, geometry);
+
+                            ::close(fd);
+
+                            if (!is_created)
+                                ::shm_unlink(name.c_str());
+
+                            return is_created;
+                        }
+
+                        if (errno!=EEXIST)
+                            return false;
+
+                        fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+
+                        if (fd<0)
+                            return false;
+
+                        auto
+                            is_attached = adopt(fd);
+
+                        ::close(fd);
+
+                        return is_attached;
+                    }
+
+            private : bool
+                map(
+                        int         fd
+                    ,   ::std::size_t size
+                    )
+                    {
+                        auto
+                            m = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+                        if (m==MAP_FAILED)
+                            return false;
+
+                        m_map      = m;
+                        m_map_size = size;
+                        m_header   = static_cast<RingHeader*>(m);
+                        m_slots    = static_cast<unsigned char*>(m) + sizeof(RingHeader);
+
+                        return true;
+                    }
+
+            private : bool
+                create(
+                        int                        fd
+                    ,   LogShmRingGeometry const & geometry
+                    )
+                    {
+                        m_slot_size  = (::std::max(geometry.slot_size, 2*c_cache_line) + c_cache_line-1) & ~(c_cache_line-1);
+                        m_slot_count = round_up_pow2(geometry.slot_count);
+
+                        auto
+                            size = sizeof(RingHeader) + m_slot_size*m_slot_count;
+
+                        if (::ftruncate(fd, off_t(size))!=0 || !map(fd, size))
+                            return false;
+
+                        auto
+                            h = new (m_header) RingHeader{};
+
+                        h->slot_size  = m_slot_size;
+                        h->slot_count = m_slot_count;
+
+                        for (auto i=::std::uint64_t{}; i<m_slot_count; ++i)
+                        {
+                            auto
+                                s = new (slot(i)) SlotHeader{};
+
+                            s->seq.store(2*i, ::std::memory_order_relaxed);
+                        }
+
+                        h->magic.store(c_magic, ::std::memory_order_release);
+
+                        return true;
+                    }
+
+            /// attach to a ring created by another process
+            private : bool
+                adopt(
+                        int fd
+                    )
+                    {
+                        // the creator may still be initializing
+                        for (auto attempt=0; attempt<1000; ++attempt)
+                        {
+                            struct stat
+                                st;
+
+                            if (::fstat(fd, &st)!=0)
+                                return false;
+
+                            if (::std::size_t(st.st_size)>=sizeof(RingHeader))
+                            {
+                                if (!m_map && !map(fd, sizeof(RingHeader)))
+                                    return false;
+
+                                if (m_header->magic.load(::std::memory_order_acquire)==c_magic)
+                                    break;
+                            }
+
+                            ::std::this_thread::sleep_for(::std::chrono::milliseconds{1});
+                        }
+
+                        if (!m_map || m_header->magic.load(::std::memory_order_acquire)!=c_magic)
+                            return false;
+
+                        m_slot_size  = m_header->slot_size;
+                        m_slot_count = m_header->slot_count;
+
+                        ::munmap(m_map, m_map_size);
+                        m_map = {};
+
+                        return map(fd, sizeof(RingHeader) + m_slot_size*m_slot_count);
+                    }
+
+            public : RingHeader &
+                header() const
+                    {
+                        return *m_header;
+                    }
+
+            public : ::std::uint64_t
+                slot_count() const
+                    {
+                        return m_slot_count;
+                    }
+
+            public : ::std::size_t
+                payload_capacity() const
+                    {
+                        return m_slot_size - sizeof(SlotHeader);
+                    }
+
+            public : SlotHeader *
+                slot(
+                        ::std::uint64_t pos
+                    ) const
+                    {
+                        return reinterpret_cast<SlotHeader*>(m_slots + (pos & (m_slot_count-1))*m_slot_size);
+                    }
+
+            public : static unsigned char *
+                payload(
+                        SlotHeader * s
+                    )
+                    {
+                        return reinterpret_cast<unsigned char*>(s+1);
+                    }
+        };
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+struct
+LogShmRingWriter::State
+{
+#ifndef _WIN32
+    Mapping
+        mapping;
+
+    ::std::atomic<::std::uint64_t>
+        dropped {};
+
+    ::std::int32_t
+        pid {::std::int32_t(::getpid())};
+
+    ::std::uint64_t
+        pid_ns {pid_namespace()};
+
+
+    struct
+        Producer
+            {
+                State const   * owner {};
+                ::std::uint64_t id {};
+                ::std::uint64_t seq {};
+            };
+
+    /// the producer of the calling thread
+    Producer &
+        producer()
+            {
+                thread_local Producer
+                    p;
+
+                if (p.owner!=this)
+                {
+                    ::std::random_device
+                        rd;
+
+                    p.owner = this;
+                    p.id    = (::std::uint64_t(rd())<<32) ^ rd();
+                    p.seq   = 0;
+                }
+
+                return p;
+            }
+
+
+    /** Claim a free slot.
+        \return FALSE if the ring is full.
+    */
+    bool
+        claim(
+                ::std::uint64_t & pos
+            )
+            {
+                auto &
+                    head = mapping.header().head;
+
+                pos = head.load(::std::memory_order_relaxed);
+
+                while (true)
+                {
+                    auto
+                        s = mapping.slot(pos);
+
+                    auto
+                        seq = s->seq.load(::std::memory_order_acquire);
+
+                    if (seq==2*pos)
+                    {
+                        if (s->seq.compare_exchange_weak(seq, 2*pos+1, ::std::memory_order_acq_rel))
+                        {
+                            auto
+                                expected = pos;
+
+                            head.compare_exchange_strong(expected, pos+1, ::std::memory_order_relaxed);
+                            return true;
+                        }
+
+                        continue;
+                    }
+
+                    if (seq<2*pos)
+                        return false; // the slot is not read yet since the last lap
+
+                    if (seq<=2*pos+2)
+                    {
+                        // claimed by another producer that didn't advance the head yet
+                        auto
+                            expected = pos;
+
+                        head.compare_exchange_strong(expected, pos+1, ::std::memory_order_relaxed);
+                    }
+
+                    pos = head.load(::std::memory_order_relaxed);
+                }
+            }
+
+
+    void
+        publish(
+                ::std::string_view const frame
+            )
+            {
+                auto &
+                    p = producer();
+
+                auto
+                    producer_seq = p.seq++;
+
+                ::std::uint64_t
+                    pos;
+
+                if (frame.size()>mapping.payload_capacity() || !claim(pos))
+                {
+                    dropped_add();
+                    return;
+                }
+
+                auto
+                    s = mapping.slot(pos);
+
+                s->pid_ns = pid_ns;
+                s->pid.store(pid, ::std::memory_order_release);
+                s->size         = ::std::uint32_t(frame.size());
+                s->producer     = p.id;
+                s->producer_seq = producer_seq;
+                s->checksum     = checksum(pos, p.id, producer_seq, frame);
+
+                ::std::memcpy(Mapping::payload(s), frame.data(), frame.size());
+
+                auto
+                    expected = 2*pos+1;
+
+                // fails if a reader considered this producer stuck
+                if (!s->seq.compare_exchange_strong(expected, 2*pos+2, ::std::memory_order_release))
+                    dropped_add();
+            }
+
+
+    void
+        dropped_add()
+            {
+                ++dropped;
+                mapping.header().lost.fetch_add(1, ::std::memory_order_relaxed);
+                log_metrics_count_dropped();
+            }
+#endif
+};
+
+
+LogShmRingWriter::~LogShmRingWriter()
+{
+    close();
+}
+
+
+LogShmRingWriter::LogShmRingWriter() = default;
+
+
+LogShmRingWriter::LogShmRingWriter(
+    LogShmRingWriter && src
+)
+{
+    ::std::swap(m_state, src.m_state);
+}
+
+
+LogShmRingWriter &
+LogShmRingWriter::operator=(
+    LogShmRingWriter && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        ::std::swap(m_state, src.m_state);
+    }
+
+    return *this;
+}
+
+
+bool
+LogShmRingWriter::open(
+    ::std::string      const & name
+,   LogShmRingGeometry const & geometry
+)
+{
+    close();
+
+#ifdef _WIN32
+    (void)name;
+    (void)geometry;
+
+    return false;
+#else
+    auto
+        state = ::std::make_unique<State>();
+
+    if (!state->mapping.attach(name, geometry))
+        return false;
+
+    m_state = ::std::move(state);
+
+    return true;
+#endif
+}
+
+
+bool
+LogShmRingWriter::is_open() const
+{
+    return bool(m_state);
+}
+
+
+void
+LogShmRingWriter::close()
+{
+    m_state.reset();
+}
+
+
+void
+LogShmRingWriter::operator()(
+    Log & log
+)
+{
+    if (!m_state)
+        return;
+
+#ifndef _WIN32
+    // the encoding happens before claiming a slot
+    thread_local ::std::string
+        frame;
+
+    frame.clear();
+    log_binary_encode(log, frame);
+
+    m_state->publish(frame);
+#else
+    (void)log;
+#endif
+}
+
+
+::std::uint64_t
+LogShmRingWriter::dropped_count() const
+{
+#ifndef _WIN32
+    if (m_state)
+        return m_state->dropped;
+#endif
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+struct
+LogShmRingReader::State
+{
+#ifndef _WIN32
+    Mapping
+        mapping;
+
+    ::std::chrono::milliseconds
+        stale_timeout;
+
+    ::std::uint64_t
+        pid_ns {pid_namespace()};
+
+    // the claimed slot the reader is waiting for
+    ::std::uint64_t
+        stuck_pos {::std::uint64_t(-1)};
+
+    ::std::chrono::steady_clock::time_point
+        stuck_since;
+
+    ::std::string
+        buffer;
+
+
+    void
+        lost_add()
+            {
+                mapping.header().lost.fetch_add(1, ::std::memory_order_relaxed);
+            }
+
+
+    /// TRUE if the process that claimed the slot doesn't exist anymore
+    bool
+        is_dead(
+                SlotHeader const * s
+            )
+            {
+                auto
+                    pid = s->pid.load(::std::memory_order_acquire);
+
+                // the pids of other namespaces can't be looked up
+                return pid>0 && s->pid_ns==pid_ns && ::kill(pid, 0)!=0 && errno==ESRCH;
+            }
+
+
+    /// TRUE if the slot stays claimed for longer than the stale_timeout
+    bool
+        is_stuck(
+                ::std::uint64_t pos
+            )
+            {
+                auto
+                    now = ::std::chrono::steady_clock::now();
+
+                if (stuck_pos!=pos)
+                {
+                    stuck_pos   = pos;
+                    stuck_since = now;
+                    return false;
+                }
+
+                return now - stuck_since > stale_timeout;
+            }
+
+
+    ::std::size_t
+        drain(
+                ::std::function<void(Log &)> const & sink
+            ,   ::std::size_t                        count_max
+            )
+            {
+                auto &
+                    tail = mapping.header().tail;
+
+                auto
+                    n = mapping.slot_count();
+
+                auto
+                    count = 0_sz;
+
+                auto
+                    pos = tail.load(::std::memory_order_relaxed);
+
+                while (count<count_max)
+                {
+                    auto
+                        s = mapping.slot(pos);
+
+                    auto
+                        seq = s->seq.load(::std::memory_order_acquire);
+
+                    if (seq==2*pos+1)
+                    {
+                        auto
+                            is_producer_dead = is_dead(s);
+
+                        if (!is_producer_dead && !is_stuck(pos))
+                            break;
+
+                        // take the position, then take the slot from the producer
+                        if (!tail.compare_exchange_strong(pos, pos+1, ::std::memory_order_relaxed))
+                            continue;
+
+                        auto
+                            expected = seq;
+
+                        if (s->seq.compare_exchange_strong(expected, 2*(pos+n), ::std::memory_order_acq_rel))
+                        {
+                            // a living producer counts the Log when it fails to release the slot
+                            if (is_producer_dead)
+                                lost_add();
+
+                            s->pid.store(0, ::std::memory_order_relaxed);
+                            ++pos;
+                            continue;
+                        }
+
+                        // published meanwhile
+                        seq = expected;
+                    }
+                    else if (seq==2*pos+2)
+                    {
+                        if (!tail.compare_exchange_strong(pos, pos+1, ::std::memory_order_relaxed))
+                            continue;
+                    }
+                    else if (seq<2*pos+1)
+                    {
+                        break; // empty
+                    }
+                    else
+                    {
+                        pos = tail.load(::std::memory_order_relaxed);
+                        continue;
+                    }
+
+                    // the position is owned by this reader now
+                    auto
+                        size         = ::std::min<::std::size_t>(s->size, mapping.payload_capacity());
+                    auto
+                        producer     = s->producer;
+                    auto
+                        producer_seq = s->producer_seq;
+                    auto
+                        sum          = s->checksum;
+
+                    buffer.assign(reinterpret_cast<char const*>(Mapping::payload(s)), size);
+
+                    s->pid.store(0, ::std::memory_order_relaxed);
+                    s->seq.store(2*(pos+n), ::std::memory_order_release);
+
+                    ++pos;
+
+                    // overwritten by a producer that was too slow
+                    if (checksum(pos-1, producer, producer_seq, buffer)!=sum)
+                    {
+                        lost_add();
+                        continue;
+                    }
+
+                    ::std::string_view
+                        data = buffer;
+
+                    ::std::optional<Log>
+                        log;
+
+                    try
+                    {
+                        log = log_binary_decode(data);
+                    }
+                    catch(...)
+                    {
+                    }
+
+                    if (!log)
+                    {
+                        lost_add();
+                        continue;
+                    }
+
+                    ++count;
+
+                    if (sink)
+                        sink(*log);
+                }
+
+                return count;
+            }
+#endif
+};
+
+
+LogShmRingReader::~LogShmRingReader()
+{
+    close();
+}
+
+
+LogShmRingReader::LogShmRingReader() = default;
+
+
+LogShmRingReader::LogShmRingReader(
+    LogShmRingReader && src
+)
+{
+    ::std::swap(m_state, src.m_state);
+}
+
+
+LogShmRingReader &
+LogShmRingReader::operator=(
+    LogShmRingReader && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        ::std::swap(m_state, src.m_state);
+    }
+
+    return *this;
+}
+
+
+bool
+LogShmRingReader::open(
+    ::std::string      const & name
+,   LogShmRingGeometry const & geometry
+,   ::std::chrono::milliseconds stale_timeout
+)
+{
+    close();
+
+#ifdef _WIN32
+    (void)name;
+    (void)geometry;
+    (void)stale_timeout;
+
+    return false;
+#else
+    auto
+        state = ::std::make_unique<State>();
+
+    if (!state->mapping.attach(name, geometry))
+        return false;
+
+    state->stale_timeout = stale_timeout;
+
+    m_state = ::std::move(state);
+
+    return true;
+#endif
+}
+
+
+bool
+LogShmRingReader::is_open() const
+{
+    return bool(m_state);
+}
+
+
+void
+LogShmRingReader::close()
+{
+    m_state.reset();
+}
+
+
+::std::size_t
+LogShmRingReader::drain(
+    ::std::function<void(Log &)> const & sink
+,   ::std::size_t                        count_max
+)
+{
+#ifndef _WIN32
+    if (m_state)
+        return m_state->drain(sink, count_max);
+#else
+    (void)sink;
+    (void)count_max;
+#endif
+
+    return 0;
+}
+
+
+::std::uint64_t
+LogShmRingReader::lost_count() const
+{
+#ifndef _WIN32
+    if (m_state)
+        return m_state->mapping.header().lost.load(::std::memory_order_relaxed);
+#endif
+
+    return 0;
+}
+
+
+void
+log_shm_ring_remove(
+    ::std::string const & name
+)
+{
+#ifndef _WIN32
+    ::shm_unlink(name.c_str());
+#else
+    (void)name;
+#endif
+}
+
+}
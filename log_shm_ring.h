@@ -0,0 +1,161 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/Log.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+
+namespace nsBase
+{
+
+/** The layout of a shared-memory log ring.
+    It is decided by the process creating the ring, the others adopt it.
+*/
+struct LogShmRingGeometry
+{
+    /// bytes per slot including its header, a Log not fitting is dropped
+    ::std::size_t
+        slot_size {2048};
+
+    /// rounded up to a power of 2
+    ::std::size_t
+        slot_count {4096};
+};
+
+
+/**
+    A log consumer that publishes the Logs into a ring in a POSIX shared
+    memory segment (/dev/shm on Linux), to be drained by a LogShmRingReader
+    of another process.
+
+    Each Log is encoded by log_binary_encode() into a fixed-size slot.
+    Publishing is lock-free: a slot is claimed by a compare-and-swap on its
+    sequence word, filled and released. If the ring is full the Log is
+    dropped - the emitting thread never waits for the reader.
+
+    The dropped Logs are counted in the ring (see LogShmRingReader::lost_count()).
+
+    Only available on POSIX systems - elsewhere open() fails.
+*/
+class LogShmRingWriter
+{
+    R_DTOR(LogShmRingWriter);
+    R_CTOR(LogShmRingWriter);
+    R_CCPY(LogShmRingWriter) = delete;
+    R_CMOV(LogShmRingWriter);
+    R_COPY(LogShmRingWriter) = delete;
+    R_MOVE(LogShmRingWriter);
+
+    /** Attach to the ring, create it if it doesn't exist.
+        \param name The name of the shared-memory object, e.g. "/my_app.log".
+        \return FALSE on failure.
+    */
+    public : bool
+        open(
+                ::std::string      const & name
+            ,   LogShmRingGeometry const & geometry = {}
+            );
+
+    public : bool
+        is_open() const;
+
+    public : void
+        close();
+
+    public : void
+        operator()(::nsBase::Log &);
+
+    /// The count of Logs dropped since the ring was full or the Log too large.
+    public : ::std::uint64_t
+        dropped_count() const;
+
+    private : struct
+        State;
+
+    private : ::std::unique_ptr<State>
+        m_state;
+};
+
+
+/**
+    Drains the Logs published by the LogShmRingWriter of any process.
+
+    A slot claimed by a producer that died before releasing it would block
+    the ring. The reader skips such a slot if the claiming process doesn't
+    exist anymore or if the slot stays claimed for longer than the
+    stale_timeout. Records are checksummed, so a slot written by a producer
+    that was too slow is detected and skipped.
+
+    Whether the claiming process exists is looked up by its pid, which works
+    for processes of the same pid namespace only. A slot claimed by a process
+    of another namespace (e.g. of another container) is skipped after the
+    stale_timeout only.
+
+    Several readers may drain the same ring, each Log is read by one of them.
+*/
+class LogShmRingReader
+{
+    R_DTOR(LogShmRingReader);
+    R_CTOR(LogShmRingReader);
+    R_CCPY(LogShmRingReader) = delete;
+    R_CMOV(LogShmRingReader);
+    R_COPY(LogShmRingReader) = delete;
+    R_MOVE(LogShmRingReader);
+
+    /** Attach to the ring, create it if it doesn't exist.
+        \return FALSE on failure.
+    */
+    public : bool
+        open(
+                ::std::string      const & name
+            ,   LogShmRingGeometry const & geometry = {}
+            ,   ::std::chrono::milliseconds stale_timeout = ::std::chrono::seconds{5}
+            );
+
+    public : bool
+        is_open() const;
+
+    public : void
+        close();
+
+    /** Pass the published Logs to the sink, oldest first.
+        Doesn't wait for Logs to be published.
+        \return The count of Logs passed.
+    */
+    public : ::std::size_t
+        drain(
+                ::std::function<void(Log &)> const & sink
+            ,   ::std::size_t                        count_max = ::std::size_t(-1)
+            );
+
+    /** The count of Logs lost in the ring since it was created: dropped by
+        the writers since the ring was full, the Log too large or the producer
+        too slow, claimed by a process that died or damaged.
+        Each loss is counted once for the ring, all readers report the same.
+    */
+    public : ::std::uint64_t
+        lost_count() const;
+
+    private : struct
+        State;
+
+    private : ::std::unique_ptr<State>
+        m_state;
+};
+
+
+/** Remove the shared-memory object of the ring.
+    Attached writers and readers continue to work on the unlinked memory.
+*/
+void
+    log_shm_ring_remove(
+            ::std::string const & name
+        );
+
+}
@@ -0,0 +1,839 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_socket.h"
+#include "r_base/log_binary.h"
+#include "r_base/log_metrics.h"
+#include "r_base/thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+namespace nsBase
+{
+
+#ifndef _WIN32
+namespace
+{
+using steady_clock = ::std::chrono::steady_clock;
+
+// the size prefix of the frames written by log_binary_encode()
+constexpr ::std::size_t
+    c_prefix_size = 4;
+
+constexpr ::std::size_t
+    c_recv_size = 64_sz<<10;
+
+// read from a client per poll round, so a busy one doesn't starve the others
+constexpr ::std::size_t
+    c_recv_round_size = 4 * c_recv_size;
+
+#ifdef MSG_NOSIGNAL
+constexpr int
+    c_send_flags = MSG_NOSIGNAL;
+#else
+constexpr int
+    c_send_flags = 0;
+#endif
+
+
+void
+    fd_configure(
+            int fd
+        )
+        {
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        #ifdef SO_NOSIGPIPE
+            int
+                on = 1;
+
+            ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+        #endif
+        }
+
+
+bool
+    address_assign(
+            sockaddr_un       & addr
+        ,   ::fs::path  const & path
+        )
+        {
+            addr = {};
+            addr.sun_family = AF_UNIX;
+
+            auto &
+                native = path.native();
+
+            if (native.empty() || native.size() >= sizeof(addr.sun_path))
+                return false;
+
+            ::std::memcpy(addr.sun_path, native.c_str(), native.size()+1);
+
+            return true;
+        }
+
+
+/// \return the connected socket or -1
+int
+    socket_connect(
+            ::fs::path const & path
+        )
+        {
+            sockaddr_un
+                addr;
+
+            if (!address_assign(addr, path))
+                return -1;
+
+            auto
+                fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+            if (fd<0)
+                return -1;
+
+            fd_configure(fd);
+
+            int
+                rc;
+
+            do
+                rc = ::connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr));
+            while (rc<0 && errno==EINTR);
+
+            if (rc!=0)
+            {
+                ::close(fd);
+                return -1;
+            }
+
+            return fd;
+        }
+
+
+::std::uint32_t
+    frame_size(
+            char const * p
+        )
+        {
+            ::std::uint32_t
+                size {};
+
+            for (auto i=0_sz; i<c_prefix_size; ++i)
+                size |= ::std::uint32_t(::std::uint8_t(p[i])) << (8*i);
+
+            return size;
+        }
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+struct
+LogSocketSender::State
+{
+#ifndef _WIN32
+    ::fs::path
+        path;
+
+    LogSocketPolicy
+        policy;
+
+    ::std::mutex
+        mutex;
+
+    ::std::condition_variable
+        cv;
+
+    // the Logs appended by the emitters, guarded by the mutex
+    ::std::string
+        pending;
+
+    bool
+        is_stopping {};
+
+    // the bytes owned by the writer thread and not sent yet
+    ::std::atomic<::std::size_t>
+        in_flight {};
+
+    ::std::atomic<::std::uint64_t>
+        dropped {};
+
+    ::std::thread
+        thread;
+
+    // writer thread only
+    int
+        fd {-1};
+
+    ::std::string
+        sending;
+
+    ::std::size_t
+        sent {};
+
+    steady_clock::time_point
+        connect_next {};
+
+
+    void
+        disconnect()
+            {
+                if (fd>=0)
+                    ::close(fd);
+
+                fd = -1;
+
+                // the collector discards the incomplete frame, so does the sender
+                auto
+                    end = 0_sz;
+
+                while (end<sent && end+c_prefix_size<=sending.size())
+                    end += c_prefix_size + frame_size(sending.data()+end);
+
+                sending.erase(0, ::std::min(end, sending.size()));
+                sent = 0;
+
+                in_flight = sending.size();
+            }
+
+
+    /** Send what is in 'sending'.
+        \return TRUE if all got sent.
+    */
+    bool
+        flush(
+                steady_clock::time_point deadline
+            )
+            {
+                while (sent<sending.size())
+                {
+                    if (fd<0)
+                    {
+                        auto
+                            now = steady_clock::now();
+
+                        if (connect_next>=deadline)
+                            return false;
+
+                        if (now<connect_next)
+                            ::std::this_thread::sleep_until(connect_next);
+
+                        fd = socket_connect(path);
+
+                        if (fd<0)
+                        {
+                            connect_next = steady_clock::now() + policy.reconnect_interval;
+                            return false;
+                        }
+                    }
+
+                    auto
+                        n = ::send(fd, sending.data()+sent, sending.size()-sent, c_send_flags);
+
+                    if (n>0)
+                    {
+                        sent += ::std::size_t(n);
+                        in_flight = sending.size()-sent;
+                        continue;
+                    }
+
+                    if (n<0 && errno==EINTR)
+                        continue;
+
+                    if (n<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+                    {
+                        auto
+                            remaining = ::std::chrono::duration_cast<::std::chrono::milliseconds>(deadline - steady_clock::now());
+
+                        if (remaining.count()<=0)
+                            return false;
+
+                        pollfd
+                            p {fd, POLLOUT, 0};
+
+                        ::poll(&p, 1, int(::std::min<::std::int64_t>(remaining.count(), 100)));
+                        continue;
+                    }
+
+                    disconnect();
+                    connect_next = steady_clock::now() + policy.reconnect_interval;
+                    return false;
+                }
+
+                sending.clear();
+                sent = 0;
+                in_flight = 0;
+
+                return true;
+            }
+
+
+    void
+        run()
+            {
+                thread::set_thread_name("log_socket");
+
+                ::std::unique_lock
+                    guard {mutex};
+
+                while (true)
+                {
+                    if (!is_stopping && pending.size()<policy.batch_size)
+                    {
+                        cv.wait_for(guard, policy.max_age, [&]
+                            {
+                                return is_stopping || pending.size()>=policy.batch_size;
+                            });
+                    }
+
+                    auto
+                        stopping = is_stopping;
+
+                    sending += pending;
+                    pending.clear();
+                    in_flight = sending.size()-sent;
+
+                    guard.unlock();
+
+                    flush(steady_clock::now() + (stopping ? policy.close_timeout : policy.max_age));
+
+                    guard.lock();
+
+                    if (stopping)
+                        break;
+                }
+
+                guard.unlock();
+
+                if (fd>=0)
+                    ::close(fd);
+
+                fd = -1;
+            }
+#endif
+};
+
+
+LogSocketSender::~LogSocketSender()
+{
+    close();
+}
+
+
+LogSocketSender::LogSocketSender() = default;
+
+
+LogSocketSender::LogSocketSender(
+    LogSocketSender && src
+)
+{
+    ::std::swap(m_state, src.m_state);
+}
+
+
+LogSocketSender &
+LogSocketSender::operator=(
+    LogSocketSender && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        ::std::swap(m_state, src.m_state);
+    }
+
+    return *this;
+}
+
+
+bool
+LogSocketSender::open(
+    ::fs::path      const & path
+,   LogSocketPolicy const & policy
+)
+{
+    close();
+
+#ifdef _WIN32
+    (void)path;
+    (void)policy;
+
+    return false;
+#else
+    sockaddr_un
+        addr;
+
+    if (!address_assign(addr, path))
+        return false;
+
+    auto
+        state = ::std::make_unique<State>();
+        state->path   = path;
+        state->policy = policy;
+
+    state->thread = ::std::thread{[s = state.get()](){s->run();}};
+
+    m_state = ::std::move(state);
+
+    return true;
+#endif
+}
+
+
+bool
+LogSocketSender::is_open() const
+{
+    return bool(m_state);
+}
+
+
+void
+LogSocketSender::close()
+{
+    if (!m_state)
+        return;
+
+#ifndef _WIN32
+    {
+        ::std::lock_guard
+            guard {m_state->mutex};
+
+        m_state->is_stopping = true;
+    }
+
+    m_state->cv.notify_one();
+
+    if (m_state->thread.joinable())
+        m_state->thread.join();
+#endif
+
+    m_state.reset();
+}
+
+
+void
+LogSocketSender::operator()(
+    Log & log
+)
+{
+    if (!m_state)
+        return;
+
+#ifndef _WIN32
+    auto &
+        s = *m_state;
+
+    // the encoding happens outside the lock
+    thread_local ::std::string
+        frame;
+
+    frame.clear();
+    log_binary_encode(log, frame);
+
+    auto
+        do_notify = false;
+
+    {
+        ::std::lock_guard
+            guard {s.mutex};
+
+        if (s.is_stopping || s.pending.size() + s.in_flight + frame.size() > s.policy.spill_size)
+        {
+            ++s.dropped;
+            log_metrics_count_dropped();
+            return;
+        }
+
+        s.pending += frame;
+
+        do_notify = s.pending.size() >= s.policy.batch_size;
+    }
+
+    if (do_notify)
+        s.cv.notify_one();
+#else
+    (void)log;
+#endif
+}
+
+
+::std::uint64_t
+LogSocketSender::dropped_count() const
+{
+#ifndef _WIN32
+    if (m_state)
+        return m_state->dropped;
+#endif
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+struct
+LogSocketCollector::State
+{
+#ifndef _WIN32
+    struct
+        Client
+            {
+                int
+                    fd;
+
+                ::std::string
+                    buffer;
+            };
+
+    ::fs::path
+        path;
+
+    ::std::function<void(Log &)>
+        sink;
+
+    int
+        listen_fd {-1};
+
+    // written by close() to wake the thread
+    int
+        wake[2] {-1, -1};
+
+    ::std::atomic_bool
+        is_stopping {};
+
+    ::std::atomic<::std::uint64_t>
+        received {};
+
+    ::std::thread
+        thread;
+
+    ::std::vector<Client>
+        clients;
+
+
+    ~State()
+        {
+            for (auto & c : clients)
+                ::close(c.fd);
+
+            for (auto fd : {listen_fd, wake[0], wake[1]})
+                if (fd>=0)
+                    ::close(fd);
+        }
+
+
+    void
+        accept_all()
+            {
+                while (true)
+                {
+                    auto
+                        fd = ::accept(listen_fd, nullptr, nullptr);
+
+                    if (fd<0)
+                    {
+                        if (errno==EINTR)
+                            continue;
+
+                        return;
+                    }
+
+                    fd_configure(fd);
+
+                    clients.push_back({fd, {}});
+                }
+            }
+
+
+    /** Pass on the complete frames received from the client.
+        \return FALSE if the stream is malformed.
+    */
+    bool
+        frames_pass_on(
+                Client & c
+            )
+            {
+                ::std::string_view
+                    data = c.buffer;
+
+                try
+                {
+                    while (auto log = log_binary_decode(data))
+                    {
+                        ++received;
+
+                        try
+                        {
+                            sink(*log);
+                        }
+                        catch(...)
+                        {
+                            // a failing sink must not stop the collector
+                        }
+                    }
+                }
+                catch(...)
+                {
+                    // the stream can't be re-synchronized
+                    return false;
+                }
+
+                c.buffer.erase(0, c.buffer.size()-data.size());
+
+                return true;
+            }
+
+
+    /** Receive from the client and pass on the complete frames.
+        Reads at most c_recv_round_size, the rest is left for the next round.
+        \return FALSE if the connection is done.
+    */
+    bool
+        receive(
+                Client & c
+            )
+            {
+                for (auto read = 0_sz; read<c_recv_round_size; )
+                {
+                    auto
+                        size = c.buffer.size();
+
+                    c.buffer.resize(size + c_recv_size);
+
+                    auto
+                        n = ::recv(c.fd, c.buffer.data()+size, c_recv_size, 0);
+
+                    c.buffer.resize(size + ::std::size_t(::std::max<ssize_t>(n, 0)));
+
+                    if (n<0 && errno==EINTR)
+                        continue;
+
+                    if (n<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+                        return true;
+
+                    // decoding as received bounds the buffer to the incomplete frame
+                    if (!frames_pass_on(c))
+                        return false;
+
+                    // closed, the complete frames got passed on
+                    if (n<=0)
+                        return false;
+
+                    read += ::std::size_t(n);
+                }
+
+                return true;
+            }
+
+
+    void
+        run()
+            {
+                thread::set_thread_name("log_collector");
+
+                ::std::vector<pollfd>
+                    fds;
+
+                while (!is_stopping)
+                {
+                    fds.clear();
+                    fds.push_back({wake[0], POLLIN, 0});
+                    fds.push_back({listen_fd, POLLIN, 0});
+
+                    for (auto & c : clients)
+                        fds.push_back({c.fd, POLLIN, 0});
+
+                    if (::poll(fds.data(), nfds_t(fds.size()), -1)<0 && errno!=EINTR)
+                        break;
+
+                    if (is_stopping)
+                        break;
+
+                    // the clients first, the accepted ones are not polled yet
+                    for (auto i=clients.size(); i-->0;)
+                    {
+                        if (!fds[2+i].revents)
+                            continue;
+
+                        if (!receive(clients[i]))
+                        {
+                            ::close(clients[i].fd);
+                            clients.erase(clients.begin() + ::std::ptrdiff_t(i));
+                        }
+                    }
+
+                    if (fds[1].revents)
+                        accept_all();
+                }
+            }
+#endif
+};
+
+
+LogSocketCollector::~LogSocketCollector()
+{
+    close();
+}
+
+
+LogSocketCollector::LogSocketCollector() = default;
+
+
+LogSocketCollector::LogSocketCollector(
+    LogSocketCollector && src
+)
+{
+    ::std::swap(m_state, src.m_state);
+}
+
+
+LogSocketCollector &
+LogSocketCollector::operator=(
+    LogSocketCollector && src
+)
+{
+    if (this!=&src)
+    {
+        close();
+        ::std::swap(m_state, src.m_state);
+    }
+
+    return *this;
+}
+
+
+bool
+LogSocketCollector::open(
+    ::fs::path                   const & path
+,   ::std::function<void(Log &)>         sink
+)
+{
+    close();
+
+#ifdef _WIN32
+    (void)path;
+    (void)sink;
+
+    return false;
+#else
+    sockaddr_un
+        addr;
+
+    if (!address_assign(addr, path))
+        return false;
+
+    // a socket that accepts belongs to a running collector
+    if (auto fd = socket_connect(path); fd>=0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    struct stat
+        st;
+
+    if (::lstat(path.c_str(), &st)==0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+            return false;
+
+        ::unlink(path.c_str());
+    }
+
+    auto
+        state = ::std::make_unique<State>();
+        state->path = path;
+        state->sink = sink
+            ?   ::std::move(sink)
+            :   [](Log & log){log.arm().broadcast_if();}
+            ;
+
+    if (::pipe(state->wake)!=0)
+        return false;
+
+    for (auto fd : state->wake)
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    state->listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (state->listen_fd<0)
+        return false;
+
+    fd_configure(state->listen_fd);
+
+    if (    ::bind(state->listen_fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr))!=0
+        ||  ::listen(state->listen_fd, SOMAXCONN)!=0
+        )
+        return false;
+
+    state->thread = ::std::thread{[s = state.get()](){s->run();}};
+
+    m_state = ::std::move(state);
+
+    return true;
+#endif
+}
+
+
+bool
+LogSocketCollector::is_open() const
+{
+    return bool(m_state);
+}
+
+
+void
+LogSocketCollector::close()
+{
+    if (!m_state)
+        return;
+
+#ifndef _WIN32
+    auto &
+        s = *m_state;
+
+    s.is_stopping = true;
+
+    char
+        c {};
+
+    while (::write(s.wake[1], &c, 1)<0 && errno==EINTR)
+        ;
+
+    if (s.thread.joinable())
+        s.thread.join();
+
+    ::unlink(s.path.c_str());
+#endif
+
+    m_state.reset();
+}
+
+
+::std::uint64_t
+LogSocketCollector::received_count() const
+{
+#ifndef _WIN32
+    if (m_state)
+        return m_state->received;
+#endif
+
+    return 0;
+}
+
+}
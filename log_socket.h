@@ -0,0 +1,158 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/filesystem.h"
+#include "r_base/Log.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+
+namespace nsBase
+{
+
+/** Controls how LogSocketSender ships the Logs to the collector.
+*/
+struct LogSocketPolicy
+{
+    /// send as soon as this many bytes are pending
+    ::std::size_t
+        batch_size {64 * 1024};
+
+    /// send pending Logs at least this often
+    ::std::chrono::milliseconds
+        max_age {100};
+
+    /** Bound of the bytes kept while the collector is slow or not reachable.
+        Logs not fitting are dropped and counted.
+    */
+    ::std::size_t
+        spill_size {4_sz<<20};
+
+    /// wait this long between the attempts to (re-)connect
+    ::std::chrono::milliseconds
+        reconnect_interval {1000};
+
+    /// close() tries this long to deliver the pending Logs
+    ::std::chrono::milliseconds
+        close_timeout {1000};
+};
+
+
+/**
+    A log consumer that ships the Logs to a LogSocketCollector through a
+    Unix domain socket, so a single process of the host owns the disk I/O.
+
+    The Logs get encoded by log_binary_encode() and appended to a buffer;
+    a background thread sends the buffer in batches. The emitting thread never
+    waits for the collector: while the collector is slow or down the buffer
+    grows up to LogSocketPolicy::spill_size, beyond that Logs are dropped.
+    A lost connection gets re-established by the background thread.
+
+    Only available on POSIX systems - elsewhere open() fails.
+
+    example use:
+
+        auto
+            sender = ::std::make_shared<LogSocketSender>();
+
+        sender->open("/run/my_app/log.sock");
+
+        auto
+            logDisposer = Log::consumer_register([sender](Log & log){(*sender)(log);});
+*/
+class LogSocketSender
+{
+    R_DTOR(LogSocketSender);
+    R_CTOR(LogSocketSender);
+    R_CCPY(LogSocketSender) = delete;
+    R_CMOV(LogSocketSender);
+    R_COPY(LogSocketSender) = delete;
+    R_MOVE(LogSocketSender);
+
+    /** Start shipping to the socket of the collector.
+        The collector doesn't need to be running yet.
+        \return FALSE on failure.
+    */
+    public : bool
+        open(
+                ::fs::path      const & path
+            ,   LogSocketPolicy const & policy = {}
+            );
+
+    public : bool
+        is_open() const;
+
+    /** Try to deliver the pending Logs (see LogSocketPolicy::close_timeout),
+        then stop.
+    */
+    public : void
+        close();
+
+    public : void
+        operator()(::nsBase::Log &);
+
+    /// The count of Logs dropped since the spill buffer was full.
+    public : ::std::uint64_t
+        dropped_count() const;
+
+    private : struct
+        State;
+
+    private : ::std::unique_ptr<State>
+        m_state;
+};
+
+
+/**
+    The receiving end of LogSocketSender.
+
+    Listens on a Unix domain socket and passes each received Log to the sink
+    from a background thread. The default sink re-broadcasts the Log to the
+    consumers registered in this process - which therefore must not include a
+    LogSocketSender of the same socket.
+
+    Only available on POSIX systems - elsewhere open() fails.
+*/
+class LogSocketCollector
+{
+    R_DTOR(LogSocketCollector);
+    R_CTOR(LogSocketCollector);
+    R_CCPY(LogSocketCollector) = delete;
+    R_CMOV(LogSocketCollector);
+    R_COPY(LogSocketCollector) = delete;
+    R_MOVE(LogSocketCollector);
+
+    /** Create the socket and start receiving.
+        A stale socket file left by a crashed collector gets replaced.
+        \return FALSE on failure or if another collector serves the path.
+    */
+    public : bool
+        open(
+                ::fs::path                   const & path
+            ,   ::std::function<void(Log &)>         sink = {}
+            );
+
+    public : bool
+        is_open() const;
+
+    /** Stop receiving and remove the socket file.
+    */
+    public : void
+        close();
+
+    /// The count of Logs received.
+    public : ::std::uint64_t
+        received_count() const;
+
+    private : struct
+        State;
+
+    private : ::std::unique_ptr<State>
+        m_state;
+};
+
+}
@@ -0,0 +1,276 @@
+﻿/* Copyright (C) Ralf Kubis */
+#include "r_base/log_stream.h"
+#include "r_base/log_file_rotation.h"
+#include "r_base/compression.h"
+
+#include <fstream>
+#include <optional>
+#include <string_view>
+
+
+namespace nsBase
+{
+
+struct
+    LogStream::State
+        {
+            ::std::vector<::fs::path>
+                paths;
+
+            // index of the current file in paths
+            ::std::size_t
+                file_index {};
+
+            bool
+                is_open {};
+
+            bool
+                is_at_end {};
+
+            ::std::ifstream
+                file;
+
+            // set if the current file is compressed
+            ::std::optional<compression::FrameReader>
+                frame;
+
+            // decompressed data not consumed yet
+            ::std::string
+                block;
+
+            ::std::size_t
+                block_pos {};
+
+            ::std::string
+                line;
+
+            Log
+                log;
+
+            ::std::uint64_t
+                invalid_count {};
+
+            ::std::function<bool(::std::string_view)>
+                line_filter;
+
+
+            /// open the next file, FALSE if there is none
+            bool
+                open_next()
+                    {
+                        frame.reset();
+                        block.clear();
+                        block_pos = 0;
+
+                        if (is_open)
+                        {
+                            file.close();
+                            ++file_index;
+                        }
+
+                        is_open = false;
+
+                        if (file_index>=paths.size())
+                            return false;
+
+                        file.clear();
+                        file.open(paths[file_index], ::std::ios::in | ::std::ios::binary);
+
+                        if (!file.is_open())
+                            "0c6d1e58-93b4-4f27-a8e0-5b2f7c4d9a13"_log("failed to open ${path}")
+                                .path(paths[file_index])
+                                .throw_error();
+
+                        is_open = true;
+
+                        // rotated segments might be compressed
+                        char
+                            magic[compression::c_magic.size()] {};
+
+                        file.read(magic, sizeof(magic));
+
+                        auto
+                            is_compressed = file.gcount()==sizeof(magic) && compression::is_compressed({magic, sizeof(magic)});
+
+                        file.clear();
+                        file.seekg(0);
+
+                        if (is_compressed)
+                            frame.emplace(file);
+
+                        return true;
+                    }
+
+
+            /// the next line of the current file, FALSE at its end
+            bool
+                read_line()
+                    {
+                        if (!frame)
+                        {
+                            if (::std::getline(file, line))
+                                return true;
+
+                            if (file.bad())
+                                "7e2a4b91-c5d8-4f03-b6e1-2d9c8a7f5e40"_log("failed to read ${path}")
+                                    .path(paths[file_index])
+                                    .throw_error();
+
+                            return false;
+                        }
+
+                        while (true)
+                        {
+                            auto
+                                rest = ::std::string_view{block}.substr(block_pos);
+
+                            if (auto eol = rest.find('\n'); eol!=::std::string_view::npos)
+                            {
+                                line.assign(rest.data(), eol);
+                                block_pos += eol+1;
+
+                                return true;
+                            }
+
+                            // keep the incomplete line, drop the consumed ones
+                            block.erase(0, block_pos);
+                            block_pos = 0;
+
+                            if (!frame->read_block(block))
+                                break;
+                        }
+
+                        // the last line without a line break
+                        if (block.empty())
+                            return false;
+
+                        line.swap(block);
+                        block.clear();
+
+                        return true;
+                    }
+        };
+
+
+R_DTOR_IMPL(LogStream) = default;
+R_CMOV_IMPL(LogStream) = default;
+R_MOVE_IMPL(LogStream) = default;
+
+
+LogStream::LogStream(
+    ::std::vector<::fs::path> paths
+)
+:   m_state {::std::make_unique<State>()}
+{
+    m_state->paths = ::std::move(paths);
+}
+
+
+LogStream::iterator
+LogStream::begin()
+{
+    if (!m_state->is_open && !m_state->is_at_end)
+        next();
+
+    return iterator{this};
+}
+
+
+bool
+LogStream::next()
+{
+    auto &
+        s = *m_state;
+
+    if (s.is_at_end)
+        return false;
+
+    while (true)
+    {
+        if (!s.is_open || !s.read_line())
+        {
+            if (s.open_next())
+                continue;
+
+            s.is_at_end = true;
+            return false;
+        }
+
+        if (s.line_filter && !s.line_filter(s.line))
+            continue;
+
+        if (s.log.deserialize_assign(s.line))
+            return true;
+
+        ++s.invalid_count;
+    }
+}
+
+
+bool
+LogStream::is_at_end() const
+{
+    return m_state->is_at_end;
+}
+
+
+Log &
+LogStream::log()
+{
+    return m_state->log;
+}
+
+
+::fs::path const &
+LogStream::path() const
+{
+    static ::fs::path const
+        none;
+
+    if (m_state->file_index>=m_state->paths.size())
+        return none;
+
+    return m_state->paths[m_state->file_index];
+}
+
+
+::std::uint64_t
+LogStream::invalid_count() const
+{
+    return m_state->invalid_count;
+}
+
+
+void
+LogStream::line_filter_assign(
+    ::std::function<bool(::std::string_view)> filter
+)
+{
+    m_state->line_filter = ::std::move(filter);
+}
+
+
+LogStream
+log_stream(
+    ::fs::path const & path
+)
+{
+    auto
+        paths = log_segments(path);
+
+    if (::fs::exists(path))
+        paths.push_back(path);
+
+    return LogStream{::std::move(paths)};
+}
+
+
+LogStream
+log_stream(
+    ::std::vector<::fs::path> paths
+)
+{
+    return LogStream{::std::move(paths)};
+}
+
+}
@@ -0,0 +1,172 @@
+﻿#pragma once
+/* Copyright (C) Ralf Kubis */
+
+#include "r_base/language_tools.h"
+#include "r_base/filesystem.h"
+#include "r_base/Log.h"
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+
+namespace nsBase
+{
+
+/**
+    Reads the Logs of a sequence of log files one by one.
+
+    Unlike log_read(), the Logs are not collected. A single Log instance gets
+    re-filled for every line, so the memory needed is bounded by the longest
+    line (and a block of a compressed segment), regardless of the file sizes.
+
+        for (auto const & log : log_stream(path))
+            ...
+
+    The Log referenced by the iterator is valid until the next increment.
+    Segments compressed by the log rotation are decompressed on the fly.
+    Lines that are no Logs are skipped.
+*/
+class LogStream
+{
+    R_DTOR(LogStream);
+    R_CTOR(LogStream) = delete;
+    R_CCPY(LogStream) = delete;
+    R_CMOV(LogStream);
+    R_COPY(LogStream) = delete;
+    R_MOVE(LogStream);
+
+    /** Stream the target files in the given order.
+    */
+    public : explicit
+        LogStream(
+                ::std::vector<::fs::path> paths
+            );
+
+    public : class
+        iterator
+        {
+            public : using iterator_category = ::std::input_iterator_tag;
+            public : using value_type        = Log;
+            public : using difference_type   = ::std::ptrdiff_t;
+            public : using pointer           = Log *;
+            public : using reference         = Log &;
+
+            R_CTOR(iterator) = default;
+
+            public : explicit
+                iterator(
+                        LogStream * stream
+                    )
+                    :   m_stream {stream}
+                    {
+                    }
+
+            public : reference
+                operator*() const
+                    {
+                        return m_stream->log();
+                    }
+
+            public : pointer
+                operator->() const
+                    {
+                        return &m_stream->log();
+                    }
+
+            public : iterator &
+                operator++()
+                    {
+                        m_stream->next();
+                        return *this;
+                    }
+
+            public : void
+                operator++(int)
+                    {
+                        m_stream->next();
+                    }
+
+            public : friend bool
+                operator==(
+                        iterator const & it
+                    ,   ::std::default_sentinel_t
+                    )
+                    {
+                        return !it.m_stream || it.m_stream->is_at_end();
+                    }
+
+            private : LogStream *
+                m_stream {};
+        };
+
+    /** Read the first Log.
+        \throws if a file cannot be read.
+    */
+    public : iterator
+        begin();
+
+    public : ::std::default_sentinel_t
+        end() const
+            {
+                return {};
+            }
+
+    /** Read the next Log.
+        \return FALSE at the end of the last file.
+        \throws if a file cannot be read.
+    */
+    public : bool
+        next();
+
+    public : bool
+        is_at_end() const;
+
+    /** The current Log.
+    */
+    public : Log &
+        log();
+
+    /** The file of the current Log.
+    */
+    public : ::fs::path const &
+        path() const;
+
+    /** Count of the lines skipped so far since they were no Logs.
+    */
+    public : ::std::uint64_t
+        invalid_count() const;
+
+    /** Lines the filter rejects are skipped without being deserialized.
+        The filter sees the raw line.
+    */
+    public : void
+        line_filter_assign(
+                ::std::function<bool(::std::string_view)> filter
+            );
+
+    private : struct
+        State;
+
+    private : ::std::unique_ptr<State>
+        m_state;
+};
+
+
+/** Stream the Logs of a log file including its rotated segments, oldest first.
+*/
+LogStream
+    log_stream(
+            ::fs::path const & path
+        );
+
+/** Stream the Logs of the target files in the given order.
+*/
+LogStream
+    log_stream(
+            ::std::vector<::fs::path> paths
+        );
+
+}
@@ -1,9 +1,30 @@
-﻿#include <csignal>
+﻿#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <ctime>
 #include <string>
-#include <map>
+#include <thread>
 
+#include "r_base/signals.h"
 #include "r_base/Log.h"
 #include "r_base/uuid.h"
+#include "r_base/current.h"
+#include "r_base/log_consumer_file.h"
+
+#include <nlohmann/json/json.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/signalfd.h>
+#endif
 
 
 namespace nsBase
@@ -16,8 +37,12 @@ namespace
 {
 using t_handler = void(*)(int);
 
-::std::map<int,t_handler>
-    default_handlers;
+constexpr int
+    c_signal_max = 65;
+
+// the handlers that were installed before, indexed by signal
+::std::array<::std::atomic<t_handler>,c_signal_max>
+    default_handlers {};
 
 uuid
     signal_to_uuid(
@@ -78,6 +103,269 @@ uuid
             default      : return "<unknown>"s;
             }
         }
+
+
+constexpr auto
+    c_creator = "c3c67049-cef2-4ba8-b9c3-4f8aa761688d"_uuid;
+
+constexpr auto
+    c_message = "Received signal [${data}] - ${description}";
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Everything below is used inside the signal handler. Only async-signal-safe
+// functions and lock-free atomics are allowed there, nothing allocates.
+
+static_assert(::std::atomic<t_handler>::is_always_lock_free);
+static_assert(::std::atomic<char const *>::is_always_lock_free);
+static_assert(::std::atomic<::std::size_t>::is_always_lock_free);
+static_assert(::std::atomic<unsigned>::is_always_lock_free);
+static_assert(::std::atomic<int>::is_always_lock_free);
+
+::std::atomic<int>
+    emergency_fd {2};
+
+// the JSON line of each signal up to the value of '_time'
+struct
+    Preformatted
+        {
+            char
+                text[1024];
+
+            ::std::atomic<::std::size_t>
+                size;
+        };
+
+::std::array<Preformatted,c_signal_max>
+    preformatted {};
+
+// the line under construction
+char
+    emergency_line[1024 + 64];
+
+::std::atomic_flag
+    emergency_busy = ATOMIC_FLAG_INIT;
+
+constexpr ::std::size_t
+    c_drain_slots = 16;
+
+::std::array<::std::atomic<SignalDrainBuffer*>,c_drain_slots>
+    drain_slots {};
+
+
+void
+    emergency_write(
+            int           fd
+        ,   char const *  data
+        ,   ::std::size_t size
+        )
+        {
+            while (size)
+            {
+#ifdef _WIN32
+                auto n = ::_write(fd, data, unsigned(size));
+#else
+                auto n = ::write(fd, data, size);
+
+                if (n<0 && errno==EINTR)
+                    continue;
+#endif
+                if (n<=0)
+                    return;
+
+                data += n;
+                size -= ::std::size_t(n);
+            }
+        }
+
+
+/// 'YYYY-MM-DDTHH:mm:ss.mmmZ', returns the end of the written text
+char *
+    format_now_utc(
+            char * out
+        )
+        {
+            ::timespec
+                ts {};
+
+#ifdef _WIN32
+            ::timespec_get(&ts, TIME_UTC);
+#else
+            ::clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+
+            auto
+                secs = ::std::int64_t(ts.tv_sec);
+
+            auto
+                days = secs / 86400;
+
+            auto
+                sod = secs % 86400;
+
+            // civil_from_days() by Howard Hinnant
+            auto z   = days + 719468;
+            auto era = (z >= 0 ? z : z - 146096) / 146097;
+            auto doe = z - era * 146097;
+            auto yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+            auto doy = doe - (365*yoe + yoe/4 - yoe/100);
+            auto mp  = (5*doy + 2) / 153;
+            auto d   = doy - (153*mp + 2)/5 + 1;
+            auto m   = mp < 10 ? mp+3 : mp-9;
+            auto y   = yoe + era * 400 + (m <= 2);
+
+            auto
+                put = [&](::std::int64_t v, int digits)
+                    {
+                        for (auto i = digits-1; i>=0; --i)
+                        {
+                            out[i] = char('0' + v%10);
+                            v /= 10;
+                        }
+                        out += digits;
+                    };
+
+            put(y, 4);             *out++ = '-';
+            put(m, 2);             *out++ = '-';
+            put(d, 2);             *out++ = 'T';
+            put(sod/3600, 2);      *out++ = ':';
+            put(sod/60%60, 2);     *out++ = ':';
+            put(sod%60, 2);        *out++ = '.';
+            put(ts.tv_nsec/1000000, 3);
+            *out++ = 'Z';
+
+            return out;
+        }
+
+
+void
+    emergency_drain()
+        {
+            for (auto & slot : drain_slots)
+            {
+                auto
+                    b = slot.load();
+
+                if (!b)
+                    continue;
+
+                // a few attempts, the interrupted thread may be the publishing one
+                for (auto attempt=0; attempt<4; ++attempt)
+                {
+                    auto sequence = b->sequence.load(::std::memory_order_acquire);
+
+                    if (sequence & 1)
+                        continue;
+
+                    auto data = b->data.load(::std::memory_order_relaxed);
+                    auto size = b->size.load(::std::memory_order_relaxed);
+                    auto fd   = b->fd  .load(::std::memory_order_relaxed);
+
+                    ::std::atomic_thread_fence(::std::memory_order_acquire);
+
+                    if (b->sequence.load(::std::memory_order_relaxed)!=sequence)
+                        continue;
+
+                    if (data && size)
+                        emergency_write(fd>=0 ? fd : emergency_fd.load(), data, size);
+
+                    break;
+                }
+            }
+        }
+
+
+void
+    emergency_log(
+            int sig
+        )
+        {
+            auto &
+                pre = preformatted[sig>=0 && sig<c_signal_max ? sig : 0];
+
+            auto
+                size = pre.size.load();
+
+            if (!size)
+                return;
+
+            auto
+                out = emergency_line;
+
+            ::std::memcpy(out, pre.text, size);
+            out += size;
+            out  = format_now_utc(out);
+            *out++ = '"';
+            *out++ = '}';
+            *out++ = '\n';
+
+            emergency_write(emergency_fd.load(), emergency_line, ::std::size_t(out - emergency_line));
+        }
+
+
+void
+    default_action(
+            int sig
+        )
+        {
+            auto
+                handler = sig>=0 && sig<c_signal_max ? default_handlers[sig].load() : nullptr;
+
+            if (handler)
+            {
+                handler(sig);
+            }
+            else
+            {
+                ::std::signal(sig, SIG_DFL);
+                ::std::raise(sig);
+            }
+        }
+////////////////////////////////////////////////////////////////////////////////
+
+
+void
+    preformat(
+            int sig
+        )
+        {
+            if (sig<0 || sig>=c_signal_max)
+                return;
+
+            auto
+                q = [](::std::string const & s)
+                    {
+                        return ::nlohmann::json(s).dump(-1, ' ', false, ::nlohmann::json::error_handler_t::replace);
+                    };
+
+            auto
+                session = current::thread_session_id();
+
+            auto
+                text =
+                        "{\"_host\":"       + q(current::host())
+                    +   ",\"_id_creator\":" + q(to_string(c_creator))
+                    +   ",\"_id_event\":"   + q(to_string(signal_to_uuid(sig)))
+                    +   (session.is_nil() ? ""s : ",\"_id_session\":" + q(to_string(session)))
+                    +   ",\"_level\":"      + q(to_string(Log::Level::CRITICAL))
+                    +   ",\"_status\":"     + q(to_string(Log::Status::OK))
+                    +   ",\"_user\":"       + q(current::user())
+                    +   ",\"data\":"        + q(signal_to_string(sig))
+                    +   ",\"description\":" + q(signal_to_description(sig))
+                    +   ",\"message\":"     + q(c_message)
+                    +   ",\"_time\":\""
+                    ;
+
+            auto &
+                pre = preformatted[sig];
+
+            if (text.size() > sizeof(pre.text))
+                return;
+
+            pre.size.store(0);
+            ::std::memcpy(pre.text, text.data(), text.size());
+            pre.size.store(text.size());
+        }
 }
 
 
@@ -86,27 +374,16 @@ signal_handler(
     int signal
 )
 {
-    "c3c67049-cef2-4ba8-b9c3-4f8aa761688d"_log
-        ("Received signal [${data}] - ${description}")
-        .critical()
-        .event(signal_to_uuid(signal))
-        .data(signal_to_string(signal))
-        ("description",signal_to_description(signal))
-        ;
-
-    // invoke the default handler
-    auto it = default_handlers.find(signal);
-
-    if (it!=default_handlers.end())
-    {
-        if (it->second)
-            it->second(signal);
-    }
-    else
+    // a second crashing thread must not garble the line of the first one
+    if (!emergency_busy.test_and_set())
     {
-        ::std::signal(signal, SIG_DFL);
-        ::std::raise(signal);
+        emergency_drain();
+        emergency_log(signal);
+
+        emergency_busy.clear();
     }
+
+    default_action(signal);
 }
 
 
@@ -118,7 +395,17 @@ install_signal_logger()
                 int sig
             )
             {
-                if (auto old = ::std::signal(sig, signal_handler))
+                preformat(sig);
+
+                auto
+                    old = ::std::signal(sig, signal_handler);
+
+                if (old==SIG_IGN)
+                {
+                    // keep ignoring
+                    ::std::signal(sig, SIG_IGN);
+                }
+                else if (old!=SIG_DFL && old!=SIG_ERR && old!=signal_handler)
                 {
                     default_handlers[sig] = old;
                 }
@@ -135,4 +422,133 @@ install_signal_logger()
     add(SIGABRT ); // abnormal termination triggered by abort call
 }
 
+
+void
+signal_logger_fd_assign(
+    int fd
+)
+{
+    emergency_fd = fd;
+}
+
+
+void
+SignalDrainBuffer::publish(
+    char const *  data
+,   ::std::size_t size
+,   int           fd
+)
+{
+    auto
+        s = sequence.load(::std::memory_order_relaxed);
+
+    sequence.store(s+1, ::std::memory_order_relaxed);
+    ::std::atomic_thread_fence(::std::memory_order_release);
+
+    this->data.store(data, ::std::memory_order_relaxed);
+    this->size.store(size, ::std::memory_order_relaxed);
+    this->fd  .store(fd  , ::std::memory_order_relaxed);
+
+    sequence.store(s+2, ::std::memory_order_release);
+}
+
+
+on_delete
+signal_drain_register(
+    SignalDrainBuffer & buffer
+)
+{
+    for (auto & slot : drain_slots)
+    {
+        SignalDrainBuffer *
+            null {};
+
+        if (slot.compare_exchange_strong(null, &buffer))
+            return on_delete{[&slot](){slot = nullptr;}};
+    }
+
+    "2e7b94d0-61c3-4f5a-9d8e-0b4a7c3f1e26"_log("no free signal drain slot")
+        .warning()
+        ;
+
+    return {};
+}
+
+
+bool
+install_signal_logger_thread()
+{
+#ifdef __linux__
+    ::sigset_t
+        set;
+
+    ::sigemptyset(&set);
+    ::sigaddset(&set, SIGINT);
+    ::sigaddset(&set, SIGTERM);
+
+    if (::pthread_sigmask(SIG_BLOCK, &set, nullptr)!=0)
+        return false;
+
+    auto
+        fd = ::signalfd(-1, &set, SFD_CLOEXEC);
+
+    if (fd<0)
+    {
+        ::pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+        return false;
+    }
+
+    ::std::thread(
+            [fd]()
+            {
+                while (true)
+                {
+                    ::signalfd_siginfo
+                        info;
+
+                    auto
+                        n = ::read(fd, &info, sizeof(info));
+
+                    if (n<0 && errno==EINTR)
+                        continue;
+
+                    if (n!=sizeof(info))
+                        return;
+
+                    auto
+                        sig = int(info.ssi_signo);
+
+                    Log{c_creator}
+                        .message(c_message)
+                        .critical()
+                        .event(signal_to_uuid(sig))
+                        .data(signal_to_string(sig))
+                        ("description",signal_to_description(sig))
+                        ("sender_pid",::std::int64_t(info.ssi_pid))
+                        ;
+
+                    log_consumer_file_flush();
+
+                    ::sigset_t
+                        one;
+
+                    ::sigemptyset(&one);
+                    ::sigaddset(&one, sig);
+
+                    // the default action has to reach this thread
+                    ::pthread_sigmask(SIG_UNBLOCK, &one, nullptr);
+
+                    default_action(sig);
+
+                    ::pthread_sigmask(SIG_BLOCK, &one, nullptr);
+                }
+            }
+        ).detach();
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 }
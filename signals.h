@@ -1,10 +1,101 @@
 ﻿#pragma once
 
 #include "r_base/decl.h"
+#include "r_base/on_delete.h"
+
+#include <atomic>
+#include <cstddef>
 
 
 namespace nsBase
 {
+/**
+    Log the fatal signals (SIGSEGV, SIGABRT, ...) and continue with the
+    previously installed handler or the default action.
+
+    The handler does not build a Log since that allocates, locks and runs the
+    consumers - all of which may deadlock a crashing process. Instead it
+    appends a pre-formatted JSON line (readable by log_read()) to the emergency
+    file descriptor using write(2) only. Before that, the buffers registered
+    by signal_drain_register() get written out to their files.
+*/
 void
     install_signal_logger();
+
+/**
+    Direct the emergency output of the signal logger to the target file
+    descriptor. It has to stay open. The default is stderr.
+*/
+void
+    signal_logger_fd_assign(
+            int fd
+        );
+
+/**
+    Handle SIGINT and SIGTERM in a dedicated thread (Linux signalfd) instead of
+    a signal handler. They get logged through the regular pipeline, then the
+    previous handler or the default action is performed.
+
+    The signals get blocked in the calling thread - call this in main()
+    before any other thread gets started so all threads inherit the mask.
+
+    \return FALSE if not supported on this platform.
+*/
+bool
+    install_signal_logger_thread();
+
+
+/**
+    An in-process log buffer that the signal logger writes out to the file
+    it is buffered for when a signal is received.
+
+    The owner publishes the content whenever it changes and withdraws it
+    before the memory gets reallocated or overwritten. The fields are
+    published together under a sequence lock, so the handler never pairs the
+    data of one publication with the size or file of another. It doesn't
+    wait for a publication in progress, so the output is best effort.
+*/
+struct
+    SignalDrainBuffer
+        {
+            /** Publish the content.
+                \param fd The file to write it to, -1 for the emergency output
+                           (see signal_logger_fd_assign()).
+                Publications of a buffer must not run concurrently.
+            */
+            void
+                publish(
+                        char const *  data
+                    ,   ::std::size_t size
+                    ,   int           fd
+                    );
+
+            void
+                withdraw()
+                    {
+                        publish(nullptr, 0, -1);
+                    }
+
+            // odd while a publication is in progress
+            ::std::atomic<unsigned>
+                sequence {};
+
+            ::std::atomic<char const *>
+                data {};
+
+            ::std::atomic<::std::size_t>
+                size {};
+
+            ::std::atomic<int>
+                fd {-1};
+        };
+
+/**
+    Register the target buffer for being written out by the signal logger.
+    The buffer must outlive the registration.
+*/
+[[nodiscard]] on_delete
+    signal_drain_register(
+            SignalDrainBuffer & buffer
+        );
 }